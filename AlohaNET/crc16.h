@@ -0,0 +1,79 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint8_t, uint16_t
+
+/**
+ * CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF, no reflection, no final XOR) for the MAC frames.
+ *
+ * Unlike the former 8-bit additive checksum it detects all burst errors up to 16 bits, all odd numbers of bit
+ * errors and swapped bytes. crc16_update processes 8 bytes per step with eight lookup tables (slicing-by-8)
+ * and the tail byte by byte with the first table. The tables are built by crc16_init, which has to be called
+ * once before the first checksum (the MAC init functions do this).
+ *
+ * Usage: crc = crc16_update(CRC16_INIT, header, headerLen); crc = crc16_update(crc, payload, payloadLen);
+ */
+
+#define CRC16_INIT 0xFFFF
+#define CRC16_POLY 0x1021
+
+// crc16_tables[k][n]: CRC of byte n followed by k zero bytes
+static uint16_t crc16_tables[8][256];
+
+/**
+ * @brief Build the lookup tables
+ */
+static inline void crc16_init()
+{
+    for (unsigned int n = 0; n < 256; n++)
+    {
+        uint16_t crc = n << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (crc << 1) ^ CRC16_POLY : crc << 1;
+        crc16_tables[0][n] = crc;
+    }
+
+    for (unsigned int n = 0; n < 256; n++)
+        for (int k = 1; k < 8; k++)
+        {
+            uint16_t prev = crc16_tables[k - 1][n];
+            crc16_tables[k][n] = (prev << 8) ^ crc16_tables[0][prev >> 8];
+        }
+}
+
+/**
+ * @brief Continue a CRC one byte per table lookup
+ */
+static inline uint16_t crc16_table(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while (len--)
+        crc = (crc << 8) ^ crc16_tables[0][(crc >> 8) ^ *data++];
+
+    return crc;
+}
+
+/**
+ * @brief Continue a CRC over data, eight bytes per step
+ * @param crc CRC16_INIT or the result of a previous call
+ */
+static inline uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while (len >= 8)
+    {
+        crc = crc16_tables[7][data[0] ^ (crc >> 8)] ^
+              crc16_tables[6][data[1] ^ (crc & 0xFF)] ^
+              crc16_tables[5][data[2]] ^
+              crc16_tables[4][data[3]] ^
+              crc16_tables[3][data[4]] ^
+              crc16_tables[2][data[5]] ^
+              crc16_tables[1][data[6]] ^
+              crc16_tables[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+
+    return crc16_table(crc, data, len);
+}
+
+#endif /* CRC16_H */
@@ -0,0 +1,94 @@
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+#include <pthread.h>   // pthread_t, pthread_attr_t
+#include <semaphore.h> // sem_t
+#include <stdint.h>    // uint64_t
+#include <time.h>      // time_t, clockid_t, struct timespec
+#include <unistd.h>    // useconds_t
+
+/**
+ * Virtual clock for the protocol stacks.
+ *
+ * Every sleep, time query and blocking semaphore operation in common/ goes through these functions.
+ * By default (VCLOCK unset or "real") they are thin wrappers around the libc calls.
+ *
+ * With VCLOCK=sim the process runs as a discrete-event simulation:
+ *  - Threads created with vclock_thread_create (and the thread that first uses the clock) run one at a
+ *    time, in a fixed FIFO order, so the same seed gives the same interleaving and the same rand() stream.
+ *  - A thread that sleeps or blocks on a semaphore hands over to the next runnable thread. When no thread
+ *    is runnable, the clock jumps to the earliest deadline instead of waiting for it.
+ *  - VCLOCK_SEED fixes the value returned by vclock_seed (otherwise salt * time(NULL) as before),
+ *    VCLOCK_EPOCH the wall clock time at the start of the simulation (default 2024-01-01T00:00:00Z).
+ *
+ * Threads that block outside these functions (raw sem_wait, read, ...) stall the simulation while they hold
+ * the clock, so application code should use vclock_* for its own sleeps as well.
+ *
+ * Several processes (e.g. nodes connected to airsim) can share one clock: a process registers a sync
+ * callback, reports when it is idle and only moves on when vclock_advance is called.
+ */
+
+/**
+ * @brief Initialise the clock from the environment. Called implicitly by the first vclock_* call.
+ */
+void vclock_init();
+
+/**
+ * @returns 1 if the clock is simulated, 0 if it is the real clock
+ */
+int vclock_isSim();
+
+/**
+ * @brief pthread_create for threads that use the clock
+ */
+int vclock_thread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg);
+
+/**
+ * @brief pthread_join that hands over the clock while waiting (in simulation the thread cannot finish otherwise)
+ */
+int vclock_thread_join(pthread_t thread, void **ret);
+
+time_t vclock_time(time_t *t);
+int vclock_gettime(clockid_t clock, struct timespec *ts);
+
+/**
+ * @returns Nanoseconds on CLOCK_MONOTONIC (virtual in simulation, shared by all processes of a simulation)
+ */
+uint64_t vclock_now();
+
+unsigned int vclock_sleep(unsigned int s);
+int vclock_usleep(useconds_t us);
+unsigned int vclock_msleep(unsigned int ms);
+
+/**
+ * @brief Sleep until the given time in nanoseconds on CLOCK_MONOTONIC (see vclock_now)
+ */
+void vclock_sleepUntil(uint64_t ns);
+
+/**
+ * @brief Semaphore operations. In simulation all waits and posts on a semaphore must use these.
+ * vclock_sem_timedwait takes a CLOCK_REALTIME deadline like sem_timedwait, vclock_sem_clockwait any clock.
+ */
+int vclock_sem_wait(sem_t *sem);
+int vclock_sem_timedwait(sem_t *sem, const struct timespec *abstime);
+int vclock_sem_clockwait(sem_t *sem, clockid_t clock, const struct timespec *abstime);
+int vclock_sem_post(sem_t *sem);
+
+/**
+ * @returns Seed for srand: salt * time(NULL), or derived from VCLOCK_SEED and salt in simulation
+ */
+unsigned int vclock_seed(unsigned int salt);
+
+/**
+ * @brief Multi-process simulation. Once a sync callback is set the process no longer advances its own clock:
+ * whenever no thread is runnable, idle(next, arg) is called with the earliest deadline (0 -> none) and the
+ * process waits for vclock_advance.
+ * vclock_enter/vclock_leave bracket work done by a thread that is not managed by the clock (e.g. the thread
+ * reading the coordinator socket), vclock_advance must be called between them.
+ */
+void vclock_setSync(void (*idle)(uint64_t next, void *arg), void *arg);
+void vclock_enter();
+void vclock_leave();
+void vclock_advance(uint64_t now);
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <errno.h>         // errno, ETIMEDOUT
+#include <sched.h>         // sched_yield
+#include <semaphore.h>     // sem_t, sem_init
+#include <stdatomic.h>     // atomic_uint, atomic_load_explicit, atomic_store_explicit
+#include <stdbool.h>       // bool, true, false
+#include <stddef.h>        // size_t
+#include <stdint.h>        // uint8_t
+#include <string.h>        // memcpy
+#include <time.h>          // struct timespec
+
+#include "vclock.h"
+
+/**
+ * Lock-free single-producer single-consumer ring of fixed-size elements.
+ *
+ * Push and pop only touch the two indices. A thread parks on a semaphore only when the ring is full (producer)
+ * or empty (consumer), and the other side posts it only if it sees the parked flag, so a busy queue costs no
+ * system calls. The semaphores go through vclock so the ring also works with VCLOCK=sim.
+ *
+ * Exactly one thread may push and one thread may pop at a time; callers with several producers or consumers
+ * have to serialise that side themselves.
+ */
+
+#define SPSC_CACHELINE 64
+
+// Retries with sched_yield before a thread parks, lets the other side catch up without a futex wake
+#define SPSC_SPIN 8
+
+typedef struct SPSC
+{
+    _Alignas(SPSC_CACHELINE) atomic_uint head; // next slot to write, only written by the producer
+    atomic_int consumerParked;                 // consumer waits on notEmpty
+
+    _Alignas(SPSC_CACHELINE) atomic_uint tail; // next slot to read, only written by the consumer
+    atomic_int producerParked;                 // producer waits on notFull
+
+    _Alignas(SPSC_CACHELINE) uint8_t *slots; // size * elemSize bytes
+    unsigned int mask;                       // size - 1, size is a power of two
+    size_t elemSize;
+    sem_t notEmpty, notFull;
+} SPSC;
+
+/**
+ * @brief Initialise the ring on caller-provided storage
+ * @param slots Array of size elements
+ * @param size Number of elements, must be a power of two
+ * @param elemSize Size of one element in bytes
+ */
+static inline void spsc_init(SPSC *q, void *slots, unsigned int size, size_t elemSize)
+{
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->consumerParked, 0);
+    atomic_init(&q->producerParked, 0);
+    q->slots = slots;
+    q->mask = size - 1;
+    q->elemSize = elemSize;
+    sem_init(&q->notEmpty, 0, 0);
+    sem_init(&q->notFull, 0, 0);
+}
+
+/**
+ * @returns Number of elements in the ring (exact only when called by the producer or the consumer)
+ */
+static inline unsigned int spsc_count(SPSC *q)
+{
+    return atomic_load_explicit(&q->head, memory_order_acquire) - atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+static inline bool spsc_trypush(SPSC *q, const void *elem)
+{
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&q->tail, memory_order_seq_cst) > q->mask)
+        return false;
+
+    memcpy(q->slots + (head & q->mask) * q->elemSize, elem, q->elemSize);
+    atomic_store_explicit(&q->head, head + 1, memory_order_seq_cst);
+
+    // wake the consumer only if it is parked
+    if (atomic_load_explicit(&q->consumerParked, memory_order_seq_cst) && atomic_exchange(&q->consumerParked, 0))
+        vclock_sem_post(&q->notEmpty);
+    return true;
+}
+
+static inline bool spsc_trypop(SPSC *q, void *elem)
+{
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&q->head, memory_order_seq_cst))
+        return false;
+
+    memcpy(elem, q->slots + (tail & q->mask) * q->elemSize, q->elemSize);
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_seq_cst);
+
+    // wake the producer only if it is parked
+    if (atomic_load_explicit(&q->producerParked, memory_order_seq_cst) && atomic_exchange(&q->producerParked, 0))
+        vclock_sem_post(&q->notFull);
+    return true;
+}
+
+// Park on sem until the other side clears flag and posts, or until abstime (CLOCK_REALTIME, NULL -> no timeout).
+// The caller retries its operation afterwards, a stale post only causes one extra retry.
+static inline bool spsc_park(atomic_int *flag, sem_t *sem, const struct timespec *abstime)
+{
+    int ret = abstime == NULL ? vclock_sem_wait(sem) : vclock_sem_timedwait(sem, abstime);
+    if (ret == -1 && errno == ETIMEDOUT)
+    {
+        atomic_store(flag, 0);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Push elem, waiting for a free slot until abstime (CLOCK_REALTIME, NULL -> no timeout)
+ * @returns false on timeout
+ */
+static inline bool spsc_timedpush(SPSC *q, const void *elem, const struct timespec *abstime)
+{
+    for (int i = 0; i < SPSC_SPIN; i++)
+    {
+        if (spsc_trypush(q, elem))
+            return true;
+        sched_yield();
+    }
+
+    while (!spsc_trypush(q, elem))
+    {
+        // announce the wait, then check again so a pop in between is not missed
+        atomic_store(&q->producerParked, 1);
+        if (spsc_trypush(q, elem))
+        {
+            atomic_store(&q->producerParked, 0);
+            return true;
+        }
+        if (!spsc_park(&q->producerParked, &q->notFull, abstime))
+            return spsc_trypush(q, elem);
+    }
+    return true;
+}
+
+/**
+ * @brief Pop into elem, waiting for an element until abstime (CLOCK_REALTIME, NULL -> no timeout)
+ * @returns false on timeout
+ */
+static inline bool spsc_timedpop(SPSC *q, void *elem, const struct timespec *abstime)
+{
+    for (int i = 0; i < SPSC_SPIN; i++)
+    {
+        if (spsc_trypop(q, elem))
+            return true;
+        sched_yield();
+    }
+
+    while (!spsc_trypop(q, elem))
+    {
+        // announce the wait, then check again so a push in between is not missed
+        atomic_store(&q->consumerParked, 1);
+        if (spsc_trypop(q, elem))
+        {
+            atomic_store(&q->consumerParked, 0);
+            return true;
+        }
+        if (!spsc_park(&q->consumerParked, &q->notEmpty, abstime))
+            return spsc_trypop(q, elem);
+    }
+    return true;
+}
+
+static inline void spsc_push(SPSC *q, const void *elem)
+{
+    spsc_timedpush(q, elem, NULL);
+}
+
+static inline void spsc_pop(SPSC *q, void *elem)
+{
+    spsc_timedpop(q, elem, NULL);
+}
+
+#endif // SPSC_H
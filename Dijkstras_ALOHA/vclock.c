@@ -0,0 +1,558 @@
+#define _GNU_SOURCE
+#include <errno.h>   // errno, ETIMEDOUT
+#include <stdio.h>   // fprintf
+#include <stdlib.h>  // getenv, malloc, free, exit
+#include <string.h>  // strcmp
+
+#include "vclock.h"
+
+// Virtual CLOCK_MONOTONIC at the start of a simulation, identical in all processes
+#define SIM_START 1000000000ULL
+
+// Default wall clock time at the start of a simulation (2024-01-01T00:00:00Z)
+#define SIM_EPOCH 1704067200ULL
+
+/**
+ * @brief Thread managed by the simulated clock
+ */
+typedef struct VThread
+{
+    pthread_cond_t cond;  // signalled when the thread becomes the running thread
+    sem_t *sem;           // semaphore the thread waits on (NULL -> sleeping)
+    uint64_t deadline;    // wake-up time on the virtual monotonic clock (0 -> none)
+    uint64_t seq;         // order in which threads blocked, breaks ties between equal deadlines
+    int timedOut;         // woken by the clock instead of a post
+    struct VThread *next; // next thread in the run queue or the wait list
+    void *(*start)(void *);
+    void *arg;
+} VThread;
+
+static struct
+{
+    int sim;                             // simulated clock
+    pthread_mutex_t lock;                // protects everything below
+    uint64_t now;                        // virtual CLOCK_MONOTONIC in ns
+    uint64_t realBase;                   // virtual CLOCK_REALTIME - CLOCK_MONOTONIC in ns
+    VThread *current;                    // thread that may run, NULL -> none
+    VThread *runHead, *runTail;          // runnable threads in FIFO order
+    VThread *waiting;                    // blocked threads
+    uint64_t seq;                        // counter for VThread.seq
+    VThread external;                    // stands for the thread between vclock_enter and vclock_leave
+    pthread_cond_t released;             // signalled when no thread is running
+    void (*idle)(uint64_t next, void *); // sync callback for multi-process simulations
+    void *idleArg;
+    int seeded;                          // VCLOCK_SEED is set
+    unsigned int seed;                   // value of VCLOCK_SEED
+    int warned;                          // deadlock already reported
+} vc;
+
+static __thread VThread *self;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static uint64_t ts2ns(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void ns2ts(uint64_t ns, struct timespec *ts)
+{
+    ts->tv_sec = ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+static VThread *newThread()
+{
+    VThread *t = calloc(1, sizeof(VThread));
+    if (t == NULL)
+    {
+        fprintf(stderr, "vclock: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_cond_init(&t->cond, NULL);
+    return t;
+}
+
+static void runQ_push(VThread *t)
+{
+    t->next = NULL;
+    if (vc.runTail)
+        vc.runTail->next = t;
+    else
+        vc.runHead = t;
+    vc.runTail = t;
+}
+
+static VThread *runQ_pop()
+{
+    VThread *t = vc.runHead;
+    if (t)
+    {
+        vc.runHead = t->next;
+        if (vc.runHead == NULL)
+            vc.runTail = NULL;
+    }
+    return t;
+}
+
+static void waiting_remove(VThread *t)
+{
+    for (VThread **p = &vc.waiting; *p; p = &(*p)->next)
+        if (*p == t)
+        {
+            *p = t->next;
+            return;
+        }
+}
+
+// Earliest deadline of all blocked threads, 0 -> none
+static uint64_t nextDeadline()
+{
+    uint64_t next = 0;
+    for (VThread *t = vc.waiting; t; t = t->next)
+        if (t->deadline && (next == 0 || t->deadline < next))
+            next = t->deadline;
+    return next;
+}
+
+// Make every thread whose deadline has passed runnable, ordered by deadline and then by blocking order
+static void wakeDue()
+{
+    while (1)
+    {
+        VThread *first = NULL;
+        for (VThread *t = vc.waiting; t; t = t->next)
+            if (t->deadline && t->deadline <= vc.now &&
+                (first == NULL || t->deadline < first->deadline || (t->deadline == first->deadline && t->seq < first->seq)))
+                first = t;
+        if (first == NULL)
+            return;
+
+        waiting_remove(first);
+        first->timedOut = 1;
+        runQ_push(first);
+    }
+}
+
+// Hand the clock to the next runnable thread; if there is none, advance time (or report idle). Lock held.
+static void dispatch()
+{
+    vc.current = NULL;
+    while (1)
+    {
+        VThread *t = runQ_pop();
+        if (t)
+        {
+            vc.current = t;
+            pthread_cond_signal(&t->cond);
+            return;
+        }
+
+        // nothing runnable: another process decides when time moves on
+        pthread_cond_broadcast(&vc.released);
+        if (vc.idle)
+        {
+            vc.idle(nextDeadline(), vc.idleArg);
+            return;
+        }
+
+        uint64_t next = nextDeadline();
+        if (next == 0)
+        {
+            if (!vc.warned)
+                fprintf(stderr, "vclock: all threads are blocked without a timeout\n");
+            vc.warned = 1;
+            return;
+        }
+
+        // jump to the next deadline
+        vc.now = next;
+        wakeDue();
+    }
+}
+
+// Wait until t is the running thread. Lock held.
+static void awaitTurn(VThread *t)
+{
+    while (vc.current != t)
+        pthread_cond_wait(&t->cond, &vc.lock);
+}
+
+// Block the running thread on sem and/or until deadline. Lock held. @returns 1 if woken by the deadline
+static int block(sem_t *sem, uint64_t deadline)
+{
+    if (deadline && deadline <= vc.now)
+        return 1;
+
+    self->sem = sem;
+    self->deadline = deadline;
+    self->timedOut = 0;
+    self->seq = ++vc.seq;
+    self->next = vc.waiting;
+    vc.waiting = self;
+
+    dispatch();
+    awaitTurn(self);
+    return self->timedOut;
+}
+
+// Register the calling thread with the simulated clock and wait for its turn. Lock held.
+static void attach()
+{
+    if (self)
+        return;
+
+    self = newThread();
+    if (vc.current == NULL)
+        vc.current = self;
+    else
+    {
+        runQ_push(self);
+        awaitTurn(self);
+    }
+}
+
+static void init()
+{
+    const char *mode = getenv("VCLOCK");
+    vc.sim = mode != NULL && strcmp(mode, "sim") == 0;
+    if (!vc.sim)
+        return;
+
+    const char *epoch = getenv("VCLOCK_EPOCH");
+    const char *seed = getenv("VCLOCK_SEED");
+    vc.now = SIM_START;
+    vc.realBase = (epoch ? strtoull(epoch, NULL, 10) : SIM_EPOCH) * 1000000000ULL - SIM_START;
+    vc.seeded = seed != NULL;
+    vc.seed = seed ? strtoul(seed, NULL, 10) : 0;
+
+    pthread_mutex_init(&vc.lock, NULL);
+    pthread_cond_init(&vc.released, NULL);
+    pthread_cond_init(&vc.external.cond, NULL);
+}
+
+void vclock_init()
+{
+    pthread_once(&once, init);
+}
+
+int vclock_isSim()
+{
+    vclock_init();
+    return vc.sim;
+}
+
+static void *threadStart(void *arg)
+{
+    VThread *t = arg;
+
+    // wait for the first turn, threads start in creation order
+    pthread_mutex_lock(&vc.lock);
+    self = t;
+    awaitTurn(t);
+    pthread_mutex_unlock(&vc.lock);
+
+    void *ret = t->start(t->arg);
+
+    // leave the simulation and hand over to the next thread
+    pthread_mutex_lock(&vc.lock);
+    self = NULL;
+    dispatch();
+    pthread_mutex_unlock(&vc.lock);
+    pthread_cond_destroy(&t->cond);
+    free(t);
+    return ret;
+}
+
+int vclock_thread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg)
+{
+    if (!vclock_isSim())
+        return pthread_create(thread, attr, start, arg);
+
+    // the new thread is queued behind the threads that are already runnable
+    VThread *t = newThread();
+    t->start = start;
+    t->arg = arg;
+
+    pthread_mutex_lock(&vc.lock);
+    attach();
+    int ret = pthread_create(thread, attr, threadStart, t);
+    if (ret == 0)
+        runQ_push(t);
+    pthread_mutex_unlock(&vc.lock);
+
+    if (ret != 0)
+        free(t);
+    return ret;
+}
+
+int vclock_thread_join(pthread_t thread, void **ret)
+{
+    if (!vclock_isSim())
+        return pthread_join(thread, ret);
+
+    // leave the simulation while blocked in pthread_join
+    pthread_mutex_lock(&vc.lock);
+    attach();
+    VThread *t = self;
+    self = NULL;
+    dispatch();
+    pthread_mutex_unlock(&vc.lock);
+
+    int r = pthread_join(thread, ret);
+
+    // rejoin behind the threads that are already runnable
+    pthread_mutex_lock(&vc.lock);
+    self = t;
+    if (vc.current == NULL)
+        vc.current = self;
+    else
+    {
+        runQ_push(self);
+        awaitTurn(self);
+    }
+    pthread_mutex_unlock(&vc.lock);
+    return r;
+}
+
+uint64_t vclock_now()
+{
+    if (!vclock_isSim())
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts2ns(&ts);
+    }
+
+    pthread_mutex_lock(&vc.lock);
+    uint64_t now = vc.now;
+    pthread_mutex_unlock(&vc.lock);
+    return now;
+}
+
+int vclock_gettime(clockid_t clock, struct timespec *ts)
+{
+    if (!vclock_isSim())
+        return clock_gettime(clock, ts);
+
+    switch (clock)
+    {
+    case CLOCK_REALTIME:
+    case CLOCK_REALTIME_COARSE:
+        ns2ts(vc.realBase + vclock_now(), ts);
+        return 0;
+
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_COARSE:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_BOOTTIME:
+        ns2ts(vclock_now(), ts);
+        return 0;
+
+    default:
+        // CPU time clocks are not simulated
+        return clock_gettime(clock, ts);
+    }
+}
+
+time_t vclock_time(time_t *t)
+{
+    if (!vclock_isSim())
+        return time(t);
+
+    struct timespec ts;
+    vclock_gettime(CLOCK_REALTIME, &ts);
+    if (t)
+        *t = ts.tv_sec;
+    return ts.tv_sec;
+}
+
+// Sleep for ns nanoseconds of simulated time
+static void simSleep(uint64_t ns)
+{
+    pthread_mutex_lock(&vc.lock);
+    attach();
+    block(NULL, vc.now + ns);
+    pthread_mutex_unlock(&vc.lock);
+}
+
+unsigned int vclock_sleep(unsigned int s)
+{
+    if (!vclock_isSim())
+        return sleep(s);
+
+    simSleep(s * 1000000000ULL);
+    return 0;
+}
+
+int vclock_usleep(useconds_t us)
+{
+    if (!vclock_isSim())
+        return usleep(us);
+
+    simSleep(us * 1000ULL);
+    return 0;
+}
+
+unsigned int vclock_msleep(unsigned int ms)
+{
+    if (!vclock_isSim())
+    {
+        struct timespec req, rem = {0};
+        ns2ts(ms * 1000000ULL, &req);
+        nanosleep(&req, &rem);
+        return rem.tv_sec * 1000 + rem.tv_nsec / 1000000;
+    }
+
+    simSleep(ms * 1000000ULL);
+    return 0;
+}
+
+void vclock_sleepUntil(uint64_t ns)
+{
+    if (!vclock_isSim())
+    {
+        struct timespec ts;
+        ns2ts(ns, &ts);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        return;
+    }
+
+    pthread_mutex_lock(&vc.lock);
+    attach();
+    block(NULL, ns);
+    pthread_mutex_unlock(&vc.lock);
+}
+
+// Wait on sem until the virtual monotonic deadline (0 -> none)
+static int simWait(sem_t *sem, uint64_t deadline)
+{
+    pthread_mutex_lock(&vc.lock);
+    attach();
+
+    int ret = 0;
+    while (sem_trywait(sem) != 0)
+    {
+        if (block(sem, deadline))
+        {
+            errno = ETIMEDOUT;
+            ret = -1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&vc.lock);
+    return ret;
+}
+
+int vclock_sem_wait(sem_t *sem)
+{
+    if (!vclock_isSim())
+        return sem_wait(sem);
+
+    return simWait(sem, 0);
+}
+
+int vclock_sem_timedwait(sem_t *sem, const struct timespec *abstime)
+{
+    if (!vclock_isSim())
+        return sem_timedwait(sem, abstime);
+
+    uint64_t deadline = ts2ns(abstime);
+    deadline = deadline > vc.realBase ? deadline - vc.realBase : 1;
+    return simWait(sem, deadline);
+}
+
+int vclock_sem_clockwait(sem_t *sem, clockid_t clock, const struct timespec *abstime)
+{
+    if (!vclock_isSim())
+        return sem_clockwait(sem, clock, abstime);
+
+    if (clock == CLOCK_REALTIME)
+        return vclock_sem_timedwait(sem, abstime);
+
+    uint64_t deadline = ts2ns(abstime);
+    return simWait(sem, deadline ? deadline : 1);
+}
+
+int vclock_sem_post(sem_t *sem)
+{
+    if (!vclock_isSim())
+        return sem_post(sem);
+
+    pthread_mutex_lock(&vc.lock);
+    int ret = sem_post(sem);
+
+    // wake the thread that has been waiting longest on sem
+    VThread *first = NULL;
+    for (VThread *t = vc.waiting; t; t = t->next)
+        if (t->sem == sem && (first == NULL || t->seq < first->seq))
+            first = t;
+    if (first)
+    {
+        waiting_remove(first);
+        first->timedOut = 0;
+        runQ_push(first);
+
+        // posted from outside the simulation while every thread was blocked
+        if (vc.current == NULL)
+            dispatch();
+    }
+
+    pthread_mutex_unlock(&vc.lock);
+    return ret;
+}
+
+unsigned int vclock_seed(unsigned int salt)
+{
+    if (vclock_isSim() && vc.seeded)
+        return vc.seed * 2654435761U + salt;
+
+    return salt * vclock_time(NULL);
+}
+
+void vclock_setSync(void (*idle)(uint64_t next, void *arg), void *arg)
+{
+    if (!vclock_isSim())
+        return;
+
+    pthread_mutex_lock(&vc.lock);
+    vc.idle = idle;
+    vc.idleArg = arg;
+    pthread_mutex_unlock(&vc.lock);
+}
+
+void vclock_enter()
+{
+    if (!vclock_isSim())
+        return;
+
+    // wait until no simulated thread is running
+    pthread_mutex_lock(&vc.lock);
+    while (vc.current != NULL)
+        pthread_cond_wait(&vc.released, &vc.lock);
+    vc.current = &vc.external;
+    pthread_mutex_unlock(&vc.lock);
+}
+
+void vclock_leave()
+{
+    if (!vclock_isSim())
+        return;
+
+    pthread_mutex_lock(&vc.lock);
+    dispatch();
+    pthread_mutex_unlock(&vc.lock);
+}
+
+void vclock_advance(uint64_t now)
+{
+    if (!vclock_isSim())
+        return;
+
+    pthread_mutex_lock(&vc.lock);
+    if (now > vc.now)
+        vc.now = now;
+    wakeDue();
+    pthread_mutex_unlock(&vc.lock);
+}
@@ -11,6 +11,7 @@
 
 #include "../common.h"
 #include "../util.h"
+#include "../vclock.h"
 #include "../STRP/STRP.h"
 #include "../ProtoMon/ProtoMon.h"
 
@@ -191,7 +192,7 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	startTime = time(NULL);
+	startTime = vclock_time(NULL);
 	startTimeMs = getEpochMs();
 
 	getConfigStr(configStr, protomon, strp);
@@ -201,28 +202,28 @@ int main(int argc, char *argv[])
 	if (config.self != ADDR_SINK)
 	{
 		Routing_Header header;
-		if (pthread_create(&sendT, NULL, sendMsg_func, &header) != 0)
+		if (vclock_thread_create(&sendT, NULL, sendMsg_func, &header) != 0)
 		{
 			logMessage(ERROR, "Failed to create send thread\n");
 			fflush(stdout);
 			exit(EXIT_FAILURE);
 		}
-		pthread_join(sendT, NULL);
+		vclock_thread_join(sendT, NULL);
 	}
 	else
 	{
 		Routing_Header header;
-		if (pthread_create(&recvT, NULL, recvMsg_func, &header) != 0)
+		if (vclock_thread_create(&recvT, NULL, recvMsg_func, &header) != 0)
 		{
 			logMessage(ERROR, "Failed to create receive thread\n");
 			fflush(stdout);
 			exit(EXIT_FAILURE);
 		}
-		pthread_join(recvT, NULL);
+		vclock_thread_join(recvT, NULL);
 
 		generateGraph();
 
-		sleep(1800);
+		vclock_sleep(1800);
 
 		stopProcessOnPort(HTTP_PORT);
 	}
@@ -234,14 +235,14 @@ int main(int argc, char *argv[])
 static void syncTime(unsigned int n)
 {
 	// Sleep until the next multiple of n seconds
-	time_t now = time(NULL);
+	time_t now = vclock_time(NULL);
 	struct tm *wakeUpTime = localtime(&now);
 	unsigned short seconds = n - (wakeUpTime->tm_sec % n);
 	if (seconds < n)
 	{
 		logMessage(INFO, "Sleeping for %d seconds\n", seconds);
 		fflush(stdout);
-		sleep(seconds);
+		vclock_sleep(seconds);
 	}
 }
 
@@ -377,7 +378,7 @@ static void *recvMsg_func(void *args)
 	sprintf(filePath, "%s/%s", outputDir, outputFile);
 	FILE *file = fopen(filePath, "a");
 
-	while (time(NULL) - startTime < config.runtTimeS)
+	while (vclock_time(NULL) - startTime < config.runtTimeS)
 	{
 		Routing_Header h;
 		Routing_Header *header = &h;
@@ -410,7 +411,7 @@ static void *recvMsg_func(void *args)
 				logMessage(ERROR, "Malformed message received from src: %02d, buffer: %s\n", header->src, buffer);
 			}
 		}
-		usleep((rand() % 200000) + 500000); // Sleep 1-1.2s to prevent busy waiting
+		vclock_usleep((rand() % 200000) + 500000); // Sleep 1-1.2s to prevent busy waiting
 	}
 	for (int i = 1; i < MAX_ACTIVE_NODES; i++)
 	{
@@ -514,8 +515,8 @@ static void initOutputDir()
 
 static void *sendMsg_func(void *args)
 {
-	int total;
-	unsigned long long prevSleep, waitIdle;
+	int total = 0;
+	unsigned long long prevSleep = 0, waitIdle = 0;
 	char filePath[100];
 	sprintf(filePath, "../benchmark/%s", config.sendCsv);
 	// Read from config.txt
@@ -528,7 +529,7 @@ static void *sendMsg_func(void *args)
 	}
 
 	int numLine = 0;
-	while ((time(NULL) - startTime) < config.runtTimeS)
+	while ((vclock_time(NULL) - startTime) < config.runtTimeS)
 	{
 		char line[256];
 		if (fgets(line, sizeof(line), file) == NULL)
@@ -549,8 +550,8 @@ static void *sendMsg_func(void *args)
 
 		char sleep[20];
 		char nodes[100];
-		char dest[2];
-		char size[3];
+		char dest[4];
+		char size[4];
 
 		if (sscanf(line, "%[^,],%[^,],%[^,],%s", &nodes, &sleep, &dest, &size) != CSV_COLS)
 		{
@@ -603,13 +604,13 @@ static void *sendMsg_func(void *args)
 			fflush(stdout);
 		}
 
-		if ((time(NULL) - startTime) >= config.runtTimeS)
+		if ((vclock_time(NULL) - startTime) >= config.runtTimeS)
 		{
 			fclose(file);
 			return NULL;
 		}
 
-		usleep((sleepMs + config.sendOffsetMs) * 1000);
+		vclock_usleep((sleepMs + config.sendOffsetMs) * 1000);
 
 		char buffer[MAX_PAYLOAD_SIZE];
 		if (payloadSize > minPayloadSize)
@@ -645,12 +646,12 @@ static void *sendMsg_func(void *args)
 		fflush(stdout);
 	}
 	fclose(file);
-	long idleTime = config.runtTimeS - (time(NULL) - startTime);
+	long idleTime = config.runtTimeS - (vclock_time(NULL) - startTime);
 	if (idleTime > 0)
 	{
 		logMessage(INFO, "Waiting %d seconds for forwarding\n", idleTime);
 		fflush(stdout);
-		sleep(idleTime); // Sleep for the remaining time
+		vclock_sleep(idleTime); // Sleep for the remaining time
 	}
 	return NULL;
 }
@@ -760,8 +761,8 @@ static void initPktCountTable()
 
 		char sleep[10];
 		char nodes[100];
-		char dest[2];
-		char size[3];
+		char dest[4];
+		char size[4];
 
 		if (sscanf(line, "%[^,],%[^,],%[^,],%s", &nodes, &sleep, &dest, &size) != CSV_COLS)
 		{
@@ -8,6 +8,7 @@
 #include <sys/time.h> // clock_gettime
 
 #include "common.h"
+#include "vclock.h"
 
 /**
  * @returns Current local timestamp in the yyyy-mm-dd'T'hh:mm:ss format. Eg: 2024-06-16T11:56:23
@@ -17,7 +18,7 @@ char *timestamp()
     time_t current_time;
     struct tm *time_info;
     static char time_buffer[20];
-    time(&current_time);                  // Get current time
+    vclock_time(&current_time);                  // Get current time
     time_info = localtime(&current_time); // Convert to local time
 
     // Format the timestamp
@@ -87,6 +88,6 @@ void logMessage(LogLevel logLevel, const char *format, ...)
 long long getEpochMs()
 {
     struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+    vclock_gettime(CLOCK_REALTIME, &ts);
     return (long long)(ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL);
 }
@@ -7,14 +7,24 @@
 #include <stdio.h>	   // printf
 #include <stdlib.h>	   // rand, malloc, free, exit
 #include <string.h>	   // memcpy, strerror
+#include <sys/uio.h>   // struct iovec
 
 #include "../SX1262/SX1262.h"
 #include "../common.h"
+#include "../crc16.h"
+#include "../spsc.h"
+#include "../vclock.h"
 
 // Kontrollflags
 #define CTRL_RET '\xC1' // Antwort des Moduls
 #define CTRL_MSG '\xC4' // Nachricht
 #define CTRL_ACK '\xC5' // Acknowledgement
+#define CTRL_AGG '\xC6' // mehrere Nachrichten in einem Frame (je Nachricht Länge (1 Byte) und Payload)
+
+// maximale Payloadgröße, begrenzt die Größe eines aggregierten Frames
+#ifndef MAX_PAYLOAD_SIZE
+#define MAX_PAYLOAD_SIZE 120
+#endif
 
 // ####
 
@@ -26,6 +36,9 @@ typedef struct MAC_Data
 	uint16_t retries;
 	uint16_t drops;
 	uint16_t bytes;
+	uint16_t queued[MAC_PRIO_CLASSES];	 // max. Länge der Sendewarteschlange beim Einfügen
+	uint16_t dequeued[MAC_PRIO_CLASSES]; // aus der Sendewarteschlange entnommene Nachrichten
+	uint32_t wait[MAC_PRIO_CLASSES];	 // Summe der Wartezeiten in der Sendewarteschlange in ms
 } MAC_Data;
 
 typedef struct MAC_Metrics
@@ -37,8 +50,11 @@ typedef struct MAC_Metrics
 static MAC_Metrics metrics;
 
 int (*MAC_send)(MAC *h, unsigned char dest, unsigned char *data, unsigned int len) = ALOHA_send;
+int (*MAC_sendPrio)(MAC *h, unsigned char dest, unsigned char *data, unsigned int len, MAC_Prio prio) = ALOHA_sendPrio;
 int (*MAC_recv)(MAC *h, unsigned char *data) = ALOHA_recv;
 int (*MAC_timedRecv)(MAC *h, unsigned char *data, unsigned int timeout) = ALOHA_timedrecv;
+int (*MAC_recvBorrow)(MAC *h, MAC_Buffer *buf, unsigned int timeout) = ALOHA_recvBorrow;
+void (*MAC_release)(MAC *h, MAC_Buffer *buf) = ALOHA_release;
 
 static void initMetrics();
 
@@ -47,18 +63,19 @@ static void initMetrics();
 // Struktur einer zu empfangenden Nachricht
 typedef struct recvMessage
 {
-	MAC_Header header; // Nachrichtenheader
-	uint8_t *data;	   // Payload der Nachricht bzw. die eigentliche Nachricht
-	int8_t RSSI;	   // RSSI-Wert der Nachricht
+	MAC_Header header;	  // Nachrichtenheader
+	SX1262_Frame *frame;  // von der PHY ausgeliehener Frame
+	uint8_t *data;		  // Payload der Nachricht bzw. die eigentliche Nachricht (zeigt in den Frame)
+	int8_t RSSI;		  // RSSI-Wert der Nachricht
 } recvMessage;
 
 // Struktur für die Empfangs-Warteschlange
 #define recvMsgQ_size 32
 typedef struct recvMsgQueue
 {
+	SPSC ring;						// Ringpuffer (Produzent: Empfangsthread)
 	recvMessage msg[recvMsgQ_size]; // Nachrichten der Warteschlange
-	unsigned int begin, end;		// Zeiger auf den Anfang und das Ende der Daten
-	sem_t mutex, free, full;		// Semaphoren
+	sem_t readers;					// serialisiert die empfangenden Anwendungsthreads
 } recvMsgQueue;
 
 // Struktur für eine zu sendende Nachricht
@@ -66,26 +83,36 @@ typedef struct sendMessage
 {
 	uint8_t addr;  // Empfängeradresse
 	uint16_t len;  // Nachrichtenlänge
-	uint8_t *data; // Payload der Nachricht
+	uint8_t *data; // Payload der Nachricht (blockierend: Puffer des Aufrufers, sonst Kopie)
+	MAC_Prio prio;	 // Klasse der Sendewarteschlange
+	uint64_t queued; // Zeitpunkt des Einfügens (vclock_now)
 
 	bool blocking; // Gibt an, ob der Anwendungsthread blockiert
 	bool *success; // Gibt den erfolgreichen Abschluss einer Übertragung an
 	sem_t *fin;	   // Signalisiert den Abschluss der Übertragung
 } sendMessage;
 
-// Struktur für die Sende-Warteschlange
+// Struktur für die Sende-Warteschlange, eine pro Klasse (MAC_Prio)
 #define sendMsgQ_size 32
 typedef struct sendMsgQueue
 {
+	SPSC ring;						// Ringpuffer (Konsument: Sendethread)
 	sendMessage msg[sendMsgQ_size]; // Nachrichten der Warteschlange
-	unsigned int begin, end;		// Zeiger auf den Anfang und das Ende der Daten
-	sem_t mutex, free, full;		// Semaphoren
+	sem_t writers;					// serialisiert die sendenden Threads
 } sendMsgQueue;
 
 // Struktur für das Ambient Noise
+// Der Noise-Thread fragt es regelmäßig ab, Sendeentscheidungen verwenden den Mittelwert der letzten Messwerte
+#define noiseWindow_size 4
 typedef struct AmbientNoise
 {
-	int8_t value; // Wert des Ambient Noise in dBm
+	int8_t value;					   // Wert des Ambient Noise in dBm (letzte Antwort des Moduls)
+	int8_t samples[noiseWindow_size];  // letzte Messwerte
+	unsigned int count;				   // Anzahl gültiger Messwerte
+	unsigned int next;				   // Index für den nächsten Messwert
+	uint64_t time;					   // Zeitpunkt des letzten Messwerts (vclock_now)
+	sem_t mutex;					   // schützt die Messwerte
+	sem_t query;					   // serialisiert die Abfragen beim Modul
 } AmbientNoise;
 
 // Struktur für das Acknowledgement
@@ -95,84 +122,132 @@ typedef struct Acknowledgement
 	uint8_t src_addr; // Absenderadresse
 	uint8_t dst_addr; // Zieladresse
 	uint16_t seq;	  // Acknowledgementnummer
+	uint64_t time;	  // Empfangszeitpunkt (vclock_now), wird nicht übertragen
 } Acknowledgement;
 #define ACK_len 5
 
+// Warteschlange der empfangenen Acknowledgements (Produzent: Empfangsthread, Konsument: Sendethread)
+#define ackQ_size 16
+typedef struct ackQueue
+{
+	SPSC ring;						// Ringpuffer
+	Acknowledgement ack[ackQ_size]; // Acknowledgements der Warteschlange
+} ackQueue;
+
+// Frame im Sendefenster
+// Frames an verschiedene Empfänger (und bis zu mac->window an denselben) warten gleichzeitig auf ihr Acknowledgement
+// Bis zum ersten Senden können weitere kleine Nachrichten an denselben Empfänger angehängt werden
+#define sendWindow_slots 16
+#define aggregate_parts 8
+typedef struct sendSlot
+{
+	bool used;						  // Slot ist belegt
+	bool sent;						  // Frame wurde gesendet und wartet auf das Acknowledgement
+	bool sealed;					  // Header und Payload stehen fest, keine Nachrichten mehr anhängen
+	uint8_t addr;					  // Empfängeradresse
+	MAC_Prio prio;					  // höchste Klasse der enthaltenen Nachrichten
+	sendMessage msg[aggregate_parts]; // Nachrichten aus der Sendewarteschlange
+	unsigned int parts;				  // Anzahl Nachrichten
+	uint16_t aggLen;				  // Länge des Payloads als aggregierter Frame
+	uint8_t *data;					  // Payload des Frames (Nachricht oder agg)
+	uint16_t len;					  // Länge des Payloads des Frames
+	uint8_t agg[MAX_PAYLOAD_SIZE];	  // Payload eines aggregierten Frames
+	uint64_t hold;					  // Ende der Wartezeit auf weitere Nachrichten (vclock_now)
+	uint32_t order;					  // Reihenfolge der Entnahme, ältere Frames werden zuerst gesendet
+	unsigned int numtrials;			  // Anzahl Sendeversuche
+	bool retransmitted;				  // Frame wurde wiederholt, sein ACK liefert keinen RTT-Messwert
+	uint64_t sentAt;				  // Sendezeitpunkt (vclock_now)
+	uint64_t deadline;				  // Ende des ACK-Timeouts (vclock_now)
+	uint8_t header[MAC_Header_len];	  // Nachrichtenheader mit fester Sequenznummer
+} sendSlot;
+
+// Größe des Empfangsfensters für die Duplikaterkennung (Bits von recvMask)
+#define recvWindow_size 32
+
+// Round-Trip-Time-Schätzung pro Empfänger (wie TCP, RFC 6298), alle Zeiten in Millisekunden
+#define RTO_init 5000 // ACK-Timeout, solange kein Messwert vorliegt
+#define RTO_min 1000  // untere Grenze des ACK-Timeouts
+#define RTO_max 10000 // obere Grenze des ACK-Timeouts
+typedef struct RTTEstimate
+{
+	uint32_t srtt;	 // geglättete Round-Trip-Time (0 -> noch kein Messwert)
+	uint32_t rttvar; // mittlere Abweichung der Round-Trip-Time
+	uint32_t rto;	 // aktueller ACK-Timeout
+} RTTEstimate;
+
 // Empfangsthread
 static pthread_t recvT;
 
 // Sendethread
 static pthread_t sendT;
 
+// Thread zum Abfragen des Ambient Noise, wird beim ersten Sendeversuch mit mac->ambient gestartet
+static pthread_t noiseT;
+static bool noiseT_started = false;
+
 // Empfangswarteschlange
 static recvMsgQueue recvMsgQ;
 
-// Sendewarteschlange
-static sendMsgQueue sendMsgQ;
+// Sendewarteschlangen der Klassen
+static sendMsgQueue sendMsgQ[MAC_PRIO_CLASSES];
+
+// verbleibende Nachrichten der Klassen in der aktuellen Runde (gewichtetes Scheduling, nur Sendethread)
+static unsigned int sendCredit[MAC_PRIO_CLASSES] = {0};
 
 // Ambient Noise speichern
 static AmbientNoise noise;
 
-// Acknowledgement speichern
-static Acknowledgement ack;
+// empfangene Acknowledgements
+static ackQueue ackQ;
 
 // Gibt an, ob das Ambient Noise empfangen wurde
 static sem_t sem_noise;
 
-// Gibt an, ob ein Acknowledgement empfangen wurde
-static sem_t sem_ack;
+// Weckt den Sendethread (neue Nachricht oder Acknowledgement)
+static sem_t sem_send;
+
+// Sendefenster
+static sendSlot sendWindow[sendWindow_slots];
+
+// Anzahl gesendeter, unbestätigter Nachrichten pro Empfänger
+static uint8_t inFlight[256] = {0};
 
-// aktuelle empfangene Sequenznummern
+// höchste empfangene Sequenznummern
 static uint16_t recvSeq[256] = {0};
 
+// bereits empfangene Sequenznummern pro Absender, Bit i steht für recvSeq - i
+static uint32_t recvMask[256] = {0};
+
+// Empfangszeitpunkt der Startsequenznummer pro Absender
+static time_t recvStart[256] = {0};
+
 // aktuelle gesendete Sequentnummern
 static uint16_t sendSeq[256] = {0};
 
+// Round-Trip-Time-Schätzung pro Empfänger (geschützt durch metrics.mutex)
+static RTTEstimate rtt[256];
+
 static void recvMsgQ_init()
 {
-	// Start- und Endzeiger initialisieren
-	recvMsgQ.begin = 0;
-	recvMsgQ.end = 0;
-
-	// Semaphoren initialisieren
-	sem_init(&recvMsgQ.mutex, 0, 1);
-	sem_init(&recvMsgQ.free, 0, recvMsgQ_size);
-	sem_init(&recvMsgQ.full, 0, 0);
+	// Ringpuffer und Semaphore initialisieren
+	spsc_init(&recvMsgQ.ring, recvMsgQ.msg, recvMsgQ_size, sizeof(recvMessage));
+	sem_init(&recvMsgQ.readers, 0, 1);
 }
 
 static bool recvMsgQ_tryenqueue(recvMessage msg)
 {
-	// nicht blockieren und Semaphoren dekrementieren
-	if (sem_trywait(&recvMsgQ.free) == -1)
-		return false;
-
-	sem_wait(&recvMsgQ.mutex);
-
-	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
-	recvMsgQ.msg[recvMsgQ.end] = msg;
-	recvMsgQ.end = (recvMsgQ.end + 1) % recvMsgQ_size;
-
-	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.full);
-
-	return true;
+	// nicht blockieren, nur der Empfangsthread fügt ein
+	return spsc_trypush(&recvMsgQ.ring, &msg);
 }
 
 static recvMessage recvMsgQ_dequeue()
 {
+	recvMessage msg;
 
-	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&recvMsgQ.full);
-	sem_wait(&recvMsgQ.mutex);
-
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-	recvMessage msg = recvMsgQ.msg[recvMsgQ.begin];
-	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
-
-	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	// ggf. blockieren, mehrere Anwendungsthreads nacheinander
+	vclock_sem_wait(&recvMsgQ.readers);
+	spsc_pop(&recvMsgQ.ring, &msg);
+	vclock_sem_post(&recvMsgQ.readers);
 
 	// Nachricht zurückgeben
 	return msg;
@@ -180,134 +255,231 @@ static recvMessage recvMsgQ_dequeue()
 
 static bool recvMsgQ_trydequeue(recvMessage *msg)
 {
-	// nicht blockieren und Semaphoren dekrementieren
-	if (sem_trywait(&recvMsgQ.full) == -1)
-		return false;
-
-	sem_wait(&recvMsgQ.mutex);
-
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-	*msg = recvMsgQ.msg[recvMsgQ.begin];
-	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
-
-	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	// nicht blockieren
+	vclock_sem_wait(&recvMsgQ.readers);
+	bool ret = spsc_trypop(&recvMsgQ.ring, msg);
+	vclock_sem_post(&recvMsgQ.readers);
 
-	return true;
+	return ret;
 }
 
 static bool recvMsgQ_timeddequeue(recvMessage *msg, struct timespec *ts)
 {
-	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout false zurückgeben
-	if (sem_timedwait(&recvMsgQ.full, ts) == -1)
+	// ggf. blockieren, bei Timeout false zurückgeben
+	if (vclock_sem_timedwait(&recvMsgQ.readers, ts) == -1)
 		return false;
+	bool ret = spsc_timedpop(&recvMsgQ.ring, msg, ts);
+	vclock_sem_post(&recvMsgQ.readers);
 
-	sem_wait(&recvMsgQ.mutex);
-
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-	*msg = recvMsgQ.msg[recvMsgQ.begin];
-	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
-
-	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
-
-	return true;
+	return ret;
 }
 
 static void sendMsgQ_init()
 {
-	// Start- und Endzeiger initialisieren
-	sendMsgQ.begin = 0;
-	sendMsgQ.end = 0;
+	// Ringpuffer und Semaphore jeder Klasse initialisieren
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+	{
+		spsc_init(&sendMsgQ[c].ring, sendMsgQ[c].msg, sendMsgQ_size, sizeof(sendMessage));
+		sem_init(&sendMsgQ[c].writers, 0, 1);
+	}
+}
 
-	// Semaphoren initialisieren
-	sem_init(&sendMsgQ.mutex, 0, 1);
-	sem_init(&sendMsgQ.free, 0, sendMsgQ_size);
-	sem_init(&sendMsgQ.full, 0, 0);
+static void sendMsgQ_count(sendMessage *msg, unsigned int depth)
+{
+	// Broadcasts werden unter Adresse 0 gezählt
+	uint8_t addr = msg->addr == ADDR_BROADCAST ? 0 : msg->addr;
+
+	vclock_sem_wait(&metrics.mutex);
+	if (depth > metrics.data[addr].queued[msg->prio])
+		metrics.data[addr].queued[msg->prio] = depth;
+	vclock_sem_post(&metrics.mutex);
 }
 
 static void sendMsgQ_enqueue(sendMessage msg)
 {
-	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.free);
-	sem_wait(&sendMsgQ.mutex);
+	sendMsgQueue *q = &sendMsgQ[msg.prio];
+	msg.queued = vclock_now();
+
+	// ggf. blockieren, mehrere sendende Threads nacheinander
+	vclock_sem_wait(&q->writers);
+	spsc_push(&q->ring, &msg);
+	unsigned int depth = spsc_count(&q->ring);
+	vclock_sem_post(&q->writers);
 
-	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
-	sendMsgQ.msg[sendMsgQ.end] = msg;
-	sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
+	sendMsgQ_count(&msg, depth);
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.full);
+	// Sendethread wecken
+	vclock_sem_post(&sem_send);
 }
 
 static bool sendMsgQ_tryenqueue(sendMessage msg)
 {
-	// nicht blockieren und Semaphoren dekrementieren
-	if (sem_trywait(&sendMsgQ.free) == -1)
-		return false;
+	sendMsgQueue *q = &sendMsgQ[msg.prio];
+	msg.queued = vclock_now();
 
-	sem_wait(&sendMsgQ.mutex);
-
-	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
-	sendMsgQ.msg[sendMsgQ.end] = msg;
-	sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
+	// nicht blockieren
+	vclock_sem_wait(&q->writers);
+	bool ret = spsc_trypush(&q->ring, &msg);
+	unsigned int depth = spsc_count(&q->ring);
+	vclock_sem_post(&q->writers);
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.full);
+	// Sendethread wecken
+	if (ret)
+	{
+		sendMsgQ_count(&msg, depth);
+		vclock_sem_post(&sem_send);
+	}
 
-	return true;
+	return ret;
 }
 
-static sendMessage sendMsgQ_dequeue()
+static bool sendMsgQ_trydequeue(MAC *mac, sendMessage *msg)
 {
-	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.full);
-	sem_wait(&sendMsgQ.mutex);
+	// nicht blockieren, nur der Sendethread entnimmt
+	// strikt: immer die Klasse mit der höchsten Priorität zuerst
+	// gewichtet: jede Klasse erhält pro Runde prioWeight Nachrichten, eine Runde endet, sobald keine Klasse
+	// mit verbleibendem Anteil mehr Nachrichten hat (leere Klassen geben ihren Anteil an die anderen ab)
+	for (int round = 0; round < 2; round++)
+	{
+		for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+		{
+			if (mac->prioWeighted && sendCredit[c] == 0)
+				continue;
+			if (!spsc_trypop(&sendMsgQ[c].ring, msg))
+				continue;
 
-	// Byte aus der Warteschlange speichern und Startzeiger inkrementieren
-	sendMessage msg = sendMsgQ.msg[sendMsgQ.begin];
-	sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
+			if (mac->prioWeighted)
+				sendCredit[c]--;
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.free);
+			// Wartezeit in der Warteschlange erfassen
+			uint8_t addr = msg->addr == ADDR_BROADCAST ? 0 : msg->addr;
+			vclock_sem_wait(&metrics.mutex);
+			metrics.data[addr].dequeued[c]++;
+			metrics.data[addr].wait[c] += (vclock_now() - msg->queued) / 1000000;
+			vclock_sem_post(&metrics.mutex);
 
-	// Nachricht zurückgeben
-	return msg;
+			return true;
+		}
+
+		if (!mac->prioWeighted)
+			break;
+
+		// neue Runde
+		for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+			sendCredit[c] = mac->prioWeight[c] > 0 ? mac->prioWeight[c] : 1;
+	}
+
+	return false;
 }
 
-static int8_t ambientNoise(MAC *mac)
+static void ackQ_init()
+{
+	// Ringpuffer initialisieren
+	spsc_init(&ackQ.ring, ackQ.ack, ackQ_size, sizeof(Acknowledgement));
+}
+
+static bool ambientNoise(MAC *mac)
 {
 	// Kommando zum Abrufen des Ambient Noise
 	uint8_t cmd[] = {'\xC0', '\xC1', '\xC2', '\xC3', '\x00', '\x01'};
 
+	// nur eine Abfrage gleichzeitig, die Messwerte bleiben währenddessen lesbar
+	vclock_sem_wait(&noise.query);
+
+	// Kommando senden
+	SX1262_send(cmd, sizeof(cmd));
+
+	// 1 Sekunde auf das Ambient Noise warten
+	struct timespec ts;
+	vclock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 1;
+
+	// Timeout ausgeben, der Noise-Thread fragt in der nächsten Periode erneut ab
+	if (vclock_sem_timedwait(&sem_noise, &ts) != 0)
+	{
+		vclock_sem_post(&noise.query);
+
+		if (mac->debug)
+			printf("Timeout beim Abrufen des Ambient Noise.\n");
+
+		return false;
+	}
+
+	if (mac->debug)
+		printf("Noise: %hhddBm\n", noise.value);
+
+	// Messwert speichern, veraltete Messwerte verwerfen
+	vclock_sem_wait(&noise.mutex);
+
+	uint64_t now = vclock_now();
+	if (now - noise.time > (uint64_t)mac->noiseMaxAgeMs * 1000000)
+	{
+		noise.count = 0;
+		noise.next = 0;
+	}
+
+	noise.samples[noise.next] = noise.value;
+	noise.next = (noise.next + 1) % noiseWindow_size;
+	if (noise.count < noiseWindow_size)
+		noise.count++;
+	noise.time = now;
+
+	vclock_sem_post(&noise.mutex);
+	vclock_sem_post(&noise.query);
+
+	return true;
+}
+
+static void *noise_func(void *args)
+{
+	MAC *mac = (MAC *)args;
+
 	while (1)
 	{
-		// Kommando senden
-		SX1262_send(cmd, sizeof(cmd));
+		vclock_msleep(mac->noisePeriodMs);
+
+		// Ambient Noise nur abfragen, wenn es beim Senden berücksichtigt wird
+		if (mac->ambient)
+			ambientNoise(mac);
+	}
 
-		// 1 Sekunde auf das Ambient Noise warten
-		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
-		ts.tv_sec += 1;
+	return NULL;
+}
 
-		// Wenn empfangen, Ambient Noise zurückgeben
-		if (sem_timedwait(&sem_noise, &ts) == 0)
+static int8_t ambientNoise_estimate(MAC *mac)
+{
+	// Noise-Thread beim ersten Aufruf starten (nur der Sendethread ruft auf)
+	if (!noiseT_started)
+	{
+		if (vclock_thread_create(&noiseT, NULL, &noise_func, mac) != 0)
 		{
-			if (mac->debug)
-				printf("Noise: %hhddBm\n", noise.value);
+			fprintf(stderr, "Error %d creating noiseThread: %s\n",
+					errno, strerror(errno));
 
-			return noise.value;
+			exit(EXIT_FAILURE);
 		}
 
-		// Timeout ausgeben
-		if (mac->debug)
-			printf("Timeout beim Abrufen des Ambient Noise.\n");
+		noiseT_started = true;
+	}
+
+	// Der Sendethread fragt das Modul nie selbst ab und wartet nicht auf eine laufende Abfrage
+	vclock_sem_wait(&noise.mutex);
+
+	// Messwerte aktuell -> Mittelwert zurückgeben
+	if (noise.count > 0 && vclock_now() - noise.time <= (uint64_t)mac->noiseMaxAgeMs * 1000000)
+	{
+		int sum = 0;
+		for (unsigned int i = 0; i < noise.count; i++)
+			sum += noise.samples[i];
+
+		vclock_sem_post(&noise.mutex);
+		return sum / (int)noise.count;
 	}
+
+	vclock_sem_post(&noise.mutex);
+
+	// sonst (noch kein Messwert oder Modul antwortet nicht) Senden nicht zurückhalten
+	return INT8_MAX;
 }
 
 static void acknowledgement(MAC *mac, MAC_Header recvH)
@@ -335,37 +507,173 @@ static void acknowledgement(MAC *mac, MAC_Header recvH)
 
 	// Acknowledgement versenden
 	SX1262_send(buffer, sizeof(buffer));
-	sem_wait(&metrics.mutex);
+	vclock_sem_wait(&metrics.mutex);
 	metrics.data[recvH.src_addr].bytes += sizeof(buffer);
-	sem_post(&metrics.mutex);
+	vclock_sem_post(&metrics.mutex);
 	printf("## MAC_TX: %d B\n", sizeof(buffer));
 }
 
-static bool acknowledged(MAC *mac, uint8_t addr)
+static bool recvSeq_accept(MAC *mac, uint8_t src, uint16_t seq)
 {
-	// 5 bis 10 Sekuden Timeout
-	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
-	ts.tv_sec += 5 + rand() % 6;
-	// ###
-	// ts.tv_sec += 1;
+	// Startsequenznummer
+	if (seq == 0)
+	{
+		time_t now = vclock_time(NULL);
 
-	while (1)
+		// Startnachricht liegt im Empfangsfenster
+		if (recvSeq[src] < recvWindow_size)
+		{
+			// verspätete (oder erste) Startnachricht
+			if (!(recvMask[src] & (1u << recvSeq[src])))
+			{
+				recvMask[src] |= 1u << recvSeq[src];
+				recvStart[src] = now;
+				return true;
+			}
+
+			// Wiederholung, solange der Absender sie noch senden kann (max. maxtrials * 10 Sekunden)
+			if (now - recvStart[src] <= (time_t)mac->maxtrials * 10)
+				return false;
+		}
+
+		// Absender wurde neu gestartet, Empfangsfenster zurücksetzen
+		recvStart[src] = now;
+		recvSeq[src] = 0;
+		recvMask[src] = 1;
+		return true;
+	}
+
+	// Abstand zur höchsten empfangenen Sequenznummer (mit Überlauf)
+	int16_t diff = (int16_t)(seq - recvSeq[src]);
+
+	// neue höchste Sequenznummer -> Fenster verschieben
+	if (diff > 0)
+	{
+		recvMask[src] = diff >= recvWindow_size ? 0 : recvMask[src] << diff;
+		recvMask[src] |= 1;
+		recvSeq[src] = seq;
+		return true;
+	}
+
+	// zu alt oder schon empfangen -> Duplikat
+	if (-diff >= recvWindow_size || recvMask[src] & (1u << -diff))
+		return false;
+
+	// verspätete Nachricht (z.B. Wiederholung einer verlorenen Nachricht)
+	recvMask[src] |= 1u << -diff;
+	return true;
+}
+
+static void rtt_init()
+{
+	for (int i = 0; i < 256; i++)
+		rtt[i] = (RTTEstimate){0, 0, RTO_init};
+}
+
+static void rtt_sample(uint8_t addr, uint32_t ms)
+{
+	vclock_sem_wait(&metrics.mutex);
+	RTTEstimate *e = &rtt[addr];
+
+	if (e->srtt == 0)
+	{
+		// erster Messwert
+		e->srtt = ms > 0 ? ms : 1;
+		e->rttvar = ms / 2;
+	}
+	else
+	{
+		// rttvar = 3/4 rttvar + 1/4 |srtt - rtt|, srtt = 7/8 srtt + 1/8 rtt
+		uint32_t delta = e->srtt > ms ? e->srtt - ms : ms - e->srtt;
+		e->rttvar = (3 * e->rttvar + delta) / 4;
+		e->srtt = (7 * e->srtt + ms) / 8;
+		if (e->srtt == 0)
+			e->srtt = 1;
+	}
+
+	// rto = srtt + 4 rttvar, begrenzt auf [RTO_min, RTO_max]
+	uint32_t rto = e->srtt + 4 * e->rttvar;
+	e->rto = rto < RTO_min ? RTO_min : rto > RTO_max ? RTO_max : rto;
+	vclock_sem_post(&metrics.mutex);
+}
+
+static void rtt_backoff(uint8_t addr)
+{
+	// ACK-Timeout nach einem Timeout verdoppeln, bis zum nächsten Messwert
+	vclock_sem_wait(&metrics.mutex);
+	rtt[addr].rto = rtt[addr].rto * 2 > RTO_max ? RTO_max : rtt[addr].rto * 2;
+	vclock_sem_post(&metrics.mutex);
+}
+
+static uint32_t rtt_timeout(uint8_t addr)
+{
+	vclock_sem_wait(&metrics.mutex);
+	uint32_t rto = rtt[addr].rto;
+	vclock_sem_post(&metrics.mutex);
+
+	// bis zu 1/4 zufällig verlängern, damit kollidierte Sender nicht gleichzeitig wiederholen
+	return rto + rand() % (rto / 4 + 1);
+}
+
+static void recvAggregate(MAC *mac, MAC_Header recvH, SX1262_Frame *frame, uint8_t *msg_buffer)
+{
+	// RSSI-Wert des Frames gilt für alle Nachrichten
+	int8_t RSSI = msg_buffer[recvH.msg_len];
+
+	// Aufbau prüfen: Längen und Payloads müssen den Frame genau ausfüllen
+	unsigned int parts = 0;
+	uint16_t pos = 0;
+	while (pos < recvH.msg_len)
 	{
-		// Auf das Acknowledgement warten, bei Timeout abbrechen
-		if (sem_timedwait(&sem_ack, &ts) == -1)
-			return false;
+		pos += sizeof(uint8_t) + msg_buffer[pos];
+		parts++;
+	}
 
-		// Nachricht ist ein Acknowledgement, wenn Sender der vorherige Empfänger ist
-		// und Ack-Nummer mit Seq-Nummer übereinstimmt.
-		if (addr == ADDR_BROADCAST || (ack.src_addr == addr && ack.seq == sendSeq[addr]))
+	if (pos != recvH.msg_len || parts == 0)
+	{
+		if (mac->debug)
+			printf("Aggregierter Frame ungültig.\n");
+
+		SX1262_frameRelease(frame);
+		return;
+	}
+
+	pos = 0;
+	for (unsigned int i = 0; i < parts; i++)
+	{
+		uint8_t len = msg_buffer[pos];
+		pos += sizeof(uint8_t);
+
+		// Variable für die Nachricht, Header wie bei einer einzelnen Nachricht
+		recvMessage msg;
+		msg.header = recvH;
+		msg.header.ctrl = CTRL_MSG;
+		msg.header.msg_len = len;
+		msg.RSSI = RSSI;
+
+		// Die letzte Nachricht behält den Frame, die anderen werden in eigene Frames kopiert,
+		// damit jede Nachricht einzeln verliehen und zurückgegeben werden kann
+		if (i == parts - 1)
 		{
-			return true;
+			msg.frame = frame;
+			msg.data = msg_buffer + pos;
 		}
-		else if (mac->debug)
+		else
 		{
-			printf("Wrong ACK -> Expected: src_addr = %02X, seq = %d\n", addr, sendSeq[addr]);
-			printf("             Received: src_addr = %02X, seq = %d\n", ack.src_addr, ack.seq);
+			msg.frame = SX1262_frameGet();
+			msg.data = msg.frame->bytes + MAC_Header_len;
+			memcpy(msg.data, msg_buffer + pos, len);
+		}
+		pos += len;
+
+		// Nachricht zur Warteschlange hinzufügen
+		if (!recvMsgQ_tryenqueue(msg))
+		{
+			// Warteschlange voll
+			if (mac->debug)
+				printf("recvMsgQ is full.\n");
+
+			SX1262_frameRelease(msg.frame);
 		}
 	}
 }
@@ -400,7 +708,7 @@ static void *recvMsg_func(void *args)
 				noise.value = -ambient[2] / 2;
 
 				// Erhalt signalisieren
-				sem_post(&sem_noise);
+				vclock_sem_post(&sem_noise);
 			}
 			else if (mac->debug)
 				// ungültiges Ambient Noise ausgeben
@@ -446,22 +754,38 @@ static void *recvMsg_func(void *args)
 			// Sequenznummer speichern
 			recvACK.seq = *(uint16_t *)p;
 
+			// Empfangszeitpunkt für die Round-Trip-Time speichern
+			recvACK.time = vclock_now();
+
 			// Wenn das ACK nicht an diesen Pi adressiert ist
 			if (recvACK.dst_addr != mac->addr)
 				continue;
 
-			// Acknowledgement speichern
-			ack = recvACK;
+			// Acknowledgement an den Sendethread weitergeben
+			if (!spsc_trypush(&ackQ.ring, &recvACK))
+			{
+				if (mac->debug)
+					printf("ackQ is full.\n");
+
+				continue;
+			}
 
 			// Erhalt dem Sendethread signalisieren
-			sem_post(&sem_ack);
+			vclock_sem_post(&sem_send);
 		}
 
-		// Nachricht
-		else if (ctrl == CTRL_MSG)
+		// Nachricht oder aggregierte Nachrichten
+		else if (ctrl == CTRL_MSG || ctrl == CTRL_AGG)
 		{
+			// Frame von der PHY ausleihen, Header und Payload werden direkt hinein empfangen
+			SX1262_Frame *frame = SX1262_frameGet();
+
+			// Frist für den vollständigen Empfang des Frames (Header, Payload und RSSI-Wert)
+			struct timespec deadline;
+			SX1262_deadline(&deadline, mac->recvTimeout);
+
 			// Puffer für den Nachrichtenheader
-			uint8_t header_buffer[MAC_Header_len];
+			uint8_t *header_buffer = frame->bytes;
 
 			// Zeiger auf den Puffer setzen
 			uint8_t *p = header_buffer;
@@ -469,13 +793,15 @@ static void *recvMsg_func(void *args)
 			// Kontrollflag im Puffer speichern
 			*p = ctrl;
 			p += sizeof(ctrl);
+			frame->len = sizeof(ctrl);
 
 			// Nachrichtenheader empfangen
-			if (SX1262_timedrecv(p, sizeof(header_buffer) - sizeof(ctrl), mac->recvTimeout) != sizeof(header_buffer) - sizeof(ctrl))
+			if (SX1262_recvFrameUntil(frame, MAC_Header_len - sizeof(ctrl), &deadline) != MAC_Header_len - sizeof(ctrl))
 			{
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Nachrichtenheader.\n");
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -502,33 +828,32 @@ static void *recvMsg_func(void *args)
 			p += sizeof(recvH.msg_len);
 
 			// Checksumme speichern
-			recvH.checksum = *p;
+			recvH.checksum = *(uint16_t *)p;
 
 			// Puffer für den Nachrichtenpayload und den RSSI-Wert
-			uint8_t msg_buffer[recvH.msg_len + sizeof(int8_t)];
+			uint8_t *msg_buffer = frame->bytes + MAC_Header_len;
 
 			// Payload der Nachricht und RSSI-Wert empfangen
-			if (SX1262_timedrecv(msg_buffer, sizeof(msg_buffer), mac->recvTimeout) != sizeof(msg_buffer))
+			if (SX1262_recvFrameUntil(frame, recvH.msg_len + sizeof(int8_t), &deadline) != recvH.msg_len + sizeof(int8_t))
 			{
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Nachrichtenpayloads.\n");
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
-			// Checksumme berechnen
-			uint8_t checksum = 0;
-			for (int i = 0; i < MAC_Header_len - sizeof(recvH.checksum); i++)
-				checksum += header_buffer[i];
-			for (int i = 0; i < recvH.msg_len; i++)
-				checksum += msg_buffer[i];
+			// Checksumme (CRC-16) berechnen
+			uint16_t checksum = crc16_update(CRC16_INIT, header_buffer, MAC_Header_len - sizeof(recvH.checksum));
+			checksum = crc16_update(checksum, msg_buffer, recvH.msg_len);
 
 			// Checksumme prüfen
 			if (checksum != recvH.checksum)
 			{
 				if (mac->debug)
-					printf("Checksumme 0x%02X ungültig! Expected: 0x%02X.\n", recvH.checksum, checksum);
+					printf("Checksumme 0x%04X ungültig! Expected: 0x%04X.\n", recvH.checksum, checksum);
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -536,6 +861,7 @@ static void *recvMsg_func(void *args)
 			if (recvH.dst_addr != ADDR_BROADCAST && recvH.dst_addr != mac->addr)
 			{
 				// Routing logic
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -551,39 +877,32 @@ static void *recvMsg_func(void *args)
 				printf("\n");
 			}
 
-			// Wenn eine Nachricht mit einer kleineren oder gleichen Sequenznummer schon empfangen wurde
-			// und Sequenznummer nicht die Startsequenznummer ist
+			// Wenn die Nachricht schon empfangen wurde (der Sender hat mehrere Nachrichten unterwegs,
+			// daher Sequenznummern im Empfangsfenster und nicht nur die höchste prüfen)
 			// Ignore sequece number for broadcasts
-			if (recvH.dst_addr != ADDR_BROADCAST && recvH.seq <= recvSeq[recvH.src_addr] && recvH.seq != 0)
+			if (recvH.dst_addr != ADDR_BROADCAST && !recvSeq_accept(mac, recvH.src_addr, recvH.seq))
 			{
 				if (mac->debug)
 					printf("... wurde schon empfangen.\n\n");
+
+				SX1262_frameRelease(frame);
+			}
+			else if (ctrl == CTRL_AGG)
+			{
+				// Aggregierten Frame in die einzelnen Nachrichten aufteilen
+				recvAggregate(mac, recvH, frame, msg_buffer);
 			}
 			else
 			{
-				// Ignore sequece number for broadcasts
-				if (recvH.dst_addr != ADDR_BROADCAST)
-				{
-					// aktuelle Sequenznummer speichern
-					recvSeq[recvH.src_addr] = recvH.seq;
-				}
-
 				// Variable für die Nachricht
 				recvMessage msg;
 
 				// Header speichern
 				msg.header = recvH;
 
-				// Speicher für den Nachrichtenpayload allokieren, bei einem Fehler das Programm beenden
-				msg.data = (uint8_t *)malloc(recvH.msg_len);
-				if (msg.data == NULL)
-				{
-					fprintf(stderr, "malloc error %d in recvMsg_func: %s\n", errno, strerror(errno));
-					exit(EXIT_FAILURE);
-				}
-
-				// Nachricht in den allokierten Speicher kopieren
-				memcpy(msg.data, msg_buffer, recvH.msg_len);
+				// Frame ohne Kopie weiterreichen, der Payload liegt hinter dem Header
+				msg.frame = frame;
+				msg.data = msg_buffer;
 
 				// RSSI-Wert speichern
 				msg.RSSI = msg_buffer[recvH.msg_len];
@@ -595,7 +914,7 @@ static void *recvMsg_func(void *args)
 					if (mac->debug)
 						printf("recvMsgQ is full.\n");
 
-					free(msg.data);
+					SX1262_frameRelease(frame);
 				}
 			}
 
@@ -614,7 +933,7 @@ static void *recvMsg_func(void *args)
 				printf("Kontrollflag %02X unbekannt.\n", ctrl);
 
 			// 100ms warten bis die Daten vollständig empfangen wurden
-			msleep(100);
+			vclock_msleep(100);
 
 			// Solange Bytes verfügbar sind, diese empfangen und verwerfen
 			uint8_t c;
@@ -622,195 +941,383 @@ static void *recvMsg_func(void *args)
 				;
 		}
 	}
+
+	return NULL;
 }
 
-static void *sendMsg_func(void *args)
+static void sendWindow_complete(MAC *mac, sendSlot *slot, bool success)
 {
-	MAC *mac = (MAC *)args;
+	// Frame ist nicht mehr unterwegs
+	if (slot->sent)
+		inFlight[slot->addr]--;
 
-	while (1)
+	if (mac->debug)
 	{
-		// Blockieren und Nachricht aus der Warteschlange speichern
-		sendMessage msg = sendMsgQ_dequeue();
+		if (success)
+			// Frame bestätigt
+			printf("Nachricht wurde nach %d Versuch(en) bestätigt.\n", slot->numtrials);
+		else
+			// Frame wurde nicht bestätigt
+			printf("Nachricht wurde nach %d Versuch(en) nicht bestätigt.\n", slot->numtrials);
+	}
 
-		// Puffer für den Header und die Nachricht
-		uint8_t buffer[MAC_Header_len + msg.len];
+	// Jede Nachricht des Frames abschließen
+	for (unsigned int i = 0; i < slot->parts; i++)
+	{
+		sendMessage *msg = &slot->msg[i];
 
-		// Zeiger auf buffer setzen
-		uint8_t *p = buffer;
+		// Kopie einer nicht blockierenden Nachricht freigeben
+		if (!msg->blocking)
+			free(msg->data);
 
-		// Kontrollflag in buffer schreiben
-		*p = CTRL_MSG;
-		p += sizeof(uint8_t);
+		// Wenn der empfangende (Anwendungs-) Thread blockiert
+		else
+		{
+			// Erfolg der Übertragung setzen
+			*msg->success = success;
 
-		// Absenderadresse in buffer schreiben, Zeiger weitersetzen
-		*p = mac->addr;
-		p += sizeof(mac->addr);
+			// Signalisieren, dass die Operation abgeschlossen wurde
+			vclock_sem_post(msg->fin);
+		}
+	}
 
-		// Zieladresse in buffer schreiben, Zeiger weitersetzen
-		*p = msg.addr;
-		p += sizeof(msg.addr);
+	// Slot freigeben
+	slot->used = false;
+}
 
-		// Sequenznummer in buffer schreiben, Zeiger weitersetzen
-		*(uint16_t *)p = sendSeq[msg.addr];
-		p += sizeof(sendSeq[msg.addr]);
+static void sendWindow_fill(MAC *mac, sendSlot *slot, sendMessage msg, uint32_t order)
+{
+	slot->used = true;
+	slot->sent = false;
+	slot->sealed = false;
+	slot->addr = msg.addr;
+	slot->prio = msg.prio;
+	slot->msg[0] = msg;
+	slot->parts = 1;
+	slot->aggLen = sizeof(uint8_t) + msg.len;
+	slot->order = order;
+	slot->numtrials = 1;
+	slot->retransmitted = false;
+
+	// Bis zum Ende der Wartezeit dürfen weitere Nachrichten an denselben Empfänger angehängt werden
+	slot->hold = vclock_now() + (uint64_t)mac->aggHoldMs * 1000000;
+}
 
-		// Nachrichtenlänge in buffer schreiben, Zeiger weitersetzen
-		*(uint16_t *)p = msg.len;
-		p += sizeof(msg.len);
+static bool sendWindow_append(MAC *mac, sendSlot *slot, sendMessage msg)
+{
+	// Nur an noch nicht gesendete Frames an denselben Empfänger anhängen, solange Platz ist
+	if (!slot->used || slot->sealed || slot->addr != msg.addr || slot->parts >= aggregate_parts)
+		return false;
+	if (msg.len > UINT8_MAX || slot->aggLen + sizeof(uint8_t) + msg.len > MAX_PAYLOAD_SIZE)
+		return false;
 
-		// Checksumme berechnen
-		uint8_t checksum = 0;
-		for (int i = 0; i < MAC_Header_len - sizeof(checksum); i++)
-			checksum += buffer[i];
-		for (int i = 0; i < msg.len; i++)
-			checksum += msg.data[i];
+	slot->msg[slot->parts++] = msg;
+	slot->aggLen += sizeof(uint8_t) + msg.len;
+	if (msg.prio < slot->prio)
+		slot->prio = msg.prio;
+	return true;
+}
 
-		// Checksumme in buffer schreiben, Zeiger weitersetzen
-		*p = checksum;
-		p += sizeof(checksum);
+static bool sendWindow_full(sendSlot *slot)
+{
+	// Frame ist voll, wenn keine weitere Nachricht mit mindestens 1 Byte Payload mehr passt
+	return slot->parts >= aggregate_parts || slot->aggLen + 2 * sizeof(uint8_t) > MAX_PAYLOAD_SIZE;
+}
 
-		// Payload in den Puffer kopieren
-		memcpy(p, msg.data, msg.len);
+static void sendWindow_seal(MAC *mac, sendSlot *slot)
+{
+	// Einzelne Nachricht -> Payload ohne Kopie senden
+	uint8_t ctrl = CTRL_MSG;
+	slot->data = slot->msg[0].data;
+	slot->len = slot->msg[0].len;
 
-		// allokierten Speicher freigeben
-		free(msg.data);
+	// Mehrere Nachrichten -> je Nachricht Länge und Payload hintereinander kopieren
+	if (slot->parts > 1)
+	{
+		uint8_t *q = slot->agg;
+		for (unsigned int i = 0; i < slot->parts; i++)
+		{
+			*q = slot->msg[i].len;
+			q += sizeof(uint8_t);
+			memcpy(q, slot->msg[i].data, slot->msg[i].len);
+			q += slot->msg[i].len;
+		}
 
-		// Erfolg der Übertragung auf false setzen
-		bool success = false;
+		ctrl = CTRL_AGG;
+		slot->data = slot->agg;
+		slot->len = slot->aggLen;
+	}
 
-		// Anzahl Versuche speichern
-		unsigned int numtrials = 1;
+	// Zeiger auf den Header setzen
+	uint8_t *p = slot->header;
 
-		while (1)
+	// Kontrollflag in den Header schreiben
+	*p = ctrl;
+	p += sizeof(uint8_t);
+
+	// Absenderadresse in den Header schreiben, Zeiger weitersetzen
+	*p = mac->addr;
+	p += sizeof(mac->addr);
+
+	// Zieladresse in den Header schreiben, Zeiger weitersetzen
+	*p = slot->addr;
+	p += sizeof(slot->addr);
+
+	// Sequenznummer vergeben und in den Header schreiben, Zeiger weitersetzen
+	// Wiederholungen verwenden dieselbe Sequenznummer
+	*(uint16_t *)p = sendSeq[slot->addr]++;
+	p += sizeof(sendSeq[slot->addr]);
+
+	// Nachrichtenlänge in den Header schreiben, Zeiger weitersetzen
+	*(uint16_t *)p = slot->len;
+	p += sizeof(slot->len);
+
+	// Checksumme (CRC-16) berechnen
+	uint16_t checksum = crc16_update(CRC16_INIT, slot->header, MAC_Header_len - sizeof(checksum));
+	checksum = crc16_update(checksum, slot->data, slot->len);
+
+	// Checksumme in den Header schreiben
+	*(uint16_t *)p = checksum;
+
+	slot->sealed = true;
+}
+
+static void sendWindow_transmit(MAC *mac, sendSlot *slot)
+{
+	// Beim ersten Senden Header und Payload festlegen
+	if (!slot->sealed)
+		sendWindow_seal(mac, slot);
+
+	// Wenn Noise zu hoch
+	// ### Disable to prevent nodes getting stuck after a while
+	while (mac->ambient && ambientNoise_estimate(mac) <= mac->noiseThreshold)
+	{
+		// if (mac->debug)
+		printf("### Noise is too high.\n");
+		fflush(stdout);
+
+		if (slot->addr != ADDR_BROADCAST)
 		{
-			// Wenn Noise zu hoch
-			// ### Disable to prevent nodes getting stuck after a while
+			vclock_sem_wait(&metrics.mutex);
+			metrics.data[slot->addr].backoffs++;
+			vclock_sem_post(&metrics.mutex);
+		}
 
-			if (mac->ambient && ambientNoise(mac) <= mac->noiseThreshold)
+		// Anzahl Sendeversuche = max. Anz. Versuche -> Sendeversuch abbrechen
+		if (slot->numtrials >= mac->maxtrials)
+		{
+			if (slot->addr != ADDR_BROADCAST)
 			{
-				// if (mac->debug)
-				printf("### Noise is too high.\n");
-				fflush(stdout);
+				vclock_sem_wait(&metrics.mutex);
+				metrics.data[slot->addr].drops++;
+				vclock_sem_post(&metrics.mutex);
+			}
+			sendWindow_complete(mac, slot, false);
+			return;
+		}
 
-				if (msg.addr != ADDR_BROADCAST)
-				{
-					sem_wait(&metrics.mutex);
-					metrics.data[msg.addr].backoffs++;
-					sem_post(&metrics.mutex);
-				}
+		vclock_msleep(mac->noiseBackoffMs + rand() % 101);
 
-				// Anzahl Sendeversuche = max. Anz. Versuche -> Sendeversuch abbrechen
-				if (numtrials >= mac->maxtrials)
-				{
-					if (msg.addr != ADDR_BROADCAST)
-					{
-						sem_wait(&metrics.mutex);
-						metrics.data[msg.addr].drops++;
-						sem_post(&metrics.mutex);
-					}
-					break;
-				}
+		// Anzahl Sendeversuche inkrementieren
+		slot->numtrials++;
+	}
 
-				msleep(mac->noiseBackoffMs + rand() % 101);
+	// Header und Payload werden mit einem Schreibvorgang gesendet
+	struct iovec frame[] = {{slot->header, MAC_Header_len}, {slot->data, slot->len}};
 
-				// 5 bis 10 Sekunden warten
-				// msleep(5000 + rand() % 5001);
+	// Sleep for a short random duration
+	vclock_msleep(100 + rand() % 501);
+	slot->sentAt = vclock_now();
+	SX1262_sendFrame(frame, 2);
+	// Update metrics
+	uint8_t txAddr = slot->addr;
+	if (slot->addr == ADDR_BROADCAST)
+	{
+		txAddr = 0;
+	}
+	vclock_sem_wait(&metrics.mutex);
+	metrics.data[txAddr].frames++;
+	metrics.data[txAddr].bytes += MAC_Header_len + slot->len;
+	printf("## MAC_TX: %d B\n", MAC_Header_len + slot->len);
+	vclock_sem_post(&metrics.mutex);
 
-				// Anzahl Sendeversuche inkrementieren
-				numtrials++;
+	if (mac->debug)
+	{
+		// Gesendeten Header und Nachricht ausgeben
+		printf("Gesendet: ");
+		for (int i = 0; i < MAC_Header_len; i++)
+			printf("%02X ", slot->header[i]);
+		printf("|");
+		for (int i = 0; i < slot->len; i++)
+			printf(" %02X", slot->data[i]);
+		printf("\n");
+	}
 
-				continue;
-			}
+	// Broadcasts werden nicht bestätigt
+	if (slot->addr == ADDR_BROADCAST)
+	{
+		sendWindow_complete(mac, slot, true);
+		return;
+	}
 
-			// Sleep for a short random duration
-			msleep(100 + rand() % 501);
-			SX1262_send(buffer, MAC_Header_len + msg.len);
-			// Update metrics
-			uint8_t txAddr = msg.addr;
-			if (msg.addr == ADDR_BROADCAST)
+	// ACK-Timeout aus der Round-Trip-Time des Empfängers, der Sendethread blockiert dabei nicht
+	slot->deadline = vclock_now() + (uint64_t)rtt_timeout(slot->addr) * 1000000;
+
+	slot->sent = true;
+	inFlight[slot->addr]++;
+}
+
+static void *sendMsg_func(void *args)
+{
+	MAC *mac = (MAC *)args;
+
+	// Reihenfolge der Nachrichten im Sendefenster
+	uint32_t order = 0;
+
+	while (1)
+	{
+		// Empfangene Acknowledgements der passenden gesendeten Nachricht zuordnen, auch wenn deren
+		// Wiederholung nach dem ACK-Timeout noch aussteht (die Sequenznummer steht ab dem ersten Senden fest)
+		Acknowledgement ack;
+		while (spsc_trypop(&ackQ.ring, &ack))
+		{
+			sendSlot *slot = NULL;
+			for (int i = 0; i < sendWindow_slots; i++)
 			{
-				txAddr = 0;
+				sendSlot *s = &sendWindow[i];
+				if (s->used && s->sealed && s->addr == ack.src_addr && *(uint16_t *)(s->header + 3) == ack.seq)
+				{
+					slot = s;
+					break;
+				}
 			}
-			sem_wait(&metrics.mutex);
-			metrics.data[txAddr].frames++;
-			metrics.data[txAddr].bytes += MAC_Header_len + msg.len;
-			printf("## MAC_TX: %d B\n", MAC_Header_len + msg.len);
-			sem_post(&metrics.mutex);
 
-			if (mac->debug)
+			if (slot != NULL)
 			{
-				// Gesendeten Header und Nachricht ausgeben
-				printf("Gesendet: ");
-				for (int i = 0; i < MAC_Header_len; i++)
-					printf("%02X ", buffer[i]);
-				printf("|");
-				for (int i = MAC_Header_len; i < MAC_Header_len + msg.len; i++)
-					printf(" %02X", buffer[i]);
-				printf("\n");
+				// Round-Trip-Time nur für nicht wiederholte Nachrichten messen (Karn)
+				if (!slot->retransmitted)
+					rtt_sample(slot->addr, (ack.time - slot->sentAt) / 1000000);
+
+				sendWindow_complete(mac, slot, true);
 			}
+			else if (mac->debug)
+				// Wiederholtes oder unbekanntes Acknowledgement
+				printf("Wrong ACK -> Received: src_addr = %02X, seq = %d\n", ack.src_addr, ack.seq);
+		}
 
-			// Auf Acknowledgement warten
-			if (msg.addr != ADDR_BROADCAST && !acknowledged(mac, msg.addr))
-			{
-				// Update metrics
-				sem_wait(&metrics.mutex);
-				metrics.data[msg.addr].failures++;
-				sem_post(&metrics.mutex);
+		// Nachrichten aus der Warteschlange an einen wartenden Frame an denselben Empfänger anhängen
+		// oder in einen freien Slot legen, solange ein Slot frei ist
+		while (1)
+		{
+			sendSlot *empty = NULL;
+			for (int i = 0; i < sendWindow_slots && empty == NULL; i++)
+				if (!sendWindow[i].used)
+					empty = &sendWindow[i];
 
-				if (mac->debug)
-					printf("No ACK received. addr:%02d seq:%d\n", msg.addr, sendSeq[msg.addr]);
+			sendMessage msg;
+			if (empty == NULL || !sendMsgQ_trydequeue(mac, &msg))
+				break;
 
-				// Anzahl Sendeversuche = max. Anz. Versuche -> Sendeversuch abbrechen
-				if (numtrials >= mac->maxtrials)
-				{
-					sem_wait(&metrics.mutex);
-					metrics.data[msg.addr].drops++;
-					sem_post(&metrics.mutex);
-					printf("### Packet to %02d dropped: %d B\n", msg.addr, msg.len);
-					fflush(stdout);
-					break;
-				}
+			bool appended = false;
+			for (int i = 0; i < sendWindow_slots && mac->aggregate && !appended; i++)
+				appended = sendWindow_append(mac, &sendWindow[i], msg);
+
+			if (!appended)
+				sendWindow_fill(mac, empty, msg, order++);
+		}
 
-				// Anzahl Sendeversuche inkrementieren
-				numtrials++;
+		// Abgelaufene Nachrichten wiederholen oder verwerfen
+		uint64_t now = vclock_now();
+		for (int i = 0; i < sendWindow_slots; i++)
+		{
+			sendSlot *slot = &sendWindow[i];
+			if (!slot->used || !slot->sent || now < slot->deadline)
+				continue;
 
-				sem_wait(&metrics.mutex);
-				metrics.data[msg.addr].retries++;
-				sem_post(&metrics.mutex);
+			uint8_t addr = slot->addr;
 
+			// Update metrics
+			vclock_sem_wait(&metrics.mutex);
+			metrics.data[addr].failures++;
+			vclock_sem_post(&metrics.mutex);
+
+			if (mac->debug)
+				printf("No ACK received. addr:%02d seq:%d\n", addr, *(uint16_t *)(slot->header + 3));
+
+			// Anzahl Sendeversuche = max. Anz. Versuche -> Sendeversuch abbrechen
+			if (slot->numtrials >= mac->maxtrials)
+			{
+				vclock_sem_wait(&metrics.mutex);
+				metrics.data[addr].drops++;
+				vclock_sem_post(&metrics.mutex);
+				printf("### Packet to %02d dropped: %d B\n", addr, slot->len);
+				fflush(stdout);
+				sendWindow_complete(mac, slot, false);
 				continue;
 			}
 
-			// Erfolg der Übertragung setzen
-			success = true;
+			// Anzahl Sendeversuche inkrementieren, Nachricht erneut senden
+			slot->numtrials++;
+			slot->sent = false;
+			slot->retransmitted = true;
+			inFlight[addr]--;
 
-			break;
+			// ACK-Timeout des Empfängers verlängern
+			rtt_backoff(addr);
+
+			vclock_sem_wait(&metrics.mutex);
+			metrics.data[addr].retries++;
+			vclock_sem_post(&metrics.mutex);
 		}
 
-		// Sequenznummer inkrementieren
-		sendSeq[msg.addr]++;
+		// Ältesten ungesendeten Frame wählen, dessen Empfänger noch Platz im Fenster hat
+		// und der nicht mehr auf weitere Nachrichten wartet, bei striktem Scheduling aus der höchsten Klasse
+		sendSlot *next = NULL;
+		for (int i = 0; i < sendWindow_slots; i++)
+		{
+			sendSlot *slot = &sendWindow[i];
+			if (!slot->used || slot->sent)
+				continue;
+			if (slot->addr != ADDR_BROADCAST && inFlight[slot->addr] >= mac->window)
+				continue;
+			if (mac->aggregate && !slot->sealed && !sendWindow_full(slot) && now < slot->hold)
+				continue;
+			if (next == NULL || (!mac->prioWeighted && slot->prio < next->prio))
+				next = slot;
+			else if ((mac->prioWeighted || slot->prio == next->prio) && (int32_t)(slot->order - next->order) < 0)
+				next = slot;
+		}
 
-		if (mac->debug)
+		if (next != NULL)
 		{
-			if (success)
-				// Nachricht bestätigt
-				printf("Nachricht wurde nach %d Versuch(en) bestätigt.\n", numtrials);
-			else
-				// Nachricht wurde nicht bestätigt
-				printf("Nachricht wurde nach %d Versuch(en) nicht bestätigt.\n", numtrials);
+			sendWindow_transmit(mac, next);
+			continue;
 		}
 
-		// Wenn der empfangende (Anwendungs-) Thread blockiert
-		if (msg.blocking)
+		// Nichts zu senden -> bis zum nächsten ACK-Timeout, dem Ende einer Wartezeit auf weitere Nachrichten,
+		// einem Acknowledgement oder einer neuen Nachricht warten
+		uint64_t deadline = 0;
+		for (int i = 0; i < sendWindow_slots; i++)
 		{
-			// Erfolg der Übertragung setzen
-			*msg.success = success;
+			sendSlot *slot = &sendWindow[i];
+			if (slot->used && slot->sent && (deadline == 0 || slot->deadline < deadline))
+				deadline = slot->deadline;
+			if (slot->used && !slot->sent && !slot->sealed && (deadline == 0 || slot->hold < deadline))
+				deadline = slot->hold;
+		}
 
-			// Signalisieren, dass die Operation abgeschlossen wurde
-			sem_post(msg.fin);
+		if (deadline == 0)
+			vclock_sem_wait(&sem_send);
+		else
+		{
+			struct timespec ts;
+			ts.tv_sec = deadline / 1000000000;
+			ts.tv_nsec = deadline % 1000000000;
+			vclock_sem_clockwait(&sem_send, CLOCK_MONOTONIC, &ts);
 		}
 	}
+
+	return NULL;
 }
 
 void ALOHA_init(MAC *mac, unsigned char addr)
@@ -824,6 +1331,19 @@ void ALOHA_init(MAC *mac, unsigned char addr)
 	// maximal 5 Sendeversuche
 	mac->maxtrials = 5;
 
+	// bis zu 4 unbestätigte Nachrichten pro Empfänger
+	mac->window = 4;
+
+	// wartende Nachrichten an denselben Empfänger zusammenfassen, ohne auf weitere zu warten
+	mac->aggregate = 1;
+	mac->aggHoldMs = 0;
+
+	// Klassen der Sendewarteschlange strikt nach Priorität senden, gewichtet 4:2:1
+	mac->prioWeighted = 0;
+	mac->prioWeight[MAC_PRIO_CONTROL] = 4;
+	mac->prioWeight[MAC_PRIO_DATA] = 2;
+	mac->prioWeight[MAC_PRIO_TELEMETRY] = 1;
+
 	// nicht senden wenn Noise >= -95dBm
 	mac->noiseThreshold = -95;
 
@@ -837,22 +1357,38 @@ void ALOHA_init(MAC *mac, unsigned char addr)
 	mac->ambient = 1;
 	mac->noiseBackoffMs = 500;
 
+	// Ambient Noise alle 250ms abfragen, Messwerte älter als 1 Sekunde nicht mehr verwenden
+	mac->noisePeriodMs = 250;
+	mac->noiseMaxAgeMs = 1000;
+
 	// untere Schicht initialisieren
-	SX1262_init(868, SX1262_Transmission);
+	SX1262_Config phy = {0};
+	phy.channel = 868;
+	phy.mode = SX1262_Transmission;
+	SX1262_init(&phy);
+
+	// Tabellen der Checksumme berechnen
+	crc16_init();
 
 	// Warteschlange initialisieren
 	recvMsgQ_init();
 	sendMsgQ_init();
+	ackQ_init();
 
 	// Semaphoren initialisieren
 	sem_init(&sem_noise, 0, 0);
-	sem_init(&sem_ack, 0, 0);
+	sem_init(&noise.mutex, 0, 1);
+	sem_init(&noise.query, 0, 1);
+	sem_init(&sem_send, 0, 0);
+
+	// Round-Trip-Time-Schätzungen initialisieren
+	rtt_init();
 
 	// Zufallsgenerator initialisieren
 	srand(addr);
 
 	// Threads starten, bei Fehler Programm beenden
-	if (pthread_create(&recvT, NULL, &recvMsg_func, mac) != 0)
+	if (vclock_thread_create(&recvT, NULL, &recvMsg_func, mac) != 0)
 	{
 		fprintf(stderr, "Error %d creating recvThread: %s\n",
 				errno, strerror(errno));
@@ -860,7 +1396,7 @@ void ALOHA_init(MAC *mac, unsigned char addr)
 		exit(EXIT_FAILURE);
 	}
 
-	if (pthread_create(&sendT, NULL, &sendMsg_func, mac) != 0)
+	if (vclock_thread_create(&sendT, NULL, &sendMsg_func, mac) != 0)
 	{
 		fprintf(stderr, "Error %d creating sendMsgThread: %s\n",
 				errno, strerror(errno));
@@ -881,8 +1417,8 @@ int ALOHA_recv(MAC *mac, unsigned char *msg_buffer)
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -904,8 +1440,8 @@ int ALOHA_tryrecv(MAC *mac, unsigned char *msg_buffer)
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -918,7 +1454,7 @@ int ALOHA_timedrecv(MAC *mac, unsigned char *msg_buffer, unsigned int timeout)
 {
 	//  Timeout festlegen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
+	vclock_gettime(CLOCK_REALTIME, &ts);
 	ts.tv_sec += timeout;
 
 	// Nachricht aus Warteschlange entfernen, bei Timeout 0 zurückgeben
@@ -934,17 +1470,58 @@ int ALOHA_timedrecv(MAC *mac, unsigned char *msg_buffer, unsigned int timeout)
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
+
+	// RSSI-Wert in der ALOHA-Struktur speichern
+	mac->RSSI = msg.RSSI;
+
+	// Anzahl empfangener Bytes zurückgeben
+	return msg.header.msg_len;
+}
+
+int ALOHA_recvBorrow(MAC *mac, MAC_Buffer *buf, unsigned int timeout)
+{
+	// Timeout festlegen
+	struct timespec ts;
+	vclock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout;
+
+	// Nachricht aus Warteschlange entfernen, bei Timeout 0 zurückgeben
+	recvMessage msg;
+	if (!recvMsgQ_timeddequeue(&msg, &ts))
+		return 0;
+
+	// Nachrichtenheader in der ALOHA-Struktur speichern
+	mac->recvH = msg.header;
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
 
+	// Frame ohne Kopie verleihen, der Aufrufer gibt ihn mit ALOHA_release zurück
+	buf->frame = msg.frame;
+	buf->data = msg.data;
+	buf->len = msg.header.msg_len;
+	buf->room = SX1262_RXFRAME_SIZE - (msg.data - msg.frame->bytes);
+
 	// Anzahl empfangener Bytes zurückgeben
 	return msg.header.msg_len;
 }
 
+void ALOHA_release(MAC *mac, MAC_Buffer *buf)
+{
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease((SX1262_Frame *)buf->frame);
+	buf->frame = NULL;
+	buf->data = NULL;
+}
+
 int ALOHA_send(MAC *mac, unsigned char addr, unsigned char *data, unsigned int len)
+{
+	return ALOHA_sendPrio(mac, addr, data, len, MAC_PRIO_DATA);
+}
+
+int ALOHA_sendPrio(MAC *mac, unsigned char addr, unsigned char *data, unsigned int len, MAC_Prio prio)
 {
 	// Variablen für die Zeiger deklarieren
 	bool success;
@@ -957,28 +1534,21 @@ int ALOHA_send(MAC *mac, unsigned char addr, unsigned char *data, unsigned int l
 	sendMessage msg;
 	msg.addr = addr;
 	msg.len = len;
+	msg.prio = prio < MAC_PRIO_CLASSES ? prio : MAC_PRIO_DATA;
 
 	// Blockieren und Zeiger setzen
 	msg.blocking = true;
 	msg.success = &success;
 	msg.fin = &fin;
 
-	// Speicher für den Payload der Nachricht allokieren
-	msg.data = (uint8_t *)malloc(len);
-	if (msg.data == NULL)
-	{
-		fprintf(stderr, "malloc error %d in ALOHA_send: %s\n", errno, strerror(errno));
-		exit(EXIT_FAILURE);
-	}
-
-	// Nachricht in den allokierten Speicher kopieren
-	memcpy(msg.data, data, len);
+	// Der Aufrufer blockiert bis zum Abschluss, der Payload wird daher nicht kopiert
+	msg.data = data;
 
 	// Nachricht in Warteschlange einfügen
 	sendMsgQ_enqueue(msg);
 
 	// Blockieren bis die Operation abgeschlossen wurde
-	sem_wait(&fin);
+	vclock_sem_wait(&fin);
 
 	// Speicher der Semaphore freigeben
 	sem_destroy(&fin);
@@ -993,6 +1563,7 @@ int ALOHA_Isend(MAC *mac, unsigned char addr, unsigned char *data, unsigned int
 	sendMessage msg;
 	msg.addr = addr;
 	msg.len = len;
+	msg.prio = MAC_PRIO_DATA;
 
 	// nicht blockieren
 	msg.blocking = false;
@@ -1027,24 +1598,40 @@ uint8_t MAC_getHeaderSize()
 
 uint8_t *MAC_getMetricsHeader()
 {
-	return "Backffs,TotalFrames,TotalRetries,TotalFailures,PDR,AggDrops,AggTotalBytesSent";
+	return "Backffs,TotalFrames,TotalRetries,TotalFailures,PDR,AggDrops,AggTotalBytesSent,SRTT,RTO,QCtrl,QData,QTele,WaitCtrl,WaitData,WaitTele";
 }
 
 int MAC_getMetricsData(uint8_t *buffer, uint8_t addr)
 {
-	sem_wait(&metrics.mutex);
+	char *out = (char *)buffer;
+
+	vclock_sem_wait(&metrics.mutex);
 	const MAC_Data data = metrics.data[addr];
-	int rowlen = sprintf(buffer, "%ld,%ld,%ld,%ld,%ld,%ld,%ld", data.backoffs, data.frames, data.retries, data.failures, data.frames > 0 ? (((data.frames - data.failures) * 100) / data.frames) : 0, data.drops, data.bytes + metrics.data[0].bytes);
+	int rowlen = sprintf(out, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%u,%u", data.backoffs, data.frames, data.retries, data.failures, data.frames > 0 ? (((data.frames - data.failures) * 100) / data.frames) : 0, data.drops, data.bytes + metrics.data[0].bytes, rtt[addr].srtt, rtt[addr].rto);
+
+	// Sendewarteschlange pro Klasse: max. Länge und mittlere Wartezeit in ms, Broadcasts wie die Bytes
+	const MAC_Data bcast = metrics.data[0];
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+		rowlen += sprintf(out + rowlen, ",%u", data.queued[c] > bcast.queued[c] ? data.queued[c] : bcast.queued[c]);
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+	{
+		unsigned int dequeued = data.dequeued[c] + bcast.dequeued[c];
+		rowlen += sprintf(out + rowlen, ",%u", dequeued > 0 ? (data.wait[c] + bcast.wait[c]) / dequeued : 0);
+	}
+
 	metrics.data[addr] = (MAC_Data){0};
 	metrics.data[0].bytes = 0;
-	sem_post(&metrics.mutex);
+	memset(metrics.data[0].queued, 0, sizeof(metrics.data[0].queued));
+	memset(metrics.data[0].dequeued, 0, sizeof(metrics.data[0].dequeued));
+	memset(metrics.data[0].wait, 0, sizeof(metrics.data[0].wait));
+	vclock_sem_post(&metrics.mutex);
 	return rowlen;
 }
 
 static void initMetrics()
 {
 	sem_init(&metrics.mutex, 0, 1);
-	sem_wait(&metrics.mutex);
+	vclock_sem_wait(&metrics.mutex);
 	memset(metrics.data, 0, sizeof(metrics.data));
-	sem_post(&metrics.mutex);
+	vclock_sem_post(&metrics.mutex);
 }
\ No newline at end of file
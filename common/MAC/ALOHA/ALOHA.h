@@ -10,14 +10,14 @@
 // Struktur für den Nachrichtenheader
 typedef struct MAC_Header
 {
-	uint8_t ctrl;	  // Kontrollflag
-	uint8_t src_addr; // Absenderadresse
-	uint8_t dst_addr; // Zieladresse
-	uint16_t seq;	  // Sequenznummer
-	uint16_t msg_len; // Nachrichtenlänge
-	uint8_t checksum; // Checksumme
+	uint8_t ctrl;	   // Kontrollflag
+	uint8_t src_addr;  // Absenderadresse
+	uint8_t dst_addr;  // Zieladresse
+	uint16_t seq;	   // Sequenznummer
+	uint16_t msg_len;  // Nachrichtenlänge
+	uint16_t checksum; // Checksumme (CRC-16/CCITT)
 } MAC_Header;
-#define MAC_Header_len 8
+#define MAC_Header_len 9
 
 // Struktur für die Daten des MAC-Protokolls
 typedef struct MAC
@@ -25,6 +25,7 @@ typedef struct MAC
 	/* konfigurierbare Parameter */
 	uint8_t addr;			  // Adresse des Pis
 	unsigned int maxtrials;	  // Anzahl Sendeversuche
+	unsigned int window;	  // Anzahl unbestätigter Nachrichten pro Empfänger (max. 32)
 	int noiseThreshold;		  // Schwellwert für das Ambient Noise
 	unsigned int recvTimeout; // Timeout beim Empfangen der Bytes einer Nachricht in Millisekunden
 
@@ -40,6 +41,22 @@ typedef struct MAC
 
 	// Backoff time in ms if noise too high
 	int noiseBackoffMs;
+
+	// Abfrageintervall des Ambient Noise und max. Alter der Messwerte für Sendeentscheidungen in Millisekunden
+	unsigned int noisePeriodMs;
+	unsigned int noiseMaxAgeMs;
+
+	// Kleine Nachrichten an denselben Empfänger in einem Frame zusammenfassen
+	int aggregate;
+
+	// Wartezeit auf weitere Nachrichten an denselben Empfänger in Millisekunden
+	unsigned int aggHoldMs;
+
+	// Scheduling der Klassen der Sendewarteschlange: 0 -> strikt nach Priorität, sonst gewichtet nach prioWeight
+	int prioWeighted;
+
+	// Gewichte der Klassen Kontrolle, Daten und Telemetrie (Nachrichten pro Runde)
+	unsigned int prioWeight[MAC_PRIO_CLASSES];
 } MAC;
 
 void ALOHA_init(MAC *, unsigned char);
@@ -47,9 +64,12 @@ void ALOHA_init(MAC *, unsigned char);
 int ALOHA_recv(MAC *, unsigned char *);
 int ALOHA_tryrecv(MAC *, unsigned char *);
 int ALOHA_timedrecv(MAC *, unsigned char *, unsigned int);
+int ALOHA_recvBorrow(MAC *, MAC_Buffer *, unsigned int);
+void ALOHA_release(MAC *, MAC_Buffer *);
 
 int ALOHA_send(MAC *, unsigned char, unsigned char *, unsigned int);
 int ALOHA_Isend(MAC *, unsigned char, unsigned char *, unsigned int);
+int ALOHA_sendPrio(MAC *, unsigned char, unsigned char *, unsigned int, MAC_Prio);
 
 
 #endif /* ALOHA_H */
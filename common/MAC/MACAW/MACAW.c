@@ -1,14 +1,19 @@
 ﻿#include "MACAW.h"
 
 #include <errno.h>	   // errno
+#include <inttypes.h>  // PRIu64
 #include <pthread.h>   // pthread_create
 #include <semaphore.h> // sem_init, sem_wait, sem_trywait, sem_timedwait
 #include <stdbool.h>   // bool, true, false
 #include <stdio.h>	   // printf
 #include <stdlib.h>	   // rand, malloc, free, exit
 #include <string.h>	   // memcpy, strerror
+#include <sys/uio.h>   // struct iovec
 
 #include "../SX1262/SX1262.h"
+#include "../crc16.h"
+#include "../nav.h"
+#include "../vclock.h"
 
 typedef struct MAC_Data
 {
@@ -16,6 +21,13 @@ typedef struct MAC_Data
 	uint16_t drops;
 	uint16_t bytes;
 	uint16_t control;
+	uint16_t collisions; // RTS ohne CTS
+	uint16_t idleSlots;	 // im Backoff abgewartete freie Timeslots
+	uint16_t deferrals;	 // Sendeversuche, die auf das Ende des NAV warten mussten
+	uint32_t deferMs;	 // Summe der Wartezeiten auf das Ende des NAV in ms
+	uint16_t queued[MAC_PRIO_CLASSES];	 // max. Länge der Sendewarteschlange beim Einfügen
+	uint16_t dequeued[MAC_PRIO_CLASSES]; // aus der Sendewarteschlange entnommene Nachrichten
+	uint32_t wait[MAC_PRIO_CLASSES];	 // Summe der Wartezeiten in der Sendewarteschlange in ms
 } MAC_Data;
 
 typedef struct MAC_Metrics
@@ -27,8 +39,11 @@ typedef struct MAC_Metrics
 static MAC_Metrics metrics;
 
 int (*MAC_send)(MAC *h, unsigned char dest, unsigned char *data, unsigned int len) = MACAW_send;
+int (*MAC_sendPrio)(MAC *h, unsigned char dest, unsigned char *data, unsigned int len, MAC_Prio prio) = MACAW_sendPrio;
 int (*MAC_recv)(MAC *h, unsigned char *data) = MACAW_recv;
 int (*MAC_timedRecv)(MAC *h, unsigned char *data, unsigned int timeout) = MACAW_timedrecv;
+int (*MAC_recvBorrow)(MAC *h, MAC_Buffer *buf, unsigned int timeout) = MACAW_recvBorrow;
+void (*MAC_release)(MAC *h, MAC_Buffer *buf) = MACAW_release;
 
 static void initMetrics();
 
@@ -38,13 +53,19 @@ static void initMetrics();
 #define CTRL_CTS '\xC7' // Clear To Send (CTS)
 #define CTRL_MSG '\xC8' // Nachricht
 #define CTRL_ACK '\xC9' // Acknowledgement
+#define CTRL_PRB '\xCA' // Messframe der Kalibrierung (wie eine Nachricht, wird nicht zugestellt)
+#define CTRL_BAK '\xCB' // Acknowledgement eines Bursts (Bitmap der empfangenen Frames)
+
+// max. Anzahl Nachrichten eines Bursts (Bits der Bitmap)
+#define BURST_MAX 16
 
 // Struktur einer zu empfangenden Nachricht
 typedef struct recvMessage
 {
-	MAC_Header header; // Nachrichtenheader
-	uint8_t *data;	   // Payload der Nachricht bzw. die eigentliche Nachricht
-	int8_t RSSI;	   // RSSI-Wert der Nachricht
+	MAC_Header header;	  // Nachrichtenheader
+	SX1262_Frame *frame;  // von der PHY ausgeliehener Frame
+	uint8_t *data;		  // Payload der Nachricht bzw. die eigentliche Nachricht (zeigt in den Frame)
+	int8_t RSSI;		  // RSSI-Wert der Nachricht
 } recvMessage;
 
 // Struktur für die Empfangs-Warteschlange
@@ -61,14 +82,17 @@ typedef struct sendMessage
 {
 	uint8_t addr;  // Empfängeradresse
 	uint16_t len;  // Nachrichtenlänge
-	uint8_t *data; // Payload der Nachricht
+	uint8_t *data; // Payload der Nachricht (blockierend: Puffer des Aufrufers, sonst Kopie)
+	MAC_Prio prio;	 // Klasse der Sendewarteschlange
+	uint64_t queued; // Zeitpunkt des Einfügens (vclock_now)
+	bool probe;		 // Messframe der Kalibrierung
 
 	bool blocking; // Gibt an, ob der Anwendungsthread blockiert
 	bool *success; // Gibt den erfolgreichen Abschluss einer Übertragung an
 	sem_t *fin;	   // Signalisiert den Abschluss der Übertragung
 } sendMessage;
 
-// Struktur für die Sende-Warteschlange
+// Struktur für die Sende-Warteschlange, eine pro Klasse (MAC_Prio)
 #define sendMsgQ_size 16
 typedef struct sendMsgQueue
 {
@@ -89,9 +113,11 @@ typedef struct Acknowledgement
 	uint8_t ctrl;	  // Kontrollflag
 	uint8_t src_addr; // Absenderadresse
 	uint8_t dst_addr; // Zieladresse
-	uint16_t seq;	  // Acknowledgementnummer
+	uint16_t seq;	  // Acknowledgementnummer (Burst: Sequenznummer des ersten Frames)
+	uint16_t bitmap;  // Burst: empfangene Frames, Bit i -> Sequenznummer seq + i
 } Acknowledgement;
 #define ACK_len 5
+#define BAK_len 7
 
 // Struktur für das Clear To Send und deren Semaphoren
 typedef struct RequestToSend
@@ -99,9 +125,12 @@ typedef struct RequestToSend
 	uint8_t ctrl;	  // Kontrollflag
 	uint8_t src_addr; // Absenderadresse
 	uint8_t dst_addr; // Zieladresse
-	uint16_t msg_len; // Nachrichtenlänge
+	uint16_t msg_len; // Nachrichtenlänge (Burst: Summe der Nachrichtenlängen)
+	uint8_t backoff;  // Contention Window des Absenders für diese Verbindung (Backoff Copying)
+	uint8_t burst;	  // Anzahl Frames der Reservierung
+	uint16_t seq;	  // Sequenznummer des ersten Frames
 } RequestToSend;
-#define RTS_len 5
+#define RTS_len 9
 
 // Struktur für das Clear To Send und deren Semaphoren
 typedef struct ClearToSend
@@ -109,9 +138,31 @@ typedef struct ClearToSend
 	uint8_t ctrl;	  // Kontrollflag
 	uint8_t src_addr; // Absenderadresse
 	uint8_t dst_addr; // Zieladresse
-	uint16_t msg_len; // Nachrichtenlänge
+	uint16_t msg_len; // Nachrichtenlänge (Burst: Summe der Nachrichtenlängen)
+	uint8_t backoff;  // Contention Window des Absenders für diese Verbindung (Backoff Copying)
+	uint8_t burst;	  // Anzahl Frames der Reservierung
 } ClearToSend;
-#define CTS_len 5
+#define CTS_len 7
+
+// Frames eines Sendeversuchs, mit einer RTS/CTS-Reservierung gesendet
+typedef struct Burst
+{
+	unsigned int n;								// Anzahl Frames
+	uint16_t len;								// Summe der Nachrichtenlängen
+	uint8_t index[BURST_MAX];					// Nachricht des Frames
+	uint8_t header[BURST_MAX][MAC_Header_len];	// Nachrichtenheader, die Payloads werden nicht hineinkopiert
+	struct iovec frame[BURST_MAX][2];			// Header und Payload, mit einem Schreibvorgang gesendet
+} Burst;
+
+// empfangener Burst eines Absenders, nach Verlusten wird er mit denselben Sequenznummern wiederholt
+typedef struct RecvBurst
+{
+	uint16_t seq;	 // Sequenznummer des ersten Frames
+	uint8_t count;	 // Anzahl Frames (0, 1 -> kein Burst)
+	uint16_t bitmap; // empfangene Frames, Bit i -> Sequenznummer seq + i
+	uint64_t end;	 // erwartetes Ende der Frames (vclock_now), danach wird auch ohne letzten Frame bestätigt
+	bool acked;		 // Bitmap gesendet, später eintreffende Frames werden mit neuen Sequenznummern wiederholt
+} RecvBurst;
 
 // Zustände des Sendethreads
 typedef enum sendT_State
@@ -131,11 +182,20 @@ static pthread_t recvT;
 // Sendethread
 static pthread_t sendT;
 
+// Thread, der Bursts nach ihrem erwarteten Ende bestätigt, wenn der letzte Frame fehlt
+static pthread_t burstT;
+
 // Empfangswarteschlange
 static recvMsgQueue recvMsgQ;
 
-// Sendewarteschlange
-static sendMsgQueue sendMsgQ;
+// Sendewarteschlangen der Klassen
+static sendMsgQueue sendMsgQ[MAC_PRIO_CLASSES];
+
+// Anzahl Nachrichten in allen Sendewarteschlangen
+static sem_t sendMsgQ_pending;
+
+// verbleibende Nachrichten der Klassen in der aktuellen Runde (gewichtetes Scheduling, nur Sendethread)
+static unsigned int sendCredit[MAC_PRIO_CLASSES] = {0};
 
 // Ambient Noise speichern
 static AmbientNoise noise;
@@ -161,9 +221,8 @@ static sem_t sem_busy;
 // aktuellen Zustand des Sendethread speichern
 static sendT_State state;
 
-// Zeitpunkt, ab dem wieder übertragen werden kann
-// static struct timespec wait;
-static struct timespec NAV = {0};
+// Network Allocation Vector: Zeitpunkt (monoton), ab dem wieder übertragen werden kann
+static NAV nav;
 
 // aktuelle empfangene Sequenznummern
 static uint16_t recvSeq[256] = {0};
@@ -171,6 +230,38 @@ static uint16_t recvSeq[256] = {0};
 // aktuelle gesendete Sequentnummern
 static uint16_t sendSeq[256] = {0};
 
+// Contention Window pro Empfänger in Timeslots
+static uint8_t contentionWindow[256] = {0};
+
+// aktueller Burst pro Absender
+static RecvBurst recvBurst[256] = {0};
+static sem_t recvBurst_mutex;
+
+// Gibt an, dass ein Burst angekündigt wurde (Ende für burstT neu bestimmen)
+static sem_t sem_burst;
+
+// Kalibrierung von t_offset und t_perByte aus den ACK-Latenzen:
+// Latenz = Nachricht + ACK = 2 * t_offset + (Framelänge + ACK_len) * t_perByte
+typedef struct Calibration
+{
+	sem_t mutex;
+	bool probing;					 // Kalibrierung läuft, Messungen ungewichtet sammeln
+	double n, sx, sy, sxx, sxy;		 // Summen der Ausgleichsgeraden (x: Framelänge, y: Latenz in ms)
+	double offset, perByte;			 // aktuelle Schätzung in ms (ungerundet)
+} Calibration;
+static Calibration calib;
+
+// Gewicht älterer Messungen im Betrieb und Verstärkung der Korrektur, wenn nur eine Framelänge gemessen wurde
+#define CALIB_DECAY 0.95
+#define CALIB_GAIN 0.125
+
+// Mindeststreuung der Framelängen (Standardabweichung in Bytes), ab der t_perByte geschätzt wird
+#define CALIB_SPREAD 16
+
+// Längen der Payloads der Messframes (Frames bleiben unter einem Paket des Moduls)
+static const uint16_t probeLen[] = {0, 40, 80, 120, 160, 200};
+#define probeLens (sizeof(probeLen) / sizeof(*probeLen))
+
 static void recvMsgQ_init()
 {
 	// Start- und Endzeiger initialisieren
@@ -189,15 +280,15 @@ static bool recvMsgQ_tryenqueue(recvMessage msg)
 	if (sem_trywait(&recvMsgQ.free) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
 	recvMsgQ.msg[recvMsgQ.end] = msg;
 	recvMsgQ.end = (recvMsgQ.end + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.full);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.full);
 
 	return true;
 }
@@ -205,16 +296,16 @@ static bool recvMsgQ_tryenqueue(recvMessage msg)
 static recvMessage recvMsgQ_dequeue()
 {
 	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&recvMsgQ.full);
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.full);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	recvMessage msg = recvMsgQ.msg[recvMsgQ.begin];
 	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.free);
 
 	// Nachricht zurückgeben
 	return msg;
@@ -226,15 +317,15 @@ static bool recvMsgQ_trydequeue(recvMessage *msg)
 	if (sem_trywait(&recvMsgQ.full) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	*msg = recvMsgQ.msg[recvMsgQ.begin];
 	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.free);
 
 	return true;
 }
@@ -242,84 +333,183 @@ static bool recvMsgQ_trydequeue(recvMessage *msg)
 static bool recvMsgQ_timeddequeue(recvMessage *msg, struct timespec *ts)
 {
 	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout 0 zurückgeben
-	if (sem_timedwait(&recvMsgQ.full, ts) == -1)
+	if (vclock_sem_timedwait(&recvMsgQ.full, ts) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	*msg = recvMsgQ.msg[recvMsgQ.begin];
 	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.free);
 
 	return true;
 }
 
 static void sendMsgQ_init()
 {
-	// Start- und Endzeiger initialisieren
-	sendMsgQ.begin = 0;
-	sendMsgQ.end = 0;
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+	{
+		// Start- und Endzeiger initialisieren
+		sendMsgQ[c].begin = 0;
+		sendMsgQ[c].end = 0;
+
+		// Semaphoren initialisieren
+		sem_init(&sendMsgQ[c].mutex, 0, 1);
+		sem_init(&sendMsgQ[c].free, 0, sendMsgQ_size);
+		sem_init(&sendMsgQ[c].full, 0, 0);
+	}
+	sem_init(&sendMsgQ_pending, 0, 0);
+}
 
-	// Semaphoren initialisieren
-	sem_init(&sendMsgQ.mutex, 0, 1);
-	sem_init(&sendMsgQ.free, 0, sendMsgQ_size);
-	sem_init(&sendMsgQ.full, 0, 0);
+static void sendMsgQ_insert(sendMessage msg)
+{
+	sendMsgQueue *q = &sendMsgQ[msg.prio];
+	vclock_sem_wait(&q->mutex);
+
+	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
+	q->msg[q->end] = msg;
+	q->end = (q->end + 1) % sendMsgQ_size;
+
+	// Länge der Warteschlange (mind. die eingefügte Nachricht)
+	unsigned int depth = (q->end + sendMsgQ_size - q->begin - 1) % sendMsgQ_size + 1;
+
+	// Semaphoren inkrementieren, zuerst die der Klasse, damit der Sendethread sie findet
+	vclock_sem_post(&q->mutex);
+	vclock_sem_post(&q->full);
+	vclock_sem_post(&sendMsgQ_pending);
+
+	// Broadcasts werden unter Adresse 0 gezählt
+	uint8_t addr = msg.addr == ADDR_BROADCAST ? 0 : msg.addr;
+	vclock_sem_wait(&metrics.mutex);
+	if (depth > metrics.data[addr].queued[msg.prio])
+		metrics.data[addr].queued[msg.prio] = depth;
+	vclock_sem_post(&metrics.mutex);
 }
 
 static void sendMsgQ_enqueue(sendMessage msg)
 {
-	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.free);
-	sem_wait(&sendMsgQ.mutex);
+	msg.queued = vclock_now();
 
-	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
-	sendMsgQ.msg[sendMsgQ.end] = msg;
-	sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
+	// ggf. blockieren und Semaphore dekrementieren
+	vclock_sem_wait(&sendMsgQ[msg.prio].free);
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.full);
+	sendMsgQ_insert(msg);
 }
 
 static bool sendMsgQ_tryenqueue(sendMessage msg)
 {
-	// nicht blockieren und Semaphoren dekrementieren
-	if (sem_trywait(&sendMsgQ.free) == -1)
+	msg.queued = vclock_now();
+
+	// nicht blockieren und Semaphore dekrementieren
+	if (sem_trywait(&sendMsgQ[msg.prio].free) == -1)
 		return false;
 
-	sem_wait(&sendMsgQ.mutex);
+	sendMsgQ_insert(msg);
 
-	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
-	sendMsgQ.msg[sendMsgQ.end] = msg;
-	sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
+	return true;
+}
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.full);
+static void sendMsgQ_dequeued(sendMessage *msg)
+{
+	// Wartezeit in der Warteschlange erfassen
+	uint8_t addr = msg->addr == ADDR_BROADCAST ? 0 : msg->addr;
+	vclock_sem_wait(&metrics.mutex);
+	metrics.data[addr].dequeued[msg->prio]++;
+	metrics.data[addr].wait[msg->prio] += (vclock_now() - msg->queued) / 1000000;
+	vclock_sem_post(&metrics.mutex);
+}
 
-	return true;
+static sendMessage sendMsgQ_dequeue(MAC *mac)
+{
+	// ggf. blockieren, bis eine Klasse eine Nachricht enthält
+	vclock_sem_wait(&sendMsgQ_pending);
+
+	// strikt: immer die Klasse mit der höchsten Priorität zuerst
+	// gewichtet: jede Klasse erhält pro Runde prioWeight Nachrichten, eine Runde endet, sobald keine Klasse
+	// mit verbleibendem Anteil mehr Nachrichten hat (leere Klassen geben ihren Anteil an die anderen ab)
+	while (1)
+	{
+		for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+		{
+			if (mac->prioWeighted && sendCredit[c] == 0)
+				continue;
+			if (sem_trywait(&sendMsgQ[c].full) == -1)
+				continue;
+
+			sendMsgQueue *q = &sendMsgQ[c];
+			vclock_sem_wait(&q->mutex);
+
+			// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
+			sendMessage msg = q->msg[q->begin];
+			q->begin = (q->begin + 1) % sendMsgQ_size;
+
+			// Semaphoren inkrementieren
+			vclock_sem_post(&q->mutex);
+			vclock_sem_post(&q->free);
+
+			if (mac->prioWeighted)
+				sendCredit[c]--;
+
+			sendMsgQ_dequeued(&msg);
+
+			// Nachricht zurückgeben
+			return msg;
+		}
+
+		// neue Runde
+		for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+			sendCredit[c] = mac->prioWeight[c] > 0 ? mac->prioWeight[c] : 1;
+	}
 }
 
-static sendMessage sendMsgQ_dequeue()
+static bool sendMsgQ_take(uint8_t addr, sendMessage *msg)
 {
-	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.full);
-	sem_wait(&sendMsgQ.mutex);
+	// nicht blockierend die älteste Nachricht an addr entnehmen (Klassen nach Priorität), für einen Burst
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+	{
+		if (sem_trywait(&sendMsgQ[c].full) == -1)
+			continue;
 
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-	sendMessage msg = sendMsgQ.msg[sendMsgQ.begin];
-	sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
+		sendMsgQueue *q = &sendMsgQ[c];
+		vclock_sem_wait(&q->mutex);
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.free);
+		// Nachricht an addr suchen, Messframes nicht bündeln (begin == end -> Warteschlange voll)
+		unsigned int len = (q->end + sendMsgQ_size - q->begin - 1) % sendMsgQ_size + 1;
+		unsigned int k = 0, i = q->begin;
+		while (k < len && (q->msg[i].addr != addr || q->msg[i].probe))
+		{
+			k++;
+			i = (i + 1) % sendMsgQ_size;
+		}
 
-	// Nachricht zurückgeben
-	return msg;
+		if (k == len)
+		{
+			vclock_sem_post(&q->mutex);
+			vclock_sem_post(&q->full);
+			continue;
+		}
+
+		// Nachricht entnehmen, die vorherigen Nachrichten rücken nach
+		*msg = q->msg[i];
+		for (; i != q->begin; i = (i + sendMsgQ_size - 1) % sendMsgQ_size)
+			q->msg[i] = q->msg[(i + sendMsgQ_size - 1) % sendMsgQ_size];
+		q->begin = (q->begin + 1) % sendMsgQ_size;
+
+		// Semaphoren inkrementieren, die Nachricht ist in sendMsgQ_pending gezählt (ggf. gleich nach full)
+		vclock_sem_post(&q->mutex);
+		vclock_sem_post(&q->free);
+		vclock_sem_wait(&sendMsgQ_pending);
+
+		sendMsgQ_dequeued(msg);
+
+		return true;
+	}
+
+	return false;
 }
 
 static int8_t ambientNoise(MAC *mac)
@@ -334,11 +524,11 @@ static int8_t ambientNoise(MAC *mac)
 
 		// 1 Sekunde auf das Ambient Noise warten
 		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
+		vclock_gettime(CLOCK_REALTIME, &ts);
 		ts.tv_sec += 1;
 
 		// Wenn empfangen, Ambient Noise zurückgeben
-		if (sem_timedwait(&sem_noise, &ts) == 0)
+		if (vclock_sem_timedwait(&sem_noise, &ts) == 0)
 		{
 			if (mac->debug)
 				printf("Noise: %hhddBm\n", noise.value);
@@ -352,7 +542,183 @@ static int8_t ambientNoise(MAC *mac)
 	}
 }
 
-static void requestToSend(MAC *mac, uint8_t addr, uint16_t msg_len)
+static uint8_t cw_get(MAC *mac, uint8_t addr)
+{
+	// Contention Window des Empfängers, mind. 1 Timeslot
+	unsigned int cw = contentionWindow[addr];
+	if (cw < mac->cwMin)
+		cw = mac->cwMin;
+	if (cw > mac->cwMax)
+		cw = mac->cwMax;
+	return cw > 0 ? cw : 1;
+}
+
+static void cw_set(MAC *mac, uint8_t addr, unsigned int cw)
+{
+	if (addr == ADDR_BROADCAST)
+		return;
+	if (cw < mac->cwMin)
+		cw = mac->cwMin;
+	if (cw > mac->cwMax)
+		cw = mac->cwMax;
+	contentionWindow[addr] = cw < UINT8_MAX ? cw : UINT8_MAX;
+}
+
+static void cw_increase(MAC *mac, uint8_t addr)
+{
+	// MILD: multiplikativ um den Faktor 1,5 erhöhen (mind. um 1 Timeslot)
+	unsigned int cw = cw_get(mac, addr);
+	cw_set(mac, addr, cw * 3 / 2 > cw ? cw * 3 / 2 : cw + 1);
+}
+
+static void cw_decrease(MAC *mac, uint8_t addr)
+{
+	// MILD: linear um 1 Timeslot verringern
+	unsigned int cw = cw_get(mac, addr);
+	cw_set(mac, addr, cw > 1 ? cw - 1 : cw);
+}
+
+static void cw_copy(MAC *mac, uint8_t src, uint8_t dst, uint8_t backoff)
+{
+	// Backoff Copying: ein gehörtes RTS/CTS gibt das Contention Window der Verbindung zwischen src und dst vor,
+	// Übertragungen zu beiden Stationen konkurrieren in derselben Umgebung
+	cw_set(mac, src, backoff);
+	if (dst != mac->addr)
+		cw_set(mac, dst, backoff);
+}
+
+static uint64_t airtime(MAC *mac, unsigned int len)
+{
+	// Übertragungsdauer eines Frames mit len Bytes in Nanosekunden
+	return nav_airtime(mac->t_offset, mac->t_perByte, len);
+}
+
+static uint64_t burstAirtime(MAC *mac, unsigned int burst, unsigned int msg_len)
+{
+	// Übertragungsdauer von burst Frames mit zusammen msg_len Bytes Payload und deren Acknowledgement in Nanosekunden
+	if (burst <= 1)
+		return airtime(mac, MAC_Header_len + msg_len) + airtime(mac, ACK_len);
+	return airtime(mac, burst * MAC_Header_len + msg_len) + (uint64_t)(burst - 1) * mac->t_offset * 1000000 +
+		   airtime(mac, BAK_len);
+}
+
+static void deadline(struct timespec *ts, unsigned int ms)
+{
+	// Frist auf CLOCK_MONOTONIC, unabhängig von Sprüngen der Systemzeit
+	uint64_t ns = vclock_now() + (uint64_t)ms * 1000000;
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
+static void defer(uint8_t addr)
+{
+	// Warten bis laufende fremde Übertragungen abgeschlossen wurden
+	uint64_t ns = nav_defer(&nav);
+	if (ns == 0)
+		return;
+
+	if (addr == ADDR_BROADCAST)
+		addr = 0;
+	vclock_sem_wait(&metrics.mutex);
+	metrics.data[addr].deferrals++;
+	metrics.data[addr].deferMs += ns / 1000000;
+	vclock_sem_post(&metrics.mutex);
+}
+
+static void calib_reset(MAC *mac, bool probing)
+{
+	// Lock held
+	calib.probing = probing;
+	calib.n = calib.sx = calib.sy = calib.sxx = calib.sxy = 0;
+	calib.offset = mac->t_offset;
+	calib.perByte = mac->t_perByte;
+}
+
+static bool calib_fit(double *offset, double *perByte)
+{
+	// Ausgleichsgerade y = a + b * x, nur bei ausreichend gestreuten Framelängen
+	double det = calib.n * calib.sxx - calib.sx * calib.sx;
+	if (calib.n < 2 || det < calib.n * calib.n * CALIB_SPREAD * CALIB_SPREAD)
+		return false;
+
+	double b = (calib.n * calib.sxy - calib.sx * calib.sy) / det;
+	double a = (calib.sy - b * calib.sx) / calib.n;
+	if (b <= 0)
+		return false;
+
+	// a = 2 * t_offset + ACK_len * t_perByte
+	*perByte = b;
+	*offset = (a - ACK_len * b) / 2;
+	if (*offset < 0)
+		*offset = 0;
+	return true;
+}
+
+static void calib_apply(MAC *mac)
+{
+	// Lock held
+	mac->t_offset = (unsigned int)(calib.offset + 0.5);
+	mac->t_perByte = calib.perByte < 1 ? 1 : (unsigned int)(calib.perByte + 0.5);
+}
+
+static void calib_sample(MAC *mac, unsigned int frameLen, uint64_t latency)
+{
+	// Latenz zwischen dem Senden eines Frames und dem Erhalt seines ACKs auswerten
+	double x = frameLen;
+	double y = latency / 1e6;
+
+	vclock_sem_wait(&calib.mutex);
+	if (!calib.probing)
+	{
+		if (!mac->calibDrift)
+		{
+			vclock_sem_post(&calib.mutex);
+			return;
+		}
+
+		// Werte wurden von außen gesetzt -> Schätzung neu beginnen
+		if ((unsigned int)(calib.offset + 0.5) != mac->t_offset ||
+			(calib.perByte < 1 ? 1 : (unsigned int)(calib.perByte + 0.5)) != mac->t_perByte)
+			calib_reset(mac, false);
+
+		// Ausreißer (z. B. verzögert gesendete ACKs) verwerfen, sobald die Schätzung auf Messungen beruht
+		double predicted = 2 * calib.offset + (x + ACK_len) * calib.perByte;
+		if (calib.n >= 4 && y > 2 * predicted)
+		{
+			vclock_sem_post(&calib.mutex);
+			return;
+		}
+
+		// ältere Messungen abschwächen, damit die Schätzung einer Drift folgt
+		calib.n *= CALIB_DECAY;
+		calib.sx *= CALIB_DECAY;
+		calib.sy *= CALIB_DECAY;
+		calib.sxx *= CALIB_DECAY;
+		calib.sxy *= CALIB_DECAY;
+	}
+
+	calib.n += 1;
+	calib.sx += x;
+	calib.sy += y;
+	calib.sxx += x * x;
+	calib.sxy += x * y;
+
+	if (!calib.probing)
+	{
+		// mit gestreuten Framelängen beide Werte schätzen, sonst nur den Offset nachführen
+		if (!calib_fit(&calib.offset, &calib.perByte))
+		{
+			double predicted = 2 * calib.offset + (x + ACK_len) * calib.perByte;
+			calib.offset += CALIB_GAIN * (y - predicted) / 2;
+			if (calib.offset < 0)
+				calib.offset = 0;
+		}
+		calib_apply(mac);
+	}
+	vclock_sem_post(&calib.mutex);
+}
+
+static void requestToSend(MAC *mac, uint8_t addr, uint16_t msg_len, uint8_t burst, uint16_t seq)
 {
 	// Puffer für das Request To Send
 	uint8_t buffer[RTS_len];
@@ -372,17 +738,27 @@ static void requestToSend(MAC *mac, uint8_t addr, uint16_t msg_len)
 	*p = addr;
 	p += sizeof(addr);
 
-	// Nachrichtenlänge in den Puffer schreiben
+	// Nachrichtenlänge in den Puffer schreiben, Zeiger weitersetzen
 	*(uint16_t *)p = msg_len;
+	p += sizeof(msg_len);
+
+	// Contention Window für den Empfänger in den Puffer schreiben
+	*p = cw_get(mac, addr);
+	p += sizeof(uint8_t);
+
+	// Anzahl Frames und Sequenznummer des ersten Frames in den Puffer schreiben
+	*p = burst;
+	p += sizeof(burst);
+	*(uint16_t *)p = seq;
 
 	// Request To Send versenden
 	SX1262_send(buffer, sizeof(buffer));
 	if (addr != ADDR_BROADCAST)
 	{
-		sem_wait(&metrics.mutex);
+		vclock_sem_wait(&metrics.mutex);
 		metrics.data[addr].bytes += sizeof(buffer);
 		metrics.data[addr].control++;
-		sem_post(&metrics.mutex);
+		vclock_sem_post(&metrics.mutex);
 		printf("## MAC_TX: %d B\n", sizeof(buffer));
 	}
 
@@ -391,7 +767,7 @@ static void requestToSend(MAC *mac, uint8_t addr, uint16_t msg_len)
 		printf("Sent RTS to pi%d.\n", addr);
 }
 
-static void clearToSend(MAC *mac, uint8_t addr, uint16_t msg_len)
+static void clearToSend(MAC *mac, uint8_t addr, uint16_t msg_len, uint8_t burst)
 {
 	// Puffer für das Clear To Send
 	uint8_t buffer[CTS_len];
@@ -411,17 +787,25 @@ static void clearToSend(MAC *mac, uint8_t addr, uint16_t msg_len)
 	*p = addr;
 	p += sizeof(addr);
 
-	// Nachrichtenlänge in den Puffer schreiben
+	// Nachrichtenlänge in den Puffer schreiben, Zeiger weitersetzen
 	*(uint16_t *)p = msg_len;
+	p += sizeof(msg_len);
+
+	// Contention Window für den Absender des RTS in den Puffer schreiben
+	*p = cw_get(mac, addr);
+	p += sizeof(uint8_t);
+
+	// Anzahl Frames in den Puffer schreiben
+	*p = burst;
 
 	// Clear To Send versenden
 	if (addr != ADDR_BROADCAST)
 	{
 		SX1262_send(buffer, sizeof(buffer));
-		sem_wait(&metrics.mutex);
+		vclock_sem_wait(&metrics.mutex);
 		metrics.data[addr].bytes += sizeof(buffer);
 		metrics.data[addr].control++;
-		sem_post(&metrics.mutex);
+		vclock_sem_post(&metrics.mutex);
 		printf("## MAC_TX: %d B\n", sizeof(buffer));
 	}
 
@@ -456,24 +840,84 @@ static void acknowledgement(MAC *mac, MAC_Header recvH)
 	// Acknowledgement versenden
 	SX1262_send(buffer, sizeof(buffer));
 	
-	sem_wait(&metrics.mutex);
+	vclock_sem_wait(&metrics.mutex);
 	metrics.data[recvH.src_addr].bytes += sizeof(buffer);
 	metrics.data[recvH.src_addr].control++;
-	sem_post(&metrics.mutex);
+	vclock_sem_post(&metrics.mutex);
 	printf("## MAC_TX: %d B\n", sizeof(buffer));
 }
 
+static void burstAcknowledgement(MAC *mac, uint8_t addr, const RecvBurst *burst)
+{
+	// Puffer für das Acknowledgement des Bursts
+	uint8_t buffer[BAK_len];
+
+	// Zeiger auf buffer setzen
+	uint8_t *p = buffer;
+
+	// Kontrollflag in buffer schreiben
+	*p = CTRL_BAK;
+	p += sizeof(uint8_t);
+
+	// Absenderadresse in buffer schreiben, Zeiger weitersetzen
+	*p = mac->addr;
+	p += sizeof(mac->addr);
+
+	// Zieladresse in buffer schreiben, Zeiger weitersetzen
+	*p = addr;
+	p += sizeof(addr);
+
+	// Sequenznummer des ersten Frames und Bitmap der empfangenen Frames in buffer kopieren
+	*(uint16_t *)p = burst->seq;
+	p += sizeof(burst->seq);
+	*(uint16_t *)p = burst->bitmap;
+
+	// Acknowledgement versenden
+	SX1262_send(buffer, sizeof(buffer));
+
+	vclock_sem_wait(&metrics.mutex);
+	metrics.data[addr].bytes += sizeof(buffer);
+	metrics.data[addr].control++;
+	vclock_sem_post(&metrics.mutex);
+	printf("## MAC_TX: %zu B\n", sizeof(buffer));
+}
+
+static bool burstAcknowledged(MAC *mac, uint8_t addr, uint16_t *bitmap)
+{
+	// Timeout festlegen
+	struct timespec ts;
+	deadline(&ts, mac->timeout * 1000);
+
+	while (1)
+	{
+		// Auf das Acknowledgement warten, bei Timeout abbrechen
+		if (vclock_sem_clockwait(&sem_ack, CLOCK_MONOTONIC, &ts) == -1)
+			return false;
+
+		// Acknowledgement des Bursts, wenn Sender der Empfänger ist und die Sequenznummer des ersten Frames übereinstimmt
+		if (ack.ctrl == CTRL_BAK && ack.src_addr == addr && ack.seq == sendSeq[addr])
+		{
+			*bitmap = ack.bitmap;
+			return true;
+		}
+		else if (mac->debug)
+		{
+			printf("Wrong ACK -> Expected: src_addr = %02X, seq = %d (Burst)\n", addr, sendSeq[addr]);
+			printf("             Received: src_addr = %02X, seq = %d\n", ack.src_addr, ack.seq);
+		}
+	}
+}
+
 static bool acknowledged(MAC *mac, uint8_t addr)
 {
 	// Timeout festlegen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
-	ts.tv_sec += mac->timeout;
+	deadline(&ts, mac->timeout * 1000);
 
 	while (1)
 	{
 		// Auf das Acknowledgement warten, bei Timeout abbrechen
-		if (sem_timedwait(&sem_ack, &ts) == -1)
+		if (vclock_sem_clockwait(&sem_ack, CLOCK_MONOTONIC, &ts) == -1)
 			return false;
 
 		// Nachricht ist ein Acknowledgement, wenn Sender der vorherige Empfänger ist
@@ -495,8 +939,11 @@ static void *recvT_func(void *args)
 	// Gibt an, ob eine eingehende Übertragung stattfindet
 	bool transm = false;
 
-	// Empfangszeitpunkt des RTS
-	struct timespec transmTime;
+	// Empfangszeitpunkt des RTS (vclock_now)
+	uint64_t transmTime = 0;
+
+	// Absender des RTS
+	uint8_t transmAddr = 0;
 
 	while (1)
 	{
@@ -527,7 +974,7 @@ static void *recvT_func(void *args)
 					noise.value = -ambient[2] / 2;
 
 					// Erhalt signalisieren
-					sem_post(&sem_noise);
+					vclock_sem_post(&sem_noise);
 				}
 			}
 			else if (mac->debug)
@@ -573,19 +1020,29 @@ static void *recvT_func(void *args)
 
 			// Nachrichtenlänge speichern
 			recvRTS.msg_len = *(uint16_t *)p;
+			p += sizeof(recvRTS.msg_len);
+
+			// Contention Window des Absenders übernehmen
+			recvRTS.backoff = *p;
+			p += sizeof(recvRTS.backoff);
+			cw_copy(mac, recvRTS.src_addr, recvRTS.dst_addr, recvRTS.backoff);
+
+			// Anzahl Frames und Sequenznummer des ersten Frames speichern
+			recvRTS.burst = *p;
+			p += sizeof(recvRTS.burst);
+			recvRTS.seq = *(uint16_t *)p;
 
 			// aktuelle Zeit abrufen
-			struct timespec now;
-			clock_gettime(CLOCK_REALTIME, &now);
+			uint64_t now = vclock_now();
 
-			// Übertragungsdauer in Millisekunden berechnen
-			uint64_t ms = (mac->t_offset + CTS_len * mac->t_perByte) +							  // Clear To Send
-						  (mac->t_offset + (MAC_Header_len + recvRTS.msg_len) * mac->t_perByte) + // Nachricht
-						  (mac->t_offset + ACK_len * mac->t_perByte);							  // Acknowledgement
+			// Übertragungsdauer bis zum Ende der Nachrichten und bis zum Ende des Acknowledgements berechnen
+			uint64_t ns = airtime(mac, CTS_len) +									// Clear To Send
+						  burstAirtime(mac, recvRTS.burst, recvRTS.msg_len);		// Nachrichten und Acknowledgement
+			uint64_t toMsg = ns - airtime(mac, recvRTS.burst > 1 ? BAK_len : ACK_len);
 
 			if (mac->debug)
 				// Empfangenes RTS ausgeben
-				printf("RTS: pi%d -> pi%d, NAV = %llums\n", recvRTS.src_addr, recvRTS.dst_addr, ms);
+				printf("RTS: pi%d -> pi%d, NAV = %" PRIu64 "ms\n", recvRTS.src_addr, recvRTS.dst_addr, ns / 1000000);
 
 			// Wenn das RTS an diesen Pi adressiert ist
 			if (recvRTS.dst_addr == mac->addr)
@@ -593,32 +1050,46 @@ static void *recvT_func(void *args)
 				// Wenn nicht schon ein RTS empfangen wurde
 				// oder ein Timeout auftritt
 				// und keine fremde Übertragung stattfindet
-				if ((!transm || now.tv_sec - transmTime.tv_sec >= mac->timeout) &&
-					(NAV.tv_sec < now.tv_sec || NAV.tv_sec == now.tv_sec && NAV.tv_nsec < now.tv_nsec))
+				// (ein von burstT bestätigter Burst beendet die Übertragung ebenfalls)
+				if ((!transm || now - transmTime >= (uint64_t)mac->timeout * 1000000000 || recvBurst[transmAddr].acked) &&
+					nav_remaining(&nav) == 0)
 				{
 					// Clear To Send (CTS) senden
-					clearToSend(mac, recvRTS.src_addr, recvRTS.msg_len);
+					clearToSend(mac, recvRTS.src_addr, recvRTS.msg_len, recvRTS.burst);
+
+					// Burst erwarten, eine Wiederholung (gleiche Sequenznummern) behält die empfangenen Frames
+					vclock_sem_wait(&recvBurst_mutex);
+					RecvBurst *burst = &recvBurst[recvRTS.src_addr];
+					if (burst->seq != recvRTS.seq || burst->count != recvRTS.burst)
+					{
+						burst->seq = recvRTS.seq;
+						burst->count = recvRTS.burst <= BURST_MAX ? recvRTS.burst : 0;
+						burst->bitmap = 0;
+					}
+					// bis zum Ende der Frames (plus einem Timeslot) auf den letzten Frame warten
+					burst->end = burst->count > 1 ? now + toMsg + (uint64_t)mac->timeslot * 1000000 : 0;
+					burst->acked = false;
+					vclock_sem_post(&recvBurst_mutex);
+					if (burst->end)
+						vclock_sem_post(&sem_burst);
 
 					// Neu empfangene RTS nicht bestätigen
 					transm = true;
+					transmAddr = recvRTS.src_addr;
 
 					// Empfangszeit speichern
 					transmTime = now;
 				}
 			}
 
-			// Übertragungsdauer auf die aktuelle Zeit aufaddieren
-			uint64_t ns = now.tv_nsec + ms * 1000000;
-			now.tv_sec += ns / 1000000000;
-			now.tv_nsec = ns % 1000000000;
+			// Medium bis zum Ende der Übertragung reservieren, die Reservierung verfällt,
+			// wenn bis zum Ende der Nachrichten (plus einem Timeslot) weder CTS noch Nachricht gehört werden
+			nav_reserve(&nav, NAV_RTS, ns, toMsg + (uint64_t)mac->timeslot * 1000000);
 
-			// Endzeitpunkt der Übertragung speichern
-			NAV = now;
-
-			// Wenn sich der Sendethread im Zustand "listen" befindet
-			if (state == listen_s)
+			// Wenn sich der Sendethread im Zustand "listen" oder "backoff" befindet
+			if (state == listen_s || state == backoff_s)
 				// Dem Sendethread signalisieren, dass der Kanal nicht frei ist
-				sem_post(&sem_busy);
+				vclock_sem_post(&sem_busy);
 		}
 
 		// Clear To Send (CTS)
@@ -659,28 +1130,27 @@ static void *recvT_func(void *args)
 
 			// Nachrichtenlänge speichern
 			recvCTS.msg_len = *(uint16_t *)p;
+			p += sizeof(recvCTS.msg_len);
 
-			if (recvCTS.dst_addr != mac->addr)
-			{
-				// Übertragungsdauer in Millisekunden berechnen
-				uint64_t ms = (mac->t_offset + (MAC_Header_len + recvCTS.msg_len) * mac->t_perByte) + // Nachricht
-							  (mac->t_offset + ACK_len * mac->t_perByte);							  // Acknowledgement
+			// Contention Window des Absenders übernehmen
+			recvCTS.backoff = *p;
+			p += sizeof(recvCTS.backoff);
+			cw_copy(mac, recvCTS.src_addr, recvCTS.dst_addr, recvCTS.backoff);
 
-				// aktuelle Zeit abrufen
-				struct timespec now;
-				clock_gettime(CLOCK_REALTIME, &now);
+			// Anzahl Frames speichern
+			recvCTS.burst = *p;
 
-				// Übertragungsdauer auf die aktuelle Zeit aufaddieren
-				uint64_t ns = now.tv_nsec + ms * 1000000;
-				now.tv_sec += ns / 1000000000;
-				now.tv_nsec = ns % 1000000000;
+			if (recvCTS.dst_addr != mac->addr)
+			{
+				// Übertragungsdauer der Nachrichten und des Acknowledgements in Nanosekunden berechnen
+				uint64_t ns = burstAirtime(mac, recvCTS.burst, recvCTS.msg_len);
 
-				// Endzeitpunkt der Übertragung speichern
-				NAV = now;
+				// Medium bis zum Ende der Übertragung reservieren
+				nav_reserve(&nav, NAV_CTS, ns, 0);
 
 				if (mac->debug)
 					// Empfangenes CTS ausgeben
-					printf("CTS: pi%d -> pi%d, NAV = %llums\n", recvCTS.src_addr, recvCTS.dst_addr, ms);
+					printf("CTS: pi%d -> pi%d, NAV = %" PRIu64 "ms\n", recvCTS.src_addr, recvCTS.dst_addr, ns / 1000000);
 			}
 
 			if (mac->debug)
@@ -694,19 +1164,20 @@ static void *recvT_func(void *args)
 				cts = recvCTS;
 
 				// Empfang dem Sendethread signalisieren
-				sem_post(&sem_cts);
+				vclock_sem_post(&sem_cts);
 			}
-			// Wenn sich der Sendethread im Zustand "listen" befindet
-			else if (state == listen_s)
+			// Wenn sich der Sendethread im Zustand "listen" oder "backoff" befindet
+			else if (state == listen_s || state == backoff_s)
 				// Dem Sendethread signalisieren, dass der Kanal nicht frei ist
-				sem_post(&sem_busy);
+				vclock_sem_post(&sem_busy);
 		}
 
 		// Acknowledgement
-		else if (ctrl == CTRL_ACK)
+		else if (ctrl == CTRL_ACK || ctrl == CTRL_BAK)
 		{
-			// Puffer für das Acknowledgement und den RSSI-Wert
-			uint8_t ack_buffer[ACK_len + sizeof(int8_t)];
+			// Puffer für das Acknowledgement (ggf. mit Bitmap) und den RSSI-Wert
+			uint8_t ack_buffer[BAK_len + sizeof(int8_t)];
+			unsigned int ack_len = (ctrl == CTRL_BAK ? BAK_len : ACK_len) + sizeof(int8_t);
 
 			// Zeiger auf den Puffer setzen
 			uint8_t *p = ack_buffer;
@@ -716,7 +1187,7 @@ static void *recvT_func(void *args)
 			p += sizeof(ctrl);
 
 			// Acknowledgement und RSSI-Wert empfangen
-			if (SX1262_timedrecv(p, sizeof(ack_buffer) - sizeof(ctrl), mac->recvTimeout) != sizeof(ack_buffer) - sizeof(ctrl))
+			if (SX1262_timedrecv(p, ack_len - sizeof(ctrl), mac->recvTimeout) != ack_len - sizeof(ctrl))
 			{
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Acknowledgement.\n");
@@ -740,6 +1211,10 @@ static void *recvT_func(void *args)
 
 			// Sequenznummer speichern
 			recvACK.seq = *(uint16_t *)p;
+			p += sizeof(recvACK.seq);
+
+			// Bitmap der empfangenen Frames eines Bursts speichern
+			recvACK.bitmap = ctrl == CTRL_BAK ? *(uint16_t *)p : 0;
 
 			// Wenn das ACK nicht an diesen Pi adressiert ist
 			if (recvACK.dst_addr != mac->addr)
@@ -758,15 +1233,22 @@ static void *recvT_func(void *args)
 				ack = recvACK;
 
 				// Erhalt dem Sendethread signalisieren
-				sem_post(&sem_ack);
+				vclock_sem_post(&sem_ack);
 			}
 		}
 
 		// Nachricht
-		else if (ctrl == CTRL_MSG)
+		else if (ctrl == CTRL_MSG || ctrl == CTRL_PRB)
 		{
+			// Frame von der PHY ausleihen, Header und Payload werden direkt hinein empfangen
+			SX1262_Frame *frame = SX1262_frameGet();
+
+			// Frist für den vollständigen Empfang des Frames (Header, Payload und RSSI-Wert)
+			struct timespec deadline;
+			SX1262_deadline(&deadline, mac->recvTimeout);
+
 			// Puffer für den Nachrichtenheader
-			uint8_t header_buffer[MAC_Header_len];
+			uint8_t *header_buffer = frame->bytes;
 
 			// Zeiger auf den Puffer setzen
 			uint8_t *p = header_buffer;
@@ -774,13 +1256,15 @@ static void *recvT_func(void *args)
 			// Kontrollflag im Puffer speichern
 			*p = ctrl;
 			p += sizeof(ctrl);
+			frame->len = sizeof(ctrl);
 
 			// Nachrichtenheader empfangen
-			if (SX1262_timedrecv(p, sizeof(header_buffer) - sizeof(ctrl), mac->recvTimeout) != sizeof(header_buffer) - sizeof(ctrl))
+			if (SX1262_recvFrameUntil(frame, MAC_Header_len - sizeof(ctrl), &deadline) != MAC_Header_len - sizeof(ctrl))
 			{
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Nachrichtenheader.\n");
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -807,62 +1291,53 @@ static void *recvT_func(void *args)
 			p += sizeof(recvH.msg_len);
 
 			// Checksumme speichern
-			recvH.checksum = *p;
+			recvH.checksum = *(uint16_t *)p;
 
 			// Puffer für den Nachrichtenpayload und den RSSI-Wert
-			uint8_t msg_buffer[recvH.msg_len + sizeof(int8_t)];
+			uint8_t *msg_buffer = frame->bytes + MAC_Header_len;
 
 			// Payload der Nachricht und RSSI-Wert empfangen
-			if (SX1262_timedrecv(msg_buffer, sizeof(msg_buffer), mac->recvTimeout) != sizeof(msg_buffer))
+			if (SX1262_recvFrameUntil(frame, recvH.msg_len + sizeof(int8_t), &deadline) != recvH.msg_len + sizeof(int8_t))
 			{
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Nachrichtenpayloads.\n");
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
-			// Checksumme berechnen
-			uint8_t checksum = 0;
-			for (int i = 0; i < MAC_Header_len - sizeof(recvH.checksum); i++)
-				checksum += header_buffer[i];
-			for (int i = 0; i < recvH.msg_len; i++)
-				checksum += msg_buffer[i];
+			// Checksumme (CRC-16) berechnen
+			uint16_t checksum = crc16_update(CRC16_INIT, header_buffer, MAC_Header_len - sizeof(recvH.checksum));
+			checksum = crc16_update(checksum, msg_buffer, recvH.msg_len);
 
 			// Checksumme prüfen
 			if (checksum != recvH.checksum)
 			{
 				if (mac->debug)
-					printf("Checksumme 0x%02X ungültig! Expected: 0x%02X.\n", recvH.checksum, checksum);
+					printf("Checksumme 0x%04X ungültig! Expected: 0x%04X.\n", recvH.checksum, checksum);
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
-			// Übertragungsdauer in Millisekunden berechnen
-			uint64_t ms = (mac->t_offset + ACK_len * mac->t_perByte); // Acknowledgement
-
-			// aktuelle Zeit abrufen
-			struct timespec now;
-			clock_gettime(CLOCK_REALTIME, &now);
-
-			// Übertragungsdauer auf die aktuelle Zeit aufaddieren
-			uint64_t ns = now.tv_nsec + ms * 1000000;
-			now.tv_sec += ns / 1000000000;
-			now.tv_nsec = ns % 1000000000;
+			// Übertragungsdauer in Nanosekunden berechnen
+			uint64_t ns = airtime(mac, ACK_len); // Acknowledgement
 
-			// Endzeitpunkt der Übertragung speichern
-			NAV = now;
+			// Medium bis zum Ende des Acknowledgements reservieren
+			nav_reserve(&nav, NAV_MSG, ns, 0);
 
 			// Wenn Nachricht nicht an diesen Pi adressiert ist
 			if (recvH.dst_addr != ADDR_BROADCAST && recvH.dst_addr != mac->addr)
 			{
 				// Empfangene Nachricht ausgeben
-				printf("MSG: pi%d -> pi%d, NAV = %llums\n", recvH.src_addr, recvH.dst_addr, ms);
+				printf("MSG: pi%d -> pi%d, NAV = %" PRIu64 "ms\n", recvH.src_addr, recvH.dst_addr, ns / 1000000);
 
-				// Wenn sich der Sendethread im Zustand "listen" befindet
-				if (state == listen_s)
+				// Wenn sich der Sendethread im Zustand "listen" oder "backoff" befindet
+				if (state == listen_s || state == backoff_s)
 					// Dem Sendethread signalisieren, dass der Kanal nicht frei ist
-					sem_post(&sem_busy);
+					vclock_sem_post(&sem_busy);
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -878,17 +1353,51 @@ static void *recvT_func(void *args)
 				printf("\n");
 			}
 
+			// Frame eines angekündigten Bursts: Duplikate anhand der Bitmap erkennen, da fehlende Frames nach den
+			// folgenden schon empfangenen Frames wiederholt werden. Nach der Bestätigung durch burstT eintreffende
+			// Frames fehlen in der Bitmap und werden vom Absender wiederholt, sie werden deshalb verworfen.
+			vclock_sem_wait(&recvBurst_mutex);
+			RecvBurst *burst = &recvBurst[recvH.src_addr];
+			uint16_t index = recvH.seq - burst->seq;
+			bool inBurst = recvH.dst_addr == mac->addr && burst->count > 1 && index < burst->count;
+			bool duplicate = inBurst && (burst->bitmap & 1 << index || burst->acked);
+			bool lastFrame = inBurst && index == burst->count - 1;
+			bool sendBAK = lastFrame && !burst->acked;
+
+			// Frame des Bursts als empfangen markieren
+			if (inBurst && !duplicate && ctrl != CTRL_PRB)
+				burst->bitmap |= 1 << index;
+			if (sendBAK)
+				burst->acked = true;
+			RecvBurst received = *burst;
+			vclock_sem_post(&recvBurst_mutex);
+
+			// Messframes der Kalibrierung werden nur bestätigt, nicht zugestellt
+			if (ctrl == CTRL_PRB)
+			{
+				SX1262_frameRelease(frame);
+			}
+			// Frame des Bursts schon empfangen
+			else if (duplicate)
+			{
+				if (mac->debug)
+					printf("... wurde schon empfangen.\n\n");
+
+				SX1262_frameRelease(frame);
+			}
 			// Wenn eine Nachricht mit einer kleineren oder gleichen Sequenznummer schon empfangen wurde
 			// und Sequenznummer nicht die Startsequenznummer ist
-			if (recvH.dst_addr != ADDR_BROADCAST && recvH.seq <= recvSeq[recvH.src_addr] && recvH.seq != 0)
+			else if (!inBurst && recvH.dst_addr != ADDR_BROADCAST && recvH.seq <= recvSeq[recvH.src_addr] && recvH.seq != 0)
 			{
 				if (mac->debug)
 					printf("... wurde schon empfangen.\n\n");
+
+				SX1262_frameRelease(frame);
 			}
 			else
 			{
 				// Ignore sequece number for broadcasts
-				if (recvH.dst_addr != ADDR_BROADCAST)
+				if (recvH.dst_addr != ADDR_BROADCAST && (!inBurst || recvH.seq > recvSeq[recvH.src_addr]))
 				{
 					// aktuelle Sequenznummer speichern
 					recvSeq[recvH.src_addr] = recvH.seq;
@@ -900,16 +1409,9 @@ static void *recvT_func(void *args)
 				// Header speichern
 				msg.header = recvH;
 
-				// Speicher für den Nachrichtenpayload allokieren, bei einem Fehler das Programm beenden
-				msg.data = (uint8_t *)malloc(recvH.msg_len);
-				if (msg.data == NULL)
-				{
-					fprintf(stderr, "malloc error %d in recvT_func: %s\n", errno, strerror(errno));
-					exit(EXIT_FAILURE);
-				}
-
-				// Nachricht in den allokierten Speicher kopieren
-				memcpy(msg.data, msg_buffer, recvH.msg_len);
+				// Frame ohne Kopie weiterreichen, der Payload liegt hinter dem Header
+				msg.frame = frame;
+				msg.data = msg_buffer;
 
 				// RSSI-Wert speichern
 				msg.RSSI = msg_buffer[recvH.msg_len];
@@ -921,19 +1423,25 @@ static void *recvT_func(void *args)
 					if (mac->debug)
 						printf("recvMsgQ is full.\n");
 
-					free(msg.data);
+					SX1262_frameRelease(frame);
 				}
 			}
 
-			// Acknowledgment senden
-			// Acknowledgment senden
-			if (recvH.dst_addr != ADDR_BROADCAST)
+			// Acknowledgment senden, ein Burst wird nach seinem letzten Frame mit der Bitmap bestätigt
+			// (fehlt der letzte Frame, bestätigt burstT nach dem erwarteten Ende)
+			if (inBurst)
+			{
+				if (sendBAK)
+					burstAcknowledgement(mac, recvH.src_addr, &received);
+			}
+			else if (recvH.dst_addr != ADDR_BROADCAST)
 			{
 				acknowledgement(mac, recvH);
 			}
 
 			// Neu empfangene RTS wieder bestätigen
-			transm = false;
+			if (!inBurst || lastFrame)
+				transm = false;
 		}
 
 		// Kontrollflag unbekannt
@@ -944,7 +1452,7 @@ static void *recvT_func(void *args)
 				printf("Kontrollflag %02X unbekannt.\n", ctrl);
 
 			// 100ms warten bis die Daten vollständig empfangen wurden
-			msleep(100);
+			vclock_msleep(100);
 
 			// Solange Bytes verfügbar sind, diese empfangen und verwerfen
 			uint8_t c;
@@ -952,32 +1460,115 @@ static void *recvT_func(void *args)
 				;
 		}
 	}
-}
 
-static unsigned int backoff(unsigned int timeslot, int c)
-{
-	// Exponential Backoff: k × TimeSlot
-	// k = 0...2^c-1
-	return msleep((rand() % (1 << c)) * timeslot);
+	return NULL;
 }
 
-static void *sendT_func(void *args)
+static void *burstT_func(void *args)
 {
 	MAC *mac = (MAC *)args;
 
 	while (1)
 	{
-		// Blockieren und Nachricht aus der Warteschlange speichern
-		sendMessage msg = sendMsgQ_dequeue();
+		// frühestes Ende eines noch nicht bestätigten Bursts bestimmen
+		uint64_t next = 0;
+		vclock_sem_wait(&recvBurst_mutex);
+		for (int i = 0; i < 256; i++)
+			if (recvBurst[i].end && !recvBurst[i].acked && (next == 0 || recvBurst[i].end < next))
+				next = recvBurst[i].end;
+		vclock_sem_post(&recvBurst_mutex);
+
+		// bis dahin oder bis zum nächsten angekündigten Burst warten
+		if (next == 0)
+		{
+			vclock_sem_wait(&sem_burst);
+			continue;
+		}
+		struct timespec ts;
+		ts.tv_sec = next / 1000000000;
+		ts.tv_nsec = next % 1000000000;
+		if (vclock_sem_clockwait(&sem_burst, CLOCK_MONOTONIC, &ts) == 0)
+			continue;
+
+		// Bursts ohne letzten Frame mit den bisher empfangenen Frames bestätigen, damit der Absender
+		// nur die fehlenden wiederholt, statt nach dem ACK-Timeout den ganzen Burst
+		uint64_t now = vclock_now();
+		for (int i = 0; i < 256; i++)
+		{
+			vclock_sem_wait(&recvBurst_mutex);
+			RecvBurst *burst = &recvBurst[i];
+			bool expired = burst->end && !burst->acked && burst->end <= now;
+			if (expired)
+				burst->acked = true;
+			RecvBurst received = *burst;
+			vclock_sem_post(&recvBurst_mutex);
+
+			// ohne empfangenen Frame (z. B. CTS verloren) nicht bestätigen, der Absender wiederholt nach dem Timeout
+			if (expired && received.bitmap != 0)
+			{
+				if (mac->debug)
+					printf("Burst von pi%d ohne letzten Frame bestätigt: %04X\n", i, received.bitmap);
+				burstAcknowledgement(mac, i, &received);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void backoff(MAC *mac, uint8_t addr)
+{
+	// MACAW Backoff: 1...CW freie Timeslots abwarten, CW aus dem Contention Window des Empfängers.
+	// Hört der Empfangsthread im Backoff eine Übertragung, wird der Zähler bis zum Ende des NAV angehalten.
+	unsigned int slots = 1 + rand() % cw_get(mac, addr);
+	unsigned int idle = 0;
+
+	// Signale zu vergangenen Übertragungen verwerfen
+	while (sem_trywait(&sem_busy) == 0)
+		;
+
+	while (slots > 0)
+	{
+		struct timespec ts;
+		deadline(&ts, mac->timeslot);
+
+		// Kanal belegt -> Zähler anhalten, bis die fremde Übertragung abgeschlossen ist
+		if (vclock_sem_clockwait(&sem_busy, CLOCK_MONOTONIC, &ts) == 0)
+		{
+			defer(addr);
+			continue;
+		}
+
+		slots--;
+		idle++;
+	}
 
-		// Puffer für den Nachrichtenheader und -payload
-		uint8_t buffer[MAC_Header_len + msg.len];
+	if (addr == ADDR_BROADCAST)
+		addr = 0;
+	vclock_sem_wait(&metrics.mutex);
+	metrics.data[addr].idleSlots += idle;
+	vclock_sem_post(&metrics.mutex);
+}
+
+static void burst_build(MAC *mac, Burst *frames, sendMessage *msg, unsigned int count, uint16_t pending)
+{
+	// Frames der noch nicht bestätigten Nachrichten mit fortlaufenden Sequenznummern ab sendSeq
+	frames->n = 0;
+	frames->len = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!(pending & 1 << i))
+			continue;
+
+		// Puffer für den Nachrichtenheader, der Payload wird nicht hineinkopiert
+		uint8_t *buffer = frames->header[frames->n];
 
 		// Zeiger auf buffer setzen
 		uint8_t *p = buffer;
 
 		// Kontrollflag in buffer schreiben
-		*p = CTRL_MSG;
+		*p = msg[i].probe ? CTRL_PRB : CTRL_MSG;
 		p += sizeof(uint8_t);
 
 		// Absenderadresse in buffer schreiben, Zeiger weitersetzen
@@ -985,72 +1576,123 @@ static void *sendT_func(void *args)
 		p += sizeof(mac->addr);
 
 		// Zieladresse in buffer schreiben, Zeiger weitersetzen
-		*p = msg.addr;
-		p += sizeof(msg.addr);
+		*p = msg[i].addr;
+		p += sizeof(msg[i].addr);
 
 		// Sequenznummer in buffer kopieren, Zeiger weitersetzen
-		*(uint16_t *)p = sendSeq[msg.addr];
-		p += sizeof(sendSeq[msg.addr]);
+		*(uint16_t *)p = sendSeq[msg[i].addr] + frames->n;
+		p += sizeof(uint16_t);
 
 		// Nachrichtenlänge in buffer kopieren, Zeiger weitersetzen
-		*(uint16_t *)p = msg.len;
-		p += sizeof(msg.len);
+		*(uint16_t *)p = msg[i].len;
+		p += sizeof(msg[i].len);
 
-		// Checksumme berechnen
-		uint8_t checksum = 0;
-		for (int i = 0; i < MAC_Header_len - sizeof(checksum); i++)
-			checksum += buffer[i];
-		for (int i = 0; i < msg.len; i++)
-			checksum += msg.data[i];
+		// Checksumme (CRC-16) berechnen
+		uint16_t checksum = crc16_update(CRC16_INIT, buffer, MAC_Header_len - sizeof(checksum));
+		checksum = crc16_update(checksum, msg[i].data, msg[i].len);
 
-		// Checksumme in buffer schreiben, Zeiger weitersetzen
-		*p = checksum;
-		p += sizeof(checksum);
+		// Checksumme in buffer schreiben
+		*(uint16_t *)p = checksum;
 
-		// Payload in den Puffer kopieren
-		memcpy(p, msg.data, msg.len);
+		// Header und Payload werden mit einem Schreibvorgang gesendet
+		frames->frame[frames->n][0] = (struct iovec){buffer, MAC_Header_len};
+		frames->frame[frames->n][1] = (struct iovec){msg[i].data, msg[i].len};
 
-		// allokierten Speicher freigeben
-		free(msg.data);
+		frames->index[frames->n] = i;
+		frames->len += msg[i].len;
+		frames->n++;
+	}
+}
 
-		// Erfolg der Übertragung auf false setzen
-		bool success = false;
+static void dropped(uint8_t addr, sendMessage *msg, unsigned int count, uint16_t pending)
+{
+	// nicht bestätigte Nachrichten nach dem letzten Sendeversuch verwerfen
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!(pending & 1 << i))
+			continue;
+
+		vclock_sem_wait(&metrics.mutex);
+		metrics.data[addr].drops++;
+		vclock_sem_post(&metrics.mutex);
+		printf("### Packet to %02d dropped: %d B\n", addr, msg[i].len);
+	}
+	fflush(stdout);
+}
+
+static void complete(MAC *mac, sendMessage *msg, bool success, unsigned int numtrials)
+{
+	// Kopie einer nicht blockierenden Nachricht freigeben
+	if (!msg->blocking)
+		free(msg->data);
+
+	if (mac->debug)
+	{
+		if (success)
+			// Nachricht bestätigt
+			printf("Nachricht wurde nach %d Versuch(en) bestätigt.\n", numtrials);
+		else
+			// Nachricht wurde nicht bestätigt
+			printf("Nachricht wurde nach %d Versuch(en) nicht bestätigt.\n", numtrials);
+	}
+
+	// Wenn der empfangende (Anwendungs-) Thread blockiert
+	if (msg->blocking)
+	{
+		// Erfolg der Übertragung setzen
+		*msg->success = success;
+
+		// Signalisieren, dass die Operation abgeschlossen wurde
+		vclock_sem_post(msg->fin);
+	}
+}
+
+static void *sendT_func(void *args)
+{
+	MAC *mac = (MAC *)args;
+
+	while (1)
+	{
+		// Blockieren und Nachricht aus der Warteschlange speichern
+		sendMessage msg = sendMsgQ_dequeue(mac);
+
+		// Burst: weitere Nachrichten an denselben Empfänger mit derselben RTS/CTS-Reservierung senden
+		sendMessage burst[BURST_MAX];
+		burst[0] = msg;
+		unsigned int count = 1;
+		if (msg.addr != ADDR_BROADCAST && !msg.probe)
+			while (count < mac->burstMax && count < BURST_MAX && sendMsgQ_take(msg.addr, &burst[count]))
+				count++;
+
+		// noch nicht bestätigte Nachrichten, Bit i -> burst[i]
+		uint16_t pending = (1u << count) - 1;
+
+		// Frames des ersten Sendeversuchs
+		Burst frames;
+		burst_build(mac, &frames, burst, count, pending);
 
 		// Anzahl Versuche speichern
 		unsigned int numtrials = 1;
 
-		// aktuelle Zeit abrufen
 		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
 
 		// Warten bis laufende fremde Übertragungen abgeschlossen wurden
-		while (NAV.tv_sec > ts.tv_sec || NAV.tv_sec == ts.tv_sec && NAV.tv_nsec > ts.tv_nsec)
-		{
-			msleep((NAV.tv_sec - ts.tv_sec) * 1e3 + (NAV.tv_nsec - ts.tv_nsec) / 1e6);
-			clock_gettime(CLOCK_REALTIME, &ts);
-		}
+		defer(msg.addr);
 
 		// In den Zustand "delay" wechseln
 		state = delay_s;
 
 		// Sleep for a short random duration
-		msleep(100 + rand() % 501);
+		vclock_msleep(100 + rand() % 501);
 
 		while (1)
 		{
 			// In den Zustand "listen" wechseln
 			state = listen_s;
 
-			// aktuelle Zeit abrufen
-			clock_gettime(CLOCK_REALTIME, &ts);
-
-			// Timeslot aufaddieren
-			uint64_t ns = ts.tv_nsec + mac->timeslot * 1000000;
-			ts.tv_sec += ns / 1000000000;
-			ts.tv_nsec = ns % 1000000000;
-
-			// Auf einen freien Kanal warten
-			if (sem_timedwait(&sem_busy, &ts) == 0)
+			// Einen Timeslot auf einen freien Kanal warten
+			deadline(&ts, mac->timeslot);
+			if (vclock_sem_clockwait(&sem_busy, CLOCK_MONOTONIC, &ts) == 0)
 			{
 				if (mac->debug)
 					printf("Channel is busy.\n");
@@ -1059,17 +1701,15 @@ static void *sendT_func(void *args)
 				if (numtrials >= mac->maxtrials)
 					break;
 
+				// Warten bis die fremde Übertragung abgeschlossen wurden
+				defer(msg.addr);
+
 				// In den Zustand "Backoff" wechseln
 				state = backoff_s;
 
-				// aktuelle Zeit abrufen
-				clock_gettime(CLOCK_REALTIME, &ts);
-
-				// Warten bis die fremde Übertragung abgeschlossen wurden
-				msleep((NAV.tv_sec - ts.tv_sec) * 1e3 + (NAV.tv_nsec - ts.tv_nsec) / 1e6);
-
 				// Backoff
-				backoff(mac->timeslot, numtrials++);
+				backoff(mac, msg.addr);
+				numtrials++;
 
 				continue;
 			}
@@ -1092,7 +1732,8 @@ static void *sendT_func(void *args)
 				state = backoff_s;
 
 				// Backoff
-				backoff(mac->timeslot, numtrials++);
+				backoff(mac, msg.addr);
+				numtrials++;
 
 				continue;
 			}
@@ -1103,18 +1744,23 @@ static void *sendT_func(void *args)
 			// Request To Send (RTS) senden
 			if (msg.addr != ADDR_BROADCAST)
 			{
-				requestToSend(mac, msg.addr, msg.len);
+				requestToSend(mac, msg.addr, frames.len, frames.n, sendSeq[msg.addr]);
 
 				// Timeout festlegen
-				clock_gettime(CLOCK_REALTIME, &ts);
-				ts.tv_sec += mac->timeout;
+				deadline(&ts, mac->timeout * 1000);
 
 				// Auf Clear To Send (CTS) warten
-				if (sem_timedwait(&sem_cts, &ts) == -1)
+				if (vclock_sem_clockwait(&sem_cts, CLOCK_MONOTONIC, &ts) == -1)
 				{
 					if (mac->debug)
 						printf("No CTS received.\n");
 
+					// RTS kollidiert oder Empfänger blockiert -> Contention Window vergrößern
+					cw_increase(mac, msg.addr);
+					vclock_sem_wait(&metrics.mutex);
+					metrics.data[msg.addr].collisions++;
+					vclock_sem_post(&metrics.mutex);
+
 					// anz_versuche = max_versuche -> Sendeversuch abbrechen
 					if (numtrials >= mac->maxtrials)
 						break;
@@ -1123,7 +1769,8 @@ static void *sendT_func(void *args)
 					state = backoff_s;
 
 					// Backoff
-					backoff(mac->timeslot, numtrials++);
+					backoff(mac, msg.addr);
+					numtrials++;
 
 					continue;
 				}
@@ -1138,17 +1785,15 @@ static void *sendT_func(void *args)
 					if (numtrials >= mac->maxtrials)
 						break;
 
+					// Warten bis die fremde Übertragung abgeschlossen wurden
+					defer(msg.addr);
+
 					// In den Zustand "Backoff" wechseln
 					state = backoff_s;
 
-					// aktuelle Zeit abrufen
-					clock_gettime(CLOCK_REALTIME, &ts);
-
-					// Warten bis die fremde Übertragung abgeschlossen wurden
-					msleep((NAV.tv_sec - ts.tv_sec) * 1e3 + (NAV.tv_nsec - ts.tv_nsec) / 1e6);
-
 					// Backoff
-					backoff(mac->timeslot, numtrials++);
+					backoff(mac, msg.addr);
+					numtrials++;
 
 					continue;
 				}
@@ -1157,47 +1802,53 @@ static void *sendT_func(void *args)
 			// In den Zustand "Await ACK" wechseln
 			state = awaitAck_s;
 
-			// Nachricht versenden
-			SX1262_send(buffer, sizeof(buffer));
-
-			// Update metrics
-			uint8_t txAddr = msg.addr;
-			if (msg.addr == ADDR_BROADCAST)
-			{
-				txAddr = 0;
-			}
-			sem_wait(&metrics.mutex);
-			metrics.data[txAddr].frames++;
-			metrics.data[txAddr].bytes += sizeof(buffer);
-			printf("## MAC_TX: %d B\n", sizeof(buffer));
-			sem_post(&metrics.mutex);
-			
-			if (mac->debug)
+			// Nachrichten direkt nacheinander versenden
+			uint64_t sentAt = vclock_now();
+			for (unsigned int j = 0; j < frames.n; j++)
 			{
-				// Gesendeten Header und Nachricht zum Testen ausgeben
-				printf("Gesendet: ");
-				for (int i = 0; i < MAC_Header_len; i++)
-					printf("%02X ", buffer[i]);
-				printf("|");
-				for (int i = MAC_Header_len; i < MAC_Header_len + msg.len; i++)
-					printf(" %02X", buffer[i]);
-				printf("\n");
+				sendMessage *m = &burst[frames.index[j]];
+				SX1262_sendFrame(frames.frame[j], 2);
+
+				// Update metrics
+				uint8_t txAddr = msg.addr;
+				if (msg.addr == ADDR_BROADCAST)
+				{
+					txAddr = 0;
+				}
+				vclock_sem_wait(&metrics.mutex);
+				metrics.data[txAddr].frames++;
+				metrics.data[txAddr].bytes += MAC_Header_len + m->len;
+				printf("## MAC_TX: %d B\n", MAC_Header_len + m->len);
+				vclock_sem_post(&metrics.mutex);
+
+				if (mac->debug)
+				{
+					// Gesendeten Header und Nachricht zum Testen ausgeben
+					printf("Gesendet: ");
+					for (int i = 0; i < MAC_Header_len; i++)
+						printf("%02X ", frames.header[j][i]);
+					printf("|");
+					for (int i = 0; i < m->len; i++)
+						printf(" %02X", m->data[i]);
+					printf("\n");
+				}
 			}
 
-			// Auf Acknowledgement warten
-			if (msg.addr != ADDR_BROADCAST && !acknowledged(mac, msg.addr))
+			// Auf Acknowledgement warten, ein Burst wird mit der Bitmap der empfangenen Frames bestätigt
+			uint16_t acked = 1;
+			if (msg.addr != ADDR_BROADCAST &&
+				!(frames.n == 1 ? acknowledged(mac, msg.addr) : burstAcknowledged(mac, msg.addr, &acked)))
 			{
 				if (mac->debug)
 					printf("No ACK received.\n");
 
+				// Nachricht oder ACK verloren -> Contention Window vergrößern
+				cw_increase(mac, msg.addr);
+
 				// anz_versuche = max_versuche -> Sendeversuch abbrechen
 				if (numtrials >= mac->maxtrials)
 				{
-					sem_wait(&metrics.mutex);
-					metrics.data[msg.addr].drops++;
-					sem_post(&metrics.mutex);
-					printf("### Packet to %02d dropped: %d B\n", msg.addr, msg.len);
-					fflush(stdout);
+					dropped(msg.addr, burst, count, pending);
 					break;
 				}
 
@@ -1205,43 +1856,55 @@ static void *sendT_func(void *args)
 				state = backoff_s;
 
 				// Backoff
-				backoff(mac->timeslot, numtrials++);
+				backoff(mac, msg.addr);
+				numtrials++;
 
 				continue;
 			}
 
-			// Erfolg der Übertragung setzen
-			success = true;
-
-			break;
+			// Contention Window verkleinern
+			if (msg.addr != ADDR_BROADCAST)
+				cw_decrease(mac, msg.addr);
+
+			// ACK-Latenz einzelner Frames zur Kalibrierung der Übertragungszeiten, nach Wiederholungen könnte
+			// das ACK einem früheren Versuch gelten
+			if (msg.addr != ADDR_BROADCAST && numtrials == 1 && frames.n == 1)
+				calib_sample(mac, MAC_Header_len + frames.len, vclock_now() - sentAt);
+
+			// bestätigte Nachrichten
+			for (unsigned int j = 0; j < frames.n; j++)
+				if (acked & 1 << j)
+					pending &= ~(1 << frames.index[j]);
+
+			// Erfolg der Übertragung
+			if (pending == 0)
+				break;
+
+			// Burst teilweise bestätigt: fehlende Nachrichten mit neuen Sequenznummern in einer neuen
+			// Reservierung senden
+			sendSeq[msg.addr] += frames.n;
+			if (numtrials >= mac->maxtrials)
+			{
+				dropped(msg.addr, burst, count, pending);
+				frames.n = 0;
+				break;
+			}
+			burst_build(mac, &frames, burst, count, pending);
+			numtrials++;
 		}
 
 		// In den Zustand "IDLE" wechseln
 		state = idle_s;
 
-		// Sequenznummer inkrementieren
-		sendSeq[msg.addr]++;
-
-		if (mac->debug)
-		{
-			if (success)
-				// Nachricht bestätigt
-				printf("Nachricht wurde nach %d Versuch(en) bestätigt.\n", numtrials);
-			else
-				// Nachricht wurde nicht bestätigt
-				printf("Nachricht wurde nach %d Versuch(en) nicht bestätigt.\n", numtrials);
-		}
+		// Sequenznummern der Frames des letzten Sendeversuchs inkrementieren
+		sendSeq[msg.addr] += frames.n;
 
-		// Wenn der empfangende (Anwendungs-) Thread blockiert
-		if (msg.blocking)
-		{
-			// Erfolg der Übertragung setzen
-			*msg.success = success;
-
-			// Signalisieren, dass die Operation abgeschlossen wurde
-			sem_post(msg.fin);
-		}
+		// Nachrichten abschließen
+		for (unsigned int i = 0; i < count; i++)
+			complete(mac, &burst[i], !(pending & 1 << i), numtrials);
 	}
+
+	return NULL;
 }
 
 void MACAW_init(MAC *mac, unsigned char addr)
@@ -1252,7 +1915,13 @@ void MACAW_init(MAC *mac, unsigned char addr)
 	mac->addr = addr;
 
 	// untere Schicht initialisieren
-	SX1262_init(868, SX1262_Transmission);
+	SX1262_Config phy = {0};
+	phy.channel = 868;
+	phy.mode = SX1262_Transmission;
+	SX1262_init(&phy);
+
+	// Tabellen der Checksumme berechnen
+	crc16_init();
 
 	// Warteschlange initialisieren
 	recvMsgQ_init();
@@ -1263,9 +1932,12 @@ void MACAW_init(MAC *mac, unsigned char addr)
 	sem_init(&sem_ack, 0, 0);
 	sem_init(&sem_cts, 0, 0);
 	sem_init(&sem_busy, 0, 0);
+	sem_init(&sem_burst, 0, 0);
+	sem_init(&recvBurst_mutex, 0, 1);
+	nav_init(&nav);
 
 	// Zufallsgenerator initialisieren
-	srand(addr * time(NULL));
+	srand(vclock_seed(addr));
 
 	// maximal 5 Sendeversuche
 	mac->maxtrials = 5;
@@ -1287,21 +1959,44 @@ void MACAW_init(MAC *mac, unsigned char addr)
 	mac->t_offset = 170;
 	mac->t_perByte = 6;
 
+	// t_offset und t_perByte im Betrieb aus den ACK-Latenzen nachführen
+	mac->calibDrift = 1;
+	sem_init(&calib.mutex, 0, 1);
+	calib_reset(mac, false);
+
+	// Contention Window zwischen 2 und 64 Timeslots (MILD)
+	mac->cwMin = 2;
+	mac->cwMax = 64;
+	mac->burstMax = 4;
+	memset(contentionWindow, mac->cwMin, sizeof(contentionWindow));
+
+	// Klassen der Sendewarteschlange strikt nach Priorität senden, gewichtet 4:2:1
+	mac->prioWeighted = 0;
+	mac->prioWeight[MAC_PRIO_CONTROL] = 4;
+	mac->prioWeight[MAC_PRIO_DATA] = 2;
+	mac->prioWeight[MAC_PRIO_TELEMETRY] = 1;
+
 	// Zustand des Sendethreads initailisieren (IDLE)
 	state = idle_s;
 
 	// Threads starten, bei Fehler Programm beenden
-	if (pthread_create(&recvT, NULL, &recvT_func, mac) != 0)
+	if (vclock_thread_create(&recvT, NULL, &recvT_func, mac) != 0)
 	{
 		fprintf(stderr, "Error %d creating recvThread: %s\n", errno, strerror(errno));
 		exit(EXIT_FAILURE);
 	}
 
-	if (pthread_create(&sendT, NULL, &sendT_func, mac) != 0)
+	if (vclock_thread_create(&sendT, NULL, &sendT_func, mac) != 0)
 	{
 		fprintf(stderr, "Error %d creating sendThread: %s\n", errno, strerror(errno));
 		exit(EXIT_FAILURE);
 	}
+
+	if (vclock_thread_create(&burstT, NULL, &burstT_func, mac) != 0)
+	{
+		fprintf(stderr, "Error %d creating burstThread: %s\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
 }
 
 int MACAW_recv(MAC *mac, unsigned char *msg_buffer)
@@ -1315,8 +2010,8 @@ int MACAW_recv(MAC *mac, unsigned char *msg_buffer)
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -1338,8 +2033,8 @@ int MACAW_tryrecv(MAC *mac, unsigned char *msg_buffer)
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -1352,7 +2047,7 @@ int MACAW_timedrecv(MAC *mac, unsigned char *msg_buffer, unsigned int timeout)
 {
 	// Timeout festlegen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
+	vclock_gettime(CLOCK_REALTIME, &ts);
 	ts.tv_sec += timeout;
 
 	// Nachricht aus Warteschlange entfernen, bei Timeout 0 zurückgeben
@@ -1366,8 +2061,8 @@ int MACAW_timedrecv(MAC *mac, unsigned char *msg_buffer, unsigned int timeout)
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -1376,7 +2071,48 @@ int MACAW_timedrecv(MAC *mac, unsigned char *msg_buffer, unsigned int timeout)
 	return msg.header.msg_len;
 }
 
+int MACAW_recvBorrow(MAC *mac, MAC_Buffer *buf, unsigned int timeout)
+{
+	// Timeout festlegen
+	struct timespec ts;
+	vclock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout;
+
+	// Nachricht aus Warteschlange entfernen, bei Timeout 0 zurückgeben
+	recvMessage msg;
+	if (!recvMsgQ_timeddequeue(&msg, &ts))
+		return 0;
+
+	// Nachrichtenheader in der MACAW-Struktur speichern
+	mac->recvH = msg.header;
+
+	// RSSI-Wert in der MACAW-Struktur speichern
+	mac->RSSI = msg.RSSI;
+
+	// Frame ohne Kopie verleihen, der Aufrufer gibt ihn mit MACAW_release zurück
+	buf->frame = msg.frame;
+	buf->data = msg.data;
+	buf->len = msg.header.msg_len;
+	buf->room = SX1262_RXFRAME_SIZE - (msg.data - msg.frame->bytes);
+
+	// Anzahl empfangener Bytes zurückgeben
+	return msg.header.msg_len;
+}
+
+void MACAW_release(MAC *mac, MAC_Buffer *buf)
+{
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease((SX1262_Frame *)buf->frame);
+	buf->frame = NULL;
+	buf->data = NULL;
+}
+
 int MACAW_send(MAC *mac, unsigned char addr, unsigned char *data, unsigned int len)
+{
+	return MACAW_sendPrio(mac, addr, data, len, MAC_PRIO_DATA);
+}
+
+static int sendBlocking(uint8_t addr, uint8_t *data, unsigned int len, MAC_Prio prio, bool probe)
 {
 	// Variablen für die Zeiger deklarieren
 	bool success;
@@ -1389,28 +2125,22 @@ int MACAW_send(MAC *mac, unsigned char addr, unsigned char *data, unsigned int l
 	sendMessage msg;
 	msg.addr = addr;
 	msg.len = len;
+	msg.prio = prio < MAC_PRIO_CLASSES ? prio : MAC_PRIO_DATA;
+	msg.probe = probe;
 
 	// Blockieren und Zeiger setzen
 	msg.blocking = true;
 	msg.success = &success;
 	msg.fin = &fin;
 
-	// Speicher für den Payload der Nachricht allokieren
-	msg.data = (uint8_t *)malloc(len);
-	if (msg.data == NULL)
-	{
-		fprintf(stderr, "malloc error %d in MAC_send: %s\n", errno, strerror(errno));
-		exit(EXIT_FAILURE);
-	}
-
-	// Nachricht in den allokierten Speicher kopieren
-	memcpy(msg.data, data, len);
+	// Der Aufrufer blockiert bis zum Abschluss, der Payload wird daher nicht kopiert
+	msg.data = data;
 
 	// Nachricht in Warteschlange einfügen
 	sendMsgQ_enqueue(msg);
 
 	// Blockieren bis die Operation abgeschlossen wurde
-	sem_wait(&fin);
+	vclock_sem_wait(&fin);
 
 	// Speicher der Semaphore freigeben
 	sem_destroy(&fin);
@@ -1419,12 +2149,19 @@ int MACAW_send(MAC *mac, unsigned char addr, unsigned char *data, unsigned int l
 	return success;
 }
 
+int MACAW_sendPrio(MAC *mac, unsigned char addr, unsigned char *data, unsigned int len, MAC_Prio prio)
+{
+	return sendBlocking(addr, data, len, prio, false);
+}
+
 int MACAW_Isend(MAC *mac, unsigned char addr, unsigned char *data, unsigned int len)
 {
 	// Nachricht setzen
 	sendMessage msg;
 	msg.addr = addr;
 	msg.len = len;
+	msg.prio = MAC_PRIO_DATA;
+	msg.probe = false;
 
 	// nicht blockieren
 	msg.blocking = false;
@@ -1452,6 +2189,88 @@ int MACAW_Isend(MAC *mac, unsigned char addr, unsigned char *data, unsigned int
 	return true;
 }
 
+int MACAW_calibrate(MAC *mac, unsigned char addr, unsigned int rounds)
+{
+	// Messframes werden bestätigt, Broadcasts nicht
+	if (addr == ADDR_BROADCAST)
+		return false;
+
+	vclock_sem_wait(&calib.mutex);
+	calib_reset(mac, true);
+	vclock_sem_post(&calib.mutex);
+
+	// Payload der Messframes
+	uint8_t data[200] = {0};
+
+	// je Runde ein Messframe jeder Länge, nur bestätigte Frames ohne Wiederholung werden ausgewertet
+	for (unsigned int r = 0; r < rounds; r++)
+		for (unsigned int i = 0; i < probeLens; i++)
+			sendBlocking(addr, data, probeLen[i], MAC_PRIO_CONTROL, true);
+
+	vclock_sem_wait(&calib.mutex);
+	double offset, perByte;
+	bool ok = calib_fit(&offset, &perByte);
+	if (ok)
+	{
+		calib.offset = offset;
+		calib.perByte = perByte;
+		calib_apply(mac);
+	}
+	// die Messungen bleiben die Grundlage für die Nachführung im Betrieb
+	calib.probing = false;
+	vclock_sem_post(&calib.mutex);
+
+	if (mac->debug)
+	{
+		if (ok)
+			printf("Kalibrierung: t_offset = %.1fms, t_perByte = %.2fms (%.0f Messungen).\n", offset, perByte, calib.n);
+		else
+			printf("Kalibrierung fehlgeschlagen (%.0f Messungen).\n", calib.n);
+	}
+
+	return ok;
+}
+
+int MACAW_saveTiming(MAC *mac, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Error %d opening %s: %s\n", errno, path, strerror(errno));
+		return false;
+	}
+
+	fprintf(file, "t_offset=%u\nt_perByte=%u\n", mac->t_offset, mac->t_perByte);
+	fclose(file);
+
+	return true;
+}
+
+int MACAW_loadTiming(MAC *mac, const char *path)
+{
+	// Datei fehlt -> Standardwerte bzw. eigene Kalibrierung verwenden
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return false;
+
+	unsigned int offset, perByte;
+	int n = fscanf(file, "t_offset=%u t_perByte=%u", &offset, &perByte);
+	fclose(file);
+	if (n != 2 || perByte == 0)
+	{
+		fprintf(stderr, "MACAW_loadTiming - Error: %s is not a timing file.\n", path);
+		return false;
+	}
+
+	vclock_sem_wait(&calib.mutex);
+	mac->t_offset = offset;
+	mac->t_perByte = perByte;
+	calib_reset(mac, false);
+	vclock_sem_post(&calib.mutex);
+
+	return true;
+}
+
 uint8_t MAC_getHeaderSize()
 {
 	return MAC_Header_len;
@@ -1459,24 +2278,49 @@ uint8_t MAC_getHeaderSize()
 
 uint8_t *MAC_getMetricsHeader()
 {
-	return "AggTotalBytes,AggDrops,ControlFramesSent";
+	return "AggTotalBytes,AggDrops,ControlFramesSent,QCtrl,QData,QTele,WaitCtrl,WaitData,WaitTele,Collisions,IdleSlots,CW,Deferrals,DeferMs";
 }
 
 int MAC_getMetricsData(uint8_t *buffer, uint8_t addr)
 {
-	sem_wait(&metrics.mutex);
+	char *out = (char *)buffer;
+
+	vclock_sem_wait(&metrics.mutex);
 	const MAC_Data data = metrics.data[addr];
-	int rowlen = sprintf(buffer, "%ld,%ld,%ld", data.bytes + metrics.data[0].bytes, data.drops,data.control);
+	int rowlen = sprintf(out, "%ld,%ld,%ld", data.bytes + metrics.data[0].bytes, data.drops,data.control);
+
+	// Sendewarteschlange pro Klasse: max. Länge und mittlere Wartezeit in ms, Broadcasts wie die Bytes
+	const MAC_Data bcast = metrics.data[0];
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+		rowlen += sprintf(out + rowlen, ",%u", data.queued[c] > bcast.queued[c] ? data.queued[c] : bcast.queued[c]);
+	for (int c = 0; c < MAC_PRIO_CLASSES; c++)
+	{
+		unsigned int dequeued = data.dequeued[c] + bcast.dequeued[c];
+		rowlen += sprintf(out + rowlen, ",%u", dequeued > 0 ? (data.wait[c] + bcast.wait[c]) / dequeued : 0);
+	}
+
+	// Backoff: Kollisionen, freie Timeslots im Backoff (Broadcasts wie die Bytes) und aktuelles Contention Window
+	rowlen += sprintf(out + rowlen, ",%u,%u,%u", data.collisions, data.idleSlots + bcast.idleSlots, contentionWindow[addr]);
+
+	// NAV: Sendeversuche, die auf fremde Übertragungen warten mussten, und Wartezeit in ms (Broadcasts wie die Bytes)
+	rowlen += sprintf(out + rowlen, ",%u,%u", data.deferrals + bcast.deferrals, data.deferMs + bcast.deferMs);
+
 	metrics.data[addr] = (MAC_Data){0};
 	metrics.data[0].bytes = 0;
-	sem_post(&metrics.mutex);
+	metrics.data[0].idleSlots = 0;
+	metrics.data[0].deferrals = 0;
+	metrics.data[0].deferMs = 0;
+	memset(metrics.data[0].queued, 0, sizeof(metrics.data[0].queued));
+	memset(metrics.data[0].dequeued, 0, sizeof(metrics.data[0].dequeued));
+	memset(metrics.data[0].wait, 0, sizeof(metrics.data[0].wait));
+	vclock_sem_post(&metrics.mutex);
 	return rowlen;
 }
 
 static void initMetrics()
 {
 	sem_init(&metrics.mutex, 0, 1);
-	sem_wait(&metrics.mutex);
+	vclock_sem_wait(&metrics.mutex);
 	memset(metrics.data, 0, sizeof(metrics.data));
-	sem_post(&metrics.mutex);
+	vclock_sem_post(&metrics.mutex);
 }
\ No newline at end of file
@@ -13,9 +13,9 @@ typedef struct MAC_Header {
 	uint8_t dst_addr;		// Zieladresse
 	uint16_t seq;			// Sequenznummer
 	uint16_t msg_len;		// Nachrichtenlänge
-	uint8_t checksum;		// Checksumme
+	uint16_t checksum;		// Checksumme (CRC-16/CCITT)
 } MAC_Header;
-#define MAC_Header_len 8
+#define MAC_Header_len 9
 
 // Struktur für die Daten des MACAW-Protokolls
 typedef struct MAC {
@@ -28,6 +28,10 @@ typedef struct MAC {
 	unsigned int timeslot;		// Timeslot in Millisekunden für den Backoff
 	unsigned int t_offset;		// Offset für das Versenden von Bytes in Millisekunden
 	unsigned int t_perByte;		// Übertragungsdauer für jedes zusätzliche Byte in Millisekuden
+	int calibDrift;				// t_offset und t_perByte im Betrieb aus den ACK-Latenzen nachführen (0 -> aus)
+	unsigned int cwMin;			// kleinstes Contention Window in Timeslots
+	unsigned int cwMax;			// größtes Contention Window in Timeslots (max. 255)
+	unsigned int burstMax;		// max. Anzahl Nachrichten an denselben Empfänger je RTS/CTS-Reservierung (1 -> kein Burst, max. 16)
 
 	/* Daten zur letzten empfangenen Nachricht */
 	MAC_Header recvH;			// Nachrichtenheader der letzten empfangenen Nachricht
@@ -38,6 +42,12 @@ typedef struct MAC {
 
 	// Enable ambient noise monitoring
 	int ambient;
+
+	// Scheduling der Klassen der Sendewarteschlange: 0 -> strikt nach Priorität, sonst gewichtet nach prioWeight
+	int prioWeighted;
+
+	// Gewichte der Klassen Kontrolle, Daten und Telemetrie (Nachrichten pro Runde)
+	unsigned int prioWeight[MAC_PRIO_CLASSES];
 } MAC;
 
 void MACAW_init(MAC*, unsigned char);
@@ -45,9 +55,20 @@ void MACAW_init(MAC*, unsigned char);
 int MACAW_recv(MAC*, unsigned char*);
 int MACAW_tryrecv(MAC*, unsigned char*);
 int MACAW_timedrecv(MAC*, unsigned char*, unsigned int);
+int MACAW_recvBorrow(MAC*, MAC_Buffer*, unsigned int);
+void MACAW_release(MAC*, MAC_Buffer*);
 
 int MACAW_send(MAC*, unsigned char, unsigned char*, unsigned int);
 int MACAW_Isend(MAC*, unsigned char, unsigned char*, unsigned int);
+int MACAW_sendPrio(MAC*, unsigned char, unsigned char*, unsigned int, MAC_Prio);
+
+// Kalibrierung von t_offset und t_perByte: Messframes verschiedener Länge an einen Nachbarn senden und die
+// ACK-Latenzen mit einer Ausgleichsgeraden auswerten, rounds Durchläufe über alle Längen
+int MACAW_calibrate(MAC*, unsigned char, unsigned int);
+
+// kalibrierte Zeiten für spätere Läufe speichern bzw. laden
+int MACAW_saveTiming(MAC*, const char*);
+int MACAW_loadTiming(MAC*, const char*);
 
 
 #endif /* MACAW_H */
@@ -1,14 +1,19 @@
 ﻿#include "STEM.h"
 
 #include <errno.h>			// errno
+#include <inttypes.h>		// PRIu64
 #include <pthread.h>        // pthread_create
 #include <semaphore.h>      // sem_init, sem_wait, sem_trywait, sem_timedwait
 #include <stdbool.h>		// bool, true, false
 #include <stdio.h>			// printf
 #include <stdlib.h>			// rand, malloc, free, exit
 #include <string.h>			// memcpy, strerror
+#include <sys/uio.h>		// struct iovec
 
 #include "../SX1262/SX1262.h"
+#include "../crc16.h"
+#include "../nav.h"
+#include "../vclock.h"
 
 // Kontrollflags
 #define CTRL_RET 		'\xC1'		// Antwort des Moduls
@@ -26,7 +31,8 @@
 // Struktur einer zu empfangenden Nachricht
 typedef struct recvMessage {
 	MAC_Header header;		// Nachrichtenheader
-	uint8_t* data;			// Payload der Nachricht bzw. die eigentliche Nachricht
+	SX1262_Frame* frame;	// von der PHY ausgeliehener Frame
+	uint8_t* data;			// Payload der Nachricht bzw. die eigentliche Nachricht (zeigt in den Frame)
 	uint8_t RSSI;			// RSSI-Wert der Nachricht
 } recvMessage;
 
@@ -42,7 +48,7 @@ typedef struct recvMsgQueue {
 typedef struct sendMessage {
 	uint8_t addr;			// Empfängeradresse
 	uint16_t len;			// Nachrichtenlänge
-	uint8_t* data;			// Payload der Nachricht
+	uint8_t* data;			// Payload der Nachricht (blockierend: Puffer des Aufrufers, sonst Kopie)
 
 	bool blocking;			// Gibt an, ob der Anwendungsthread blockiert
 	bool* success;			// Gibt den erfolgreichen Abschluss einer Übertragung an
@@ -94,8 +100,9 @@ typedef struct WakeBeacon {
 	uint8_t ctrl;				// Kontrollflag
 	uint8_t src_addr;			// Absenderadresse
 	uint8_t dst_addr;			// Zieladresse
+	uint8_t count;				// Anzahl Nachrichten, die im Wachzyklus übertragen werden
 } WakeBeacon;
-#define WakeBeacon_len 3
+#define WakeBeacon_len 4
 
 // Struktur für das Wake-Acknowledgement
 typedef struct WakeAcknowledgement {
@@ -110,6 +117,19 @@ typedef enum sendT_State {
 	idle_s, awaitWakeBea_s, awaitWakeAck_s, awaitMsg_s, delay_s, listen_s, awaitNoise_s, awaitCTS_s, awaitAck_s, backoff_s
 } sendT_State;
 
+// Zustände des Energiemodells
+enum { energyTx, energyRx, energyConfig, energySleep, energyStates };
+
+// Energiemodell: Zeit des Funkmoduls je Zustand
+typedef struct Energy {
+	sem_t mutex;
+	int mode;						// aktueller Modus des Funkmoduls (SX1262_*)
+	uint64_t since;					// Beginn des Modus (vclock_now)
+	int64_t ns[energyStates];		// Zeit je Zustand in Nanosekunden, Senden wird von Empfangen abgezogen
+	uint32_t switches;				// Anzahl Kanalwechsel
+	uint64_t switchNs;				// Dauer der Kanalwechsel in Nanosekunden
+} Energy;
+
 // Empfangsthread
 static pthread_t recvT;
 
@@ -161,9 +181,14 @@ static sem_t sem_msg;
 // aktuellen Zustand des Sendethreads speichern
 static sendT_State state;
 
-// Zeitpunkt, ab dem wieder übertragen werden kann
-//static struct timespec wait;
-static struct timespec NAV;
+// Network Allocation Vector: Zeitpunkt (monoton), ab dem wieder übertragen werden kann
+static NAV nav;
+
+// Betriebszeiten des Funkmoduls
+static Energy energy;
+
+// aktueller Kanal des Funkmoduls
+static unsigned int channel;
 
 // aktuelle empfangene Sequenznummern
 static uint16_t recvSeq[256] = { 0 };
@@ -187,31 +212,31 @@ static bool recvMsgQ_tryenqueue(recvMessage msg) {
 	if (sem_trywait(&recvMsgQ.free) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
     recvMsgQ.msg[recvMsgQ.end] = msg;
     recvMsgQ.end = (recvMsgQ.end + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-    sem_post(&recvMsgQ.full);
+	vclock_sem_post(&recvMsgQ.mutex);
+    vclock_sem_post(&recvMsgQ.full);
 
 	return true;
 }
 
 static recvMessage recvMsgQ_dequeue() {
 	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&recvMsgQ.full);
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.full);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
     recvMessage msg = recvMsgQ.msg[recvMsgQ.begin];
     recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-    sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+    vclock_sem_post(&recvMsgQ.free);
 
 	// Nachricht zurückgeben
     return msg;
@@ -222,33 +247,33 @@ static bool recvMsgQ_trydequeue(recvMessage* msg) {
 	if (sem_trywait(&recvMsgQ.full) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
     *msg = recvMsgQ.msg[recvMsgQ.begin];
     recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-    sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+    vclock_sem_post(&recvMsgQ.free);
 
     return true;
 }
 
 static bool recvMsgQ_timeddequeue(recvMessage* msg, struct timespec* ts) {
 	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout 0 zurückgeben
-	if (sem_timedwait(&recvMsgQ.full, ts) == -1)
+	if (vclock_sem_timedwait(&recvMsgQ.full, ts) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
     *msg = recvMsgQ.msg[recvMsgQ.begin];
     recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-    sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+    vclock_sem_post(&recvMsgQ.free);
 
     return true;
 }
@@ -266,16 +291,16 @@ static void sendMsgQ_init() {
 
 static void sendMsgQ_enqueue(sendMessage msg) {
 	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.free);
-	sem_wait(&sendMsgQ.mutex);
+	vclock_sem_wait(&sendMsgQ.free);
+	vclock_sem_wait(&sendMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
     sendMsgQ.msg[sendMsgQ.end] = msg;
     sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-    sem_post(&sendMsgQ.full);
+	vclock_sem_post(&sendMsgQ.mutex);
+    vclock_sem_post(&sendMsgQ.full);
 }
 
 static bool sendMsgQ_tryenqueue(sendMessage msg) {
@@ -283,92 +308,154 @@ static bool sendMsgQ_tryenqueue(sendMessage msg) {
 	if (sem_trywait(&sendMsgQ.free) == -1)
 		return false;
 
-	sem_wait(&sendMsgQ.mutex);
+	vclock_sem_wait(&sendMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
     sendMsgQ.msg[sendMsgQ.end] = msg;
     sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-    sem_post(&sendMsgQ.full);
+	vclock_sem_post(&sendMsgQ.mutex);
+    vclock_sem_post(&sendMsgQ.full);
 
 	return true;
 }
 
-static sendMessage sendMsgQ_dequeue() {
-	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.full);
-	sem_wait(&sendMsgQ.mutex);
+static bool sendMsgQ_timeddequeue(sendMessage* msg, struct timespec* ts) {
+	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout 0 zurückgeben
+	if (vclock_sem_timedwait(&sendMsgQ.full, ts) == -1)
+		return false;
+
+	vclock_sem_wait(&sendMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-    sendMessage msg = sendMsgQ.msg[sendMsgQ.begin];
+    *msg = sendMsgQ.msg[sendMsgQ.begin];
     sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-    sem_post(&sendMsgQ.free);
+	vclock_sem_post(&sendMsgQ.mutex);
+    vclock_sem_post(&sendMsgQ.free);
 
-	// Nachricht zurückgeben
-    return msg;
+    return true;
 }
 
-static bool sendMsgQ_trydequeue(sendMessage* msg) {
-	// nicht blockieren und Semaphoren dekrementieren
+static int sendMsgQ_count() {
+	// Variable für die Nachrichtenanzahl
+	int count;
+
+	// Nachrichtenanzahl über die full-Semaphore abrufen
+	sem_getvalue(&sendMsgQ.full, &count);
+
+	// Nachrichtenanzahl zurückgeben
+	return count;
+}
+
+static bool sendMsgQ_take(uint8_t addr, sendMessage* msg) {
+	// nicht blockierend die älteste Nachricht an addr entnehmen, für einen gemeinsamen Wachzyklus
 	if (sem_trywait(&sendMsgQ.full) == -1)
 		return false;
 
-	sem_wait(&sendMsgQ.mutex);
+	vclock_sem_wait(&sendMsgQ.mutex);
 
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-    *msg = sendMsgQ.msg[sendMsgQ.begin];
-    sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
+	// Nachricht an addr suchen (begin == end -> Warteschlange voll)
+	unsigned int len = (sendMsgQ.end + sendMsgQ_size - sendMsgQ.begin - 1) % sendMsgQ_size + 1;
+	unsigned int k = 0, i = sendMsgQ.begin;
+	while (k < len && sendMsgQ.msg[i].addr != addr) {
+		k++;
+		i = (i + 1) % sendMsgQ_size;
+	}
+
+	if (k == len) {
+		vclock_sem_post(&sendMsgQ.mutex);
+		vclock_sem_post(&sendMsgQ.full);
+		return false;
+	}
+
+	// Nachricht entnehmen, die vorherigen Nachrichten rücken nach
+	*msg = sendMsgQ.msg[i];
+	for (; i != sendMsgQ.begin; i = (i + sendMsgQ_size - 1) % sendMsgQ_size)
+		sendMsgQ.msg[i] = sendMsgQ.msg[(i + sendMsgQ_size - 1) % sendMsgQ_size];
+	sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-    sem_post(&sendMsgQ.free);
+	vclock_sem_post(&sendMsgQ.mutex);
+	vclock_sem_post(&sendMsgQ.free);
 
-    return true;
+	return true;
 }
 
-static bool sendMsgQ_timeddequeue(sendMessage* msg, struct timespec* ts) {
-	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout 0 zurückgeben
-	if (sem_timedwait(&sendMsgQ.full, ts) == -1)
-		return false;
+static uint64_t airtime(MAC* mac, unsigned int len) {
+	// Übertragungsdauer eines Frames mit len Bytes in Nanosekunden
+	return nav_airtime(mac->t_offset, mac->t_perByte, len);
+}
 
-	sem_wait(&sendMsgQ.mutex);
+static void deadline(struct timespec* ts, unsigned int ms) {
+	// Frist auf CLOCK_MONOTONIC, unabhängig von Sprüngen der Systemzeit
+	uint64_t ns = vclock_now() + (uint64_t)ms * 1000000;
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
 
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-    *msg = sendMsgQ.msg[sendMsgQ.begin];
-    sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
+static void defer(MAC* mac) {
+	// Warten bis laufende fremde Übertragungen abgeschlossen wurden
+	uint64_t ns = nav_defer(&nav);
 
-	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-    sem_post(&sendMsgQ.free);
+	if (ns > 0 && mac->debug)
+		printf("NAV: %" PRIu64 "ms deferred (%u deferrals, %" PRIu64 "ms total, %u RTS released).\n", ns / 1000000,
+			   nav.deferrals, nav.deferredNs / 1000000, nav.released);
+}
 
-    return true;
+static void energy_init(int mode) {
+	sem_init(&energy.mutex, 0, 1);
+	energy.mode = mode;
+	energy.since = vclock_now();
+	memset(energy.ns, 0, sizeof(energy.ns));
+	energy.switches = 0;
+	energy.switchNs = 0;
 }
 
-static int sendMsgQ_count() {
-	// Variable für die Nachrichtenanzahl
-	int count;
+// Lock gehalten
+static void energy_account(uint64_t now) {
+	// Zeit seit dem letzten Wechsel dem aktuellen Modus zuschreiben, im Übertragungsmodus wird empfangen
+	int64_t ns = now - energy.since;
+	if (energy.mode == SX1262_DeepSleep)
+		energy.ns[energySleep] += ns;
+	else if (energy.mode == SX1262_Configuration)
+		energy.ns[energyConfig] += ns;
+	else
+		energy.ns[energyRx] += ns;
+
+	energy.since = now;
+}
 
-	// Nachrichtenanzahl über die full-Semaphore abrufen
-	sem_getvalue(&sendMsgQ.full, &count);
+static void energy_tx(MAC* mac, unsigned int len) {
+	// Airtime eines gesendeten Frames von der Empfangszeit auf die Sendezeit umbuchen
+	int64_t ns = airtime(mac, len);
 
-	// Nachrichtenanzahl zurückgeben
-	return count;
+	vclock_sem_wait(&energy.mutex);
+	energy.ns[energyTx] += ns;
+	energy.ns[energyRx] -= ns;
+	vclock_sem_post(&energy.mutex);
+}
+
+static void setMode(int mode) {
+	// Zeit im bisherigen Modus verbuchen, die Umschaltdauer zählt zum neuen Modus
+	vclock_sem_wait(&energy.mutex);
+	energy_account(vclock_now());
+	energy.mode = mode;
+	vclock_sem_post(&energy.mutex);
+
+	SX1262_setMode(mode);
 }
 
 static bool acknowledged(MAC* mac, uint8_t addr) {
 	// Timeout festlegen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
-	ts.tv_sec += mac->timeout;
+	deadline(&ts, mac->timeout * 1000);
 
 	while (1) {
 		// Auf das Acknowledgement warten, bei Timeout abbrechen
-		if (sem_timedwait(&sem_ack, &ts) == -1)
+		if (vclock_sem_clockwait(&sem_ack, CLOCK_MONOTONIC, &ts) == -1)
 			return false;
 
 		// Nachricht ist ein Acknowledgement, wenn Sender der vorherige Empfänger ist
@@ -406,6 +493,7 @@ static void acknowledgement(MAC* mac, MAC_Header recvH) {
 	
 	// Acknowledgement versenden
 	SX1262_send(buffer, sizeof(buffer));
+	energy_tx(mac, sizeof(buffer));
 }
 
 static void requestToSend(MAC* mac, uint8_t addr, uint16_t msg_len) {
@@ -432,6 +520,7 @@ static void requestToSend(MAC* mac, uint8_t addr, uint16_t msg_len) {
 	
 	// Request To Send versenden
 	SX1262_send(buffer, sizeof(buffer));
+	energy_tx(mac, sizeof(buffer));
 
 	if (mac->debug)
 		// Gesendetes RTS ausgeben
@@ -462,22 +551,24 @@ static void clearToSend(MAC* mac, uint8_t addr, uint16_t msg_len) {
 	
 	// Clear To Send versenden
 	SX1262_send(buffer, sizeof(buffer));
+	energy_tx(mac, sizeof(buffer));
 
 	if (mac->debug)
 		// Gesendetes CTS ausgeben
 		printf("Sent CTS to pi%d.\n", addr);
 }
 
-static void wakeBeacon(MAC* mac, uint8_t addr) {
+static void wakeBeacon(MAC* mac, uint8_t addr, uint8_t count) {
 	// Inhalt des Beacons setzen
-	uint8_t bea[] = { CTRL_WAKE_BEA, mac->addr, addr };
+	uint8_t bea[] = { CTRL_WAKE_BEA, mac->addr, addr, count };
 
 	// Beacon senden
 	SX1262_send(bea, sizeof(bea));
+	energy_tx(mac, sizeof(bea));
 
 	if (mac->debug)
 		// Gesendeten Baecon ausgeben
-		printf("Sent Beacon to pi%d.\n", addr);
+		printf("Sent Beacon to pi%d (%d message(s)).\n", addr, count);
 }
 
 static void wakeAcknowledgement(MAC* mac, uint8_t addr) {
@@ -486,6 +577,7 @@ static void wakeAcknowledgement(MAC* mac, uint8_t addr) {
 
 	// Acknowledgement senden
 	SX1262_send(ack, sizeof(ack));
+	energy_tx(mac, sizeof(ack));
 
 	if (mac->debug)
 		// Gesendetes Acknowledgement ausgeben
@@ -502,11 +594,11 @@ static int8_t ambientNoise(MAC* mac) {
 
 		// 1 Sekunde auf das Ambient Noise warten
 		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
+		vclock_gettime(CLOCK_REALTIME, &ts);
 		ts.tv_sec += 1;
 
 		// Auf das Ambient Noise bzw. die Antwort warten
-		if (sem_timedwait(&sem_ret, &ts) == 0) {
+		if (vclock_sem_timedwait(&sem_ret, &ts) == 0) {
 			// Wenn Anfang = 0 und Länge = 1
 			if (ret.reg[0] == '\x00' && ret.reg[1] == '\x01') {
 				// Ambient Noise zwischenspeichern
@@ -532,22 +624,28 @@ static int8_t ambientNoise(MAC* mac) {
 	}
 }
 
-static void setChannel(unsigned int channel) {
+static void setChannel(unsigned int ch) {
 	// Ungültigen Kanal übergeben
-    if (channel < 850 || channel > 933) {
-        fprintf(stderr, "SX1262_setChannel - Error: Channel %d is not allowed.\n", channel);
+    if (ch < 850 || ch > 933) {
+        fprintf(stderr, "SX1262_setChannel - Error: Channel %d is not allowed.\n", ch);
         exit(EXIT_FAILURE);
     }
 
+	// Jeder Wechsel kostet zwei Moduswechsel (> 1 Sekunde), daher nur bei einem anderen Kanal umschalten
+	if (ch == channel)
+		return;
+
+	uint64_t start = vclock_now();
+
 	// Funkmodul in den Konfigurationmodus schalten
-	SX1262_setMode(SX1262_Configuration);
+	setMode(SX1262_Configuration);
 
 	// Konfiguration auf den Bus schreiben
-	uint8_t cfg_reg[] = { '\xC2', '\x05', '\x01', channel - 850 };
+	uint8_t cfg_reg[] = { '\xC2', '\x05', '\x01', ch - 850 };
 	SX1262_send(cfg_reg, sizeof(cfg_reg));
 
 	// Auf die Antowrt des Funkmoduls warten
-    sem_wait(&sem_ret);
+    vclock_sem_wait(&sem_ret);
 
     // wenn ein Byte der Antwort unterschiedlich -> falsche Konfiguration
     for (int i = 0; i < sizeof(ret.reg); i++) {
@@ -564,7 +662,14 @@ static void setChannel(unsigned int channel) {
     }
 	
 	// Funkmodul in den Übertragungsmodus schalten
-	SX1262_setMode(SX1262_Transmission);
+	setMode(SX1262_Transmission);
+	channel = ch;
+
+	// Kosten des Kanalwechsels speichern
+	vclock_sem_wait(&energy.mutex);
+	energy.switches++;
+	energy.switchNs += vclock_now() - start;
+	vclock_sem_post(&energy.mutex);
 }
 
 static void* recvT_func(void* args) {
@@ -573,8 +678,8 @@ static void* recvT_func(void* args) {
 	// Gibt an, ob eine eingehende Übertragung stattfindet
 	bool transm = false;
 
-	// Empfangszeitpunkt des RTS
-	struct timespec transmTime;
+	// Empfangszeitpunkt des RTS (vclock_now)
+	uint64_t transmTime = 0;
 
 	while (1) {
 		// Kontrollflag empfangen
@@ -592,7 +697,7 @@ static void* recvT_func(void* args) {
 			}
 
 			// Erhalt signalisieren
-			sem_post(&sem_ret);
+			vclock_sem_post(&sem_ret);
 
 			continue;
 		}
@@ -628,10 +733,15 @@ static void* recvT_func(void* args) {
 
 			// Zieladresse speichern
 			recvWakeBea.dst_addr = *p;
+			p += sizeof(recvWakeBea.dst_addr);
+
+			// Anzahl angekündigter Nachrichten speichern
+			recvWakeBea.count = *p;
 
 			if (mac->debug)
 				// Empfangenen Wake-Beacon ausgeben
-				printf("Wake-Beacon: pi%d -> pi%d.\n", recvWakeBea.src_addr, recvWakeBea.dst_addr);
+				printf("Wake-Beacon: pi%d -> pi%d, %d message(s).\n", recvWakeBea.src_addr, recvWakeBea.dst_addr,
+					recvWakeBea.count);
 
 			// Wenn sich der Sendethread im Zustand "awaitWakeBeacon" befindet
 			if (state == awaitWakeBea_s) {
@@ -639,7 +749,7 @@ static void* recvT_func(void* args) {
 				wakeBea = recvWakeBea;
 
 				// Erhalt signalisieren
-				sem_post(&sem_wakeBea);
+				vclock_sem_post(&sem_wakeBea);
 			}
 
 			continue;
@@ -687,7 +797,7 @@ static void* recvT_func(void* args) {
 				wakeAck = recvWakeAck;
 
 				// Erhalt signalisieren
-				sem_post(&sem_wakeAck);
+				vclock_sem_post(&sem_wakeAck);
 			}
 
 			continue;
@@ -735,16 +845,15 @@ static void* recvT_func(void* args) {
 				printf("RTS: pi%d -> pi%d.\n", recvRTS.src_addr, recvRTS.dst_addr);
 
 			// aktuelle Zeit abrufen
-			struct timespec now;
-			clock_gettime(CLOCK_REALTIME, &now);
+			uint64_t now = vclock_now();
 
 			// Wenn das RTS an diesen Pi adressiert ist
 			if (recvRTS.dst_addr == mac->addr) {
 				// Wenn nicht schon ein RTS empfangen wurde
 				// oder ein Timeout auftritt
 				// und keine fremde Übertragung stattfindet
-				if ((!transm || now.tv_sec - transmTime.tv_sec >= mac->timeout) &&
-					(NAV.tv_sec < now.tv_sec || NAV.tv_sec == now.tv_sec && NAV.tv_nsec < now.tv_nsec)) {
+				if ((!transm || now - transmTime >= (uint64_t)mac->timeout * 1000000000) &&
+					nav_remaining(&nav) == 0) {
 					// Clear To Send (CTS) senden
 					clearToSend(mac, recvRTS.src_addr, recvRTS.msg_len);
 
@@ -756,23 +865,19 @@ static void* recvT_func(void* args) {
 				}
 			}
 
-			// Übertragungsdauer in Millisekunden berechnen
-			uint64_t ms = (mac->t_offset + CTS_len * mac->t_perByte) +									// Clear To Send
-						(mac->t_offset + (MAC_Header_len + recvRTS.msg_len) * mac->t_perByte) +		// Nachricht
-						(mac->t_offset + ACK_len * mac->t_perByte);									// Acknowledgement
-
-			// Übertragungsdauer auf die aktuelle Zeit aufaddieren
-			uint64_t ns = now.tv_nsec + ms * 1000000;
-			now.tv_sec += ns / 1000000000;
-			now.tv_nsec = ns % 1000000000;
+			// Übertragungsdauer bis zum Ende der Nachricht und bis zum Ende des Acknowledgements berechnen
+			uint64_t toMsg = airtime(mac, CTS_len) +							// Clear To Send
+							 airtime(mac, MAC_Header_len + recvRTS.msg_len);	// Nachricht
+			uint64_t ns = toMsg + airtime(mac, ACK_len);						// Acknowledgement
 
-			// Endzeitpunkt der Übertragung speichern
-			NAV = now;
+			// Medium bis zum Ende der Übertragung reservieren, die Reservierung verfällt,
+			// wenn bis zum Ende der Nachricht (plus einem Timeslot) weder CTS noch Nachricht gehört werden
+			nav_reserve(&nav, NAV_RTS, ns, toMsg + (uint64_t)mac->timeslot * 1000000);
 
 			// Wenn sich der Sendethread im Zustand "listen" befindet
 			if (state == listen_s)
 				// Dem Sendethread signalisieren, dass der Kanal nicht frei ist
-				sem_post(&sem_busy);
+				vclock_sem_post(&sem_busy);
 		}
 
 		// Clear To Send (CTS)
@@ -817,22 +922,12 @@ static void* recvT_func(void* args) {
 				printf("CTS: pi%d -> pi%d.\n", recvCTS.src_addr, recvCTS.dst_addr);
 
 			if (recvCTS.dst_addr != mac->addr) {
-				// Übertragungsdauer in Millisekunden berechnen
-				uint64_t ms = (mac->t_offset + (MAC_Header_len + recvCTS.msg_len) * mac->t_perByte) +	// Nachricht
-							  (mac->t_offset + ACK_len * mac->t_perByte);								// Acknowledgement
-
-				// aktuelle Zeit abrufen
-				struct timespec now;
-				clock_gettime(CLOCK_REALTIME, &now);
-
-				// Übertragungsdauer auf die aktuelle Zeit aufaddieren
-				uint64_t ns = now.tv_nsec + ms * 1000000;
-				now.tv_sec  += ns / 1000000000;
-				now.tv_nsec  = ns % 1000000000;
-
-				// Endzeitpunkt der Übertragung speichern
-				//wait = now;
-				NAV = now;
+				// Übertragungsdauer in Nanosekunden berechnen
+				uint64_t ns = airtime(mac, MAC_Header_len + recvCTS.msg_len) +	// Nachricht
+							  airtime(mac, ACK_len);								// Acknowledgement
+
+				// Medium bis zum Ende der Übertragung reservieren
+				nav_reserve(&nav, NAV_CTS, ns, 0);
 			}
 
 			// Wenn sich der Sendethread im Zustand "awaitCTS" befindet, also auf ein CTS wartet
@@ -841,12 +936,12 @@ static void* recvT_func(void* args) {
 				cts = recvCTS;
 
 				// Empfang dem Sendethread signalisieren
-				sem_post(&sem_cts);
+				vclock_sem_post(&sem_cts);
 			}
 			// Wenn sich der Sendethread im Zustand "listen" befindet
 			else if (state == listen_s)
 				// Dem Sendethread signalisieren, dass der Kanal nicht frei ist
-				sem_post(&sem_busy);
+				vclock_sem_post(&sem_busy);
 		}
 
 		// Acknowledgement
@@ -901,14 +996,21 @@ static void* recvT_func(void* args) {
 				ack = recvACK;
 
 				// Erhalt dem Sendethread signalisieren
-				sem_post(&sem_ack);
+				vclock_sem_post(&sem_ack);
 			}
 		}
 
 		// Nachricht
 		else if (ctrl == CTRL_MSG) {
+			// Frame von der PHY ausleihen, Header und Payload werden direkt hinein empfangen
+			SX1262_Frame* frame = SX1262_frameGet();
+
+			// Frist für den vollständigen Empfang des Frames (Header, Payload und RSSI-Wert)
+			struct timespec deadline;
+			SX1262_deadline(&deadline, mac->recvTimeout);
+
 			// Puffer für den Nachrichtenheader
-			uint8_t header_buffer[MAC_Header_len];
+			uint8_t* header_buffer = frame->bytes;
 
 			// Zeiger auf den Puffer setzen
 			uint8_t* p = header_buffer;
@@ -916,12 +1018,14 @@ static void* recvT_func(void* args) {
 			// Kontrollflag im Puffer speichern
 			*p = ctrl;
 			p += sizeof(ctrl);
+			frame->len = sizeof(ctrl);
 
 			// Nachrichtenheader empfangen
-			if (SX1262_timedrecv(p, sizeof(header_buffer) - sizeof(ctrl), mac->recvTimeout) != sizeof(header_buffer) - sizeof(ctrl)) {
+			if (SX1262_recvFrameUntil(frame, MAC_Header_len - sizeof(ctrl), &deadline) != MAC_Header_len - sizeof(ctrl)) {
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Nachrichtenheader.\n");
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -948,59 +1052,50 @@ static void* recvT_func(void* args) {
 			p += sizeof(recvH.msg_len);
 
 			// Checksumme speichern
-			recvH.checksum = *p;
+			recvH.checksum = *(uint16_t*)p;
 
 			// Puffer für den Nachrichtenpayload und den RSSI-Wert
-			uint8_t msg_buffer[recvH.msg_len + sizeof(int8_t)];
+			uint8_t* msg_buffer = frame->bytes + MAC_Header_len;
 
 			// Payload der Nachricht und RSSI-Wert empfangen
-			if (SX1262_timedrecv(msg_buffer, sizeof(msg_buffer), mac->recvTimeout) != sizeof(msg_buffer)) {
+			if (SX1262_recvFrameUntil(frame, recvH.msg_len + sizeof(int8_t), &deadline) != recvH.msg_len + sizeof(int8_t)) {
 				if (mac->debug)
 					printf("Timeout beim Empfangen des Nachrichtenpayloads.\n");
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
-			// Checksumme berechnen
-			uint8_t checksum = 0;
-			for (int i = 0; i < MAC_Header_len - sizeof(recvH.checksum); i++)
-				checksum += header_buffer[i];
-			for (int i = 0; i < recvH.msg_len; i++)
-				checksum += msg_buffer[i];
+			// Checksumme (CRC-16) berechnen
+			uint16_t checksum = crc16_update(CRC16_INIT, header_buffer, MAC_Header_len - sizeof(recvH.checksum));
+			checksum = crc16_update(checksum, msg_buffer, recvH.msg_len);
 
 			// Checksumme prüfen
 			if (checksum != recvH.checksum) {
 				if (mac->debug)
-					printf("Checksumme 0x%02X ungültig! Expected: 0x%02X.\n", recvH.checksum, checksum);
+					printf("Checksumme 0x%04X ungültig! Expected: 0x%04X.\n", recvH.checksum, checksum);
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
-			// Übertragungsdauer in Millisekunden berechnen
-			uint64_t ms = (mac->t_offset + ACK_len * mac->t_perByte);		// Acknowledgement
-
-			// aktuelle Zeit abrufen
-			struct timespec now;
-			clock_gettime(CLOCK_REALTIME, &now);
+			// Übertragungsdauer in Nanosekunden berechnen
+			uint64_t ns = airtime(mac, ACK_len);		// Acknowledgement
 
-			// Übertragungsdauer auf die aktuelle Zeit aufaddieren
-			uint64_t ns = now.tv_nsec + ms * 1000000;
-			now.tv_sec  += ns / 1000000000;
-			now.tv_nsec  = ns % 1000000000;
-
-			// Endzeitpunkt der Übertragung speichern
-			NAV = now;
+			// Medium bis zum Ende des Acknowledgements reservieren
+			nav_reserve(&nav, NAV_MSG, ns, 0);
 
 			// Wenn Nachricht nicht an diesen Pi adressiert ist
 			if (recvH.dst_addr != mac->addr) {
 				// Empfangene Nachricht ausgeben
-				printf("MSG: pi%d -> pi%d, NAV = %llums\n", recvH.src_addr, recvH.dst_addr, ms);
+				printf("MSG: pi%d -> pi%d, NAV = %" PRIu64 "ms\n", recvH.src_addr, recvH.dst_addr, ns / 1000000);
 
 				// Wenn sich der Sendethread im Zustand "listen" befindet
 				if (state == listen_s)
 					// Dem Sendethread signalisieren, dass der Kanal nicht frei ist
-					sem_post(&sem_busy);
+					vclock_sem_post(&sem_busy);
 
+				SX1262_frameRelease(frame);
 				continue;
 			}
 
@@ -1020,6 +1115,8 @@ static void* recvT_func(void* args) {
 			if (recvH.seq <= recvSeq[recvH.src_addr] && recvH.seq != 0) {
 				if (mac->debug)
 					printf("... wurde schon empfangen.\n\n");
+
+				SX1262_frameRelease(frame);
 			}
 			else {
 				// aktuelle Sequenznummer speichern
@@ -1031,15 +1128,9 @@ static void* recvT_func(void* args) {
 				// Header speichern
 				msg.header = recvH;
 
-				// Speicher für den Nachrichtenpayload allokieren, bei einem Fehler das Programm beenden
-				msg.data = (uint8_t*)malloc(recvH.msg_len);
-				if (msg.data == NULL) {
-					fprintf(stderr, "malloc error %d in recvT_func: %s\n", errno, strerror(errno));
-					exit(EXIT_FAILURE);
-				}
-
-				// Nachricht in den allokierten Speicher kopieren
-				memcpy(msg.data, msg_buffer, recvH.msg_len);
+				// Frame ohne Kopie weiterreichen, der Payload liegt hinter dem Header
+				msg.frame = frame;
+				msg.data = msg_buffer;
 
 				// RSSI-Wert speichern
 				msg.RSSI = msg_buffer[recvH.msg_len];
@@ -1050,7 +1141,7 @@ static void* recvT_func(void* args) {
 					if (mac->debug)
 						printf("recvMsgQ is full.\n");
 						
-					free(msg.data);
+					SX1262_frameRelease(frame);
 				}
 			}
 
@@ -1058,10 +1149,10 @@ static void* recvT_func(void* args) {
 			acknowledgement(mac, recvH);
 
 			// 100ms warten bis Acknowledgement versendet wurde
-			msleep(100);
+			vclock_msleep(100);
 
 			// Empfang der Nachricht signalisieren
-			sem_post(&sem_msg);
+			vclock_sem_post(&sem_msg);
 
 			// Neu empfangene RTS wieder bestätigen
 			transm = false;
@@ -1074,7 +1165,7 @@ static void* recvT_func(void* args) {
 				printf("Kontrollflag %02X unbekannt.\n", ctrl);
 
 			// 100ms warten bis die Daten vollständig empfangen wurden
-			msleep(100);
+			vclock_msleep(100);
 
 			// Solange Bytes verfügbar sind, diese empfangen und verwerfen
 			uint8_t c;
@@ -1086,12 +1177,12 @@ static void* recvT_func(void* args) {
 static unsigned int backoff(unsigned int timeslot, int c) {
 	// Exponential Backoff: k × TimeSlot
 	// k = 0...2^c-1
-	return msleep((rand() % (1 << c)) * timeslot);
+	return vclock_msleep((rand() % (1 << c)) * timeslot);
 }
 
 static bool MACAW(MAC* mac, sendMessage msg) {
-	// Puffer für den Nachrichtenheader und -payload
-	uint8_t buffer[MAC_Header_len + msg.len];
+	// Puffer für den Nachrichtenheader, der Payload wird nicht hineinkopiert
+	uint8_t buffer[MAC_Header_len];
 
 	// Zeiger auf buffer setzen
 	uint8_t* p = buffer;
@@ -1116,22 +1207,15 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 	*(uint16_t*)p = msg.len;
 	p += sizeof(msg.len);
 
-	// Checksumme berechnen
-	uint8_t checksum = 0;
-	for (int i = 0; i < MAC_Header_len - sizeof(checksum); i++)
-		checksum += buffer[i];
-	for (int i = 0; i < msg.len; i++)
-		checksum += msg.data[i];
+	// Checksumme (CRC-16) berechnen
+	uint16_t checksum = crc16_update(CRC16_INIT, buffer, MAC_Header_len - sizeof(checksum));
+	checksum = crc16_update(checksum, msg.data, msg.len);
 
-	// Checksumme in buffer schreiben, Zeiger weitersetzen
-	*p = checksum;
-	p += sizeof(checksum);
+	// Checksumme in buffer schreiben
+	*(uint16_t*)p = checksum;
 
-	// Payload in den Puffer kopieren
-	memcpy(p, msg.data, msg.len);
-
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Header und Payload werden mit einem Schreibvorgang gesendet
+	struct iovec frame[] = {{buffer, MAC_Header_len}, {msg.data, msg.len}};
 
 	// Erfolg der Übertragung auf false setzen
 	bool success = false;
@@ -1139,36 +1223,24 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 	// Anzahl Versuche speichern
 	unsigned int numtrials = 1;
 
-	// aktuelle Zeit abrufen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
 
 	// In den Zustand "delay" wechseln
 	state = delay_s;
 
 	// Warten bis laufende fremde Übertragungen abgeschlossen wurden
-	while (NAV.tv_sec > ts.tv_sec || NAV.tv_sec == ts.tv_sec && NAV.tv_nsec > ts.tv_nsec) {
-		msleep((NAV.tv_sec - ts.tv_sec) * 1e3 + (NAV.tv_nsec - ts.tv_nsec) / 1e6);
-		clock_gettime(CLOCK_REALTIME, &ts);
-	}
+	defer(mac);
 
 	// Random Delay
-	msleep(rand() % (mac->timeout * 1000));
+	vclock_msleep(rand() % (mac->timeout * 1000));
 
 	while (1) {
 		// In den Zustand "listen" wechseln
 		state = listen_s;
 
-		// aktuelle Zeit abrufen
-		clock_gettime(CLOCK_REALTIME, &ts);
-
-		// Timeslot aufaddieren
-		uint64_t ns = ts.tv_nsec + mac->timeslot * 1000000;
-		ts.tv_sec += ns / 1000000000;
-		ts.tv_nsec = ns % 1000000000;
-
-		// Auf einen freien Kanal warten
-		if (sem_timedwait(&sem_busy, &ts) == 0) {
+		// Einen Timeslot auf einen freien Kanal warten
+		deadline(&ts, mac->timeslot);
+		if (vclock_sem_clockwait(&sem_busy, CLOCK_MONOTONIC, &ts) == 0) {
 			if (mac->debug)
 				printf("Channel is busy.\n");
 			
@@ -1179,11 +1251,8 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 			// In den Zustand "Backoff" wechseln
 			state = backoff_s;
 
-			// aktuelle Zeit abrufen
-			clock_gettime(CLOCK_REALTIME, &ts);
-
 			// Warten bis die fremde Übertragung abgeschlossen wurden
-			msleep((NAV.tv_sec - ts.tv_sec) * 1e3 + (NAV.tv_nsec - ts.tv_nsec) / 1e6);
+			defer(mac);
 
 			// Backoff
 			backoff(mac->timeslot, numtrials++);
@@ -1219,11 +1288,10 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 		requestToSend(mac, msg.addr, msg.len);
 
 		// Timeout festlegen
-		clock_gettime(CLOCK_REALTIME, &ts);
-		ts.tv_sec += mac->timeout;
+		deadline(&ts, mac->timeout * 1000);
 		
 		// Auf Clear To Send (CTS) warten
-		if (sem_timedwait(&sem_cts, &ts) == -1) {
+		if (vclock_sem_clockwait(&sem_cts, CLOCK_MONOTONIC, &ts) == -1) {
 			if (mac->debug)
 				printf("No CTS received.\n");
 			
@@ -1262,7 +1330,8 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 		state = awaitAck_s;
 
 		// Nachricht versenden
-		SX1262_send(buffer, sizeof(buffer));
+		SX1262_sendFrame(frame, 2);
+		energy_tx(mac, MAC_Header_len + msg.len);
 
 		if (mac->debug) {
 			// Gesendeten Header und Nachricht zum Testen ausgeben
@@ -1270,8 +1339,8 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 			for (int i = 0; i < MAC_Header_len; i++)
 				printf("%02X ", buffer[i]);
 			printf("|");
-			for (int i = MAC_Header_len; i < MAC_Header_len + msg.len; i++)
-				printf(" %02X", buffer[i]);
+			for (int i = 0; i < msg.len; i++)
+				printf(" %02X", msg.data[i]);
 			printf("\n");
 		}
 
@@ -1317,38 +1386,89 @@ static bool MACAW(MAC* mac, sendMessage msg) {
 	return success;
 }
 
+static void complete(sendMessage* msg, bool success) {
+	// Kopie einer nicht blockierenden Nachricht freigeben
+	if (!msg->blocking)
+		free(msg->data);
+
+	// Wenn der empfangende (Anwendungs-) Thread blockiert
+	if (msg->blocking) {
+		// Erfolg der Übertragung setzen
+		*msg->success = success;
+
+		// Signalisieren, dass die Operation abgeschlossen wurde
+		vclock_sem_post(msg->fin);
+	}
+}
+
+static void adaptSleep(MAC* mac, bool active) {
+	// Unter Last die Schlafdauer halbieren, ohne Verkehr um die Hälfte verlängern
+	if (active)
+		mac->t_sleep /= 2;
+	else
+		mac->t_sleep += (mac->t_sleep + 1) / 2;
+
+	if (mac->t_sleep < mac->t_sleepMin)
+		mac->t_sleep = mac->t_sleepMin;
+	if (mac->t_sleep > mac->t_sleepMax)
+		mac->t_sleep = mac->t_sleepMax;
+
+	if (mac->debug) {
+		MAC_Energy e;
+		MAC_energy(mac, &e);
+		printf("Duty cycle %.1f%%, next sleep %us: TX %" PRIu64 "ms, RX %" PRIu64 "ms, config %" PRIu64 "ms, sleep %" PRIu64 "ms, "
+			"%u channel switches (%" PRIu64 "ms), %.3fmAh\n", e.dutyCycle * 100, mac->t_sleep, e.tx_ms, e.rx_ms,
+			e.config_ms, e.sleep_ms, e.channelSwitches, e.switch_ms, e.charge_mAh);
+	}
+}
+
 static void* sendT_func(void* args) {
 	MAC* mac = (MAC*)args;
 
 	while (1) {
+		// Gibt an, ob im Zyklus Nachrichten gesendet oder empfangen wurden
+		bool active = false;
+
 		// Schlafdauer festlegen
 		struct timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
+		vclock_gettime(CLOCK_REALTIME, &ts);
 		ts.tv_sec += mac->t_sleep;
 
 		// Blockieren bis Nachricht in der Warteschlange oder Sleep-Periode abgelaufen
 		sendMessage msg;
 		while (sendMsgQ_timeddequeue(&msg, &ts)) {
+			active = true;
+
 			// Funkmodul in den Übertragungsmodus schalten
-			SX1262_setMode(SX1262_Transmission);
+			setMode(SX1262_Transmission);
 			if (mac->debug)
 				printf("Switched to transmission mode.\n");
 
 			// In den Zustand "awaitWakeAck" wechseln
 			state = awaitWakeAck_s;
 
+			// Alle Nachrichten an denselben Empfänger in einem Wachzyklus senden,
+			// die Kanalwechsel fallen dann nur einmal an
+			sendMessage batch[sendMsgQ_size];
+			batch[0] = msg;
+			unsigned int count = 1;
+
 			// Solange die Beacon-Sendedauer nicht überschriten wird
 			for (int i = 0; i * mac->T_beacon < mac->t_beacon; i++) {
-				// Wake-Beacon senden
-				wakeBeacon(mac, msg.addr);
+				// Inzwischen eingereihte Nachrichten an den Empfänger hinzufügen
+				while (count < sendMsgQ_size && sendMsgQ_take(msg.addr, &batch[count]))
+					count++;
+
+				// Wake-Beacon mit der Anzahl der Nachrichten senden
+				wakeBeacon(mac, msg.addr, count);
 
 				// Beacon-Frequenz festlegen
 				struct timespec bts;
-				clock_gettime(CLOCK_REALTIME, &bts);
+				vclock_gettime(CLOCK_REALTIME, &bts);
 				bts.tv_sec += mac->T_beacon;
 
 				// Auf das Beacon-Acknowledgement warten
-				if (sem_timedwait(&sem_wakeAck, &bts) == 0)
+				if (vclock_sem_timedwait(&sem_wakeAck, &bts) == 0)
 					// Wenn Beacon-Acknowledgement an diesen Pi adressiert ist
 					if (wakeAck.dst_addr == mac->addr)
 						break;
@@ -1359,38 +1479,30 @@ static void* sendT_func(void* args) {
 			if (mac->debug)
 				printf("Switched to data channel.\n");
 
-			// MACAW-Protokoll ausführen
-			bool success = MACAW(mac, msg);
+			// MACAW-Protokoll für jede Nachricht ausführen
+			for (unsigned int i = 0; i < count; i++)
+				complete(&batch[i], MACAW(mac, batch[i]));
 
 			// Auf den Wakeup-Kanal wechseln
 			setChannel(WAKEUP_CHANNEL);
 			if (mac->debug)
 				printf("Switched to wakeup channel.\n");
 
-			// Wenn der empfangende (Anwendungs-) Thread blockiert
-			if (msg.blocking) {
-				// Erfolg der Übertragung setzen
-				*msg.success = success;
-
-				// Signalisieren, dass die Operation abgeschlossen wurde
-				sem_post(msg.fin);
-			}
-
 			// Wenn die Sleep-Periode abgelaufen ist
 			struct timespec now;
-			clock_gettime(CLOCK_REALTIME, &now);
+			vclock_gettime(CLOCK_REALTIME, &now);
 			if (now.tv_sec >= ts.tv_sec)
 				// Nicht in den Tiefschlafmodus wechseln
 				break;
 
 			// In den Tiefschlafmodus wechseln
-			SX1262_setMode(SX1262_DeepSleep);
+			setMode(SX1262_DeepSleep);
 			if (mac->debug)
 				printf("Switched to sleep mode.\n");
 		}
 
 		// In den Übertragungsmodus wechseln
-		SX1262_setMode(SX1262_Transmission);
+		setMode(SX1262_Transmission);
 		if (mac->debug)
 			printf("Switched to listen mode.\n");
 
@@ -1399,12 +1511,12 @@ static void* sendT_func(void* args) {
 
 		// Wachdauer festlegen
 		struct timespec tw;
-		clock_gettime(CLOCK_REALTIME, &tw);
+		vclock_gettime(CLOCK_REALTIME, &tw);
 		tw.tv_sec += mac->t_wake;
 
 		while (1) {
 			// Wenn ein Wake-Beacon empfangen wurde
-			if (sem_timedwait(&sem_wakeBea, &tw) == 0) {
+			if (vclock_sem_timedwait(&sem_wakeBea, &tw) == 0) {
 				// Wenn Wake-Beacon nicht an diesen Pi adressiert ist
 				if (wakeBea.dst_addr != mac->addr)
 					// Wieder schlafen gehen
@@ -1412,27 +1524,32 @@ static void* sendT_func(void* args) {
 				
 				// In den Zustand "awaitMsg" wechseln
 				state = awaitMsg_s;
+				active = true;
 
 				// Wake-Acknowledgement senden
 				wakeAcknowledgement(mac, wakeBea.src_addr);
 
 				// 100ms warten bis das Wake-Acknowledgement gesendet wurde
-				msleep(100);
+				vclock_msleep(100);
 
 				// Auf den Datenkanal wechseln
 				setChannel(DATA_CHANNEL);
 				if (mac->debug)
 					printf("Switched to data channel.\n");
 
-				// Timeout für den Empfang einer Nachricht im MACAW-Protokoll
-				struct timespec t_msg;
-				clock_gettime(CLOCK_REALTIME, &t_msg);
-				t_msg.tv_sec += mac->maxtrials * mac->timeout;
+				// Auf den Empfang der angekündigten Nachrichten warten
+				for (int i = 0; i < wakeBea.count; i++) {
+					// Timeout für den Empfang einer Nachricht im MACAW-Protokoll
+					struct timespec t_msg;
+					vclock_gettime(CLOCK_REALTIME, &t_msg);
+					t_msg.tv_sec += mac->maxtrials * mac->timeout;
 
-				// Auf den Empfang der Nachricht warten
-				if (sem_timedwait(&sem_msg, &t_msg) == -1)
-					if (mac->debug)
-						printf("Timeout receiving Message.\n");
+					if (vclock_sem_timedwait(&sem_msg, &t_msg) == -1) {
+						if (mac->debug)
+							printf("Timeout receiving Message.\n");
+						break;
+					}
+				}
 
 				// Auf den Wakeup-Kanal wechseln
 				setChannel(WAKEUP_CHANNEL);
@@ -1451,13 +1568,16 @@ static void* sendT_func(void* args) {
 
 				// Timeout für den Empfang einer Nachricht im MACAW-Protokoll
 				struct timespec t_msg;
-				clock_gettime(CLOCK_REALTIME, &t_msg);
+				vclock_gettime(CLOCK_REALTIME, &t_msg);
 				t_msg.tv_sec += mac->t_beacon;
 
 				// Auf den Empfang der Nachricht warten
-				if (sem_timedwait(&sem_msg, &t_msg) == -1)
+				if (vclock_sem_timedwait(&sem_msg, &t_msg) == -1) {
 					if (mac->debug)
 						printf("Timeout receiving Message.\n");
+				}
+				else
+					active = true;
 
 				// Auf den Wakeup-Kanal wechseln
 				setChannel(WAKEUP_CHANNEL);
@@ -1472,29 +1592,40 @@ static void* sendT_func(void* args) {
 				break;
 		}
 
+		// Schlafdauer an die Last anpassen
+		adaptSleep(mac, active || sendMsgQ_count() > 0);
+
 		// Wenn keine Nachricht in der Warteschlange verfügbar ist
 		if (sendMsgQ_count() == 0) {
 			// In den Zustand "idle" wechseln
 			state = idle_s;
 
 			// Funkmodul in den Tiefschlafmodus setzen
-			SX1262_setMode(SX1262_DeepSleep);
+			setMode(SX1262_DeepSleep);
 			if (mac->debug)
 				printf("Switched to sleep mode.\n");
 		}
 	}
+
+	return NULL;
 }
 
 void MAC_init(MAC* mac, unsigned char addr) {
-    // Wenn debug-Variable (noch) nicht gesetzt wurde -> Variable auf 0 setzen
-    if (mac->debug != 1)
-        mac->debug = 0;
+	// Wenn debug-Variable (noch) nicht gesetzt wurde -> Variable auf 0 setzen
+	if (mac->debug != 1)
+		mac->debug = 0;
 
 	// Adresse speichern
 	mac->addr = addr;
 
 	// untere Schicht initialisieren
-	SX1262_init(WAKEUP_CHANNEL, SX1262_DeepSleep);
+	SX1262_Config phy = {0};
+	phy.channel = WAKEUP_CHANNEL;
+	phy.mode = SX1262_DeepSleep;
+	SX1262_init(&phy);
+
+	// Tabellen der Checksumme berechnen
+	crc16_init();
 
 	// Warteschlange initialisieren
 	recvMsgQ_init();
@@ -1509,9 +1640,14 @@ void MAC_init(MAC* mac, unsigned char addr) {
 
 	sem_init(&sem_busy, 0, 0);
 	sem_init(&sem_msg, 0, 0);
+	nav_init(&nav);
+
+	// Betriebszeiten ab dem Tiefschlaf auf dem Wakeup-Kanal erfassen
+	energy_init(SX1262_DeepSleep);
+	channel = WAKEUP_CHANNEL;
 
 	// Zufallsgenerator initialisieren
-	srand(addr * time(NULL));
+	srand(vclock_seed(addr));
 
 	// maximal 5 Sendeversuche
 	mac->maxtrials = 5;
@@ -1531,22 +1667,26 @@ void MAC_init(MAC* mac, unsigned char addr) {
 	// Dauer des Sendeoffsets und je Byte in ms
 	mac->t_offset = 170; mac->t_perByte = 6;
 
-	// 30 Sekunden Schlaf- und 5 Sekunden Wachzeit
+	// 30 Sekunden Schlaf- und 5 Sekunden Wachzeit, die Schlafdauer passt sich zwischen 5 und 30 Sekunden an die Last an
 	mac->t_sleep = 30; mac->t_wake = 5;
+	mac->t_sleepMin = 5; mac->t_sleepMax = 30;
 
 	// 40 Sekunden lang alle 2 Sekunden Beacons senden
 	mac->t_beacon = 40; mac->T_beacon = 2;
 
+	// Stromaufnahme des Funkmoduls (E22-900T22S) in mA
+	mac->I_tx = 110; mac->I_rx = 12; mac->I_config = 12; mac->I_sleep = 0.002;
+
 	// Zustand des Sendethreads initailisieren (IDLE)
 	state = idle_s;
 
 	// Threads starten, bei Fehler Programm beenden
-	if (pthread_create(&recvT, NULL, &recvT_func, mac) != 0) {
+	if (vclock_thread_create(&recvT, NULL, &recvT_func, mac) != 0) {
         fprintf(stderr, "Error %d creating recvThread: %s\n", errno, strerror(errno));
         exit(EXIT_FAILURE);
     }
 
-	if (pthread_create(&sendT, NULL, &sendT_func, mac) != 0) {
+	if (vclock_thread_create(&sendT, NULL, &sendT_func, mac) != 0) {
         fprintf(stderr, "Error %d creating sendThread: %s\n", errno, strerror(errno));
         exit(EXIT_FAILURE);
     }
@@ -1562,8 +1702,8 @@ int MAC_recv(MAC* mac, unsigned char* msg_buffer) {
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -1584,8 +1724,8 @@ int MAC_tryrecv(MAC* mac, unsigned char* msg_buffer) {
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -1597,7 +1737,7 @@ int MAC_tryrecv(MAC* mac, unsigned char* msg_buffer) {
 int MAC_timedrecv(MAC* mac, unsigned char* msg_buffer, unsigned int timeout) {
 	// Timeout festlegen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
+	vclock_gettime(CLOCK_REALTIME, &ts);
 	ts.tv_sec += timeout;
 
 	// Nachricht aus Warteschlange entfernen, bei Timeout 0 zurückgeben
@@ -1611,8 +1751,8 @@ int MAC_timedrecv(MAC* mac, unsigned char* msg_buffer, unsigned int timeout) {
 	// Payload der Nachricht in den übergebenen Puffer kopieren
 	memcpy(msg_buffer, msg.data, msg.header.msg_len);
 
-	// allokierten Speicher freigeben
-	free(msg.data);
+	// Frame an die PHY zurückgeben
+	SX1262_frameRelease(msg.frame);
 
 	// RSSI-Wert in der ALOHA-Struktur speichern
 	mac->RSSI = msg.RSSI;
@@ -1639,21 +1779,14 @@ int MAC_send(MAC* mac, unsigned char addr, unsigned char* data, unsigned int len
 	msg.success = &success;
 	msg.fin = &fin;
 
-	// Speicher für den Payload der Nachricht allokieren
-	msg.data = (uint8_t*)malloc(len);
-	if (msg.data == NULL) {
-		fprintf(stderr, "malloc error %d in MAC_send: %s\n", errno, strerror(errno));
-		exit(EXIT_FAILURE);
-	}
-
-	// Nachricht in den allokierten Speicher kopieren
-	memcpy(msg.data, data, len);
+	// Der Aufrufer blockiert bis zum Abschluss, der Payload wird daher nicht kopiert
+	msg.data = data;
 
 	// Nachricht in Warteschlange einfügen
 	sendMsgQ_enqueue(msg);
 
 	// Blockieren bis die Operation abgeschlossen wurde
-	sem_wait(&fin);
+	vclock_sem_wait(&fin);
 
 	// Speicher der Semaphore freigeben
 	sem_destroy(&fin);
@@ -1691,3 +1824,31 @@ int MAC_Isend(MAC* mac, unsigned char addr, unsigned char* data, unsigned int le
 
 	return true;
 }
+
+void MAC_energy(MAC* mac, MAC_Energy* e) {
+	// Zeit im aktuellen Modus bis jetzt verbuchen
+	vclock_sem_wait(&energy.mutex);
+	energy_account(vclock_now());
+	int64_t ns[energyStates];
+	memcpy(ns, energy.ns, sizeof(ns));
+	e->channelSwitches = energy.switches;
+	e->switch_ms = energy.switchNs / 1000000;
+	vclock_sem_post(&energy.mutex);
+
+	// Geschätzte Airtime kann die gemessene Empfangszeit kurzzeitig übersteigen
+	if (ns[energyRx] < 0)
+		ns[energyRx] = 0;
+
+	e->tx_ms = ns[energyTx] / 1000000;
+	e->rx_ms = ns[energyRx] / 1000000;
+	e->config_ms = ns[energyConfig] / 1000000;
+	e->sleep_ms = ns[energySleep] / 1000000;
+
+	// Ladung in mAh: Zeit in Stunden × Stromaufnahme in mA
+	e->charge_mAh = (ns[energyTx] * mac->I_tx + ns[energyRx] * mac->I_rx + ns[energyConfig] * mac->I_config +
+		ns[energySleep] * mac->I_sleep) / 3.6e12;
+
+	// Anteil der Zeit, in der das Funkmodul wach ist
+	int64_t total = ns[energyTx] + ns[energyRx] + ns[energyConfig] + ns[energySleep];
+	e->dutyCycle = total > 0 ? (double)(total - ns[energySleep]) / total : 0;
+}
@@ -1,7 +1,7 @@
 ﻿#ifndef STEM_H
 #define STEM_H
 
-#include <stdint.h>			// uint8_t, int8_t, uint32_t
+#include <stdint.h>			// uint8_t, int8_t, uint32_t, uint64_t
 
 // Struktur für den Nachrichtenheader
 typedef struct MAC_Header {
@@ -10,9 +10,9 @@ typedef struct MAC_Header {
 	uint8_t dst_addr;		// Zieladresse
 	uint16_t seq;			// Sequenznummer
 	uint16_t msg_len;		// Nachrichtenlänge
-	uint8_t checksum;		// Checksumme
+	uint16_t checksum;		// Checksumme (CRC-16/CCITT)
 } MAC_Header;
-#define MAC_Header_len 8
+#define MAC_Header_len 9
 
 // Struktur für die Daten des MACAW-Protokolls
 typedef struct MAC {
@@ -25,10 +25,16 @@ typedef struct MAC {
 	unsigned int timeslot;		// Timeslot in Millisekunden für den Backoff
 	unsigned int t_offset;		// Offset für das Versenden von Bytes in Millisekunden
 	unsigned int t_perByte;		// Übertragungsdauer für jedes zusätzliche Byte in Millisekuden
-	unsigned int t_sleep;		// Sleep-Time in Sekunden
+	unsigned int t_sleep;		// aktuelle Sleep-Time in Sekunden (passt sich an die Last an)
+	unsigned int t_sleepMin;	// kürzeste Sleep-Time in Sekunden (unter Last)
+	unsigned int t_sleepMax;	// längste Sleep-Time in Sekunden (ohne Verkehr, höchstens t_beacon - t_wake)
 	unsigned int t_wake;		// Wake-Time in Sekunden
 	unsigned int t_beacon;		// Beacon-Sendedauer in Sekunden
 	unsigned int T_beacon;		// Beacon-Frequenz in Sekunden
+	float I_tx;					// Stromaufnahme beim Senden in mA
+	float I_rx;					// Stromaufnahme im Übertragungsmodus (Empfangen) in mA
+	float I_config;				// Stromaufnahme im Konfigurationsmodus in mA
+	float I_sleep;				// Stromaufnahme im Tiefschlaf in mA
 
 	/* Daten zur letzten empfangenen Nachricht */
 	MAC_Header recvH;			// Nachrichtenheader der letzten empfangenen Nachricht
@@ -38,7 +44,20 @@ typedef struct MAC {
 	int debug;                  // Gibt an, ob Debug-Ausgaben erstellt werden sollen
 } MAC;
 
+// Geschätzte Betriebszeiten und Ladung des Funkmoduls seit MAC_init
+typedef struct MAC_Energy {
+	uint64_t tx_ms;				// Senden (Airtime der gesendeten Frames)
+	uint64_t rx_ms;				// Übertragungsmodus ohne Senden (Empfangen)
+	uint64_t config_ms;			// Konfigurationsmodus (Kanalwechsel)
+	uint64_t sleep_ms;			// Tiefschlaf
+	uint32_t channelSwitches;	// Anzahl Kanalwechsel
+	uint64_t switch_ms;			// Dauer der Kanalwechsel
+	double charge_mAh;			// Ladung aus Zeit und Stromaufnahme je Zustand
+	double dutyCycle;			// Anteil der Zeit außerhalb des Tiefschlafs
+} MAC_Energy;
+
 void MAC_init(MAC*, unsigned char);
+void MAC_energy(MAC*, MAC_Energy*);
 
 int MAC_recv(MAC*, unsigned char*);
 int MAC_tryrecv(MAC*, unsigned char*);
@@ -4,11 +4,16 @@
 #include <fcntl.h>          // open
 #include <pthread.h>        // pthread_create
 #include <semaphore.h>      // sem_init, sem_wait, sem_trywait, sem_timedwait
+#include <stdatomic.h>      // atomic_uint, atomic_load, atomic_store
 #include <stdint.h>         // uint8_t, int8_t, uint32_t
 #include <stdio.h>          // printf
 #include <stdlib.h>         // rand
 #include <string.h>         // strerror
+#include <sys/epoll.h>      // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/timerfd.h>    // timerfd_create, timerfd_settime
+#include <sys/uio.h>        // writev
 #include <termios.h>        // tcgetattr, tcsetattr, tcflush
+#include <time.h>           // clock_gettime, nanosleep
 #include <unistd.h>         // sleep, read, write, close
 
 #include "../GPIO/GPIO.h"   // GPIO_init, GPIO_setup, GPIO_input, GPIO_output
@@ -22,14 +27,14 @@
 
 #define NETID '\x00'
 
-// baud rate, parity bit, wireless air speed
-#define REG0 '\x62'
+// baud rate (bits 7-5), parity bit (bits 4-3, 8N1), wireless air speed (bits 2-0)
+#define REG0_PARITY '\x00'
 
-// dividing packet, ambient noise, transmit power
-#define REG1 '\x32'
+// dividing packet (bits 7-6), ambient noise (bit 5), transmit power (bits 1-0)
+#define REG1_FLAGS '\x30'
 
 // channel control 0 - 83, 850.125 + REG2 * 1MHz
-#define REG2 '\x12'
+#define CHANNEL_BASE 850
 
 // RSSI byte, transmitting mode, relay, LBT, WOR -mode, -period
 #define REG3 '\x83'
@@ -37,33 +42,79 @@
 #define CRYPT_H '\x00'
 #define CRYPT_L '\x00'
 
-// Struktur für eine Byte-Warteschlange
-#define recvQ_size 256
+// Byte-Ringpuffer für den Empfang
+// Es gibt keinen Empfangsthread: der empfangende Thread liest selbst von der ser. Schnittstelle,
+// sobald epoll sie als lesbar meldet, und zwar alle verfügbaren Bytes auf einmal.
+// Die Größe muss eine Zweierpotenz sein, damit die freilaufenden Indizes maskiert werden können.
+#define recvQ_size 1024
+#define recvQ_mask (recvQ_size - 1)
 typedef struct recvQueue {
     uint8_t data[recvQ_size];        // Daten bzw. Bytes der Warteschlange
-    unsigned int begin, end;         // Zeiger auf den Anfang und das Ende der Daten
-    sem_t mutex, free, full;         // Semaphoren 
+    unsigned int head;               // Schreibindex
+    unsigned int tail;               // Leseindex
+    int epfd;                        // epoll-Instanz für die ser. Schnittstelle und den Timer
+    int tfd;                         // timerfd (CLOCK_MONOTONIC) für Timeouts
+    pthread_mutex_t mutex;           // serialisiert empfangende Threads
 } recvQueue;
 
-// Struktur zum Speichern mehrere Bytes
-typedef struct Bytes {
-    uint8_t* bytes;           // Zeiger auf die zu speichernden Bytes
-    unsigned int count;       // Anzahl der gespeicherten Bytes
-} Bytes;
+// Vorab allokierter Frame-Slot (keine Heap-Allokation beim Senden)
+typedef struct Frame {
+    uint8_t bytes[SX1262_FRAME_SIZE];   // Bytes des Frames
+    unsigned int count;                 // Anzahl der gespeicherten Bytes
+} Frame;
 
-// Struktur eine Warteschlange mit Elementen bestehend aus mehreren Bytes
+// Sendewarteschlange als Ring aus Frame-Slots (Frame-Pool)
+// Ein Slot gehört zu seiner Position im Ring: er wird beim Einfügen belegt und
+// erst nach dem Schreiben auf die ser. Schnittstelle wieder freigegeben.
 #define sendQ_size 256
 typedef struct sendQueue {
-    Bytes data[sendQ_size];         // Bytes der Warteschlange
+    Frame data[sendQ_size];         // Frame-Slots der Warteschlange
     unsigned int begin, end;        // Zeiger auf den Anfang und das Ende
-    sem_t mutex, free, full;        // Semaphoren
+    pthread_mutex_t lock;           // serialisiert die Sender (mehrteilige Frames bleiben zusammenhängend)
+    pthread_cond_t idle;            // signalisiert eine leere Warteschlange (mit serLock)
+    sem_t free, full;               // Semaphoren
+    atomic_ulong claims;            // Anzahl belegter Slots insgesamt
+    atomic_ulong exhausted;         // Anzahl Belegungen, die auf einen freien Slot warten mussten
+    atomic_uint inUse, maxInUse;    // aktuell bzw. maximal gleichzeitig belegte Slots
 } sendQueue;
 
+// Pool der Empfangs-Frames, die an die MAC-Schicht ausgeliehen werden
+#define rxPool_size 64
+typedef struct rxFramePool {
+    SX1262_Frame frames[rxPool_size];   // Frames des Pools
+    SX1262_Frame* stack[rxPool_size];   // Stapel der freien Frames
+    unsigned int top;                   // Anzahl freier Frames
+    pthread_mutex_t mutex;              // schützt den Stapel
+    sem_t free;                         // Semaphore
+} rxFramePool;
+
 // File Descriptor der seriellen Schnittstelle
 static int ser;
 
-// Empfangsthread
-static pthread_t recvT;
+// Schreibzugriffe auf die ser. Schnittstelle (Sendethread und SX1262_sendFrame)
+static pthread_mutex_t serLock = PTHREAD_MUTEX_INITIALIZER;
+
+// UART-Baudraten (REG0 Bits 7-5) und Luftdatenraten (REG0 Bits 2-0), der Index entspricht dem Registerwert
+static const unsigned int baudRates[] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+static const speed_t baudSpeeds[] = { B1200, B2400, B4800, B9600, B19200, B38400, B57600, B115200 };
+static const unsigned int airRates[] = { 300, 1200, 2400, 4800, 9600, 19200, 38400, 62500 };
+
+// Paketgrößen (REG1 Bits 7-6) und Sendeleistungen (REG1 Bits 1-0), der Index entspricht dem Registerwert
+static const unsigned int packetSizes[] = { 240, 128, 64, 32 };
+static const unsigned int powers[] = { 22, 17, 13, 10 };
+
+// Bezeichnungen der Konfigurationsbytes für Fehlermeldungen
+static const char* const regNames[] = {
+    "Kommando", "Startadresse", "Länge", "ADDH", "ADDL", "NETID",
+    "REG0 (Baudrate, Parität, Luftdatenrate)", "REG1 (Paketgröße, Ambient Noise, Sendeleistung)",
+    "REG2 (Kanal)", "REG3", "CRYPT_H", "CRYPT_L"
+};
+
+// übernommene Konfiguration
+static SX1262_Config config;
+
+// Baudrate im Übertragungsmodus, im Konfigurationsmodus arbeitet das Modul immer mit 9600 Baud
+static speed_t baudSpeed;
 
 // Sendethread
 static pthread_t sendT;
@@ -74,83 +125,140 @@ static recvQueue recvQ;
 // Sendewarteschlange
 static sendQueue sendQ;
 
+// Empfangs-Frames
+static rxFramePool rxPool;
+
 static void recvQ_init() {
     // Start- und Endzeiger initialisieren
-    recvQ.begin = 0;
-    recvQ.end = 0;
+    recvQ.head = 0;
+    recvQ.tail = 0;
+    pthread_mutex_init(&recvQ.mutex, NULL);
+
+    // Timeouts beziehen sich auf CLOCK_MONOTONIC, damit Zeitsprünge (NTP) keinen Einfluss haben
+    recvQ.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    recvQ.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (recvQ.tfd < 0 || recvQ.epfd < 0) {
+        fprintf(stderr, "Error %d creating epoll/timerfd: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
 
-    // Semaphoren initialisieren
-    sem_init(&recvQ.mutex, 0, 1);
-    sem_init(&recvQ.free, 0, recvQ_size);
-    sem_init(&recvQ.full, 0, 0);
+    // ser. Schnittstelle und Timer überwachen
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = ser;
+    if (epoll_ctl(recvQ.epfd, EPOLL_CTL_ADD, ser, &ev) != 0) {
+        fprintf(stderr, "Error %d from epoll_ctl: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    ev.data.fd = recvQ.tfd;
+    if (epoll_ctl(recvQ.epfd, EPOLL_CTL_ADD, recvQ.tfd, &ev) != 0) {
+        fprintf(stderr, "Error %d from epoll_ctl: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
 }
 
-static void recvQ_enqueue(uint8_t c) {
-    // ggf. blockieren und Semaphoren dekrementieren
-    sem_wait(&recvQ.free);
-    sem_wait(&recvQ.mutex);
-
-    // Byte in der Warteschlange speichern und Endzeiger inkrementieren
-    recvQ.data[recvQ.end] = c;
-    recvQ.end = (recvQ.end + 1) % recvQ_size;
+// Liest alle verfügbaren Bytes (höchstens bis zum Pufferende) von der ser. Schnittstelle in den Ringpuffer
+static void recvQ_fill() {
+    // Puffer voll -> zuerst müssen Bytes entnommen werden
+    unsigned int free = recvQ_size - (recvQ.head - recvQ.tail);
+    if (free == 0)
+        return;
+
+    // nur bis zum Pufferende lesen, damit der Block zusammenhängend bleibt
+    unsigned int span = recvQ_size - (recvQ.head & recvQ_mask);
+    if (span > free)
+        span = free;
+
+    // die ser. Schnittstelle ist lesbar, read() blockiert also nicht
+    ssize_t n = read(ser, &recvQ.data[recvQ.head & recvQ_mask], span);
+    if (n <= 0) {
+        if (n < 0 && errno != EINTR && errno != EAGAIN)
+            fprintf(stderr, "Error %d reading serial port: %s\n", errno, strerror(errno));
+        return;
+    }
 
-    // Semaphoren inkrementieren
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.full);
+    recvQ.head += n;
 }
 
-static uint8_t recvQ_dequeue() {
-    // ggf. blockieren und Semaphoren dekrementieren
-    sem_wait(&recvQ.full);
-    sem_wait(&recvQ.mutex);
-
-    // Byte aus der Warteschlange speichern und Startzeiger inkrementieren
-    uint8_t c = recvQ.data[recvQ.begin];
-    recvQ.begin = (recvQ.begin + 1) % recvQ_size;
+// Kopiert bis zu len Bytes aus dem Ringpuffer, ohne zu blockieren
+static unsigned int recvQ_take(uint8_t* msg, unsigned int len) {
+    unsigned int avail = recvQ.head - recvQ.tail;
+    if (avail == 0)
+        return 0;
+    if (len > avail)
+        len = avail;
 
-    // Semaphoren inkrementieren
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    // höchstens zwei zusammenhängende Abschnitte (vor und nach dem Umbruch)
+    unsigned int first = recvQ_size - (recvQ.tail & recvQ_mask);
+    if (first > len)
+        first = len;
+    memcpy(msg, &recvQ.data[recvQ.tail & recvQ_mask], first);
+    memcpy(msg + first, recvQ.data, len - first);
 
-    // Byte zurückgeben
-    return c;
+    recvQ.tail += len;
+    return len;
 }
 
-static int recvQ_trydequeue(uint8_t* c) {
-    // ggf. blockieren und Semaphoren dekrementieren
-    if (sem_trywait(&recvQ.full) == -1)
-        return 0;
-
-    sem_wait(&recvQ.mutex);
+// Wartet bis die ser. Schnittstelle lesbar ist und liest die Bytes ein.
+// deadline ist ein absoluter Zeitpunkt auf CLOCK_MONOTONIC, NULL -> ohne Timeout. Bei Timeout 0 zurückgeben
+static int recvQ_wait(const struct timespec* deadline) {
+    // Timer auf den Zeitpunkt setzen bzw. abschalten, ein Zeitpunkt in der Vergangenheit löst sofort aus
+    struct itimerspec its = { 0 };
+    if (deadline != NULL) {
+        its.it_value = *deadline;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;       // 0 würde den Timer abschalten
+    }
+    timerfd_settime(recvQ.tfd, TFD_TIMER_ABSTIME, &its, NULL);
 
-    // Byte aus der Warteschlange speichern und Startzeiger inkrementieren
-    *c = recvQ.data[recvQ.begin];
-    recvQ.begin = (recvQ.begin + 1) % recvQ_size;
+    while (1) {
+        struct epoll_event ev[2];
+        int n = epoll_wait(recvQ.epfd, ev, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error %d from epoll_wait: %s\n", errno, strerror(errno));
+            return 0;
+        }
 
-    // Semaphoren inkrementieren
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+        // empfangene Bytes haben Vorrang vor einem gleichzeitig abgelaufenen Timer
+        int expired = 0;
+        for (int i = 0; i < n; i++) {
+            if (ev[i].data.fd == ser) {
+                recvQ_fill();
+                return 1;
+            }
+            expired = 1;
+        }
 
-    // Byte zurückgeben
-    return 1;
+        if (expired) {
+            uint64_t ticks;
+            read(recvQ.tfd, &ticks, sizeof(ticks));
+            return 0;
+        }
+    }
 }
 
-static int recvQ_timeddequeue(uint8_t* c, struct timespec* ts) {
-	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout 0 zurückgeben
-	if (sem_timedwait(&recvQ.full, ts) == -1)
-		return 0;
-
-	sem_wait(&recvQ.mutex);
+// Liest bereits verfügbare Bytes ein, ohne zu blockieren
+static void recvQ_poll() {
+    struct epoll_event ev[2];
+    int n = epoll_wait(recvQ.epfd, ev, 2, 0);
+    for (int i = 0; i < n; i++)
+        if (ev[i].data.fd == ser)
+            recvQ_fill();
+}
 
-	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
-    *c = recvQ.data[recvQ.begin];
-    recvQ.begin = (recvQ.begin + 1) % recvQ_size;
+// Empfängt len Bytes bis zum Zeitpunkt deadline (NULL -> ohne Timeout), recvQ.mutex muss gehalten werden
+static unsigned int recvQ_recv(uint8_t* msg, unsigned int len, const struct timespec* deadline) {
+    unsigned int n = recvQ_take(msg, len);
+    while (n < len) {
+        // bei Timeout die bis dahin empfangenen Bytes übernehmen
+        if (!recvQ_wait(deadline))
+            return n + recvQ_take(msg + n, len - n);
 
-	// Semaphoren inkrementieren
-	sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+        n += recvQ_take(msg + n, len - n);
+    }
 
-    return 1;
+    return len;
 }
 
 static void sendQ_init() {
@@ -159,64 +267,92 @@ static void sendQ_init() {
     sendQ.end = 0;
 
     // Semaphoren initialisieren
-    sem_init(&sendQ.mutex, 0, 1);
-    sem_init(&sendQ.free, 0, recvQ_size);
+    pthread_mutex_init(&sendQ.lock, NULL);
+    pthread_cond_init(&sendQ.idle, NULL);
+    sem_init(&sendQ.free, 0, sendQ_size);
     sem_init(&sendQ.full, 0, 0);
+
+    // Zähler initialisieren
+    atomic_init(&sendQ.claims, 0);
+    atomic_init(&sendQ.exhausted, 0);
+    atomic_init(&sendQ.inUse, 0);
+    atomic_init(&sendQ.maxInUse, 0);
 }
 
-static void sendQ_enqueue(Bytes c) {
-    // ggf. blockieren und Semaphoren dekrementieren
-    sem_wait(&sendQ.free);
-    sem_wait(&sendQ.mutex);
+// Freien Slot belegen, sendQ.lock muss gehalten werden
+static Frame* sendQ_claim() {
+    // Pool erschöpft -> zählen und blockieren bis der Sendethread einen Slot freigibt
+    if (sem_trywait(&sendQ.free) == -1) {
+        atomic_fetch_add(&sendQ.exhausted, 1);
+        while (sem_wait(&sendQ.free) == -1 && errno == EINTR)
+            ;
+    }
+
+    atomic_fetch_add(&sendQ.claims, 1);
+    unsigned int inUse = atomic_fetch_add(&sendQ.inUse, 1) + 1;
+    unsigned int max = atomic_load(&sendQ.maxInUse);
+    while (inUse > max && !atomic_compare_exchange_weak(&sendQ.maxInUse, &max, inUse))
+        ;
 
-    // Byte-Struktur in der Warteschlange speichern und Endzeiger inkrementieren
-    sendQ.data[sendQ.end] = c;
-    sendQ.end = (sendQ.end + 1) % sendQ_size;
+    return &sendQ.data[sendQ.end];
+}
 
-    // Semaphoren inkrementieren
-    sem_post(&sendQ.mutex);
+// Belegten Slot an den Sendethread übergeben, sendQ.lock muss gehalten werden
+static void sendQ_publish() {
+    sendQ.end = (sendQ.end + 1) % sendQ_size;
     sem_post(&sendQ.full);
 }
 
-static Bytes sendQ_dequeue() {
-    // ggf. blockieren und Semaphoren dekrementieren
-    sem_wait(&sendQ.full);
-    sem_wait(&sendQ.mutex);
+static Frame* sendQ_dequeue() {
+    // ggf. blockieren bis ein Frame in der Warteschlange verfügbar ist
+    while (sem_wait(&sendQ.full) == -1 && errno == EINTR)
+        ;
 
-    // Byte-Struktur der Warteschlange speichern und Startzeiger inkrementieren
-    Bytes c = sendQ.data[sendQ.begin];
-    sendQ.begin = (sendQ.begin + 1) % sendQ_size;
+    // Nur der Sendethread liest den Anfang der Warteschlange
+    return &sendQ.data[sendQ.begin];
+}
 
-    // Semaphoren inkrementieren
-    sem_post(&sendQ.mutex);
+// Slot freigeben, serLock muss gehalten werden
+static void sendQ_release() {
+    // Startzeiger inkrementieren, bei leerer Warteschlange auf SX1262_sendFrame wartende Sender wecken
+    sendQ.begin = (sendQ.begin + 1) % sendQ_size;
+    if (atomic_fetch_sub(&sendQ.inUse, 1) == 1)
+        pthread_cond_broadcast(&sendQ.idle);
     sem_post(&sendQ.free);
-
-    // Byte zurückgeben
-    return c;
 }
 
-static void* recvBytes_func(void* args) {
-    while (1) {
-        uint8_t c;
-
-        // Blockieren bis 1 Byte gelesen wird
-        read(ser, &c, 1);
+static void rxPool_init() {
+    // alle Frames auf den Stapel legen
+    for (unsigned int i = 0; i < rxPool_size; i++)
+        rxPool.stack[i] = &rxPool.frames[i];
+    rxPool.top = rxPool_size;
 
-        // gelesenes Byte zur Warteschlange hinzufügen
-        recvQ_enqueue(c);
-    }
+    pthread_mutex_init(&rxPool.mutex, NULL);
+    sem_init(&rxPool.free, 0, rxPool_size);
 }
 
 static void* sendBytes_func(void* args) {
     while (1) {
-        // Blockieren bis Bytes in der Warteschlange verfügbar ist
-        Bytes c = sendQ_dequeue();
-
-        // Bytes aus der Warteschlange auf die ser. Schnittstelle schreiben
-        write(ser, c.bytes, c.count);
+        // Blockieren bis ein Frame in der Warteschlange verfügbar ist
+        Frame* f = sendQ_dequeue();
+
+        // Bytes des Slots auf die ser. Schnittstelle schreiben
+        pthread_mutex_lock(&serLock);
+        unsigned int written = 0;
+        while (written < f->count) {
+            ssize_t n = write(ser, f->bytes + written, f->count - written);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                fprintf(stderr, "Error %d writing serial port: %s\n", errno, strerror(errno));
+                break;
+            }
+            written += n;
+        }
 
-        // allokierten Speicher freigeben
-        free(c.bytes);
+        // Slot wieder freigeben
+        sendQ_release();
+        pthread_mutex_unlock(&serLock);
     }
 }
 
@@ -230,7 +366,60 @@ unsigned int msleep(unsigned int ms) {
     return rem.tv_sec * 1000 + rem.tv_nsec / 1000000;
 }
 
-void SX1262_init(unsigned int channel, int mode) {
+// Registerwert zu einem Konfigurationswert suchen, bei ungültigem Wert Programm beenden
+static uint8_t regValue(const unsigned int* table, unsigned int n, unsigned int value, const char* name) {
+    for (unsigned int i = 0; i < n; i++)
+        if (table[i] == value)
+            return i;
+
+    fprintf(stderr, "SX1262_init - Error: %s %u is not supported.\n", name, value);
+    exit(EXIT_FAILURE);
+}
+
+// Baudrate der ser. Schnittstelle umstellen, noch ausstehende Bytes werden mit der alten Baudrate gesendet
+static void setBaud(speed_t speed) {
+    struct termios options;
+    if (tcgetattr(ser, &options) != 0) {
+        fprintf(stderr, "Error %d from tcgetattr: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    cfsetospeed(&options, speed);
+    cfsetispeed(&options, speed);
+
+    if (tcsetattr(ser, TCSADRAIN, &options) != 0) {
+        fprintf(stderr, "Error %d from tcsetattr: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void SX1262_init(const SX1262_Config* cfg) {
+    /*** Parameter ***/
+    // nicht gesetzte Felder mit den Standardwerten belegen
+    config = *cfg;
+    if (config.port == NULL)    config.port = "/dev/ttyS0";
+    if (config.channel == 0)    config.channel = 868;
+    if (config.baudRate == 0)   config.baudRate = 9600;
+    if (config.airRate == 0)    config.airRate = 2400;
+    if (config.packetSize == 0) config.packetSize = 240;
+    if (config.power == 0)      config.power = 13;
+
+    if (config.channel < CHANNEL_BASE || config.channel > CHANNEL_BASE + 83) {
+        fprintf(stderr, "SX1262_init - Error: Channel %u is not allowed.\n", config.channel);
+        exit(EXIT_FAILURE);
+    }
+
+    // Registerwerte bestimmen
+    uint8_t baud = regValue(baudRates, sizeof(baudRates) / sizeof(*baudRates), config.baudRate, "Baud rate");
+    uint8_t air = regValue(airRates, sizeof(airRates) / sizeof(*airRates), config.airRate, "Air data rate");
+    uint8_t size = regValue(packetSizes, sizeof(packetSizes) / sizeof(*packetSizes), config.packetSize, "Packet size");
+    uint8_t power = regValue(powers, sizeof(powers) / sizeof(*powers), config.power, "Transmit power");
+
+    uint8_t reg0 = baud << 5 | REG0_PARITY | air;
+    uint8_t reg1 = size << 6 | REG1_FLAGS | power;
+    baudSpeed = baudSpeeds[baud];
+    /*** Parameter ***/
+
     /*** GPIO-Pins ***/
     // GPIO Pins initialisieren
 	GPIO_init();
@@ -245,9 +434,9 @@ void SX1262_init(unsigned int channel, int mode) {
 
     /*** serielle Schnittstelle ***/
 	// serielle Schnittstelle öffnen
-	ser = open("/dev/ttyS0", O_RDWR | O_NOCTTY | O_SYNC);       // Read & Write | Will not become the process's controlling terminal | Write operations on the file will complete synchronized
+	ser = open(config.port, O_RDWR | O_NOCTTY | O_SYNC);       // Read & Write | Will not become the process's controlling terminal | Write operations on the file will complete synchronized
     if (ser < 0) {
-        fprintf(stderr, "Error %d opening /dev/ttyS0: %s\n", errno, strerror(errno));
+        fprintf(stderr, "Error %d opening %s: %s\n", errno, config.port, strerror(errno));
         exit(EXIT_FAILURE);
     }
 
@@ -263,7 +452,7 @@ void SX1262_init(unsigned int channel, int mode) {
     // Attribute auf einen "Rohzustand" setzen
     cfmakeraw(&options);
 
-    // Baudrate auf 9600 setzen
+    // Baudrate im Konfigurationsmodus auf 9600 setzen
     cfsetospeed(&options, B9600);
     cfsetispeed(&options, B9600);
 
@@ -283,7 +472,7 @@ void SX1262_init(unsigned int channel, int mode) {
 	tcflush(ser, TCIOFLUSH);
 
 	// Konfiguration auf den Bus schreiben
-	const uint8_t CFG_REG[] = { '\xC2', '\x00', '\x09', ADDH, ADDL, NETID, REG0, REG1, channel - 850, REG3, CRYPT_H, CRYPT_L };
+	const uint8_t CFG_REG[] = { '\xC2', '\x00', '\x09', ADDH, ADDL, NETID, reg0, reg1, config.channel - CHANNEL_BASE, REG3, CRYPT_H, CRYPT_L };
 	write(ser, CFG_REG, sizeof(CFG_REG));
 
     // 100ms warten, während die Konfiguration übernommen wird
@@ -294,7 +483,7 @@ void SX1262_init(unsigned int channel, int mode) {
     read(ser, RET_REG, sizeof(RET_REG));
 
     // Falsche Antwort vom Modul
-    if (RET_REG[0] != '\xC1') {
+    if (RET_REG[0] != (uint8_t)'\xC1') {
         fprintf(stderr, "Fehler: Konfiguration konnte nicht übernommen werden:");
         for (int j = 0; j < sizeof(RET_REG); j++)
             fprintf(stderr, " %02X", RET_REG[j]);
@@ -303,20 +492,27 @@ void SX1262_init(unsigned int channel, int mode) {
         exit(EXIT_FAILURE);
     }
 
-    // wenn ein Byte der Antwort unterschiedlich -> falsche Konfiguration
+    // jedes Register der Antwort mit der Konfiguration vergleichen und Abweichungen einzeln ausgeben
+    int mismatch = 0;
     for (int i = 1; i < sizeof(RET_REG); i++) {
         if (RET_REG[i] != CFG_REG[i]) {
-            fprintf(stderr, "Fehler: Konfiguration konnte nicht übernommen werden:");
-            for (int j = 0; j < sizeof(RET_REG); j++)
-                fprintf(stderr, " %02X", RET_REG[j]);
-            fprintf(stderr, "\n");
-
-            exit(EXIT_FAILURE);
+            fprintf(stderr, "Fehler: %s: gesendet %02X, Antwort %02X\n", regNames[i], CFG_REG[i], RET_REG[i]);
+            mismatch = 1;
         }
     }
+
+    // wenn ein Byte der Antwort unterschiedlich -> falsche Konfiguration
+    if (mismatch) {
+        fprintf(stderr, "Fehler: Konfiguration konnte nicht übernommen werden:");
+        for (int j = 0; j < sizeof(RET_REG); j++)
+            fprintf(stderr, " %02X", RET_REG[j]);
+        fprintf(stderr, "\n");
+
+        exit(EXIT_FAILURE);
+    }
 	
 	// je nach gewünschten Modus
-    switch (mode) {
+    switch (config.mode) {
         case SX1262_DeepSleep:
             GPIO_output(M0, GPIO_HIGH);		    // deep sleep
             msleep(100);
@@ -334,21 +530,20 @@ void SX1262_init(unsigned int channel, int mode) {
             fprintf(stderr, "SX1262_setMode - Error: Wrong mode specified.\n");
             exit(EXIT_FAILURE);
     }
+
+    // außerhalb des Konfigurationsmodus mit der konfigurierten Baudrate arbeiten
+    if (config.mode != SX1262_Configuration)
+        setBaud(baudSpeed);
     /*** Konfiguration ***/
 
     /*** Warteschlangen ***/
     // Empfangs- und Sendewarteschlange initialisieren
     recvQ_init();
     sendQ_init();
+    rxPool_init();
     /*** Warteschlangen ***/
 
     /*** Threads ***/
-    // Empfangsthread starten
-    if (pthread_create(&recvT, NULL, &recvBytes_func, NULL) != 0) {
-        fprintf(stderr, "Error %d creating recvThread: %s\n", errno, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-
     // Sendethread starten
     if (pthread_create(&sendT, NULL, &sendBytes_func, NULL) != 0) {
         fprintf(stderr, "Error %d creating sendThread: %s\n", errno, strerror(errno));
@@ -363,15 +558,19 @@ void SX1262_setMode(int mode) {
             GPIO_output(M0, GPIO_LOW);
             GPIO_output(M1, GPIO_LOW);
             msleep(100);
+            setBaud(baudSpeed);
             break;
 
         case SX1262_DeepSleep:
             GPIO_output(M0, GPIO_HIGH);
             GPIO_output(M1, GPIO_HIGH);
             msleep(100);
+            setBaud(baudSpeed);
             break;
 
         case SX1262_Configuration:
+            // im Konfigurationsmodus antwortet das Modul nur mit 9600 Baud
+            setBaud(B9600);
             GPIO_output(M0, GPIO_LOW);
             GPIO_output(M1, GPIO_HIGH);
             msleep(1000);
@@ -385,53 +584,154 @@ void SX1262_setMode(int mode) {
 
 void SX1262_recv(unsigned char* msg, unsigned int len) {
     // len Bytes aus der Warteschlange entfernen und in den Puffer msg schreiben
-    for (int i = 0; i < len; i++)
-        msg[i] = recvQ_dequeue();
+    SX1262_recvUntil(msg, len, NULL);
 }
 
 unsigned int SX1262_tryrecv(unsigned char* msg, unsigned int len) {
-    // len Bytes aus der Warteschlange entfernen und in den Puffer msg schreiben
-    for (int i = 0; i < len; i++)
-        if (!recvQ_trydequeue(&msg[i]))
-            return i;
+    pthread_mutex_lock(&recvQ.mutex);
 
-    return len;
+    // verfügbare Bytes (höchstens len) aus der Warteschlange entfernen und in den Puffer msg schreiben
+    unsigned int n = recvQ_take(msg, len);
+    if (n < len) {
+        recvQ_poll();
+        n += recvQ_take(msg + n, len - n);
+    }
+
+    pthread_mutex_unlock(&recvQ.mutex);
+    return n;
 }
 
 unsigned int SX1262_timedrecv(unsigned char* msg, unsigned int len, unsigned int timeout) {
     // Timeout festlegen
-	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
+    struct timespec deadline;
+    SX1262_deadline(&deadline, timeout);
 
-	uint64_t nsec = ts.tv_nsec + (timeout * 1000000);
-	ts.tv_sec  += nsec / 1000000000;
-	ts.tv_nsec  = nsec % 1000000000;
+    return SX1262_recvUntil(msg, len, &deadline);
+}
 
-    // len Bytes aus der Warteschlange entfernen und in den Puffer msg schreiben
-    for (int i = 0; i < len; i++)
-        if (!recvQ_timeddequeue(&msg[i], &ts))
-            return i;
+void SX1262_deadline(struct timespec* ts, unsigned int ms) {
+    // aktuelle Zeit auf CLOCK_MONOTONIC plus ms Millisekunden
+    clock_gettime(CLOCK_MONOTONIC, ts);
 
-    return len;
+    uint64_t nsec = ts->tv_nsec + (ms * 1000000ULL);
+    ts->tv_sec  += nsec / 1000000000;
+    ts->tv_nsec  = nsec % 1000000000;
+}
+
+unsigned int SX1262_recvUntil(unsigned char* msg, unsigned int len, const struct timespec* deadline) {
+    // len Bytes bis zum Zeitpunkt deadline empfangen, bei Timeout die bis dahin empfangenen Bytes zurückgeben
+    pthread_mutex_lock(&recvQ.mutex);
+    unsigned int n = recvQ_recv(msg, len, deadline);
+    pthread_mutex_unlock(&recvQ.mutex);
+
+    return n;
 }
 
 void SX1262_send(unsigned char* msg, unsigned int len) {
-    // Variable zum Speichern mehrerer Bytes
-    Bytes c;
+    pthread_mutex_lock(&sendQ.lock);
 
-    // Speicher für die Bytes allokieren
-    c.bytes = (uint8_t*)malloc(len);
-    if (c.bytes == NULL) {
-        fprintf(stderr, "SX1262_send: malloc error!\n");
-        exit(EXIT_FAILURE);
+    // Nachricht in Slots zu je SX1262_FRAME_SIZE Bytes kopieren, längere Nachrichten belegen aufeinanderfolgende Slots
+    do {
+        Frame* f = sendQ_claim();
+
+        f->count = len < SX1262_FRAME_SIZE ? len : SX1262_FRAME_SIZE;
+        memcpy(f->bytes, msg, f->count);
+        msg += f->count;
+        len -= f->count;
+
+        sendQ_publish();
+    } while (len > 0);
+
+    pthread_mutex_unlock(&sendQ.lock);
+}
+
+void SX1262_getPoolStats(SX1262_PoolStats* stats) {
+    stats->slots = sendQ_size;
+    stats->claims = atomic_load(&sendQ.claims);
+    stats->exhausted = atomic_load(&sendQ.exhausted);
+    stats->inUse = atomic_load(&sendQ.inUse);
+    stats->maxInUse = atomic_load(&sendQ.maxInUse);
+}
+
+unsigned int SX1262_sendFrame(const struct iovec* iov, int iovcnt) {
+    // lokale Kopie, da die Einträge bei unvollständigen Schreibvorgängen weitergesetzt werden
+    struct iovec v[iovcnt];
+    memcpy(v, iov, sizeof(v));
+
+    // keine weiteren Sender zulassen und warten bis die Warteschlange leer ist, damit die Reihenfolge erhalten bleibt
+    pthread_mutex_lock(&sendQ.lock);
+    pthread_mutex_lock(&serLock);
+    while (atomic_load(&sendQ.inUse) > 0)
+        pthread_cond_wait(&sendQ.idle, &serLock);
+
+    // Header und Payload ohne Zwischenkopie auf die ser. Schnittstelle schreiben
+    unsigned int written = 0;
+    int i = 0;
+    while (i < iovcnt) {
+        ssize_t n = writev(ser, &v[i], iovcnt - i);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            fprintf(stderr, "Error %d writing serial port: %s\n", errno, strerror(errno));
+            break;
+        }
+        written += n;
+
+        // vollständig geschriebene Einträge überspringen, den angefangenen kürzen
+        while (i < iovcnt && (size_t)n >= v[i].iov_len) {
+            n -= v[i].iov_len;
+            i++;
+        }
+        if (i < iovcnt) {
+            v[i].iov_base = (uint8_t*)v[i].iov_base + n;
+            v[i].iov_len -= n;
+        }
     }
 
-    // Bytes in den allokierten Speicher kopieren
-    memcpy(c.bytes, msg, len);
+    pthread_mutex_unlock(&serLock);
+    pthread_mutex_unlock(&sendQ.lock);
+
+    return written;
+}
+
+SX1262_Frame* SX1262_frameGet() {
+    // ggf. blockieren bis ein Frame zurückgegeben wurde
+    while (sem_wait(&rxPool.free) == -1 && errno == EINTR)
+        ;
+
+    pthread_mutex_lock(&rxPool.mutex);
+    SX1262_Frame* frame = rxPool.stack[--rxPool.top];
+    pthread_mutex_unlock(&rxPool.mutex);
+
+    frame->len = 0;
+    return frame;
+}
+
+void SX1262_frameRelease(SX1262_Frame* frame) {
+    // Frame zurück auf den Stapel legen
+    pthread_mutex_lock(&rxPool.mutex);
+    rxPool.stack[rxPool.top++] = frame;
+    pthread_mutex_unlock(&rxPool.mutex);
+
+    sem_post(&rxPool.free);
+}
+
+unsigned int SX1262_recvFrame(SX1262_Frame* frame, unsigned int len, unsigned int timeout) {
+    // Timeout festlegen
+    struct timespec deadline;
+    SX1262_deadline(&deadline, timeout);
+
+    return SX1262_recvFrameUntil(frame, len, &deadline);
+}
+
+unsigned int SX1262_recvFrameUntil(SX1262_Frame* frame, unsigned int len, const struct timespec* deadline) {
+    // Frame zu klein (Nachricht größer als die max. Paketgröße des Moduls)
+    if (frame->len + len > SX1262_RXFRAME_SIZE)
+        return 0;
 
-    // Anzahl Bytes speichern
-    c.count = len;
+    // len Bytes direkt aus dem Ringpuffer an den Frame anhängen
+    unsigned int n = SX1262_recvUntil(frame->bytes + frame->len, len, deadline);
+    frame->len += n;
 
-    // Bytes zur Warteschlange hinzufügen
-    sendQ_enqueue(c);
+    return n;
 }
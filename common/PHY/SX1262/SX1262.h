@@ -5,15 +5,63 @@
 #define SX1262_DeepSleep     1
 #define SX1262_Configuration 2
 
+#include <stdint.h>         // uint8_t
+#include <sys/uio.h>        // struct iovec
+#include <time.h>           // struct timespec
+
+// Konfiguration des Moduls, mit 0 bzw. NULL belegte Felder erhalten den Standardwert
+typedef struct SX1262_Config {
+    const char* port;               // ser. Schnittstelle (Standard: /dev/ttyS0)
+    unsigned int channel;           // Frequenz in MHz, 850 - 933 (Standard: 868)
+    int mode;                       // Modus nach der Konfiguration (Standard: SX1262_Transmission)
+    unsigned int baudRate;          // UART-Baudrate: 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 (Standard: 9600)
+    unsigned int airRate;           // Luftdatenrate in bit/s: 300, 1200, 2400, 4800, 9600, 19200, 38400, 62500 (Standard: 2400)
+    unsigned int packetSize;        // Aufteilung in Pakete zu 32, 64, 128 oder 240 Bytes (Standard: 240)
+    unsigned int power;             // Sendeleistung in dBm: 10, 13, 17, 22 (Standard: 13)
+} SX1262_Config;
+
+// Maximale Paketgröße des Moduls und Größe eines Slots im Sende-Frame-Pool
+#define SX1262_FRAME_SIZE    240
+
+// Zähler des Sende-Frame-Pools
+typedef struct SX1262_PoolStats {
+    unsigned int slots;             // Anzahl Slots im Pool
+    unsigned long claims;           // Anzahl belegter Slots insgesamt
+    unsigned long exhausted;        // Anzahl Belegungen, die auf einen freien Slot warten mussten
+    unsigned int inUse;             // aktuell belegte Slots
+    unsigned int maxInUse;          // maximal gleichzeitig belegte Slots
+} SX1262_PoolStats;
+
+// Größe eines Empfangs-Frames (Nachrichtenheader, Payload und RSSI-Byte)
+#define SX1262_RXFRAME_SIZE  256
+
+// Empfangs-Frame aus dem Frame-Pool, gehört bis SX1262_frameRelease dem Aufrufer
+typedef struct SX1262_Frame {
+    unsigned int len;                       // Anzahl empfangener Bytes
+    uint8_t bytes[SX1262_RXFRAME_SIZE];     // Bytes des Frames
+} SX1262_Frame;
+
 unsigned int msleep(unsigned int);
 
-void SX1262_init(unsigned int, int);
+void SX1262_init(const SX1262_Config*);
 void SX1262_setMode(int);
 
 void SX1262_recv(unsigned char*, unsigned int);
 unsigned int SX1262_tryrecv(unsigned char*, unsigned int);
 unsigned int SX1262_timedrecv(unsigned char*, unsigned int, unsigned int);
 
+// Zeitpunkte für die *Until-Funktionen sind absolut und beziehen sich auf CLOCK_MONOTONIC
+void SX1262_deadline(struct timespec*, unsigned int);
+unsigned int SX1262_recvUntil(unsigned char*, unsigned int, const struct timespec*);
+
 void SX1262_send(unsigned char*, unsigned int);
+void SX1262_getPoolStats(SX1262_PoolStats*);
+
+unsigned int SX1262_sendFrame(const struct iovec*, int);
+
+SX1262_Frame* SX1262_frameGet();
+void SX1262_frameRelease(SX1262_Frame*);
+unsigned int SX1262_recvFrame(SX1262_Frame*, unsigned int, unsigned int);
+unsigned int SX1262_recvFrameUntil(SX1262_Frame*, unsigned int, const struct timespec*);
 
 #endif // SX1262_H
@@ -0,0 +1,13 @@
+// GPIO ohne Hardware für das simulierte Funkmodul: die Pins M0 und M1 werden von SX1262Sim/SX1262.c nicht benötigt
+
+#include "../GPIO/GPIO.h"
+
+void GPIO_init() {}
+
+void GPIO_setup(int pin, int direction) {}
+
+int GPIO_input(int pin) {
+    return GPIO_LOW;
+}
+
+void GPIO_output(int pin, int value) {}
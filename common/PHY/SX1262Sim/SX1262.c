@@ -0,0 +1,655 @@
+// Simuliertes SX1262-Funkmodul mit derselben Schnittstelle wie SX1262/SX1262.c
+//
+// Wird beim Linken anstelle von SX1262/SX1262.c und GPIO/GPIO.c verwendet, MAC- und Routing-Schicht bleiben unverändert:
+// 	gcc -g -funsigned-char -o Debug/STRP_ALOHA_SIM main.c util.c vclock.c ProtoMon/ProtoMon.c STRP/STRP.c ALOHA/ALOHA.c SX1262Sim/SX1262.c SX1262Sim/GPIO.c -lpthread -lm
+// -funsigned-char wie auf dem Pi (ARM), siehe airsim.c
+//
+// Umgebungsvariablen:
+// 	SX1262SIM_SOCKET	Pfad des Unix-Sockets des Funkkanals (airsim), ohne Angabe Loopback-Betrieb
+// 	SX1262SIM_NODE		Adresse des Knotens im Funkkanal (0 - 255), bei Verbindung zum Funkkanal erforderlich
+// 	VCLOCK=sim			virtuelle Uhr (siehe vclock.h), mit Funkkanal muss auch airsim mit VCLOCK=sim laufen
+// 	SX1262SIM_AIRRATE	Luftdatenrate in bit/s unabhängig von der Konfiguration (beliebiger Wert, z. B. zum Testen der
+// 						Kalibrierung der Sendezeiten in der MAC-Schicht)
+// 	SX1262SIM_TXDELAY	zusätzliche Sendedauer je Paket in us (Standard: 0)
+//
+// Im Loopback-Betrieb empfängt der Knoten seine eigenen Pakete nach der Sendedauer mit -40dBm zurück.
+// Mit Funkkanal entscheidet airsim über Reichweite, Kollisionen und Ausbreitungsverzögerung.
+//
+// Nachgebildet werden die Zeiten des Moduls: UART (10 Bit pro Byte bei der konfigurierten Baudrate), Aufteilung
+// in Pakete der konfigurierten Paketgröße und Sendedauer (Paket plus SIM_AIR_OVERHEAD Bytes bei der Luftdatenrate).
+// Vom Modul verstanden werden die Abfrage des Ambient Noise (C0 C1 C2 C3 00 01) und das Schreiben der Register
+// im Konfigurationsmodus (C0/C2 Startadresse Länge Werte), beide werden wie vom Modul mit C1 beantwortet.
+
+#include "../SX1262/SX1262.h"
+
+#include <errno.h>          // errno
+#include <pthread.h>        // pthread_create, pthread_mutex_lock
+#include <semaphore.h>      // sem_init, sem_trywait
+#include <stdio.h>          // fprintf
+#include <stdlib.h>         // getenv, exit
+#include <string.h>         // memcpy, strerror
+#include <sys/socket.h>     // socket, connect
+#include <sys/un.h>         // sockaddr_un
+#include <time.h>           // struct timespec
+
+#include "sim.h"
+#include "../vclock.h"
+
+// channel control 0 - 83, 850.125 + REG2 * 1MHz
+#define CHANNEL_BASE 850
+
+// RSSI im Loopback-Betrieb und Ambient Noise ohne Funkkanal
+#define LOOPBACK_RSSI  -40
+#define LOOPBACK_NOISE -110
+
+// Byte-Ringpuffer für den Empfang, wird vom UART-Thread mit der Ausgabe des Moduls gefüllt
+#define recvQ_size 4096
+#define recvQ_mask (recvQ_size - 1)
+typedef struct recvQueue {
+    uint8_t data[recvQ_size];        // Daten bzw. Bytes der Warteschlange
+    unsigned int head;               // Schreibindex
+    unsigned int tail;               // Leseindex
+    unsigned long overruns;          // verworfene Bytes bei vollem Puffer (wie ein UART-Überlauf)
+    pthread_mutex_t lock;            // schützt die Indizes
+    sem_t readers;                   // serialisiert empfangende Threads
+    sem_t avail;                     // wird nach jedem Einfügen erhöht
+} recvQueue;
+
+// Ausgabe des Moduls an den Pi (Paket mit RSSI-Byte oder Antwort), wird zum Zeitpunkt due in recvQ geschrieben
+typedef struct UartChunk {
+    uint64_t due;                    // Ende der Übertragung über den UART
+    unsigned int len;                // Anzahl Bytes
+    uint8_t bytes[SIM_MAX_LEN];      // Bytes
+} UartChunk;
+
+#define uartQ_size 64
+typedef struct uartQueue {
+    UartChunk data[uartQ_size];      // Einträge der Warteschlange
+    unsigned int begin, end;         // Zeiger auf den Anfang und das Ende
+    uint64_t busyUntil;              // Ende der letzten Übertragung Modul -> Pi
+    pthread_mutex_t lock;            // schützt Endzeiger und busyUntil
+    sem_t free, full;                // Semaphoren
+} uartQueue;
+
+// Pool der Empfangs-Frames, die an die MAC-Schicht ausgeliehen werden
+#define rxPool_size 64
+typedef struct rxFramePool {
+    SX1262_Frame frames[rxPool_size];   // Frames des Pools
+    SX1262_Frame* stack[rxPool_size];   // Stapel der freien Frames
+    unsigned int top;                   // Anzahl freier Frames
+    pthread_mutex_t mutex;              // schützt den Stapel
+    sem_t free;                         // Semaphore
+} rxFramePool;
+
+// Zustand des simulierten Moduls
+typedef struct Radio {
+    int hub;                        // Verbindung zum Funkkanal, -1 im Loopback-Betrieb
+    uint8_t node;                   // Adresse im Funkkanal
+    int mode;                       // aktueller Modus
+    unsigned int channel;           // aktueller Kanal in MHz
+    uint64_t uartInFree;            // Ende der letzten Übertragung Pi -> Modul
+    uint64_t airFree;               // Ende der letzten Aussendung
+    unsigned int airRate;           // Luftdatenrate aus SX1262SIM_AIRRATE (0 -> konfigurierte Luftdatenrate)
+    uint64_t txDelay;               // zusätzliche Sendedauer je Paket aus SX1262SIM_TXDELAY
+    unsigned long packets;          // Anzahl gesendeter Pakete
+    uint32_t consumed;              // Anzahl gelesener Nachrichten des Hubs (virtuelle Uhr)
+    pthread_mutex_t lock;           // serialisiert die Sender
+    pthread_mutex_t fdLock;         // serialisiert Schreibzugriffe auf hub
+} Radio;
+
+// UART-Baudraten und Luftdatenraten des Moduls
+static const unsigned int baudRates[] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+static const unsigned int airRates[] = { 300, 1200, 2400, 4800, 9600, 19200, 38400, 62500 };
+static const unsigned int packetSizes[] = { 240, 128, 64, 32 };
+static const unsigned int powers[] = { 22, 17, 13, 10 };
+
+// übernommene Konfiguration
+static SX1262_Config config;
+
+// UART-Thread und Thread für die Verbindung zum Funkkanal
+static pthread_t uartT, hubT;
+
+// Empfangswarteschlange
+static recvQueue recvQ;
+
+// Ausgabe des Moduls
+static uartQueue uartQ;
+
+// Empfangs-Frames
+static rxFramePool rxPool;
+
+// simuliertes Modul
+static Radio radio;
+
+// Dauer der Übertragung von len Bytes über den UART (Start-, 8 Daten-, Stoppbit)
+static uint64_t uartTime(unsigned int len) {
+    return len * 10 * 1000000000ULL / config.baudRate;
+}
+
+// Sendedauer eines Pakets mit len Bytes
+static uint64_t airTime(unsigned int len) {
+    unsigned int rate = radio.airRate ? radio.airRate : config.airRate;
+    return radio.txDelay + (len + SIM_AIR_OVERHEAD) * 8 * 1000000000ULL / rate;
+}
+
+static void recvQ_init() {
+    recvQ.head = 0;
+    recvQ.tail = 0;
+    recvQ.overruns = 0;
+    pthread_mutex_init(&recvQ.lock, NULL);
+    sem_init(&recvQ.readers, 0, 1);
+    sem_init(&recvQ.avail, 0, 0);
+}
+
+// Bytes an den Ringpuffer anhängen (Ausgabe des Moduls an den Pi)
+static void recvQ_put(const uint8_t* bytes, unsigned int len) {
+    pthread_mutex_lock(&recvQ.lock);
+    for (unsigned int i = 0; i < len; i++) {
+        if (recvQ.head - recvQ.tail == recvQ_size) {
+            recvQ.overruns += len - i;
+            break;
+        }
+        recvQ.data[recvQ.head++ & recvQ_mask] = bytes[i];
+    }
+    pthread_mutex_unlock(&recvQ.lock);
+
+    vclock_sem_post(&recvQ.avail);
+}
+
+// verfügbare Bytes übernehmen, höchstens len
+static unsigned int recvQ_take(uint8_t* msg, unsigned int len) {
+    pthread_mutex_lock(&recvQ.lock);
+    unsigned int n = 0;
+    while (n < len && recvQ.tail != recvQ.head)
+        msg[n++] = recvQ.data[recvQ.tail++ & recvQ_mask];
+    pthread_mutex_unlock(&recvQ.lock);
+
+    return n;
+}
+
+// Empfängt len Bytes bis zum Zeitpunkt deadline (NULL -> ohne Timeout, Zeitpunkt 0 -> nicht blockieren)
+static unsigned int recvQ_recv(uint8_t* msg, unsigned int len, const struct timespec* deadline) {
+    vclock_sem_wait(&recvQ.readers);
+
+    unsigned int n = recvQ_take(msg, len);
+    while (n < len) {
+        if (deadline != NULL && deadline->tv_sec == 0 && deadline->tv_nsec == 0)
+            break;
+
+        // auf weitere Bytes warten, bei Timeout die bis dahin empfangenen Bytes zurückgeben
+        int ret = deadline == NULL ? vclock_sem_wait(&recvQ.avail) : vclock_sem_clockwait(&recvQ.avail, CLOCK_MONOTONIC, deadline);
+        n += recvQ_take(msg + n, len - n);
+        if (ret != 0 && errno == ETIMEDOUT)
+            break;
+    }
+
+    vclock_sem_post(&recvQ.readers);
+    return n;
+}
+
+static void uartQ_init() {
+    uartQ.begin = 0;
+    uartQ.end = 0;
+    uartQ.busyUntil = 0;
+    pthread_mutex_init(&uartQ.lock, NULL);
+    sem_init(&uartQ.free, 0, uartQ_size);
+    sem_init(&uartQ.full, 0, 0);
+}
+
+// Ausgabe des Moduls einreihen: Übertragung über den UART nach dem Ende des Empfangs (end) und der vorherigen Ausgabe
+static void uartQ_enqueue(uint64_t end, const uint8_t* head, unsigned int headLen, const uint8_t* tail, unsigned int tailLen) {
+    // Warteschlange voll -> wie bei einem UART-Überlauf verwerfen
+    if (sem_trywait(&uartQ.free) != 0) {
+        pthread_mutex_lock(&recvQ.lock);
+        recvQ.overruns += headLen + tailLen;
+        pthread_mutex_unlock(&recvQ.lock);
+        return;
+    }
+
+    pthread_mutex_lock(&uartQ.lock);
+    UartChunk* c = &uartQ.data[uartQ.end];
+    memcpy(c->bytes, head, headLen);
+    memcpy(c->bytes + headLen, tail, tailLen);
+    c->len = headLen + tailLen;
+
+    uint64_t start = end > uartQ.busyUntil ? end : uartQ.busyUntil;
+    c->due = uartQ.busyUntil = start + uartTime(c->len);
+    uartQ.end = (uartQ.end + 1) % uartQ_size;
+    pthread_mutex_unlock(&uartQ.lock);
+
+    vclock_sem_post(&uartQ.full);
+}
+
+static void rxPool_init() {
+    // alle Frames auf den Stapel legen
+    for (unsigned int i = 0; i < rxPool_size; i++)
+        rxPool.stack[i] = &rxPool.frames[i];
+    rxPool.top = rxPool_size;
+
+    pthread_mutex_init(&rxPool.mutex, NULL);
+    sem_init(&rxPool.free, 0, rxPool_size);
+}
+
+// Nachricht an den Funkkanal schicken
+static void radio_write(uint8_t type, const void* head, uint16_t headLen, const void* body, uint16_t bodyLen) {
+    pthread_mutex_lock(&radio.fdLock);
+    if (sim_write(radio.hub, type, head, headLen, body, bodyLen) != 0) {
+        fprintf(stderr, "Error %d writing to the air simulator: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_unlock(&radio.fdLock);
+}
+
+// Modus bzw. Kanal an den Funkkanal melden
+static void radio_notify(uint8_t type) {
+    if (radio.hub < 0)
+        return;
+
+    if (type == SIM_MODE) {
+        uint8_t mode = radio.mode;
+        radio_write(SIM_MODE, &mode, 1, NULL, 0);
+    }
+    else {
+        uint8_t channel[2] = { radio.channel & 0xFF, radio.channel >> 8 };
+        radio_write(SIM_CHANNEL, channel, sizeof(channel), NULL, 0);
+    }
+}
+
+// virtuelle Uhr: kein Thread ist lauffähig, nächster Zeitpunkt next (0 -> keiner)
+static void radio_idle(uint64_t next, void* arg) {
+    uint8_t idle[12];
+    memcpy(idle, &next, 8);
+    memcpy(idle + 8, &radio.consumed, 4);
+    radio_write(SIM_IDLE, idle, sizeof(idle), NULL, 0);
+}
+
+// Kommando im Konfigurationsmodus: Register ab Startadresse schreiben und mit C1 bestätigen
+static void radio_configure(const uint8_t* cmd, unsigned int len) {
+    if (len < 3 || (cmd[0] != 0xC0 && cmd[0] != 0xC2) || len != 3u + cmd[2] || cmd[1] + cmd[2] > 9)
+        return;
+
+    for (unsigned int i = 0; i < cmd[2]; i++) {
+        uint8_t reg = cmd[1] + i, value = cmd[3 + i];
+        switch (reg) {
+            case 3:     // REG0: Baudrate (Bits 7-5), Luftdatenrate (Bits 2-0)
+                config.baudRate = baudRates[value >> 5];
+                config.airRate = airRates[value & 0x07];
+                break;
+            case 4:     // REG1: Paketgröße (Bits 7-6), Sendeleistung (Bits 1-0)
+                config.packetSize = packetSizes[value >> 6];
+                config.power = powers[value & 0x03];
+                break;
+            case 5:     // REG2: Kanal
+                if (value <= 83) {
+                    radio.channel = CHANNEL_BASE + value;
+                    radio_notify(SIM_CHANNEL);
+                }
+                break;
+        }
+    }
+
+    // Antwort des Moduls nach der UART-Übertragung der Anfrage: C1 Startadresse Länge Werte
+    uint8_t ret[3 + 9];
+    memcpy(ret, cmd, len);
+    ret[0] = 0xC1;
+    uartQ_enqueue(radio.uartInFree, ret, len, NULL, 0);
+}
+
+// Bytes vom Pi an das Modul: Kommando oder Daten, Daten werden in Pakete aufgeteilt und ausgesendet
+static void radio_send(const uint8_t* msg, unsigned int len) {
+    pthread_mutex_lock(&radio.lock);
+
+    // Übertragung über den UART
+    uint64_t now = vclock_now();
+    uint64_t uartStart = radio.uartInFree > now ? radio.uartInFree : now;
+    radio.uartInFree = uartStart + uartTime(len);
+
+    if (radio.mode == SX1262_Configuration) {
+        radio_configure(msg, len);
+        pthread_mutex_unlock(&radio.lock);
+        return;
+    }
+
+    // im Tiefschlaf werden keine Bytes angenommen
+    if (radio.mode == SX1262_DeepSleep) {
+        pthread_mutex_unlock(&radio.lock);
+        return;
+    }
+
+    // Abfrage des Ambient Noise
+    static const uint8_t noiseCmd[] = { 0xC0, 0xC1, 0xC2, 0xC3, 0x00, 0x01 };
+    if (len == sizeof(noiseCmd) && memcmp(msg, noiseCmd, len) == 0) {
+        // mit Funkkanal bestimmt airsim das Ambient Noise, sonst Grundrauschen
+        if (radio.hub >= 0)
+            radio_write(SIM_NOISE_REQ, NULL, 0, NULL, 0);
+        else {
+            uint8_t ret[] = { 0xC1, 0x00, 0x01, -2 * LOOPBACK_NOISE };
+            uartQ_enqueue(radio.uartInFree, ret, sizeof(ret), NULL, 0);
+        }
+        pthread_mutex_unlock(&radio.lock);
+        return;
+    }
+
+    // Aufteilung in Pakete: ein Paket wird ausgesendet, sobald es vollständig über den UART empfangen wurde
+    unsigned int offset = 0;
+    while (offset < len) {
+        unsigned int n = len - offset < config.packetSize ? len - offset : config.packetSize;
+        uint64_t ready = uartStart + uartTime(offset + n);
+        uint64_t start = ready > radio.airFree ? ready : radio.airFree;
+        uint64_t duration = airTime(n);
+        radio.airFree = start + duration;
+        radio.packets++;
+
+        if (radio.hub < 0) {
+            // Loopback: eigenes Paket nach der Sendedauer mit RSSI-Byte zurück empfangen
+            uint8_t rssi = (uint8_t)(int8_t)LOOPBACK_RSSI;
+            uartQ_enqueue(start + duration, msg + offset, n, &rssi, 1);
+        }
+        else {
+            uint8_t head[16];
+            memcpy(head, &start, 8);
+            memcpy(head + 8, &duration, 8);
+            radio_write(SIM_TX, head, sizeof(head), msg + offset, n);
+        }
+
+        offset += n;
+    }
+
+    pthread_mutex_unlock(&radio.lock);
+}
+
+// UART-Thread: Ausgabe des Moduls zum jeweiligen Zeitpunkt in den Ringpuffer schreiben
+static void* uart_func(void* args) {
+    while (1) {
+        vclock_sem_wait(&uartQ.full);
+
+        // nur dieser Thread liest den Anfang der Warteschlange
+        UartChunk* c = &uartQ.data[uartQ.begin];
+        vclock_sleepUntil(c->due);
+        recvQ_put(c->bytes, c->len);
+
+        uartQ.begin = (uartQ.begin + 1) % uartQ_size;
+        vclock_sem_post(&uartQ.free);
+    }
+
+    return NULL;
+}
+
+// Thread für die Verbindung zum Funkkanal: empfangene Pakete und Antworten an den UART-Thread übergeben
+static void* hub_func(void* args) {
+    uint8_t buf[SIM_MAX_LEN];
+    int entered = 0;
+
+    while (1) {
+        uint8_t type;
+        int len = sim_read(radio.hub, &type, buf);
+        if (len < 0) {
+            fprintf(stderr, "Error: connection to the air simulator lost.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // virtuelle Uhr: die Nachrichten eines Zeitschritts werden bearbeitet, während kein anderer Thread läuft
+        if (!entered) {
+            vclock_enter();
+            entered = vclock_isSim();
+        }
+        radio.consumed++;
+
+        switch (type) {
+            case SIM_RX:
+                // Paket und RSSI-Byte
+                if (len >= 9) {
+                    uint64_t end;
+                    memcpy(&end, buf, 8);
+                    uartQ_enqueue(end, buf + 9, len - 9, buf + 8, 1);
+                }
+                break;
+
+            case SIM_NOISE: {
+                // Antwort des Moduls: C1 00 01 RSSI, Ambient Noise = -RSSI / 2 dBm
+                int rssi = -2 * (int8_t)buf[0];
+                uint8_t ret[] = { 0xC1, 0x00, 0x01, rssi > 255 ? 255 : rssi };
+                uartQ_enqueue(vclock_now(), ret, sizeof(ret), NULL, 0);
+                break;
+            }
+
+            case SIM_ADVANCE: {
+                // Zeitschritt abgeschlossen, die Threads des Knotens laufen weiter
+                uint64_t now;
+                memcpy(&now, buf, 8);
+                vclock_advance(now);
+                vclock_leave();
+                entered = 0;
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+unsigned int msleep(unsigned int ms) {
+    return vclock_msleep(ms);
+}
+
+// Konfigurationswert prüfen, bei ungültigem Wert Programm beenden
+static void checkValue(const unsigned int* table, unsigned int n, unsigned int value, const char* name) {
+    for (unsigned int i = 0; i < n; i++)
+        if (table[i] == value)
+            return;
+
+    fprintf(stderr, "SX1262_init - Error: %s %u is not supported.\n", name, value);
+    exit(EXIT_FAILURE);
+}
+
+// Verbindung zum Funkkanal aufbauen, ohne SX1262SIM_SOCKET im Loopback-Betrieb arbeiten
+static void connectAir() {
+    radio.hub = -1;
+    const char* path = getenv("SX1262SIM_SOCKET");
+    if (path == NULL || *path == '\0')
+        return;
+
+    const char* node = getenv("SX1262SIM_NODE");
+    if (node == NULL || atoi(node) < 0 || atoi(node) > 255) {
+        fprintf(stderr, "SX1262_init - Error: SX1262SIM_NODE (0 - 255) must be set to use %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    radio.node = atoi(node);
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    radio.hub = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (radio.hub < 0 || connect(radio.hub, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Error %d connecting to %s: %s\n", errno, path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // beim Funkkanal anmelden, mit virtueller Uhr gibt ab jetzt der Hub die Zeit vor
+    uint64_t now = vclock_now();
+    uint8_t hello[13] = { radio.node, radio.channel & 0xFF, radio.channel >> 8, radio.mode };
+    memcpy(hello + 4, &now, 8);
+    hello[12] = vclock_isSim();
+    radio_write(SIM_HELLO, hello, sizeof(hello), NULL, 0);
+    vclock_setSync(radio_idle, NULL);
+}
+
+void SX1262_init(const SX1262_Config* cfg) {
+    /*** Parameter ***/
+    // nicht gesetzte Felder mit den Standardwerten belegen
+    config = *cfg;
+    if (config.port == NULL)    config.port = "/dev/ttyS0";
+    if (config.channel == 0)    config.channel = 868;
+    if (config.baudRate == 0)   config.baudRate = 9600;
+    if (config.airRate == 0)    config.airRate = 2400;
+    if (config.packetSize == 0) config.packetSize = 240;
+    if (config.power == 0)      config.power = 13;
+
+    if (config.channel < CHANNEL_BASE || config.channel > CHANNEL_BASE + 83) {
+        fprintf(stderr, "SX1262_init - Error: Channel %u is not allowed.\n", config.channel);
+        exit(EXIT_FAILURE);
+    }
+    if (config.mode != SX1262_Transmission && config.mode != SX1262_DeepSleep && config.mode != SX1262_Configuration) {
+        fprintf(stderr, "SX1262_setMode - Error: Wrong mode specified.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    checkValue(baudRates, sizeof(baudRates) / sizeof(*baudRates), config.baudRate, "Baud rate");
+    checkValue(airRates, sizeof(airRates) / sizeof(*airRates), config.airRate, "Air data rate");
+    checkValue(packetSizes, sizeof(packetSizes) / sizeof(*packetSizes), config.packetSize, "Packet size");
+    checkValue(powers, sizeof(powers) / sizeof(*powers), config.power, "Transmit power");
+    /*** Parameter ***/
+
+    /*** Warteschlangen ***/
+    recvQ_init();
+    uartQ_init();
+    rxPool_init();
+    /*** Warteschlangen ***/
+
+    /*** Funkkanal ***/
+    radio.mode = config.mode;
+    radio.channel = config.channel;
+
+    // Sendedauer abweichend von der Konfiguration
+    const char* rate = getenv("SX1262SIM_AIRRATE");
+    const char* delay = getenv("SX1262SIM_TXDELAY");
+    radio.airRate = rate != NULL && atoi(rate) > 0 ? atoi(rate) : 0;
+    radio.txDelay = delay != NULL && atoi(delay) > 0 ? atoi(delay) * 1000ULL : 0;
+    pthread_mutex_init(&radio.lock, NULL);
+    pthread_mutex_init(&radio.fdLock, NULL);
+    connectAir();
+    /*** Funkkanal ***/
+
+    /*** Threads ***/
+    // UART-Thread starten
+    if (vclock_thread_create(&uartT, NULL, &uart_func, NULL) != 0) {
+        fprintf(stderr, "Error %d creating uartThread: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Thread für die Verbindung zum Funkkanal starten, er läuft außerhalb der virtuellen Uhr
+    if (radio.hub >= 0 && pthread_create(&hubT, NULL, &hub_func, NULL) != 0) {
+        fprintf(stderr, "Error %d creating hubThread: %s\n", errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    /*** Threads ***/
+}
+
+void SX1262_setMode(int mode) {
+    if (mode != SX1262_Transmission && mode != SX1262_DeepSleep && mode != SX1262_Configuration) {
+        fprintf(stderr, "SX1262_setMode - Error: Wrong mode specified.\n");
+        return;
+    }
+
+    pthread_mutex_lock(&radio.lock);
+    radio.mode = mode;
+    radio_notify(SIM_MODE);
+    pthread_mutex_unlock(&radio.lock);
+
+    // Umschaltzeiten des Moduls
+    msleep(mode == SX1262_Configuration ? 1000 : 100);
+}
+
+void SX1262_recv(unsigned char* msg, unsigned int len) {
+    SX1262_recvUntil(msg, len, NULL);
+}
+
+unsigned int SX1262_tryrecv(unsigned char* msg, unsigned int len) {
+    // Zeitpunkt 0 -> nur bereits verfügbare Bytes übernehmen
+    struct timespec deadline = { 0, 0 };
+    return recvQ_recv(msg, len, &deadline);
+}
+
+unsigned int SX1262_timedrecv(unsigned char* msg, unsigned int len, unsigned int timeout) {
+    // Timeout festlegen
+    struct timespec deadline;
+    SX1262_deadline(&deadline, timeout);
+
+    return SX1262_recvUntil(msg, len, &deadline);
+}
+
+void SX1262_deadline(struct timespec* ts, unsigned int ms) {
+    // aktuelle Zeit auf CLOCK_MONOTONIC plus ms Millisekunden
+    vclock_gettime(CLOCK_MONOTONIC, ts);
+
+    uint64_t nsec = ts->tv_nsec + (ms * 1000000ULL);
+    ts->tv_sec  += nsec / 1000000000;
+    ts->tv_nsec  = nsec % 1000000000;
+}
+
+unsigned int SX1262_recvUntil(unsigned char* msg, unsigned int len, const struct timespec* deadline) {
+    return recvQ_recv(msg, len, deadline);
+}
+
+void SX1262_send(unsigned char* msg, unsigned int len) {
+    radio_send(msg, len);
+}
+
+void SX1262_getPoolStats(SX1262_PoolStats* stats) {
+    // ohne Sende-Frame-Pool: jedes Paket zählt als Belegung
+    pthread_mutex_lock(&radio.lock);
+    stats->slots = 0;
+    stats->claims = radio.packets;
+    stats->exhausted = 0;
+    stats->inUse = 0;
+    stats->maxInUse = 0;
+    pthread_mutex_unlock(&radio.lock);
+}
+
+unsigned int SX1262_sendFrame(const struct iovec* iov, int iovcnt) {
+    // Teile zusammenfügen, der Frame wird wie beim Modul als zusammenhängende Bytefolge übertragen
+    uint8_t buf[4096];
+    unsigned int len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (len + iov[i].iov_len > sizeof(buf)) {
+            fprintf(stderr, "SX1262_sendFrame - Error: Frame too long.\n");
+            return 0;
+        }
+        memcpy(buf + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+
+    radio_send(buf, len);
+    return len;
+}
+
+SX1262_Frame* SX1262_frameGet() {
+    // ggf. blockieren bis ein Frame zurückgegeben wurde
+    while (vclock_sem_wait(&rxPool.free) == -1 && errno == EINTR)
+        ;
+
+    pthread_mutex_lock(&rxPool.mutex);
+    SX1262_Frame* frame = rxPool.stack[--rxPool.top];
+    pthread_mutex_unlock(&rxPool.mutex);
+
+    frame->len = 0;
+    return frame;
+}
+
+void SX1262_frameRelease(SX1262_Frame* frame) {
+    // Frame zurück auf den Stapel legen
+    pthread_mutex_lock(&rxPool.mutex);
+    rxPool.stack[rxPool.top++] = frame;
+    pthread_mutex_unlock(&rxPool.mutex);
+
+    vclock_sem_post(&rxPool.free);
+}
+
+unsigned int SX1262_recvFrame(SX1262_Frame* frame, unsigned int len, unsigned int timeout) {
+    // Timeout festlegen
+    struct timespec deadline;
+    SX1262_deadline(&deadline, timeout);
+
+    return SX1262_recvFrameUntil(frame, len, &deadline);
+}
+
+unsigned int SX1262_recvFrameUntil(SX1262_Frame* frame, unsigned int len, const struct timespec* deadline) {
+    // Frame zu klein (Nachricht größer als die max. Paketgröße des Moduls)
+    if (frame->len + len > SX1262_RXFRAME_SIZE)
+        return 0;
+
+    // len Bytes direkt aus dem Ringpuffer an den Frame anhängen
+    unsigned int n = SX1262_recvUntil(frame->bytes + frame->len, len, deadline);
+    frame->len += n;
+
+    return n;
+}
@@ -0,0 +1,649 @@
+// Simulierter Funkkanal für mehrere Knoten mit SX1262Sim/SX1262.c
+//
+// Jeder Knoten ist ein eigener Prozess (MAC- und Routing-Schicht halten ihren Zustand in statischen Variablen)
+// und verbindet sich über einen Unix-Socket mit airsim. airsim entscheidet für jedes ausgesendete Paket, welche
+// Knoten es empfangen:
+// 	- Reichweite: RSSI der Verbindung Sender -> Empfänger mindestens gleich der Empfindlichkeit
+// 	- Kanal und Modus: Empfänger während des gesamten Pakets im Übertragungsmodus auf demselben Kanal
+// 	- Halbduplex: Empfänger sendet während des Pakets nicht selbst
+// 	- Kollision: kein anderes hörbares Paket auf dem Kanal überlappt, außer das eigene Paket ist um mindestens
+// 	  die Capture-Schwelle stärker
+// Das Paket wird um die Ausbreitungsverzögerung der Verbindung verschoben zugestellt.
+// Das Ambient Noise eines Knotens ist der stärkste RSSI der gerade hörbaren Aussendungen, sonst das Grundrauschen.
+//
+// Verbindungen werden aus einer CSV-Datei mit Zeilen "Sender,Empfänger,RSSI[,Verzögerung in us]" gelesen und sind
+// gerichtet. Ohne Datei sind alle Knoten mit dem Standard-RSSI verbunden.
+//
+// Mit VCLOCK=sim laufen airsim und alle Knoten mit virtueller Uhr (siehe vclock.h und sim.h): airsim wartet, bis
+// alle Knoten untätig sind, und springt dann zum nächsten Zeitpunkt, an dem ein Knoten aufwacht oder ein Paket
+// ausgewertet wird. Die Simulation läuft so schnell wie möglich und bei gleichem VCLOCK_SEED reproduzierbar.
+// Mit -n beginnt die Zeit erst, wenn sich so viele Knoten angemeldet haben.
+//
+// Build:
+// 	gcc -O2 -funsigned-char -o Debug/airsim SX1262Sim/airsim.c
+// Die Knoten müssen mit -funsigned-char gebaut werden (siehe SX1262Sim/SX1262.c): MAC- und Routing-Schicht vergleichen
+// uint8_t-Kontrollflags mit char-Literalen wie '\xC4'. Auf dem Pi (ARM) ist char vorzeichenlos, auf x86 vorzeichenbehaftet,
+// dort wäre '\xC4' negativ und jeder Frame würde als "Kontrollflag C4 unbekannt" verworfen.
+// Usage:
+// 	Debug/airsim [-s socket] [-l links.csv] [-r rssi] [-d delayUs] [-e sensitivity] [-f noiseFloor] [-c captureDb] [-n nodes] [-v]
+// 	SX1262SIM_SOCKET=/tmp/sx1262sim.sock SX1262SIM_NODE=1 Debug/STRP_ALOHA_SIM 1 ...
+// 	VCLOCK=sim Debug/airsim -n 3 & VCLOCK=sim VCLOCK_SEED=1 SX1262SIM_NODE=1 Debug/STRP_ALOHA_SIM 1 ...
+// Mit Strg+C werden die Zähler der Knoten ausgegeben.
+
+#define _GNU_SOURCE
+#include <errno.h>          // errno
+#include <poll.h>           // ppoll
+#include <signal.h>         // sigaction
+#include <stdint.h>         // uint8_t, int8_t, uint64_t
+#include <stdio.h>          // printf, fopen, fgets
+#include <stdlib.h>         // atoi, exit
+#include <string.h>         // memcpy, strerror
+#include <sys/socket.h>     // socket, bind, listen, accept
+#include <sys/un.h>         // sockaddr_un
+#include <unistd.h>         // close, unlink, getopt
+
+#include "sim.h"
+
+#define MAX_NODES 256
+#define MAX_CLIENTS 64
+#define MAX_TX 4096
+#define MAX_OUT (4 * MAX_CLIENTS)
+
+// Pakete werden erst nach ihrem Ende zuzüglich dieser Zeit ausgewertet, damit überlappende Pakete sicher bekannt sind
+// (mit virtueller Uhr sind beim Auswerten alle früheren Aussendungen bekannt)
+#define RESOLVE_GUARD 1000000ULL
+
+// Aufbewahrungsdauer ausgewerteter Pakete für Kollisionen mit späteren Paketen (länger als die längste Sendedauer)
+#define KEEP_NS 10000000000ULL
+
+#define NO_LINK -128
+
+// Zähler eines Knotens
+typedef struct NodeStats {
+    unsigned long sent;             // ausgesendete Pakete
+    unsigned long received;         // zugestellte Pakete
+    unsigned long collisions;       // durch Kollisionen verlorene Pakete
+    unsigned long halfDuplex;       // verlorene Pakete, weil der Knoten selbst gesendet hat
+    unsigned long missed;           // verlorene Pakete wegen Tiefschlaf, Konfiguration oder anderem Kanal
+    unsigned long noiseRequests;    // Abfragen des Ambient Noise
+} NodeStats;
+
+// Verbundener Knoten
+typedef struct Client {
+    int fd;                         // Verbindung, -1 -> frei
+    int node;                       // Adresse, -1 vor SIM_HELLO
+    unsigned int channel;           // Kanal in MHz
+    int mode;                       // Modus (SX1262_Transmission = 0)
+    unsigned int prevChannel;       // Kanal vor dem letzten Wechsel
+    int prevMode;                   // Modus vor dem letzten Wechsel
+    uint64_t changedAt;             // Zeitpunkt des letzten Wechsels
+    uint32_t sent;                  // Anzahl geschickter Nachrichten (virtuelle Uhr)
+    uint32_t acked;                 // Anzahl vom Knoten gelesener Nachrichten laut SIM_IDLE
+    int idle;                       // Knoten hat seit der letzten Nachricht SIM_IDLE gemeldet
+    uint64_t next;                  // nächster Zeitpunkt des Knotens laut SIM_IDLE (0 -> keiner)
+} Client;
+
+// Antwort auf eine Abfrage des Ambient Noise, wird mit virtueller Uhr beim nächsten Zeitschritt geschickt
+typedef struct Reply {
+    Client* client;                 // Empfänger
+    int8_t noise;                   // Ambient Noise in dBm
+} Reply;
+
+// Ausgesendetes Paket
+typedef struct Transmission {
+    uint8_t src;                    // Sender
+    unsigned int channel;           // Kanal in MHz
+    uint64_t start, end;            // Beginn und Ende beim Sender
+    int resolved;                   // Empfänger bereits bestimmt
+    uint8_t missed[MAX_NODES / 8];  // Empfänger, die während des Pakets Kanal oder Modus gewechselt haben
+    unsigned int len;               // Anzahl Bytes
+    uint8_t bytes[256];             // Bytes des Pakets
+} Transmission;
+
+// Verbindungen: RSSI in dBm (NO_LINK -> keine Verbindung) und Ausbreitungsverzögerung in ns
+static int8_t linkRSSI[MAX_NODES][MAX_NODES];
+static uint64_t linkDelay[MAX_NODES][MAX_NODES];
+
+static Client clients[MAX_CLIENTS];
+static NodeStats stats[MAX_NODES];
+static int seen[MAX_NODES];
+
+static Transmission txs[MAX_TX];
+static unsigned int numTx;
+
+static Reply outbox[MAX_OUT];
+static unsigned int numOut;
+
+// Parameter
+static int sensitivity = -120;
+static int noiseFloor = -110;
+static int capture = 6;
+static int verbose = 0;
+static int minNodes = 1;
+
+// virtuelle Uhr
+static int simClock = 0;
+static uint64_t simTime = 0;
+static int simStarted = 0;
+static uint64_t resolveGuard = RESOLVE_GUARD;
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int sig) {
+    stop = 1;
+}
+
+// aktuelle Zeit, mit virtueller Uhr die Zeit des letzten Zeitschritts
+static uint64_t currentTime() {
+    return simClock ? simTime : sim_now();
+}
+
+// Nachricht an einen Knoten schicken und zählen
+static int sendTo(Client* c, uint8_t type, const void* head, uint16_t headLen, const void* body, uint16_t bodyLen) {
+    c->sent++;
+    return sim_write(c->fd, type, head, headLen, body, bodyLen);
+}
+
+static Client* clientOf(int node) {
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd >= 0 && clients[i].node == node)
+            return &clients[i];
+    return NULL;
+}
+
+// Paket g am Empfänger r hörbar
+static int audible(const Transmission* g, int r) {
+    return g->src != r && linkRSSI[g->src][r] != NO_LINK && linkRSSI[g->src][r] >= sensitivity;
+}
+
+// Zeitraum eines Pakets am Empfänger r
+static uint64_t startAt(const Transmission* t, int r) { return t->start + linkDelay[t->src][r]; }
+static uint64_t endAt(const Transmission* t, int r) { return t->end + linkDelay[t->src][r]; }
+
+static void resolve(Transmission* f) {
+    f->resolved = 1;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Client* c = &clients[i];
+        if (c->fd < 0 || c->node < 0 || !audible(f, c->node))
+            continue;
+        int r = c->node;
+        int rssi = linkRSSI[f->src][r];
+
+        // Zustand des Empfängers bei Ende des Pakets (ein späterer Wechsel ist noch nicht ausgewertet)
+        int after = c->changedAt > endAt(f, r);
+        int mode = after ? c->prevMode : c->mode;
+        unsigned int channel = after ? c->prevChannel : c->channel;
+
+        // Empfänger schläft, wird konfiguriert oder hört einen anderen Kanal
+        if (mode != 0 || channel != f->channel || (f->missed[r / 8] & 1 << r % 8)) {
+            stats[r].missed++;
+            continue;
+        }
+
+        // überlappende Pakete am Empfänger
+        int lost = 0;
+        for (unsigned int j = 0; j < numTx && !lost; j++) {
+            Transmission* g = &txs[j];
+            if (g == f || g->channel != f->channel)
+                continue;
+
+            // Halbduplex: eigene Aussendung während des Pakets
+            if (g->src == r) {
+                if (g->start < endAt(f, r) && startAt(f, r) < g->end) {
+                    stats[r].halfDuplex++;
+                    lost = 1;
+                }
+                continue;
+            }
+
+            // Kollision, außer das Paket ist um die Capture-Schwelle stärker
+            if (audible(g, r) && startAt(g, r) < endAt(f, r) && startAt(f, r) < endAt(g, r)
+                    && rssi < linkRSSI[g->src][r] + capture) {
+                stats[r].collisions++;
+                lost = 1;
+            }
+        }
+        if (lost) {
+            if (verbose)
+                printf("%u -> %d: lost (%u bytes)\n", f->src, r, f->len);
+            continue;
+        }
+
+        // Ende des Empfangs, RSSI und Bytes zustellen
+        uint8_t head[9];
+        uint64_t end = endAt(f, r);
+        memcpy(head, &end, 8);
+        head[8] = (uint8_t)(int8_t)rssi;
+        if (sendTo(c, SIM_RX, head, sizeof(head), f->bytes, f->len) == 0)
+            stats[r].received++;
+
+        if (verbose)
+            printf("%u -> %d: %u bytes, %d dBm\n", f->src, r, f->len, rssi);
+    }
+}
+
+// Zeitpunkt der Auswertung eines Pakets (spätestes Ende bei einem Empfänger)
+static uint64_t resolveAt(const Transmission* t) {
+    uint64_t maxDelay = 0;
+    for (int r = 0; r < MAX_NODES; r++)
+        if (seen[r] && linkDelay[t->src][r] > maxDelay)
+            maxDelay = linkDelay[t->src][r];
+    return t->end + maxDelay + resolveGuard;
+}
+
+// Reihenfolge der Auswertung: Zeitpunkt, Beginn, Sender (unabhängig von der Reihenfolge der Nachrichten)
+static int before(const Transmission* a, uint64_t atA, const Transmission* b, uint64_t atB) {
+    if (atA != atB)
+        return atA < atB;
+    if (a->start != b->start)
+        return a->start < b->start;
+    return a->src < b->src;
+}
+
+// fällige Pakete auswerten, alte entfernen, Zeitpunkt der nächsten Auswertung zurückgeben (0 -> keine)
+static uint64_t process(uint64_t now) {
+    while (1) {
+        Transmission* first = NULL;
+        uint64_t firstAt = 0;
+        for (unsigned int i = 0; i < numTx; i++) {
+            Transmission* t = &txs[i];
+            uint64_t at = resolveAt(t);
+            if (!t->resolved && at <= now && (first == NULL || before(t, at, first, firstAt))) {
+                first = t;
+                firstAt = at;
+            }
+        }
+        if (first == NULL)
+            break;
+        resolve(first);
+    }
+
+    uint64_t next = 0;
+    for (unsigned int i = 0; i < numTx; i++) {
+        uint64_t at = resolveAt(&txs[i]);
+        if (!txs[i].resolved && (next == 0 || at < next))
+            next = at;
+    }
+
+    // ausgewertete Pakete nach der Aufbewahrungsdauer entfernen
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < numTx; i++)
+        if (!txs[i].resolved || txs[i].end + KEEP_NS > now)
+            txs[n++] = txs[i];
+    numTx = n;
+
+    return next;
+}
+
+// Kanal- oder Moduswechsel: der Knoten verpasst gerade laufende Pakete
+static void changeState(Client* c, unsigned int channel, int mode, uint64_t now) {
+    for (unsigned int i = 0; i < numTx; i++) {
+        Transmission* t = &txs[i];
+        if (!t->resolved && startAt(t, c->node) <= now && now < endAt(t, c->node))
+            t->missed[c->node / 8] |= 1 << c->node % 8;
+    }
+
+    c->prevChannel = c->channel;
+    c->prevMode = c->mode;
+    c->changedAt = now;
+    c->channel = channel;
+    c->mode = mode;
+}
+
+static void handle(Client* c, uint8_t type, const uint8_t* buf, int len) {
+    uint64_t now = currentTime();
+
+    // mit virtueller Uhr ist der Knoten bis zum nächsten SIM_IDLE beschäftigt
+    if (type != SIM_IDLE)
+        c->idle = 0;
+
+    switch (type) {
+        case SIM_HELLO: {
+            if (len < 13)
+                break;
+
+            // Knoten und Hub müssen dieselbe Uhr verwenden
+            if (buf[12] != simClock) {
+                fprintf(stderr, "airsim: node %d %s VCLOCK=sim, disconnected.\n", buf[0], buf[12] ? "uses" : "does not use");
+                close(c->fd);
+                c->fd = -1;
+                break;
+            }
+
+            c->node = buf[0];
+            c->channel = buf[1] | buf[2] << 8;
+            c->mode = buf[3];
+            c->changedAt = 0;
+            seen[c->node] = 1;
+
+            // die virtuelle Zeit beginnt beim spätesten Knoten
+            uint64_t t;
+            memcpy(&t, buf + 4, 8);
+            if (simClock && t > simTime)
+                simTime = t;
+
+            printf("Node %d connected (%u MHz).\n", c->node, c->channel);
+            break;
+        }
+
+        case SIM_IDLE:
+            if (len < 12)
+                break;
+            memcpy(&c->next, buf, 8);
+            memcpy(&c->acked, buf + 8, 4);
+            c->idle = 1;
+            break;
+
+        case SIM_TX: {
+            if (c->node < 0 || len < 16 || len - 16 > 256)
+                break;
+            if (numTx == MAX_TX) {
+                fprintf(stderr, "airsim: too many transmissions in flight, packet from %d dropped.\n", c->node);
+                break;
+            }
+
+            Transmission* t = &txs[numTx++];
+            uint64_t duration;
+            memcpy(&t->start, buf, 8);
+            memcpy(&duration, buf + 8, 8);
+            t->end = t->start + duration;
+            t->src = c->node;
+            t->channel = c->channel;
+            t->resolved = 0;
+            memset(t->missed, 0, sizeof(t->missed));
+            t->len = len - 16;
+            memcpy(t->bytes, buf + 16, t->len);
+            stats[c->node].sent++;
+            break;
+        }
+
+        case SIM_CHANNEL:
+            if (c->node < 0 || len < 2)
+                break;
+            changeState(c, buf[0] | buf[1] << 8, c->mode, now);
+            break;
+
+        case SIM_MODE:
+            if (c->node < 0 || len < 1)
+                break;
+            changeState(c, c->channel, buf[0], now);
+            break;
+
+        case SIM_NOISE_REQ: {
+            if (c->node < 0)
+                break;
+
+            // stärkste gerade hörbare Aussendung auf dem Kanal des Knotens
+            int noise = noiseFloor;
+            for (unsigned int i = 0; i < numTx; i++) {
+                Transmission* t = &txs[i];
+                if (t->channel == c->channel && audible(t, c->node) && startAt(t, c->node) <= now
+                        && now < endAt(t, c->node) && linkRSSI[t->src][c->node] > noise)
+                    noise = linkRSSI[t->src][c->node];
+            }
+
+            // mit virtueller Uhr erst beim nächsten Zeitschritt antworten
+            int8_t value = noise;
+            if (!simClock)
+                sendTo(c, SIM_NOISE, &value, 1, NULL, 0);
+            else if (numOut < MAX_OUT)
+                outbox[numOut++] = (Reply){ c, value };
+            else
+                fprintf(stderr, "airsim: too many noise requests, request from %d dropped.\n", c->node);
+            stats[c->node].noiseRequests++;
+            break;
+        }
+    }
+}
+
+// virtuelle Uhr: alle angemeldeten Knoten sind untätig und haben alle Nachrichten gelesen
+static int settled() {
+    int nodes = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Client* c = &clients[i];
+        if (c->fd < 0 || c->node < 0)
+            continue;
+        if (!c->idle || c->acked != c->sent)
+            return 0;
+        nodes++;
+    }
+
+    // die Zeit beginnt, wenn sich genug Knoten angemeldet haben
+    return nodes > 0 && (simStarted || nodes >= minNodes);
+}
+
+// virtuelle Uhr: zum nächsten Zeitpunkt springen, Pakete zustellen und den Knoten die neue Zeit schicken
+static void step() {
+    static int warned = 0;
+    simStarted = 1;
+
+    // offene Antworten werden ohne Zeitsprung zugestellt
+    if (numOut == 0) {
+        uint64_t next = process(simTime);
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            Client* c = &clients[i];
+            if (c->fd >= 0 && c->node >= 0 && c->next != 0 && (next == 0 || c->next < next))
+                next = c->next;
+        }
+
+        if (next == 0) {
+            if (!warned)
+                fprintf(stderr, "airsim: all nodes are blocked without a timeout.\n");
+            warned = 1;
+            return;
+        }
+
+        if (next > simTime)
+            simTime = next;
+        process(simTime);
+    }
+
+    for (unsigned int i = 0; i < numOut; i++)
+        if (outbox[i].client->fd >= 0)
+            sendTo(outbox[i].client, SIM_NOISE, &outbox[i].noise, 1, NULL, 0);
+    numOut = 0;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Client* c = &clients[i];
+        if (c->fd >= 0 && c->node >= 0) {
+            c->idle = 0;
+            sendTo(c, SIM_ADVANCE, &simTime, sizeof(simTime), NULL, 0);
+        }
+    }
+}
+
+static void readLinks(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Error %d opening %s: %s\n", errno, path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // ohne Eintrag keine Verbindung
+    for (int i = 0; i < MAX_NODES; i++)
+        for (int j = 0; j < MAX_NODES; j++)
+            linkRSSI[i][j] = NO_LINK;
+
+    char line[128];
+    unsigned int lineNo = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineNo++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        int src, dst, rssi;
+        double delayUs;
+        int n = sscanf(line, "%d,%d,%d,%lf", &src, &dst, &rssi, &delayUs);
+        if (n < 3 || src < 0 || src >= MAX_NODES || dst < 0 || dst >= MAX_NODES || rssi <= NO_LINK || rssi > 0) {
+            fprintf(stderr, "airsim - Error: %s:%u: expected \"src,dst,rssi[,delayUs]\".\n", path, lineNo);
+            exit(EXIT_FAILURE);
+        }
+
+        linkRSSI[src][dst] = rssi;
+        if (n == 4)
+            linkDelay[src][dst] = delayUs * 1000;
+    }
+
+    fclose(f);
+}
+
+static void printStats() {
+    printf("\n%4s %8s %8s %10s %10s %8s %8s\n", "node", "sent", "recv", "collisions", "halfDuplex", "missed", "noise");
+    for (int i = 0; i < MAX_NODES; i++)
+        if (seen[i])
+            printf("%4d %8lu %8lu %10lu %10lu %8lu %8lu\n", i, stats[i].sent, stats[i].received,
+                stats[i].collisions, stats[i].halfDuplex, stats[i].missed, stats[i].noiseRequests);
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = SIM_SOCKET;
+    const char* links = NULL;
+    int defaultRSSI = -60;
+    double defaultDelayUs = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:l:r:d:e:f:c:n:v")) != -1) {
+        switch (opt) {
+            case 's': path = optarg; break;
+            case 'l': links = optarg; break;
+            case 'r': defaultRSSI = atoi(optarg); break;
+            case 'd': defaultDelayUs = atof(optarg); break;
+            case 'e': sensitivity = atoi(optarg); break;
+            case 'f': noiseFloor = atoi(optarg); break;
+            case 'c': capture = atoi(optarg); break;
+            case 'n': minNodes = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-s socket] [-l links.csv] [-r rssi] [-d delayUs] [-e sensitivity] [-f noiseFloor] [-c captureDb] [-n nodes] [-v]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // Standardverbindungen, werden mit einer CSV-Datei ersetzt
+    for (int i = 0; i < MAX_NODES; i++)
+        for (int j = 0; j < MAX_NODES; j++) {
+            linkRSSI[i][j] = defaultRSSI;
+            linkDelay[i][j] = defaultDelayUs * 1000;
+        }
+    if (links != NULL)
+        readLinks(links);
+
+    // virtuelle Uhr wie bei den Knoten über VCLOCK
+    const char* clock = getenv("VCLOCK");
+    simClock = clock != NULL && strcmp(clock, "sim") == 0;
+    if (simClock)
+        resolveGuard = 0;
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+
+    // Unix-Socket anlegen
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (lfd < 0 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, MAX_CLIENTS) != 0) {
+        fprintf(stderr, "Error %d creating %s: %s\n", errno, path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Strg+C unterbricht ppoll, danach werden die Zähler ausgegeben
+    struct sigaction sa = { .sa_handler = onSignal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("airsim listening on %s%s\n", path, simClock ? " (virtual clock)" : "");
+
+    uint8_t buf[SIM_MAX_LEN];
+    while (!stop) {
+        fflush(stdout);
+
+        // virtuelle Uhr: Zeitschritt, sobald alle Knoten untätig sind, sonst bis zur nächsten Auswertung warten
+        uint64_t next = 0;
+        if (simClock) {
+            if (settled())
+                step();
+        }
+        else
+            next = process(sim_now());
+
+        struct timespec ts, *timeout = NULL;
+        if (next != 0) {
+            uint64_t now = sim_now();
+            uint64_t wait = next > now ? next - now : 0;
+            ts.tv_sec = wait / 1000000000;
+            ts.tv_nsec = wait % 1000000000;
+            timeout = &ts;
+        }
+
+        struct pollfd fds[MAX_CLIENTS + 1];
+        int idx[MAX_CLIENTS + 1];
+        nfds_t n = 0;
+        fds[n].fd = lfd;
+        fds[n].events = POLLIN;
+        idx[n++] = -1;
+        for (int i = 0; i < MAX_CLIENTS; i++)
+            if (clients[i].fd >= 0) {
+                fds[n].fd = clients[i].fd;
+                fds[n].events = POLLIN;
+                idx[n++] = i;
+            }
+
+        if (ppoll(fds, n, timeout, NULL) < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error %d from ppoll: %s\n", errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        for (nfds_t i = 0; i < n; i++) {
+            if (fds[i].revents == 0)
+                continue;
+
+            // neuer Knoten
+            if (idx[i] < 0) {
+                int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+                if (fd < 0)
+                    continue;
+                int slot = 0;
+                while (slot < MAX_CLIENTS && clients[slot].fd >= 0)
+                    slot++;
+                if (slot == MAX_CLIENTS) {
+                    fprintf(stderr, "airsim: too many nodes.\n");
+                    close(fd);
+                    continue;
+                }
+                clients[slot] = (Client){ .fd = fd, .node = -1 };
+                continue;
+            }
+
+            Client* c = &clients[idx[i]];
+            uint8_t type;
+            int len = sim_read(c->fd, &type, buf);
+            if (len < 0) {
+                if (c->node >= 0)
+                    printf("Node %d disconnected.\n", c->node);
+                close(c->fd);
+                c->fd = -1;
+                continue;
+            }
+
+            // eine neue Verbindung ersetzt eine alte mit derselben Adresse
+            if (type == SIM_HELLO && len >= 1) {
+                Client* old = clientOf(buf[0]);
+                if (old != NULL && old != c) {
+                    close(old->fd);
+                    old->fd = -1;
+                }
+            }
+
+            handle(c, type, buf, len);
+        }
+    }
+
+    printStats();
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef SX1262SIM_H
+#define SX1262SIM_H
+
+#include <errno.h>          // errno
+#include <stdint.h>         // uint8_t, uint16_t, uint64_t
+#include <string.h>         // memcpy
+#include <sys/uio.h>        // writev
+#include <time.h>           // clock_gettime
+#include <unistd.h>         // read
+
+// Protokoll zwischen den simulierten Funkmodulen (SX1262Sim/SX1262.c) und dem Funkkanal (airsim)
+// Jede Nachricht besteht aus Typ (1 Byte), Länge der Nutzdaten (2 Bytes) und den Nutzdaten.
+// Alle Zeitpunkte sind Nanosekunden auf CLOCK_MONOTONIC, Knoten und Hub laufen also auf demselben Rechner.
+// Mit virtueller Uhr (VCLOCK=sim, siehe vclock.h) gibt der Hub die Zeit vor: er wartet, bis alle Knoten
+// SIM_IDLE gemeldet und alle Nachrichten gelesen haben, und schickt dann die Nachrichten des nächsten
+// Zeitpunkts gefolgt von SIM_ADVANCE.
+#define SIM_HELLO       1   // Knoten -> Hub: Adresse (1), Kanal in MHz (2), Modus (1), Uhrzeit (8), virtuelle Uhr (1)
+#define SIM_TX          2   // Knoten -> Hub: Beginn (8), Sendedauer (8), Bytes des Pakets
+#define SIM_RX          3   // Hub -> Knoten: Ende des Empfangs (8), RSSI in dBm (1), Bytes des Pakets
+#define SIM_CHANNEL     4   // Knoten -> Hub: Kanal in MHz (2)
+#define SIM_MODE        5   // Knoten -> Hub: Modus (1)
+#define SIM_NOISE_REQ   6   // Knoten -> Hub: Abfrage des Ambient Noise
+#define SIM_NOISE       7   // Hub -> Knoten: Ambient Noise in dBm (1)
+#define SIM_IDLE        8   // Knoten -> Hub (virtuelle Uhr): nächster Zeitpunkt (8, 0 -> keiner), Anzahl gelesener Nachrichten (4)
+#define SIM_ADVANCE     9   // Hub -> Knoten (virtuelle Uhr): neue Uhrzeit (8), schließt die Nachrichten eines Zeitschritts ab
+
+#define SIM_HEADER_LEN  3
+#define SIM_MAX_LEN     (17 + 256)
+
+// Standardpfad des Unix-Sockets des Hubs
+#define SIM_SOCKET      "/tmp/sx1262sim.sock"
+
+// Zusätzliche Bytes pro Paket auf dem Funkkanal (Präambel, Sync-Wort, Header, CRC)
+#define SIM_AIR_OVERHEAD 12
+
+static inline uint64_t sim_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Nachricht aus Kopf (head) und Nutzdaten (body) in einem Aufruf schreiben, -1 bei Fehler
+static inline int sim_write(int fd, uint8_t type, const void* head, uint16_t headLen, const void* body, uint16_t bodyLen) {
+    uint16_t len = headLen + bodyLen;
+    uint8_t hdr[SIM_HEADER_LEN] = { type, len & 0xFF, len >> 8 };
+    struct iovec v[] = { { hdr, sizeof(hdr) }, { (void*)head, headLen }, { (void*)body, bodyLen } };
+
+    size_t total = sizeof(hdr) + len;
+    int i = 0;
+    while (total > 0) {
+        ssize_t n = writev(fd, &v[i], 3 - i);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        total -= n;
+
+        // vollständig geschriebene Einträge überspringen, den angefangenen kürzen
+        while (i < 3 && (size_t)n >= v[i].iov_len) {
+            n -= v[i].iov_len;
+            i++;
+        }
+        if (i < 3) {
+            v[i].iov_base = (uint8_t*)v[i].iov_base + n;
+            v[i].iov_len -= n;
+        }
+    }
+
+    return 0;
+}
+
+// genau len Bytes lesen, -1 bei Fehler oder geschlossener Verbindung
+static inline int sim_readAll(int fd, void* buf, size_t len) {
+    uint8_t* p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == 0)
+            return -1;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+// Nachricht lesen, gibt die Länge der Nutzdaten zurück, -1 bei Fehler oder zu langer Nachricht
+static inline int sim_read(int fd, uint8_t* type, uint8_t* buf) {
+    uint8_t hdr[SIM_HEADER_LEN];
+    if (sim_readAll(fd, hdr, sizeof(hdr)) != 0)
+        return -1;
+
+    uint16_t len = hdr[1] | hdr[2] << 8;
+    if (len > SIM_MAX_LEN || sim_readAll(fd, buf, len) != 0)
+        return -1;
+
+    *type = hdr[0];
+    return len;
+}
+
+#endif // SX1262SIM_H
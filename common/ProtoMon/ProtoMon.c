@@ -13,6 +13,7 @@
 
 #include "../common.h"
 #include "../util.h"
+#include "../vclock.h"
 
 #define HTTP_PORT 8000
 #define SINK_MAX_BUFFER 1024
@@ -63,8 +64,10 @@ static int (*Original_Routing_recvMsg)(Routing_Header *h, uint8_t *data) = NULL;
 static int (*Original_Routing_timedRecvMsg)(Routing_Header *h, uint8_t *data, unsigned int timeout) = NULL;
 
 static int (*Original_MAC_sendMsg)(MAC *, unsigned char dest, unsigned char *data, unsigned int len) = NULL;
+static int (*Original_MAC_sendPrio)(MAC *, unsigned char dest, unsigned char *data, unsigned int len, MAC_Prio prio) = NULL;
 static int (*Original_MAC_recvMsg)(MAC *, unsigned char *data) = NULL;
 static int (*Original_MAC_timedRecvMsg)(MAC *, unsigned char *data, unsigned int timeout) = NULL;
+static int (*Original_MAC_recvBorrow)(MAC *, MAC_Buffer *buf, unsigned int timeout) = NULL;
 
 static const char *outputDir = "results";
 static const char *networkCSV = "network.csv";
@@ -84,8 +87,10 @@ static int ProtoMon_Routing_recvMsg(Routing_Header *h, uint8_t *data);
 static int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigned int timeout);
 
 static int ProtoMon_MAC_send(MAC *h, unsigned char dest, unsigned char *data, unsigned int len);
+static int ProtoMon_MAC_sendPrio(MAC *h, unsigned char dest, unsigned char *data, unsigned int len, MAC_Prio prio);
 static int ProtoMon_MAC_recv(MAC *h, unsigned char *data);
 static int ProtoMon_MAC_timedRecv(MAC *h, unsigned char *data, unsigned int timeout);
+static int ProtoMon_MAC_recvBorrow(MAC *h, MAC_Buffer *buf, unsigned int timeout);
 
 static int killProcessOnPort(int port);
 static void installDependencies();
@@ -286,7 +291,7 @@ static int sendMetricsToSink(uint8_t *buffer, unsigned int len, CTRL ctrl)
 static uint16_t getMetricsBuffer(uint8_t *buffer, uint16_t bufferSize, CTRL ctrl)
 {
     uint16_t usedSize = 0;
-    time_t timestamp = time(NULL);
+    time_t timestamp = vclock_time(NULL);
 
     if (ctrl == CTRL_MAC)
     {
@@ -303,7 +308,7 @@ static uint16_t getMetricsBuffer(uint8_t *buffer, uint16_t bufferSize, CTRL ctrl
             {
                 uint8_t row[150];
                 memset(row, 0, sizeof(row));
-                uint8_t extra[50];
+                uint8_t extra[96];
                 memset(extra, 0, sizeof(extra));
                 int extraLen = MAC_getMetricsData(extra, i);
                 int rowLen = snprintf(row + strlen(row), sizeof(row) - strlen(row), "%ld,%d,%d,%d,%d,%ld", (unsigned long)timestamp, config.self, i, data.sent, data.recv, data.recv > 0 ? (unsigned long)(data.latency / data.recv) : 0);
@@ -403,7 +408,7 @@ static uint16_t getMetricsBuffer(uint8_t *buffer, uint16_t bufferSize, CTRL ctrl
 
 static void *sendMetrics_func(void *args)
 {
-    sleep(config.initialSendWaitS);
+    vclock_sleep(config.initialSendWaitS);
     uint16_t bufferSize = MAX_PAYLOAD_SIZE - (Routing_getHeaderSize() + MAC_getHeaderSize() + getMACOverhead());
     while (1)
     {
@@ -451,7 +456,7 @@ static void *sendMetrics_func(void *args)
             if (delayNext > 0)
             {
                 delayNext--;
-                sleep(config.sendDelayS);
+                vclock_sleep(config.sendDelayS);
                 totalDelayS += config.sendDelayS;
             }
             uint8_t buffer[bufferSize];
@@ -486,7 +491,7 @@ static void *sendMetrics_func(void *args)
             if (delayNext > 0)
             {
                 delayNext--;
-                sleep(config.sendDelayS);
+                vclock_sleep(config.sendDelayS);
                 totalDelayS += config.sendDelayS;
             }
             uint8_t buffer[bufferSize];
@@ -508,7 +513,7 @@ static void *sendMetrics_func(void *args)
             // free(buffer);
         }
 
-        sleep(config.sendIntervalS - totalDelayS);
+        vclock_sleep(config.sendIntervalS - totalDelayS);
     }
     return NULL;
 }
@@ -585,7 +590,9 @@ void ProtoMon_init(ProtoMon_Config c)
 
         Original_MAC_recvMsg = MAC_recv;
         Original_MAC_timedRecvMsg = MAC_timedRecv;
+        Original_MAC_recvBorrow = MAC_recvBorrow;
         Original_MAC_sendMsg = MAC_send;
+        Original_MAC_sendPrio = MAC_sendPrio;
 
         // Must always override Routing layer functions to capture monitoring data
         Routing_sendMsg = &ProtoMon_Routing_sendMsg;
@@ -594,12 +601,14 @@ void ProtoMon_init(ProtoMon_Config c)
 
         // Must always override MAC functions to increment numHops
         MAC_send = &ProtoMon_MAC_send;
+        MAC_sendPrio = &ProtoMon_MAC_sendPrio;
         MAC_recv = &ProtoMon_MAC_recv;
         MAC_timedRecv = &ProtoMon_MAC_timedRecv;
+        MAC_recvBorrow = &ProtoMon_MAC_recvBorrow;
     }
     if (c.monitoredLevels & PROTOMON_LEVEL_ROUTING)
     {
-        if (!Original_Routing_sendMsg || !Original_Routing_recvMsg || !Original_Routing_timedRecvMsg || !Original_MAC_sendMsg || !Original_MAC_recvMsg || !Original_MAC_timedRecvMsg)
+        if (!Original_Routing_sendMsg || !Original_Routing_recvMsg || !Original_Routing_timedRecvMsg || !Original_MAC_sendMsg || !Original_MAC_sendPrio || !Original_MAC_recvMsg || !Original_MAC_timedRecvMsg || !Original_MAC_recvBorrow)
         {
             logMessage(ERROR, "Functions of routing & MAC layers must be registered.\n");
             fflush(stdout);
@@ -612,7 +621,7 @@ void ProtoMon_init(ProtoMon_Config c)
 
     if (c.monitoredLevels & PROTOMON_LEVEL_MAC)
     {
-        if (!Original_MAC_sendMsg || !Original_MAC_recvMsg || !Original_MAC_timedRecvMsg)
+        if (!Original_MAC_sendMsg || !Original_MAC_sendPrio || !Original_MAC_recvMsg || !Original_MAC_timedRecvMsg || !Original_MAC_recvBorrow)
         {
             logMessage(ERROR, "Functions of MAC layer must be registered.\n");
             fflush(stdout);
@@ -633,7 +642,7 @@ void ProtoMon_init(ProtoMon_Config c)
     // Set default values for config
     setConfigDefaults(&c);
     config = c;
-    startTime = lastVizTime = lastMacWrite = lastNeighborWrite = lastRoutingWrite = time(NULL);
+    startTime = lastVizTime = lastMacWrite = lastNeighborWrite = lastRoutingWrite = vclock_time(NULL);
     initMetrics();
 
     // Enable visualization only when monitoring is enabled
@@ -642,7 +651,7 @@ void ProtoMon_init(ProtoMon_Config c)
         if (config.self != ADDR_SINK)
         {
             pthread_t sendMetricsT;
-            if (pthread_create(&sendMetricsT, NULL, sendMetrics_func, NULL) != 0)
+            if (vclock_thread_create(&sendMetricsT, NULL, sendMetrics_func, NULL) != 0)
             {
                 logMessage(ERROR, "Failed to create sendMetrics thread\n");
                 exit(EXIT_FAILURE);
@@ -677,20 +686,20 @@ static uint16_t getMACOverhead()
 
 static void resetMacMetrics()
 {
-    sem_wait(&macMetrics.mutex);
+    vclock_sem_wait(&macMetrics.mutex);
     macMetrics.minAddr = MAX_ACTIVE_NODES - 1;
     macMetrics.maxAddr = 0;
     memset(macMetrics.data, 0, sizeof(macMetrics.data));
-    sem_post(&macMetrics.mutex);
+    vclock_sem_post(&macMetrics.mutex);
 }
 
 static void resetRoutingMetrics()
 {
-    sem_wait(&routingMetrics.mutex);
+    vclock_sem_wait(&routingMetrics.mutex);
     routingMetrics.minAddr = MAX_ACTIVE_NODES - 1;
     routingMetrics.maxAddr = 0;
     memset(routingMetrics.data, 0, sizeof(routingMetrics.data));
-    sem_post(&routingMetrics.mutex);
+    vclock_sem_post(&routingMetrics.mutex);
 }
 
 static void initMetrics()
@@ -704,7 +713,7 @@ static void initMetrics()
 
 int ProtoMon_Routing_sendMsg(t_addr dest, uint8_t *data, unsigned int len)
 {
-    time_t start = time(NULL);
+    time_t start = vclock_time(NULL);
     uint16_t overhead = getRoutingOverhead();
     if (overhead == 0)
     {
@@ -713,7 +722,7 @@ int ProtoMon_Routing_sendMsg(t_addr dest, uint8_t *data, unsigned int len)
     uint8_t extData[MAX_PAYLOAD_SIZE];
     int extLen = len + overhead + 1; // null terminator
     const uint8_t numHops = 0;
-    const time_t ts = time(NULL);
+    const time_t ts = vclock_time(NULL);
     uint8_t *temp = extData;
 
     // Set control flag: MSG
@@ -757,7 +766,7 @@ int ProtoMon_Routing_sendMsg(t_addr dest, uint8_t *data, unsigned int len)
     int ret = Original_Routing_sendMsg(dest, extData, extLen);
 
     // Capture metrics
-    sem_wait(&routingMetrics.mutex);
+    vclock_sem_wait(&routingMetrics.mutex);
     if (dest > routingMetrics.maxAddr)
     {
         routingMetrics.maxAddr = dest;
@@ -767,14 +776,14 @@ int ProtoMon_Routing_sendMsg(t_addr dest, uint8_t *data, unsigned int len)
         routingMetrics.minAddr = dest;
     }
     routingMetrics.data[dest].sent++;
-    sem_post(&routingMetrics.mutex);
+    vclock_sem_post(&routingMetrics.mutex);
 
     return ret;
 }
 
 int ProtoMon_Routing_recvMsg(Routing_Header *header, uint8_t *data)
 {
-    time_t start = time(NULL);
+    time_t start = vclock_time(NULL);
     uint16_t overhead = getRoutingOverhead();
     uint8_t extendedData[MAX_PAYLOAD_SIZE];
     if (extendedData == NULL)
@@ -820,7 +829,7 @@ int ProtoMon_Routing_recvMsg(Routing_Header *header, uint8_t *data)
         // data[dataLen] = '\0';
         temp += dataLen + 1;
 
-        uint16_t latency = (time(NULL) - ts);
+        uint16_t latency = (vclock_time(NULL) - ts);
         if (config.loglevel >= DEBUG)
         {
             logMessage(DEBUG, "ProtoMon : %s hops: %d delay: %d s\n", data, numHops, latency);
@@ -828,7 +837,7 @@ int ProtoMon_Routing_recvMsg(Routing_Header *header, uint8_t *data)
         }
 
         // Capture metrics
-        sem_wait(&routingMetrics.mutex);
+        vclock_sem_wait(&routingMetrics.mutex);
         if (src > routingMetrics.maxAddr)
         {
             routingMetrics.maxAddr = src;
@@ -842,7 +851,7 @@ int ProtoMon_Routing_recvMsg(Routing_Header *header, uint8_t *data)
         routingMetrics.data[src].numHops = numHops;
         memset(routingMetrics.data[src].path, 0, sizeof(routingMetrics.data[src].path));
         strcpy(routingMetrics.data[src].path, lastPath);
-        sem_post(&routingMetrics.mutex);
+        vclock_sem_post(&routingMetrics.mutex);
 
         return len - overhead;
     }
@@ -866,7 +875,7 @@ int ProtoMon_Routing_recvMsg(Routing_Header *header, uint8_t *data)
 
             // Write corresponding sink metrics to file
             time_t *lastWrite = (ctrl == CTRL_MAC) ? &lastMacWrite : (ctrl == CTRL_TAB ? &lastNeighborWrite : &lastRoutingWrite);
-            if (time(NULL) - *lastWrite > config.sendIntervalS)
+            if (vclock_time(NULL) - *lastWrite > config.sendIntervalS)
             {
                 uint16_t bufferSize = SINK_MAX_BUFFER;
                 uint8_t buffer[bufferSize];
@@ -885,23 +894,23 @@ int ProtoMon_Routing_recvMsg(Routing_Header *header, uint8_t *data)
                         fflush(stdout);
                         exit(EXIT_FAILURE);
                     }
-                    *lastWrite = time(NULL);
+                    *lastWrite = vclock_time(NULL);
                 }
             }
         }
     }
     uint16_t delay = lastVizTime == 0 ? config.initialSendWaitS : 0;
-    if (config.self == ADDR_SINK && time(NULL) - lastVizTime > (delay + config.vizIntervalS))
+    if (config.self == ADDR_SINK && vclock_time(NULL) - lastVizTime > (delay + config.vizIntervalS))
     {
         generateGraph();
-        lastVizTime = time(NULL);
+        lastVizTime = vclock_time(NULL);
     }
     return 0;
 }
 
 int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigned int timeout)
 {
-    time_t start = time(NULL);
+    time_t start = vclock_time(NULL);
     uint16_t overhead = getRoutingOverhead();
     uint8_t extendedData[MAX_PAYLOAD_SIZE];
     if (extendedData == NULL)
@@ -948,7 +957,7 @@ int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigne
         uint16_t dataLen = strlen(data);
         temp += dataLen + 1;
 
-        uint16_t latency = (time(NULL) - ts);
+        uint16_t latency = (vclock_time(NULL) - ts);
         if (config.loglevel >= DEBUG)
         {
             logMessage(DEBUG, "ProtoMon : %s hops: %d delay: %d s\n", data, numHops, latency);
@@ -956,7 +965,7 @@ int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigne
         }
 
         // Capture metrics
-        sem_wait(&routingMetrics.mutex);
+        vclock_sem_wait(&routingMetrics.mutex);
         if (src > routingMetrics.maxAddr)
         {
             routingMetrics.maxAddr = src;
@@ -970,7 +979,7 @@ int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigne
         routingMetrics.data[src].numHops = numHops;
         memset(routingMetrics.data[src].path, 0, sizeof(routingMetrics.data[src].path));
         strcpy(routingMetrics.data[src].path, lastPath);
-        sem_post(&routingMetrics.mutex);
+        vclock_sem_post(&routingMetrics.mutex);
 
         return extLen;
     }
@@ -994,7 +1003,7 @@ int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigne
 
             // Write corresponding sink metrics to file
             time_t *lastWrite = (ctrl == CTRL_MAC) ? &lastMacWrite : (ctrl == CTRL_TAB ? &lastNeighborWrite : &lastRoutingWrite);
-            if (time(NULL) - *lastWrite > config.sendIntervalS)
+            if (vclock_time(NULL) - *lastWrite > config.sendIntervalS)
             {
                 uint16_t bufferSize = SINK_MAX_BUFFER;
                 uint8_t buffer[bufferSize];
@@ -1013,28 +1022,43 @@ int ProtoMon_Routing_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigne
                         fflush(stdout);
                         exit(EXIT_FAILURE);
                     }
-                    *lastWrite = time(NULL);
+                    *lastWrite = vclock_time(NULL);
                 }
             }
         }
     }
 
     uint16_t delay = lastVizTime == 0 ? config.initialSendWaitS : 0;
-    if (config.self == ADDR_SINK && time(NULL) - lastVizTime > (delay + config.vizIntervalS))
+    if (config.self == ADDR_SINK && vclock_time(NULL) - lastVizTime > (delay + config.vizIntervalS))
     {
         generateGraph();
-        lastVizTime = time(NULL);
+        lastVizTime = vclock_time(NULL);
     }
 
     return 0;
 }
 
 int ProtoMon_MAC_send(MAC *h, unsigned char dest, unsigned char *data, unsigned int len)
+{
+    // Metric reports (own and forwarded) go to the telemetry class so they do not delay data
+    MAC_Prio prio = MAC_PRIO_DATA;
+    if (dest != ADDR_BROADCAST && len > Routing_getHeaderSize() && Routing_isDataPkt(*data))
+    {
+        uint8_t ctrl = *(data + Routing_getHeaderSize());
+        if (ctrl == CTRL_MAC || ctrl == CTRL_ROU || ctrl == CTRL_TAB)
+        {
+            prio = MAC_PRIO_TELEMETRY;
+        }
+    }
+    return ProtoMon_MAC_sendPrio(h, dest, data, len, prio);
+}
+
+int ProtoMon_MAC_sendPrio(MAC *h, unsigned char dest, unsigned char *data, unsigned int len, MAC_Prio prio)
 {
     uint16_t overhead = getMACOverhead();
     if (overhead == 0)
     {
-        return Original_MAC_sendMsg(h, dest, data, len);
+        return Original_MAC_sendPrio(h, dest, data, len, prio);
     }
 
     uint8_t extData[MAX_PAYLOAD_SIZE];
@@ -1063,12 +1087,12 @@ int ProtoMon_MAC_send(MAC *h, unsigned char dest, unsigned char *data, unsigned
         if (isMsg) // Monitor only msg packets
         {
             // Add hop timestamp
-            time_t ts = time(NULL);
+            time_t ts = vclock_time(NULL);
             memcpy(temp, &ts, sizeof(ts));
             temp += sizeof(ts);
 
             // Capture metrics
-            sem_wait(&macMetrics.mutex);
+            vclock_sem_wait(&macMetrics.mutex);
 
             if (dest > macMetrics.maxAddr)
             {
@@ -1080,14 +1104,14 @@ int ProtoMon_MAC_send(MAC *h, unsigned char dest, unsigned char *data, unsigned
             }
             macMetrics.data[dest].sent++;
 
-            sem_post(&macMetrics.mutex);
+            vclock_sem_post(&macMetrics.mutex);
         }
     }
 
     memcpy(temp, data, len);
 
-    time_t start = time(NULL);
-    int ret = Original_MAC_sendMsg(h, dest, extData, overhead + len);
+    time_t start = vclock_time(NULL);
+    int ret = Original_MAC_sendPrio(h, dest, extData, overhead + len, prio);
 
     if (config.loglevel >= TRACE)
     {
@@ -1103,17 +1127,14 @@ int ProtoMon_MAC_send(MAC *h, unsigned char dest, unsigned char *data, unsigned
     return ret;
 }
 
-int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
+// Strip the hop timestamp of a received MAC payload, update hop count and path in place.
+// room is the size of extendedData, the path is only appended if it fits.
+// Returns the length of the payload that starts at *payload.
+static uint16_t unwrapMACPayload(MAC *h, uint8_t *extendedData, int len, unsigned int room, uint8_t **payload, const char *func)
 {
-    time_t start = time(NULL);
     uint16_t overhead = getMACOverhead();
-    uint8_t extendedData[MAX_PAYLOAD_SIZE];
-    int len = Original_MAC_recvMsg(h, extendedData);
-    if (len <= 0)
-    {
-        return len;
-    }
     uint8_t *temp = extendedData;
+
     uint8_t dest = h->recvH.dst_addr;
     if (dest == ADDR_BROADCAST)
     {
@@ -1123,7 +1144,7 @@ int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
 
     if (config.loglevel >= TRACE)
     {
-        logMessage(TRACE, "%s-IN: ", __func__);
+        logMessage(TRACE, "%s-IN: ", func);
         for (int i = 0; i < overhead; i++)
             printf("%02X ", extendedData[i]);
         printf("|");
@@ -1156,14 +1177,14 @@ int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
             time_t mac_ts;
             memcpy(&mac_ts, temp, sizeof(mac_ts));
             temp += sizeof(mac_ts);
-            uint16_t latency = (time(NULL) - mac_ts);
+            uint16_t latency = (vclock_time(NULL) - mac_ts);
             if (config.loglevel >= DEBUG)
             {
                 logMessage(DEBUG, "ProtoMon : hop src:%02d latency:%ds\n", src, latency);
             }
 
             // Capture metrics
-            sem_wait(&macMetrics.mutex);
+            vclock_sem_wait(&macMetrics.mutex);
             if (src > macMetrics.maxAddr)
             {
                 macMetrics.maxAddr = src;
@@ -1174,12 +1195,11 @@ int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
             }
             macMetrics.data[src].recv++;
             macMetrics.data[src].latency += latency;
-            sem_post(&macMetrics.mutex);
+            vclock_sem_post(&macMetrics.mutex);
         }
 
         if (routingOverhead && isMsg) // Monitor only msg packets
         {
-
             uint8_t *p = temp;
             uint8_t numHops;
 
@@ -1194,25 +1214,30 @@ int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
             // Append self to path
             uint8_t path[5];
             uint8_t pathLen = sprintf(path, "%c%02d", pathSeparator, config.self);
-            strcpy(extendedData + len, path);
-            p = extendedData + len + pathLen;
-            uint8_t totalPathLen = ((numHops + 1) * 3) - 1;
-            p -= totalPathLen;
-            if (config.loglevel >= DEBUG)
+            if (len + pathLen + 1 <= room)
+            {
+                strcpy(extendedData + len, path);
+                p = extendedData + len + pathLen;
+                uint8_t totalPathLen = ((numHops + 1) * 3) - 1;
+                p -= totalPathLen;
+                if (config.loglevel >= DEBUG)
+                {
+                    logMessage(DEBUG, "Path:%s\n", p);
+                }
+                memset(lastPath, 0, sizeof(lastPath));
+                memcpy(lastPath, p, totalPathLen);
+                extLen += pathLen;
+            }
+            else
             {
-                logMessage(DEBUG, "Path:%s\n", p);
+                logMessage(ERROR, "%s: no room to append path\n", func);
             }
-            memset(lastPath, 0, sizeof(lastPath));
-            memcpy(lastPath, p, totalPathLen);
-            extLen += pathLen;
         }
     }
 
-    memcpy(data, temp, extLen);
-
     if (config.loglevel >= TRACE)
     {
-        logMessage(TRACE, "%s-OUT: ", __func__);
+        logMessage(TRACE, "%s-OUT: ", func);
         for (int i = 0; i < overhead; i++)
             printf("%02X ", extendedData[i]);
         printf("|");
@@ -1221,127 +1246,54 @@ int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
         printf("\n");
     }
 
+    *payload = temp;
     return extLen;
 }
 
-int ProtoMon_MAC_timedRecv(MAC *h, unsigned char *data, unsigned int timeout)
+int ProtoMon_MAC_recv(MAC *h, unsigned char *data)
 {
-    time_t start = time(NULL);
-    uint16_t overhead = getMACOverhead();
     uint8_t extendedData[MAX_PAYLOAD_SIZE];
-    int len = Original_MAC_timedRecvMsg(h, extendedData, timeout);
+    int len = Original_MAC_recvMsg(h, extendedData);
     if (len <= 0)
     {
         return len;
     }
-    uint8_t *temp = extendedData;
 
-    uint8_t dest = h->recvH.dst_addr;
-    if (dest == ADDR_BROADCAST)
-    {
-        overhead = 0;
-    }
-    uint16_t extLen = len - overhead;
-
-    if (config.loglevel >= TRACE)
-    {
-        logMessage(TRACE, "%s-IN: ", __func__);
-        for (int i = 0; i < overhead; i++)
-            printf("%02X ", extendedData[i]);
-        printf("|");
-        for (int i = overhead; i < len; i++)
-            printf(" %02X", extendedData[i]);
-        printf("\n");
-    }
+    uint8_t *payload;
+    uint16_t extLen = unwrapMACPayload(h, extendedData, len, sizeof(extendedData), &payload, __func__);
+    memcpy(data, payload, extLen);
+    return extLen;
+}
 
-    if (dest != ADDR_BROADCAST) // exclude broadcasts - beacons
+int ProtoMon_MAC_timedRecv(MAC *h, unsigned char *data, unsigned int timeout)
+{
+    uint8_t extendedData[MAX_PAYLOAD_SIZE];
+    int len = Original_MAC_timedRecvMsg(h, extendedData, timeout);
+    if (len <= 0)
     {
-        // Check if msg packet
-        uint8_t ctrl;
-        uint8_t isMsg;
-        uint16_t routingOverhead = getRoutingOverhead();
-        if (routingOverhead)
-        {
-            ctrl = *(temp + overhead + Routing_getHeaderSize());
-            isMsg = (ctrl == CTRL_MSG);
-        }
-        else
-        {
-            ctrl = *(temp + overhead);
-            isMsg = Routing_isDataPkt(ctrl);
-        }
-        if (overhead && isMsg)
-        // if (overhead)
-        {
-            uint8_t src = h->recvH.src_addr;
-            // extract hop timestamp
-            time_t mac_ts;
-            memcpy(&mac_ts, temp, sizeof(mac_ts));
-            temp += sizeof(mac_ts);
-            uint16_t latency = (time(NULL) - mac_ts);
-            if (config.loglevel >= DEBUG)
-            {
-                printf("ProtoMon : hop src:%02d latency:%ds\n", src, latency);
-            }
-
-            // Capture metrics
-            sem_wait(&macMetrics.mutex);
-            if (src > macMetrics.maxAddr)
-            {
-                macMetrics.maxAddr = src;
-            }
-            if (src < macMetrics.minAddr)
-            {
-                macMetrics.minAddr = src;
-            }
-            macMetrics.data[src].recv++;
-            macMetrics.data[src].latency += latency;
-            sem_post(&macMetrics.mutex);
-        }
-
-        if (routingOverhead && isMsg) // Monitor only msg packets
-        {
-            uint8_t *p = temp;
-            uint8_t numHops;
-
-            // Increment hopCount
-            p += Routing_getHeaderSize();
-            p += sizeof(ctrl);
-            memcpy(&numHops, p, sizeof(numHops));
-            numHops++;
-            memcpy(p, &numHops, sizeof(numHops));
-            p += sizeof(numHops);
-
-            // Append self to path
-            uint8_t path[5];
-            uint8_t pathLen = sprintf(path, "%c%02d", pathSeparator, config.self);
-            strcpy(extendedData + len, path);
-            p = extendedData + len + pathLen;
-            uint8_t totalPathLen = ((numHops + 1) * 3) - 1;
-            p -= totalPathLen;
-            if (config.loglevel >= DEBUG)
-            {
-                logMessage(DEBUG, "Path:%s\n", p);
-            }
-            memset(lastPath, 0, sizeof(lastPath));
-            memcpy(lastPath, p, totalPathLen);
-            extLen += pathLen;
-        }
+        return len;
     }
 
-    memcpy(data, temp, extLen);
+    uint8_t *payload;
+    uint16_t extLen = unwrapMACPayload(h, extendedData, len, sizeof(extendedData), &payload, __func__);
+    memcpy(data, payload, extLen);
+    return extLen;
+}
 
-    if (config.loglevel >= TRACE)
+// Unwrap the lent frame in place, only the data pointer is moved past the hop timestamp
+int ProtoMon_MAC_recvBorrow(MAC *h, MAC_Buffer *buf, unsigned int timeout)
+{
+    int len = Original_MAC_recvBorrow(h, buf, timeout);
+    if (len <= 0)
     {
-        logMessage(TRACE, "%s-OUT: ", __func__);
-        for (int i = 0; i < overhead; i++)
-            printf("%02X ", extendedData[i]);
-        printf("|");
-        for (int i = overhead; i < extLen + overhead; i++)
-            printf(" %02X", extendedData[i]);
-        printf("\n");
+        return len;
     }
 
+    uint8_t *payload;
+    uint16_t extLen = unwrapMACPayload(h, buf->data, len, buf->room, &payload, __func__);
+    buf->room -= payload - buf->data;
+    buf->data = payload;
+    buf->len = extLen;
     return extLen;
 }
 
@@ -19,6 +19,31 @@ typedef struct MAC MAC;
  */
 extern int (*MAC_send)(MAC *h, unsigned char dest, unsigned char *data, unsigned int len);
 
+/**
+ * @brief Traffic classes of the MAC send queue, in order of priority.
+ */
+typedef enum MAC_Prio
+{
+    MAC_PRIO_CONTROL,   // Routing beacons and other control traffic
+    MAC_PRIO_DATA,      // Local and forwarded data, used by MAC_send
+    MAC_PRIO_TELEMETRY, // ProtoMon metric reports
+    MAC_PRIO_CLASSES    // Number of classes
+} MAC_Prio;
+
+/**
+ * @brief Send data to the MAC layer in the given traffic class.
+ *
+ * Each class has its own send queue, the MAC layer serves them strictly by priority or weighted (see MAC config).
+ *
+ * @param h Pointer to a MAC config.
+ * @param dest Destination address (node identifier).
+ * @param data Pointer to the data to send.
+ * @param len Length of the data.
+ * @param prio Traffic class of the data.
+ * @return 1 on success, 0 on error.
+ */
+extern int (*MAC_sendPrio)(MAC *h, unsigned char dest, unsigned char *data, unsigned int len, MAC_Prio prio);
+
 /**
  * @brief Receive data from the MAC layer. Blocking operation.
  *
@@ -38,6 +63,38 @@ extern int (*MAC_recv)(MAC *h, unsigned char *data);
  */
 extern int (*MAC_timedRecv)(MAC *h, unsigned char *data, unsigned int timeout);
 
+/**
+ * @brief Received message lent by the MAC layer instead of copied, see MAC_recvBorrow.
+ */
+typedef struct MAC_Buffer
+{
+    uint8_t *data;     // Payload, may be parsed and modified in place
+    unsigned int len;  // Length of the payload
+    unsigned int room; // Bytes writable from data on (>= len), to append in place
+    void *frame;       // Frame owned by the MAC layer, opaque to the caller
+} MAC_Buffer;
+
+/**
+ * @brief Borrow the next received message from the MAC layer with a timeout. No copy is made.
+ *
+ * recvH and RSSI of the MAC config are set like with MAC_timedRecv.
+ * The buffer must be handed back with MAC_release, the MAC layer only has a fixed number of them.
+ *
+ * @param h Pointer to the MAC config.
+ * @param buf Set to the lent message.
+ * @param timeout Maximum wait time (same unit as MAC_timedRecv).
+ * @return Length of received message on success, 0 on timeout.
+ */
+extern int (*MAC_recvBorrow)(MAC *h, MAC_Buffer *buf, unsigned int timeout);
+
+/**
+ * @brief Hand a buffer from MAC_recvBorrow back to the MAC layer.
+ *
+ * @param h Pointer to the MAC config.
+ * @param buf Buffer to release, its data pointer may have been moved by the caller.
+ */
+extern void (*MAC_release)(MAC *h, MAC_Buffer *buf);
+
 
 /**
  * @returns size of the MAC header
@@ -10,6 +10,8 @@
 #include <string.h>	   // memcpy, strerror
 #include <unistd.h>	   // sleep
 
+#include "../vclock.h"
+
 int (*Routing_sendMsg)(uint8_t dest, uint8_t *data, unsigned int len) = Dijkstras_send;
 int (*Routing_recvMsg)(Routing_Header *h, uint8_t *data) = Dijkstras_recv;
 int (*Routing_timedRecvMsg)(Routing_Header *h, uint8_t *data, unsigned int timeout) = Dijkstras_timedrecv;
@@ -95,15 +97,15 @@ static bool recvMsgQ_tryenqueue(recvMessage msg)
 	if (sem_trywait(&recvMsgQ.free) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
 	recvMsgQ.msg[recvMsgQ.end] = msg;
 	recvMsgQ.end = (recvMsgQ.end + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.full);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.full);
 
 	return true;
 }
@@ -111,16 +113,16 @@ static bool recvMsgQ_tryenqueue(recvMessage msg)
 static recvMessage recvMsgQ_dequeue()
 {
 	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&recvMsgQ.full);
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.full);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	recvMessage msg = recvMsgQ.msg[recvMsgQ.begin];
 	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.free);
 
 	// Nachricht zurückgeben
 	return msg;
@@ -132,15 +134,15 @@ static bool recvMsgQ_trydequeue(recvMessage *msg)
 	if (sem_trywait(&recvMsgQ.full) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	*msg = recvMsgQ.msg[recvMsgQ.begin];
 	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.free);
 
 	return true;
 }
@@ -148,18 +150,18 @@ static bool recvMsgQ_trydequeue(recvMessage *msg)
 static bool recvMsgQ_timeddequeue(recvMessage *msg, struct timespec *ts)
 {
 	// ggf. blockieren und Semaphoren dekrementieren, bei Timeout 0 zurückgeben
-	if (sem_timedwait(&recvMsgQ.full, ts) == -1)
+	if (vclock_sem_timedwait(&recvMsgQ.full, ts) == -1)
 		return false;
 
-	sem_wait(&recvMsgQ.mutex);
+	vclock_sem_wait(&recvMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	*msg = recvMsgQ.msg[recvMsgQ.begin];
 	recvMsgQ.begin = (recvMsgQ.begin + 1) % recvMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&recvMsgQ.mutex);
-	sem_post(&recvMsgQ.free);
+	vclock_sem_post(&recvMsgQ.mutex);
+	vclock_sem_post(&recvMsgQ.free);
 
 	return true;
 }
@@ -179,16 +181,16 @@ static void sendMsgQ_init()
 static void sendMsgQ_enqueue(sendMessage msg)
 {
 	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.free);
-	sem_wait(&sendMsgQ.mutex);
+	vclock_sem_wait(&sendMsgQ.free);
+	vclock_sem_wait(&sendMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
 	sendMsgQ.msg[sendMsgQ.end] = msg;
 	sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.full);
+	vclock_sem_post(&sendMsgQ.mutex);
+	vclock_sem_post(&sendMsgQ.full);
 }
 
 static bool sendMsgQ_tryenqueue(sendMessage msg)
@@ -197,15 +199,15 @@ static bool sendMsgQ_tryenqueue(sendMessage msg)
 	if (sem_trywait(&sendMsgQ.free) == -1)
 		return false;
 
-	sem_wait(&sendMsgQ.mutex);
+	vclock_sem_wait(&sendMsgQ.mutex);
 
 	// Nachricht in der Warteschlange speichern und Endzeiger inkrementieren
 	sendMsgQ.msg[sendMsgQ.end] = msg;
 	sendMsgQ.end = (sendMsgQ.end + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.full);
+	vclock_sem_post(&sendMsgQ.mutex);
+	vclock_sem_post(&sendMsgQ.full);
 
 	return true;
 }
@@ -213,16 +215,16 @@ static bool sendMsgQ_tryenqueue(sendMessage msg)
 static sendMessage sendMsgQ_dequeue()
 {
 	// ggf. blockieren und Semaphoren dekrementieren
-	sem_wait(&sendMsgQ.full);
-	sem_wait(&sendMsgQ.mutex);
+	vclock_sem_wait(&sendMsgQ.full);
+	vclock_sem_wait(&sendMsgQ.mutex);
 
 	// Nachricht aus der Warteschlange speichern und Startzeiger inkrementieren
 	sendMessage msg = sendMsgQ.msg[sendMsgQ.begin];
 	sendMsgQ.begin = (sendMsgQ.begin + 1) % sendMsgQ_size;
 
 	// Semaphoren inkrementieren
-	sem_post(&sendMsgQ.mutex);
-	sem_post(&sendMsgQ.free);
+	vclock_sem_post(&sendMsgQ.mutex);
+	vclock_sem_post(&sendMsgQ.free);
 
 	// Nachricht zurückgeben
 	return msg;
@@ -542,7 +544,7 @@ static void *sendT_func(void *args)
 			*msg.success = success;
 
 			// Signalisieren, dass die Operation abgeschlossen wurde
-			sem_post(msg.fin);
+			vclock_sem_post(msg.fin);
 		}
 	}
 }
@@ -569,13 +571,13 @@ void Dijkstras_init(Routing *r, unsigned char addr)
 	sendMsgQ_init();
 
 	// Threads starten, bei Fehler Programm beenden
-	if (pthread_create(&recvT, NULL, &recvT_func, r) != 0)
+	if (vclock_thread_create(&recvT, NULL, &recvT_func, r) != 0)
 	{
 		fprintf(stderr, "Error %d creating recvThread: %s\n", errno, strerror(errno));
 		exit(EXIT_FAILURE);
 	}
 
-	if (pthread_create(&sendT, NULL, &sendT_func, r) != 0)
+	if (vclock_thread_create(&sendT, NULL, &sendT_func, r) != 0)
 	{
 		fprintf(stderr, "Error %d creating sendThread: %s\n", errno, strerror(errno));
 		exit(EXIT_FAILURE);
@@ -628,7 +630,7 @@ int Dj_timedrecv(Routing *r, unsigned char *msg_buffer, unsigned int timeout)
 {
 	// Timeout festlegen
 	struct timespec ts;
-	clock_gettime(CLOCK_REALTIME, &ts);
+	vclock_gettime(CLOCK_REALTIME, &ts);
 	ts.tv_sec += timeout;
 
 	// Nachricht aus Warteschlange entfernen, bei Timeout 0 zurückgeben
@@ -684,7 +686,7 @@ int Dj_send(Routing *r, unsigned char addr, unsigned char *data, unsigned int le
 	sendMsgQ_enqueue(msg);
 
 	// Blockieren bis die Operation abgeschlossen wurde
-	sem_wait(&fin);
+	vclock_sem_wait(&fin);
 
 	// Speicher der Semaphore freigeben
 	sem_destroy(&fin);
@@ -10,6 +10,7 @@
 
 #include "SMRP.h"
 #include "../util.h"
+#include "../vclock.h"
 
 #define PACKETQ_SIZE 16
 #define MIN_RSSI -128
@@ -149,7 +150,7 @@ int SMRP_init(SMRP_Config c)
     pthread_t sendBeaconT;
     setConfigDefaults(&c);
     config = c;
-    srand(config.self * time(NULL));
+    srand(vclock_seed(config.self));
     ALOHA_init(config.mac, config.self);
     if (config.loglevel > INFO)
     {
@@ -160,7 +161,7 @@ int SMRP_init(SMRP_Config c)
     initNeighbours();
     initMetrics();
 
-    if (pthread_create(&recvT, NULL, recvPackets_func, NULL) != 0)
+    if (vclock_thread_create(&recvT, NULL, recvPackets_func, NULL) != 0)
     {
         logMessage(ERROR, "Failed to create Routing receive thread\n");
         fflush(stdout);
@@ -171,7 +172,7 @@ int SMRP_init(SMRP_Config c)
 
     // if (config.self != ADDR_SINK)
     {
-        if (pthread_create(&sendT, NULL, sendPackets_func, NULL) != 0)
+        if (vclock_thread_create(&sendT, NULL, sendPackets_func, NULL) != 0)
         {
             logMessage(ERROR, "Failed to create Routing send thread\n");
             fflush(stdout);
@@ -179,7 +180,7 @@ int SMRP_init(SMRP_Config c)
         }
     }
     // Beacon thread
-    if (pthread_create(&sendBeaconT, NULL, sendBeaconPeriodic, NULL) != 0)
+    if (vclock_thread_create(&sendBeaconT, NULL, sendBeaconPeriodic, NULL) != 0)
     {
         logMessage(ERROR, "Failed to create sendBeaconPeriodic thread");
         fflush(stdout);
@@ -244,7 +245,7 @@ int SMRP_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigned int timeou
 
     DataPacket msg;
     struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+    vclock_gettime(CLOCK_REALTIME, &ts);
     ts.tv_sec += timeout;
 
     int result = recvQ_timed_dequeue(&msg, &ts);
@@ -276,7 +277,7 @@ int SMRP_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigned int timeou
 
 static uint8_t recvQ_timed_dequeue(DataPacket *msg, struct timespec *ts)
 {
-    if (sem_timedwait(&recvQ.full, ts) == -1)
+    if (vclock_sem_timedwait(&recvQ.full, ts) == -1)
     {
         if (errno == ETIMEDOUT)
         {
@@ -285,11 +286,11 @@ static uint8_t recvQ_timed_dequeue(DataPacket *msg, struct timespec *ts)
         return -1;
     }
 
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.mutex);
     *msg = recvQ.packet[recvQ.begin];
     recvQ.begin = (recvQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.free);
     return 1;
 }
 
@@ -298,11 +299,11 @@ static bool sendQ_tryenqueue(DataPacket msg)
     if (sem_trywait(&sendQ.free) == -1)
         return false;
 
-    sem_wait(&sendQ.mutex);
+    vclock_sem_wait(&sendQ.mutex);
     sendQ.packet[sendQ.end] = msg;
     sendQ.end = (sendQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.full);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.full);
 
     return true;
 }
@@ -312,11 +313,11 @@ static bool recvQ_tryenqueue(DataPacket msg)
     if (sem_trywait(&recvQ.free) == -1)
         return false;
 
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.mutex);
     recvQ.packet[recvQ.end] = msg;
     recvQ.end = (recvQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.full);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.full);
 
     return true;
 }
@@ -326,11 +327,11 @@ static bool sendQ_trydequeue(DataPacket *msg)
     if (sem_trywait(&sendQ.full) == -1)
         return false;
 
-    sem_wait(&sendQ.mutex);
+    vclock_sem_wait(&sendQ.mutex);
     *msg = sendQ.packet[sendQ.begin];
     sendQ.begin = (sendQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.free);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.free);
 
     return true;
 }
@@ -340,11 +341,11 @@ static bool recvQ_trydequeue(DataPacket *msg)
     if (sem_trywait(&recvQ.full) == -1)
         return false;
 
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.mutex);
     *msg = recvQ.packet[recvQ.begin];
     recvQ.begin = (recvQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.free);
 
     return true;
 }
@@ -369,51 +370,51 @@ static void recvQ_init()
 
 static void sendQ_enqueue(DataPacket msg)
 {
-    time_t start = time(NULL);
-    sem_wait(&sendQ.free);
-    sem_wait(&sendQ.mutex);
+    time_t start = vclock_time(NULL);
+    vclock_sem_wait(&sendQ.free);
+    vclock_sem_wait(&sendQ.mutex);
     sendQ.packet[sendQ.end] = msg;
     sendQ.end = (sendQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.full);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.full);
 }
 
 static DataPacket sendQ_dequeue()
 {
-    sem_wait(&sendQ.full);
-    sem_wait(&sendQ.mutex);
+    vclock_sem_wait(&sendQ.full);
+    vclock_sem_wait(&sendQ.mutex);
     DataPacket msg = sendQ.packet[sendQ.begin];
     sendQ.begin = (sendQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.free);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.free);
     return msg;
 }
 
 static void recvQ_enqueue(DataPacket msg)
 {
-    sem_wait(&recvQ.free);
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.free);
+    vclock_sem_wait(&recvQ.mutex);
     recvQ.packet[recvQ.end] = msg;
     recvQ.end = (recvQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.full);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.full);
 }
 
 static DataPacket recvMsgQ_dequeue()
 {
-    sem_wait(&recvQ.full);
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.full);
+    vclock_sem_wait(&recvQ.mutex);
     DataPacket msg = recvQ.packet[recvQ.begin];
     recvQ.begin = (recvQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.free);
     return msg;
 }
 
 static void *recvPackets_func(void *args)
 {
     unsigned int total[MAX_ACTIVE_NODES] = {0};
-    time_t start = time(NULL);
+    time_t start = vclock_time(NULL);
     time_t current;
     while (1)
     {
@@ -497,7 +498,7 @@ static void *recvPackets_func(void *args)
             }
         }
         free(pkt);
-        usleep((rand() % 100000) + 700000); // Sleep 100ms + 1s to avoid busy waiting
+        vclock_usleep((rand() % 100000) + 700000); // Sleep 100ms + 1s to avoid busy waiting
     }
     return NULL;
 }
@@ -576,7 +577,7 @@ static void *sendPackets_func(void *args)
         {
             continue;
         }
-        time_t start = time(NULL);
+        time_t start = vclock_time(NULL);
         uint8_t nextHop = Routing_getnextHop(msg.src, -1, msg.dest, config.maxTries);
         // nextHop = msg.dest;
         if (!MAC_send(config.mac, nextHop, pkt, pktSize))
@@ -587,7 +588,7 @@ static void *sendPackets_func(void *args)
         {
         }
         free(pkt);
-        usleep(1000000); // Sleep 1s
+        vclock_usleep(1000000); // Sleep 1s
     }
     return NULL;
 }
@@ -606,13 +607,13 @@ static void senseNeighbours()
             logMessage(DEBUG, "Sending beacons...\n");
         }
 
-        time_t start = time(NULL);
+        time_t start = vclock_time(NULL);
         do
         {
             sendBeacon();
             count++;
-            usleep(randInRange(800000, 1200000));
-        } while (time(NULL) - start < config.senseDurationS);
+            vclock_usleep(randInRange(800000, 1200000));
+        } while (vclock_time(NULL) - start < config.senseDurationS);
 
         if (config.loglevel >= DEBUG)
         {
@@ -652,7 +653,7 @@ static void senseNeighbours()
 
 static void updateActiveNodes(uint8_t addr, int8_t RSSI)
 {
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     NodeInfo *nodePtr = &neighbours.nodes[addr];
     uint8_t numActive;
     bool new = nodePtr->state == UNKNOWN;
@@ -687,8 +688,8 @@ static void updateActiveNodes(uint8_t addr, int8_t RSSI)
         nodePtr->link = OUTBOUND;
     }
     nodePtr->RSSI = RSSI;
-    nodePtr->lastSeen = time(NULL);
-    sem_post(&neighbours.mutex);
+    nodePtr->lastSeen = vclock_time(NULL);
+    vclock_sem_post(&neighbours.mutex);
     if (new)
     {
         if (config.loglevel >= DEBUG)
@@ -711,14 +712,14 @@ void initNeighbours()
     }
     neighbours.minAddr = MAX_ACTIVE_NODES - 1;
     neighbours.maxAddr = 0;
-    neighbours.lastCleanupTime = time(NULL);
+    neighbours.lastCleanupTime = vclock_time(NULL);
 }
 
 static void cleanupInactiveNodes()
 {
-    time_t currentTime = time(NULL);
+    time_t currentTime = vclock_time(NULL);
     bool parentInactive = false;
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     uint8_t numActive = neighbours.numActive;
     for (uint8_t i = neighbours.minAddr, inactive = 0; i <= neighbours.maxAddr && inactive < numActive; i++)
     {
@@ -733,8 +734,8 @@ static void cleanupInactiveNodes()
         }
     }
     numActive = neighbours.numActive;
-    neighbours.lastCleanupTime = time(NULL);
-    sem_post(&neighbours.mutex);
+    neighbours.lastCleanupTime = vclock_time(NULL);
+    vclock_sem_post(&neighbours.mutex);
 
     if (config.loglevel >= DEBUG)
     {
@@ -750,9 +751,9 @@ static void sendBeacon()
     {
         logMessage(DEBUG, "Sending beacon\n");
     }
-    if (!MAC_send(config.mac, ADDR_BROADCAST, (uint8_t *)&beacon, sizeof(Beacon)))
+    if (!MAC_sendPrio(config.mac, ADDR_BROADCAST, (uint8_t *)&beacon, sizeof(Beacon), MAC_PRIO_CONTROL))
     {
-        logMessage(INFO, "MAC_send failed %s:%d\n", __FILE__, __LINE__);
+        logMessage(INFO, "MAC_sendPrio failed %s:%d\n", __FILE__, __LINE__);
     }
     else
     {
@@ -762,15 +763,15 @@ static void sendBeacon()
 
 static void *sendBeaconPeriodic(void *args)
 {
-    sleep(config.beaconIntervalS);
+    vclock_sleep(config.beaconIntervalS);
     while (1)
     {
         sendBeacon();
-        if ((time(NULL) - neighbours.lastCleanupTime) > config.nodeTimeoutS)
+        if ((vclock_time(NULL) - neighbours.lastCleanupTime) > config.nodeTimeoutS)
         {
             cleanupInactiveNodes();
         }
-        sleep(config.beaconIntervalS);
+        vclock_sleep(config.beaconIntervalS);
     }
     return NULL;
 }
@@ -833,19 +834,19 @@ int Routing_getMetricsData(uint8_t *buffer, uint8_t addr)
 {
     const SMRP_Params data = metrics.data[addr];
     int rowlen = sprintf(buffer, "%d,%d", metrics.data[0].beaconsTx, data.beaconsRx);
-    sem_wait(&metrics.mutex);
+    vclock_sem_wait(&metrics.mutex);
     metrics.data[addr] = (SMRP_Params){0};
     metrics.data[0].beaconsTx = 0;
-    sem_post(&metrics.mutex);
+    vclock_sem_post(&metrics.mutex);
     return rowlen;
 }
 
 static void initMetrics()
 {
     sem_init(&metrics.mutex, 0, 1);
-    sem_wait(&metrics.mutex);
+    vclock_sem_wait(&metrics.mutex);
     memset(&metrics.data, 0, sizeof(metrics.data));
-    sem_post(&metrics.mutex);
+    vclock_sem_post(&metrics.mutex);
 }
 
 int Routing_getTopologyData(char *buffer, uint16_t size)
@@ -855,7 +856,7 @@ int Routing_getTopologyData(char *buffer, uint16_t size)
     uint8_t min = neighbours.minAddr;
     int offset = 0;
     uint8_t src = config.self;
-    time_t timestamp = time(NULL);
+    time_t timestamp = vclock_time(NULL);
     for (uint8_t addr = min; addr <= max; addr++)
     {
         NodeInfo node = activeNodes.nodes[addr];
@@ -10,11 +10,26 @@
 
 #include "STRP.h"
 #include "../util.h"
+#include "../vclock.h"
 
 #define PACKETQ_SIZE 32
+#define FWDQ_SIZE 16
 #define MIN_RSSI -128
 #define INITIAL_PARENT 0
 
+// Link estimation for the ETX strategy
+#define ETX_SCALE 100        // Fixed point of the advertised path ETX (100 = one transmission)
+#define ETX_INFINITE 0xFFFF  // No route to the sink
+#define ETX_ALPHA 0.125f     // Weight of a new sample in the delivery ratio averages
+#define ETX_MAX_GAP 16       // Beacon sequence gaps above this are counted as this many losses
+#define ETX_HYSTERESIS 50    // Path ETX improvement needed to switch to another parent (0.5 transmissions)
+
+// Rank of a node in the routing tree (RPL DODAG style), parents must have a lower rank
+#define HOPS_INFINITE 0xFF   // No route to the sink
+#define MAX_HOPS 16          // Longer routes count as none, which bounds counting to infinity
+#define RANK_INFINITE 0xFFFF
+#define RANK_HOP ETX_SCALE   // Rank increase per hop, the ETX strategy ranks by path ETX instead
+
 // Packet control flags
 #define CTRL_PKT '\x45' // STRP packet
 #define CTRL_BCN '\x47' // STRP beacon
@@ -24,6 +39,9 @@ typedef struct Beacon
     uint8_t ctrl;
     uint8_t parent;
     int8_t parentRSSI;
+    uint8_t seq;      // Beacon sequence number, gaps are lost beacons for the link estimate
+    uint16_t pathETX; // Cumulative ETX to the sink (ETX_SCALE), ETX_INFINITE without a route
+    uint8_t hops;     // Hop count to the sink, HOPS_INFINITE without a route
 } Beacon;
 
 typedef struct DataPacket
@@ -43,6 +61,20 @@ typedef struct PacketQueue
     sem_t mutex, full, free;
 } PacketQueue;
 
+typedef struct FwdPacket
+{
+    MAC_Buffer buf;   // Borrowed MAC frame, released once forwarded or dropped
+    uint8_t src;      // Source of the packet
+    uint64_t arrival; // vclock_now when STRP received the packet
+} FwdPacket;
+
+typedef struct FwdQueue
+{
+    unsigned int begin, end, count;
+    FwdPacket packet[FWDQ_SIZE];
+    sem_t mutex, full;
+} FwdQueue;
+
 typedef struct
 {
     uint8_t addr;
@@ -52,6 +84,12 @@ typedef struct
     uint8_t parent;
     Routing_NodeState state;
     int8_t parentRSSI;
+    uint16_t beaconsHeard; // Beacons received from the neighbour
+    uint8_t beaconSeq;     // Sequence number of the last one
+    float delivery;        // Beacon delivery ratio from the neighbour (EWMA)
+    float ackRatio;        // MAC_send success ratio to the neighbour (EWMA), < 0 before the first send
+    uint16_t pathETX;      // Path ETX to the sink advertised by the neighbour
+    uint8_t hops;          // Hop count to the sink advertised by the neighbour
 } NodeInfo;
 
 typedef struct
@@ -65,11 +103,26 @@ typedef struct
 } ActiveNodes;
 
 
+// Trickle beacon timer (RFC 6206)
+typedef struct Trickle
+{
+    sem_t mutex;
+    sem_t reset;       // Posted on an inconsistency to end the current interval
+    uint32_t interval; // Current interval I (ms)
+    uint8_t heard;     // Consistent beacons heard in the current interval (c)
+    uint32_t resets;   // Inconsistencies so far, a beacon that caused one is not consistent
+    time_t lastSent;   // Own beacons are never suppressed for longer than half the node timeout
+} Trickle;
+
 typedef struct STRP_Params
 {
     uint16_t parentChanges;
     uint16_t beaconsSent;
     uint16_t beaconsRecv;
+    uint16_t forwarded;    // Packets of this source forwarded to the parent
+    uint32_t fwdLatencyMs; // Sum of their forwarding latencies, including the wait in the forwarding queue
+    uint16_t fwdDropped;   // Packets dropped because the forwarding queue was full
+    uint8_t fwdQueueMax;   // Highest forwarding queue occupancy
 } STRP_Params;
 
 typedef struct Metrics
@@ -82,15 +135,21 @@ typedef struct Metrics
 static Metrics metrics;
 
 static PacketQueue sendQ, recvQ;
+static FwdQueue fwdQ;
+static Trickle trickle;
 static uint16_t sendSeq[MAX_ACTIVE_NODES] = {0};
 static uint16_t recvSeq[MAX_ACTIVE_NODES] = {0};
 static pthread_t recvT;
 static pthread_t sendT;
+static pthread_t fwdT;
 
 static const unsigned short headerSize = sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint16_t); // [ ctrl | dest | src | seqId[2] | len[2] ]
+static const unsigned short beaconSize = sizeof(uint8_t) + sizeof(uint8_t) + sizeof(int8_t) + sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint8_t); // [ ctrl | parent | parentRSSI | seq | pathETX[2] | hops ]
 static uint8_t parentAddr;
 static ActiveNodes neighbours;
 static uint8_t loopyParent;
+static uint8_t beaconSeq;
+static uint16_t rank = RANK_INFINITE; // Rank last advertised in a beacon
 static STRP_Config config;
 
 int (*Routing_sendMsg)(uint8_t dest, uint8_t *data, unsigned int len) = STRP_sendMsg;
@@ -105,11 +164,15 @@ static void recvQ_enqueue(DataPacket msg);
 static DataPacket recvMsgQ_dequeue();
 static void *recvPackets_func(void *args);
 static DataPacket deserializePacket(uint8_t *pkt);
+static bool deserializeBeacon(uint8_t *pkt, unsigned int len, Beacon *beacon);
+static int serializeBeacon(Beacon beacon, uint8_t *pkt);
 static void *sendPackets_func(void *args);
+static void fwdQ_init();
+static void *forwardPackets_func(void *args);
 static int serializePacket(DataPacket msg, uint8_t **routePkt);
 static uint8_t recvQ_timed_dequeue(DataPacket *msg, struct timespec *ts);
 static void senseNeighbours();
-static void updateActiveNodes(uint8_t addr, int8_t RSSI, uint8_t parent, int8_t parentRSSI);
+static void updateActiveNodes(uint8_t addr, int8_t RSSI, uint8_t parent, int8_t parentRSSI, uint8_t hops);
 static void changeParent();
 static void initNeighbours();
 static void cleanupInactiveNodes();
@@ -118,8 +181,20 @@ static void selectRandomNeighbour();
 static void selectNextLowerNeighbour();
 static void selectClosestNeighbour();
 static void selectClosestLowerNeighbour();
+static void selectEtxNeighbour();
+static void updateLinkEstimate(uint8_t addr, uint8_t seq, uint16_t pathETX);
+static void updateAckRatio(uint8_t addr, bool success);
+static void evaluateEtxParent();
+static uint16_t ownPathETX();
+static uint8_t ownHops();
+static void refreshRank();
+static bool rankAllows(const NodeInfo *node);
 static void sendBeacon();
 static void *sendBeaconPeriodic(void *args);
+static void trickleInit();
+static void trickleReset();
+static uint32_t trickleResets();
+static void trickleHeard(uint32_t resets);
 char *getNodeStateStr(const Routing_NodeState state);
 char *getNodeRoleStr(const Routing_LinkType link);
 static char *getRoutingStrategyStr();
@@ -153,10 +228,18 @@ int STRP_init(STRP_Config c)
 
     sendQ_init();
     recvQ_init();
+    fwdQ_init();
     initNeighbours();
     initMetrics();
+    trickleInit();
 
-    if (pthread_create(&recvT, NULL, recvPackets_func, NULL) != 0)
+    if (vclock_thread_create(&fwdT, NULL, forwardPackets_func, NULL) != 0)
+    {
+        logMessage(ERROR, "STRP: Failed to create Routing forward thread");
+        exit(EXIT_FAILURE);
+    }
+
+    if (vclock_thread_create(&recvT, NULL, recvPackets_func, NULL) != 0)
     {
         logMessage(ERROR, "STRP: Failed to create Routing receive thread");
         exit(EXIT_FAILURE);
@@ -164,22 +247,23 @@ int STRP_init(STRP_Config c)
 
     logMessage(INFO, "Routing Strategy:  %s\n", getRoutingStrategyStr());
 
+    // Beacon thread, also sends the beacons for neighbour sensing
+    if (vclock_thread_create(&sendBeaconT, NULL, sendBeaconPeriodic, NULL) != 0)
+    {
+        logMessage(ERROR, "STRP: Failed to create sendBeaconPeriodic thread");
+        exit(EXIT_FAILURE);
+    }
+
     senseNeighbours();
 
     if (config.self != ADDR_SINK)
     {
-        if (pthread_create(&sendT, NULL, sendPackets_func, NULL) != 0)
+        if (vclock_thread_create(&sendT, NULL, sendPackets_func, NULL) != 0)
         {
             logMessage(ERROR, "STRP: Failed to create Routing send thread");
             exit(EXIT_FAILURE);
         }
     }
-    // Beacon thread
-    if (pthread_create(&sendBeaconT, NULL, sendBeaconPeriodic, NULL) != 0)
-    {
-        logMessage(ERROR, "STRP: Failed to create sendBeaconPeriodic thread");
-        exit(EXIT_FAILURE);
-    }
     return 1;
 }
 
@@ -233,7 +317,7 @@ int STRP_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigned int timeou
 
     DataPacket msg;
     struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+    vclock_gettime(CLOCK_REALTIME, &ts);
     ts.tv_sec += timeout;
 
     int result = recvQ_timed_dequeue(&msg, &ts);
@@ -264,7 +348,7 @@ int STRP_timedRecvMsg(Routing_Header *header, uint8_t *data, unsigned int timeou
 
 static uint8_t recvQ_timed_dequeue(DataPacket *msg, struct timespec *ts)
 {
-    if (sem_timedwait(&recvQ.full, ts) == -1)
+    if (vclock_sem_timedwait(&recvQ.full, ts) == -1)
     {
         if (errno == ETIMEDOUT)
         {
@@ -273,11 +357,11 @@ static uint8_t recvQ_timed_dequeue(DataPacket *msg, struct timespec *ts)
         return -1;
     }
 
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.mutex);
     *msg = recvQ.packet[recvQ.begin];
     recvQ.begin = (recvQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.free);
     return 1;
 }
 
@@ -286,11 +370,11 @@ static bool sendQ_tryenqueue(DataPacket msg)
     if (sem_trywait(&sendQ.free) == -1)
         return false;
 
-    sem_wait(&sendQ.mutex);
+    vclock_sem_wait(&sendQ.mutex);
     sendQ.packet[sendQ.end] = msg;
     sendQ.end = (sendQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.full);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.full);
 
     return true;
 }
@@ -300,11 +384,11 @@ static bool recvQ_tryenqueue(DataPacket msg)
     if (sem_trywait(&recvQ.free) == -1)
         return false;
 
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.mutex);
     recvQ.packet[recvQ.end] = msg;
     recvQ.end = (recvQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.full);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.full);
 
     return true;
 }
@@ -314,11 +398,11 @@ static bool sendQ_trydequeue(DataPacket *msg)
     if (sem_trywait(&sendQ.full) == -1)
         return false;
 
-    sem_wait(&sendQ.mutex);
+    vclock_sem_wait(&sendQ.mutex);
     *msg = sendQ.packet[sendQ.begin];
     sendQ.begin = (sendQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.free);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.free);
 
     return true;
 }
@@ -328,11 +412,11 @@ static bool recvQ_trydequeue(DataPacket *msg)
     if (sem_trywait(&recvQ.full) == -1)
         return false;
 
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.mutex);
     *msg = recvQ.packet[recvQ.begin];
     recvQ.begin = (recvQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.free);
 
     return true;
 }
@@ -357,66 +441,249 @@ static void recvQ_init()
 
 static void sendQ_enqueue(DataPacket msg)
 {
-    time_t start = time(NULL);
-    sem_wait(&sendQ.free);
-    sem_wait(&sendQ.mutex);
+    time_t start = vclock_time(NULL);
+    vclock_sem_wait(&sendQ.free);
+    vclock_sem_wait(&sendQ.mutex);
     sendQ.packet[sendQ.end] = msg;
     sendQ.end = (sendQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.full);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.full);
 }
 
 static DataPacket sendQ_dequeue()
 {
-    sem_wait(&sendQ.full);
-    sem_wait(&sendQ.mutex);
+    vclock_sem_wait(&sendQ.full);
+    vclock_sem_wait(&sendQ.mutex);
     DataPacket msg = sendQ.packet[sendQ.begin];
     sendQ.begin = (sendQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&sendQ.mutex);
-    sem_post(&sendQ.free);
+    vclock_sem_post(&sendQ.mutex);
+    vclock_sem_post(&sendQ.free);
     return msg;
 }
 
 static void recvQ_enqueue(DataPacket msg)
 {
-    sem_wait(&recvQ.free);
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.free);
+    vclock_sem_wait(&recvQ.mutex);
     recvQ.packet[recvQ.end] = msg;
     recvQ.end = (recvQ.end + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.full);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.full);
 }
 
 static DataPacket recvMsgQ_dequeue()
 {
-    sem_wait(&recvQ.full);
-    sem_wait(&recvQ.mutex);
+    vclock_sem_wait(&recvQ.full);
+    vclock_sem_wait(&recvQ.mutex);
     DataPacket msg = recvQ.packet[recvQ.begin];
     recvQ.begin = (recvQ.begin + 1) % PACKETQ_SIZE;
-    sem_post(&recvQ.mutex);
-    sem_post(&recvQ.free);
+    vclock_sem_post(&recvQ.mutex);
+    vclock_sem_post(&recvQ.free);
     return msg;
 }
 
-static void *recvPackets_func(void *args)
+static void fwdQ_init()
+{
+    fwdQ.begin = 0;
+    fwdQ.end = 0;
+    fwdQ.count = 0;
+    sem_init(&fwdQ.full, 0, 0);
+    sem_init(&fwdQ.mutex, 0, 1);
+}
+
+// Hand a packet to the forwarding thread without blocking, the receive thread keeps receiving
+static void fwdQ_tryenqueue(FwdPacket pkt)
+{
+    FwdPacket drop;
+    vclock_sem_wait(&fwdQ.mutex);
+    if (fwdQ.count >= config.fwdQueueDepth)
+    {
+        if (config.fwdDropPolicy == DROP_HEAD)
+        {
+            // Replace the oldest packet, the number of queued packets stays the same
+            drop = fwdQ.packet[fwdQ.begin];
+            fwdQ.begin = (fwdQ.begin + 1) % FWDQ_SIZE;
+            fwdQ.packet[fwdQ.end] = pkt;
+            fwdQ.end = (fwdQ.end + 1) % FWDQ_SIZE;
+        }
+        else
+        {
+            drop = pkt;
+        }
+        vclock_sem_post(&fwdQ.mutex);
+
+        vclock_sem_wait(&metrics.mutex);
+        metrics.data[0].fwdDropped++;
+        vclock_sem_post(&metrics.mutex);
+        printf("# %s - Forwarding queue full, dropped packet from %02d\n", timestamp(), drop.src);
+        MAC_release(config.mac, &drop.buf);
+        return;
+    }
+    fwdQ.packet[fwdQ.end] = pkt;
+    fwdQ.end = (fwdQ.end + 1) % FWDQ_SIZE;
+    uint8_t count = ++fwdQ.count;
+    vclock_sem_post(&fwdQ.mutex);
+    vclock_sem_post(&fwdQ.full);
+
+    vclock_sem_wait(&metrics.mutex);
+    if (count > metrics.data[0].fwdQueueMax)
+    {
+        metrics.data[0].fwdQueueMax = count;
+    }
+    vclock_sem_post(&metrics.mutex);
+}
+
+static FwdPacket fwdQ_dequeue()
+{
+    vclock_sem_wait(&fwdQ.full);
+    vclock_sem_wait(&fwdQ.mutex);
+    FwdPacket pkt = fwdQ.packet[fwdQ.begin];
+    fwdQ.begin = (fwdQ.begin + 1) % FWDQ_SIZE;
+    fwdQ.count--;
+    vclock_sem_post(&fwdQ.mutex);
+    return pkt;
+}
+
+static void *forwardPackets_func(void *args)
 {
     unsigned int total[MAX_ACTIVE_NODES] = {0};
-    time_t start = time(NULL);
-    time_t current;
     while (1)
     {
-        uint8_t *pkt = (uint8_t *)malloc(MAX_PAYLOAD_SIZE);
-        if (!pkt)
+        FwdPacket pkt = fwdQ_dequeue();
+        uint8_t parent = parentAddr;
+        bool sent = MAC_send(config.mac, parent, pkt.buf.data, pkt.buf.len);
+        updateAckRatio(parent, sent);
+        if (sent)
         {
-            continue;
+            // Time from handing the packet to STRP until the parent acknowledged it
+            uint32_t latencyMs = (vclock_now() - pkt.arrival) / 1000000;
+            vclock_sem_wait(&metrics.mutex);
+            metrics.data[pkt.src].forwarded++;
+            metrics.data[pkt.src].fwdLatencyMs += latencyMs;
+            vclock_sem_post(&metrics.mutex);
+            printf("%s - FWD: %02d -> %02d total: %02d latency: %ums\n", timestamp(), pkt.src, parent, ++total[pkt.src], latencyMs);
+        }
+        else
+        {
+            printf("# %s - Error FWD: %02d -> %02d\n", timestamp(), pkt.src, parent);
+        }
+        MAC_release(config.mac, &pkt.buf);
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+// @returns true if the borrowed buffer was handed on and must not be released
+static bool handlePacket(MAC_Buffer *buf, Routing_Header metadata, uint64_t arrival)
+{
+    uint8_t *pkt = buf->data;
+    int pktSize = buf->len;
+
+    uint8_t dest = *(pkt + sizeof(uint8_t));
+    uint8_t src = *(pkt + sizeof(uint8_t) + sizeof(dest));
+    updateActiveNodes(metadata.prev, metadata.RSSI, ADDR_BROADCAST, MIN_RSSI, HOPS_INFINITE);
+
+    if (config.loglevel >= TRACE)
+    {
+        logMessage(TRACE, "STRP:%s: ", __func__);
+        for (int i = 0; i < headerSize; i++)
+            printf("%02X ", pkt[i]);
+        printf("|");
+        for (int i = headerSize; i < pktSize; i++)
+            printf(" %02X", pkt[i]);
+        printf("\n");
+    }
+
+    if (dest == config.self)
+    {
+        DataPacket msg = deserializePacket(pkt);
+        // Keep
+        if (msg.len > 0 && msg.data != NULL)
+        {
+            metadata.dst = msg.dest;
+            metadata.src = msg.src;
+            msg.metadata = metadata;
+            recvQ_enqueue(msg);
+        }
+        return false;
+    }
+
+    // Forward
+    // Loop detection logic
+    if ((src == config.self || src == parentAddr) && metadata.prev != loopyParent)
+    {
+        loopyParent = (src == config.self) ? metadata.prev : parentAddr; // To skip duplicate loop detection
+        printf("%s - Loop detected %02d\n", timestamp(), loopyParent);
+        // if (config.self > metadata.prev) // To avoid both nodes changing parents
+        if (1) // Always change parent
+        {
+            changeParent();
+        }
+        else
+        {
+            if (config.loglevel >= DEBUG)
+            {
+                printf("# %s - Skipping parent change... loopyParent:%02d\n", timestamp(), loopyParent);
+            }
+        }
+    }
+
+    // The forwarding thread sends the packet straight from the borrowed frame and releases it
+    FwdPacket fwd;
+    fwd.buf = *buf;
+    fwd.src = src;
+    fwd.arrival = arrival;
+    fwdQ_tryenqueue(fwd);
+    return true;
+}
+
+static void handleBeacon(uint8_t *pkt, unsigned int len, Routing_Header metadata)
+{
+    Beacon beacon;
+    if (!deserializeBeacon(pkt, len, &beacon))
+    {
+        if (config.loglevel >= DEBUG)
+        {
+            printf("# %s - Beacon from %02d too short: %u B\n", timestamp(), metadata.prev, len);
         }
+        return;
+    }
+    if (config.loglevel >= DEBUG)
+    {
+        printf("# %s - Beacon src: %02d (%d) parent: %02d(%d) hops: %d\n", timestamp(), metadata.prev, metadata.RSSI, beacon.parent,
+               beacon.parentRSSI, beacon.hops);
+    }
+    uint32_t resets = trickleResets();
+    updateLinkEstimate(metadata.prev, beacon.seq, beacon.pathETX);
+    updateActiveNodes(metadata.prev, metadata.RSSI, beacon.parent, beacon.parentRSSI, beacon.hops);
+    metrics.data[metadata.prev].beaconsRecv++;
+
+    // Parent lost its route (or it grew too long): pick another one while the own rank still excludes the subtree
+    if (config.strategy != FIXED && config.self != ADDR_SINK && metadata.prev == parentAddr && beacon.hops >= MAX_HOPS)
+    {
+        printf("%s - Parent %02d without route\n", timestamp(), parentAddr);
+        changeParent();
+    }
+    evaluateEtxParent();
+    refreshRank();
 
-        int pktSize = MAC_timedRecv(config.mac, pkt, 1);
+    // Only beacons that did not reset the timer (new neighbour, parent without route, parent change) suppress
+    trickleHeard(resets);
+}
+
+static void *recvPackets_func(void *args)
+{
+    while (1)
+    {
+        // Block on the MAC receive queue and borrow the frame, packets are parsed and forwarded in place
+        MAC_Buffer buf;
+        int pktSize = MAC_recvBorrow(config.mac, &buf, config.nodeTimeoutS);
         if (pktSize == 0)
         {
-            free(pkt);
             continue;
         }
+        uint64_t arrival = vclock_now();
+        uint8_t *pkt = buf.data;
         Routing_Header metadata;
         metadata.prev = config.mac->recvH.src_addr;
         metadata.RSSI = config.mac->RSSI;
@@ -424,72 +691,15 @@ static void *recvPackets_func(void *args)
         uint8_t ctrl = *pkt;
         if (ctrl == CTRL_PKT)
         {
-            uint8_t dest = *(pkt + sizeof(ctrl));
-            uint8_t src = *(pkt + sizeof(ctrl) + sizeof(dest));
-            updateActiveNodes(metadata.prev, metadata.RSSI, ADDR_BROADCAST, MIN_RSSI);
-
-            if (config.loglevel >= TRACE)
+            if (handlePacket(&buf, metadata, arrival))
             {
-                logMessage(TRACE, "STRP:%s: ", __func__);
-                for (int i = 0; i < headerSize; i++)
-                    printf("%02X ", pkt[i]);
-                printf("|");
-                for (int i = headerSize; i < pktSize; i++)
-                    printf(" %02X", pkt[i]);
-                printf("\n");
-            }
-
-            if (dest == config.self)
-            {
-                DataPacket msg = deserializePacket(pkt);
-                // Keep
-                if (msg.len > 0 && msg.data != NULL)
-                {
-                    metadata.dst = msg.dest;
-                    metadata.src = msg.src;
-                    msg.metadata = metadata;
-                    recvQ_enqueue(msg);
-                }
-            }
-            else // Forward
-            {
-                // Loop detection logic
-                if ((src == config.self || src == parentAddr) && metadata.prev != loopyParent)
-                {
-                    loopyParent = (src == config.self) ? metadata.prev : parentAddr; // To skip duplicate loop detection
-                    printf("%s - Loop detected %02d\n", timestamp(), loopyParent);
-                    // if (config.self > metadata.prev) // To avoid both nodes changing parents
-                    if (1) // Always change parent
-                    {
-                        changeParent();
-                    }
-                    else
-                    {
-                        if (config.loglevel >= DEBUG)
-                        {
-                            printf("# %s - Skipping parent change... loopyParent:%02d\n", timestamp(), loopyParent);
-                        }
-                    }
-                }
-                if (MAC_send(config.mac, parentAddr, pkt, pktSize))
-                {
-                    printf("%s - FWD: %02d -> %02d total: %02d\n", timestamp(), src, parentAddr, ++total[src]);
-                }
-                else
-                {
-                    printf("# %s - Error FWD: %02d -> %02d\n", timestamp(), src, parentAddr);
-                }
+                fflush(stdout);
+                continue;
             }
         }
         else if (ctrl == CTRL_BCN)
         {
-            Beacon *beacon = (Beacon *)pkt;
-            if (config.loglevel >= DEBUG)
-            {
-                printf("# %s - Beacon src: %02d (%d) parent: %02d(%d)\n", timestamp(), metadata.prev, metadata.RSSI, beacon->parent, beacon->parentRSSI);
-            }
-            updateActiveNodes(metadata.prev, metadata.RSSI, beacon->parent, beacon->parentRSSI);
-            metrics.data[metadata.prev].beaconsRecv++;
+            handleBeacon(pkt, buf.len, metadata);
         }
         else
         {
@@ -498,9 +708,8 @@ static void *recvPackets_func(void *args)
                 printf("# %s - STRP : Unknown control flag %02d \n", timestamp(), ctrl);
             }
         }
-        free(pkt);
+        MAC_release(config.mac, &buf);
         fflush(stdout);
-        usleep((rand() % 100000) + 700000); // Sleep 100ms + 1s to avoid busy waiting
     }
     return NULL;
 }
@@ -546,6 +755,55 @@ static DataPacket deserializePacket(uint8_t *pkt)
     return msg;
 }
 
+// Parse a beacon field by field, the struct layout (padding, alignment) is not the wire format
+static bool deserializeBeacon(uint8_t *pkt, unsigned int len, Beacon *beacon)
+{
+    if (len < beaconSize)
+    {
+        return false;
+    }
+
+    beacon->ctrl = *pkt;
+    pkt += sizeof(beacon->ctrl);
+
+    beacon->parent = *pkt;
+    pkt += sizeof(beacon->parent);
+
+    beacon->parentRSSI = (int8_t)*pkt;
+    pkt += sizeof(beacon->parentRSSI);
+
+    beacon->seq = *pkt;
+    pkt += sizeof(beacon->seq);
+
+    memcpy(&beacon->pathETX, pkt, sizeof(beacon->pathETX));
+    pkt += sizeof(beacon->pathETX);
+
+    beacon->hops = *pkt;
+    return true;
+}
+
+static int serializeBeacon(Beacon beacon, uint8_t *pkt)
+{
+    uint8_t *p = pkt;
+    *p = beacon.ctrl;
+    p += sizeof(beacon.ctrl);
+
+    *p = beacon.parent;
+    p += sizeof(beacon.parent);
+
+    *p = (uint8_t)beacon.parentRSSI;
+    p += sizeof(beacon.parentRSSI);
+
+    *p = beacon.seq;
+    p += sizeof(beacon.seq);
+
+    memcpy(p, &beacon.pathETX, sizeof(beacon.pathETX));
+    p += sizeof(beacon.pathETX);
+
+    *p = beacon.hops;
+    return beaconSize;
+}
+
 static int serializePacketV2(DataPacket msg, uint8_t *routePkt)
 {
     uint16_t routePktSize = msg.len + headerSize;
@@ -598,8 +856,11 @@ static void *sendPackets_func(void *args)
             continue;
         }
 
-        time_t start = time(NULL);
-        if (!MAC_send(config.mac, parentAddr, pkt, pktSize))
+        time_t start = vclock_time(NULL);
+        uint8_t parent = parentAddr;
+        bool sent = MAC_send(config.mac, parent, pkt, pktSize);
+        updateAckRatio(parent, sent);
+        if (!sent)
         {
             printf("%s - ### Error: MAC_send failed %s:%d\n", timestamp(), __FILE__, __LINE__);
         }
@@ -618,7 +879,6 @@ static void *sendPackets_func(void *args)
             }
         }
         free(pkt);
-        usleep(randInRange(500000, 1200000)); // Sleep 1s
     }
     return NULL;
 }
@@ -673,24 +933,20 @@ static void senseNeighbours()
 
     do
     {
-        uint16_t count = 0;
+        uint16_t beaconsSent = metrics.data[0].beaconsSent;
         if (config.loglevel >= DEBUG)
         {
             printf("# %s - Sending beacons...\n", timestamp());
             fflush(stdout);
         }
 
-        time_t start = time(NULL);
-        do
-        {
-            usleep(randInRange(500000, 1200000));
-            sendBeacon();
-            count++;
-        } while (time(NULL) - start < config.senseDurationS);
+        // The beacon thread sends them from Imin on, fewer as the neighbourhood settles
+        trickleReset();
+        vclock_sleep(config.senseDurationS);
 
         if (config.loglevel >= DEBUG)
         {
-            printf("# %s - Sent %d beacons...\n", timestamp(), count);
+            printf("# %s - Sent %d beacons...\n", timestamp(), (uint16_t)(metrics.data[0].beaconsSent - beaconsSent));
             fflush(stdout);
         }
 
@@ -743,13 +999,14 @@ static void senseNeighbours()
     }
 }
 
-static void updateActiveNodes(uint8_t addr, int8_t RSSI, uint8_t parent, int8_t parentRSSI)
+static void updateActiveNodes(uint8_t addr, int8_t RSSI, uint8_t parent, int8_t parentRSSI, uint8_t hops)
 {
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     NodeInfo *nodePtr = &neighbours.nodes[addr];
     uint8_t numActive;
     bool new = nodePtr->state == UNKNOWN;
     bool child = false;
+    bool routed = false;
     if (new)
     {
         nodePtr->addr = addr;
@@ -791,10 +1048,14 @@ static void updateActiveNodes(uint8_t addr, int8_t RSSI, uint8_t parent, int8_t
     {
         nodePtr->parent = parent;
         nodePtr->parentRSSI = parentRSSI;
+        // A neighbour becomes a parent candidate once it advertises a route
+        routed = nodePtr->hops >= MAX_HOPS && hops < MAX_HOPS;
+        nodePtr->hops = hops;
     }
     nodePtr->RSSI = RSSI;
-    nodePtr->lastSeen = time(NULL);
-    sem_post(&neighbours.mutex);
+    nodePtr->lastSeen = vclock_time(NULL);
+    bool candidate = (new || routed) && rankAllows(nodePtr);
+    vclock_sem_post(&neighbours.mutex);
     if (child && parentAddr == addr && addr < config.self)
     {
         printf("%s - Direct loop with %02d..\n", timestamp(), addr);
@@ -804,56 +1065,57 @@ static void updateActiveNodes(uint8_t addr, int8_t RSSI, uint8_t parent, int8_t
 
     if (new)
     {
+        trickleReset();
         if (config.loglevel >= DEBUG)
         {
             printf("# %s - New %s: %02d (%02d)\n", timestamp(), child ? "child" : "neighbour", addr, RSSI);
             printf("# %s - Active neighbour count: %0d\n", timestamp(), numActive);
         }
+    }
 
-        // change parent if new neighbour fits
-        if (config.strategy != FIXED && config.self != ADDR_SINK && !child && addr != parentAddr)
+    // change parent if new neighbour fits
+    if (candidate && config.strategy != FIXED && config.self != ADDR_SINK && !child && addr != parentAddr)
+    {
+        bool changed = false;
+        uint8_t prevParentAddr = parentAddr;
+        if (config.strategy == NEXT_LOWER && addr > parentAddr && addr < config.self)
         {
-            bool changed = false;
-            uint8_t prevParentAddr = parentAddr;
-            if (config.strategy == NEXT_LOWER && addr > parentAddr && addr < config.self)
-            {
-                parentAddr = addr;
-                changed = true;
-            }
-            if (config.strategy == RANDOM && (rand() % 101) < 50)
-            {
-                parentAddr = addr;
-                changed = true;
-            }
-            if (config.strategy == RANDOM_LOWER && addr < config.self && (rand() % 101) < 50)
-            {
-                parentAddr = addr;
-                changed = true;
-            }
-            if (config.strategy == CLOSEST && RSSI > neighbours.nodes[parentAddr].RSSI)
-            {
-                parentAddr = addr;
-                changed = true;
-            }
-            if (config.strategy == CLOSEST_LOWER && RSSI > neighbours.nodes[parentAddr].RSSI && addr < config.self)
-            {
-                parentAddr = addr;
-                changed = true;
-            }
-            if (changed)
+            parentAddr = addr;
+            changed = true;
+        }
+        if (config.strategy == RANDOM && (rand() % 101) < 50)
+        {
+            parentAddr = addr;
+            changed = true;
+        }
+        if (config.strategy == RANDOM_LOWER && addr < config.self && (rand() % 101) < 50)
+        {
+            parentAddr = addr;
+            changed = true;
+        }
+        if (config.strategy == CLOSEST && RSSI > neighbours.nodes[parentAddr].RSSI)
+        {
+            parentAddr = addr;
+            changed = true;
+        }
+        if (config.strategy == CLOSEST_LOWER && RSSI > neighbours.nodes[parentAddr].RSSI && addr < config.self)
+        {
+            parentAddr = addr;
+            changed = true;
+        }
+        if (changed)
+        {
+            vclock_sem_wait(&neighbours.mutex);
+            neighbours.nodes[prevParentAddr].link = IDLE;
+            neighbours.nodes[addr].link = OUTBOUND;
+            vclock_sem_post(&neighbours.mutex);
+            if (config.loglevel >= DEBUG && prevParentAddr != INITIAL_PARENT)
             {
-                sem_wait(&neighbours.mutex);
-                neighbours.nodes[prevParentAddr].link = IDLE;
-                neighbours.nodes[addr].link = OUTBOUND;
-                sem_post(&neighbours.mutex);
-                if (config.loglevel >= DEBUG && prevParentAddr != INITIAL_PARENT)
-                {
-                    printf("# %s - Changing parent. Prev: %02d (%d) New: %02d (%d)\n", timestamp(), prevParentAddr, neighbours.nodes[prevParentAddr].RSSI, addr, RSSI);
-                }
-                printf("%s - Parent: %02d (%02d)\n", timestamp(), addr, RSSI);
-                metrics.data[0].parentChanges++;
-                sendBeacon();
+                printf("# %s - Changing parent. Prev: %02d (%d) New: %02d (%d)\n", timestamp(), prevParentAddr, neighbours.nodes[prevParentAddr].RSSI, addr, RSSI);
             }
+            printf("%s - Parent: %02d (%02d)\n", timestamp(), addr, RSSI);
+            metrics.data[0].parentChanges++;
+            trickleReset();
         }
     }
 }
@@ -871,7 +1133,7 @@ static void selectClosestNeighbour()
         NodeInfo node = activeNodes.nodes[i];
         if (node.state == ACTIVE)
         {
-            if (node.link != INBOUND && node.RSSI > newParentRSSI && node.addr != parentAddr)
+            if (node.link != INBOUND && rankAllows(&node) && node.RSSI > newParentRSSI && node.addr != parentAddr)
             {
                 if (config.loglevel >= DEBUG)
                 {
@@ -883,10 +1145,10 @@ static void selectClosestNeighbour()
             active++;
         }
     }
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     neighbours.nodes[newParent].link = OUTBOUND;
     neighbours.nodes[parentAddr].link = IDLE;
-    sem_post(&neighbours.mutex);
+    vclock_sem_post(&neighbours.mutex);
     parentAddr = newParent;
 }
 
@@ -903,7 +1165,8 @@ void selectClosestLowerNeighbour()
         NodeInfo node = activeNodes.nodes[i];
         if (node.state == ACTIVE)
         {
-            if (node.link != INBOUND && node.RSSI >= newParentRSSI && node.addr < config.self && node.addr != parentAddr)
+            if (node.link != INBOUND && rankAllows(&node) && node.RSSI >= newParentRSSI && node.addr < config.self &&
+                node.addr != parentAddr)
             {
                 if (config.loglevel >= DEBUG)
                 {
@@ -915,10 +1178,10 @@ void selectClosestLowerNeighbour()
             active++;
         }
     }
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     neighbours.nodes[newParent].link = OUTBOUND;
     neighbours.nodes[parentAddr].link = IDLE;
-    sem_post(&neighbours.mutex);
+    vclock_sem_post(&neighbours.mutex);
     parentAddr = newParent;
 }
 
@@ -945,6 +1208,9 @@ char *getRoutingStrategyStr()
     case FIXED:
         strategyStr = "FIXED";
         break;
+    case ETX:
+        strategyStr = "ETX";
+        break;
     default:
         strategyStr = "UNKNOWN";
         break;
@@ -969,17 +1235,17 @@ static void selectNextLowerNeighbour()
             {
                 printf("# %s - Active: %02d (%02d)\n", timestamp(), node.addr, node.RSSI);
             }
-            if (node.link != INBOUND && node.addr != parentAddr)
+            if (node.link != INBOUND && rankAllows(&node) && node.addr != parentAddr)
             {
                 newParent = node.addr;
                 newParentRSSI = node.RSSI;
             }
         }
     }
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     neighbours.nodes[newParent].link = OUTBOUND;
     neighbours.nodes[parentAddr].link = IDLE;
-    sem_post(&neighbours.mutex);
+    vclock_sem_post(&neighbours.mutex);
 
     parentAddr = newParent;
 }
@@ -997,7 +1263,7 @@ static void selectRandomNeighbour()
         NodeInfo node = activeNodes.nodes[i];
         if (node.state == ACTIVE)
         {
-            if (node.addr != ADDR_SINK && node.link != INBOUND && node.addr != parentAddr)
+            if (node.addr != ADDR_SINK && node.link != INBOUND && rankAllows(&node) && node.addr != parentAddr)
             {
                 if (config.loglevel >= DEBUG)
                 {
@@ -1016,10 +1282,10 @@ static void selectRandomNeighbour()
         newParent = pool[index].addr;
     }
 
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     neighbours.nodes[newParent].link = OUTBOUND;
     neighbours.nodes[parentAddr].link = IDLE;
-    sem_post(&neighbours.mutex);
+    vclock_sem_post(&neighbours.mutex);
 
     parentAddr = newParent;
 }
@@ -1037,7 +1303,7 @@ static void selectRandomLowerNeighbour()
         NodeInfo node = activeNodes.nodes[i];
         if (node.state == ACTIVE)
         {
-            if (node.addr != ADDR_SINK && node.link != INBOUND && node.addr < parentAddr)
+            if (node.addr != ADDR_SINK && node.link != INBOUND && rankAllows(&node) && node.addr < parentAddr)
             {
                 if (config.loglevel >= DEBUG)
                 {
@@ -1056,17 +1322,208 @@ static void selectRandomLowerNeighbour()
         newParent = pool[index].addr;
     }
 
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     neighbours.nodes[newParent].link = OUTBOUND;
     neighbours.nodes[parentAddr].link = IDLE;
-    sem_post(&neighbours.mutex);
+    vclock_sem_post(&neighbours.mutex);
 
     parentAddr = newParent;
 }
 
+static float linkETX(const NodeInfo *node)
+{
+    // ETX = 1 / (df * dr), the reverse ratio comes from the MAC ACKs once data was sent over the link
+    float df = node->delivery;
+    float dr = node->ackRatio >= 0 ? node->ackRatio : df;
+    return df * dr > 0 ? 1 / (df * dr) : (float)ETX_INFINITE / ETX_SCALE;
+}
+
+// @returns path ETX to the sink through the neighbour, ETX_INFINITE if it has no route
+static uint16_t pathETXVia(const NodeInfo *node)
+{
+    if (node->pathETX == ETX_INFINITE || node->beaconsHeard == 0)
+    {
+        return ETX_INFINITE;
+    }
+    float etx = node->pathETX + linkETX(node) * ETX_SCALE;
+    return etx < ETX_INFINITE ? (uint16_t)etx : ETX_INFINITE;
+}
+
+static uint16_t ownPathETX()
+{
+    if (config.self == ADDR_SINK)
+    {
+        return 0;
+    }
+    if (ownHops() == HOPS_INFINITE)
+    {
+        return ETX_INFINITE;
+    }
+    return pathETXVia(&neighbours.nodes[parentAddr]);
+}
+
+static uint8_t ownHops()
+{
+    if (config.self == ADDR_SINK)
+    {
+        return 0;
+    }
+    const NodeInfo *parent = &neighbours.nodes[parentAddr];
+    if (parentAddr == INITIAL_PARENT || parent->state != ACTIVE || parent->hops >= MAX_HOPS)
+    {
+        return HOPS_INFINITE;
+    }
+    return parent->hops + 1;
+}
+
+static uint16_t nodeRank(uint8_t hops, uint16_t pathETX)
+{
+    if (hops >= MAX_HOPS)
+    {
+        return RANK_INFINITE;
+    }
+    return config.strategy == ETX ? pathETX : hops * RANK_HOP;
+}
+
+static void refreshRank()
+{
+    uint16_t prevRank = rank;
+    rank = nodeRank(ownHops(), ownPathETX());
+
+    // Route lost or found (e.g. the parent advertised none): an inconsistency the neighbours need to hear about
+    if ((prevRank == RANK_INFINITE) != (rank == RANK_INFINITE))
+    {
+        trickleReset();
+    }
+}
+
+// Loop avoidance: only neighbours with a route and a rank below the own one may become the parent
+static bool rankAllows(const NodeInfo *node)
+{
+    uint16_t nodeRankValue = nodeRank(node->hops, node->pathETX);
+    return nodeRankValue != RANK_INFINITE && nodeRankValue < rank;
+}
+
+static void updateLinkEstimate(uint8_t addr, uint8_t seq, uint16_t pathETX)
+{
+    vclock_sem_wait(&neighbours.mutex);
+    NodeInfo *node = &neighbours.nodes[addr];
+    if (node->beaconsHeard == 0)
+    {
+        node->delivery = 1;
+    }
+    else if (seq != node->beaconSeq)
+    {
+        // Every skipped sequence number is a lost beacon
+        uint8_t lost = (uint8_t)(seq - node->beaconSeq) - 1;
+        if (lost > ETX_MAX_GAP)
+        {
+            lost = ETX_MAX_GAP;
+        }
+        for (uint8_t i = 0; i < lost; i++)
+        {
+            node->delivery *= 1 - ETX_ALPHA;
+        }
+        node->delivery = node->delivery * (1 - ETX_ALPHA) + ETX_ALPHA;
+    }
+    node->beaconsHeard++;
+    node->beaconSeq = seq;
+    node->pathETX = pathETX;
+    vclock_sem_post(&neighbours.mutex);
+}
+
+static void updateAckRatio(uint8_t addr, bool success)
+{
+    if (addr == INITIAL_PARENT || addr >= MAX_ACTIVE_NODES)
+    {
+        return;
+    }
+    vclock_sem_wait(&neighbours.mutex);
+    NodeInfo *node = &neighbours.nodes[addr];
+    node->ackRatio = node->ackRatio < 0 ? success : node->ackRatio * (1 - ETX_ALPHA) + success * ETX_ALPHA;
+    vclock_sem_post(&neighbours.mutex);
+}
+
+// @returns neighbour with the least path ETX (not a child, lower rank, not in except), INITIAL_PARENT if none has a route
+static uint8_t bestEtxNeighbour(const ActiveNodes *activeNodes, uint8_t except, uint16_t *bestETX)
+{
+    uint8_t best = INITIAL_PARENT;
+    *bestETX = ETX_INFINITE;
+    for (uint8_t i = activeNodes->minAddr, active = 0; i <= activeNodes->maxAddr && active < activeNodes->numActive; i++)
+    {
+        const NodeInfo *node = &activeNodes->nodes[i];
+        if (node->state == ACTIVE)
+        {
+            uint16_t etx = pathETXVia(node);
+            if (node->link != INBOUND && rankAllows(node) && node->addr != except && etx < *bestETX)
+            {
+                best = node->addr;
+                *bestETX = etx;
+            }
+            active++;
+        }
+    }
+    return best;
+}
+
+static void selectEtxNeighbour()
+{
+    const ActiveNodes activeNodes = neighbours;
+    uint16_t etx;
+    uint8_t newParent = bestEtxNeighbour(&activeNodes, parentAddr, &etx);
+    if (newParent == INITIAL_PARENT)
+    {
+        newParent = ADDR_SINK;
+    }
+    if (config.loglevel >= DEBUG)
+    {
+        printf("# %s - Least path ETX: %02d (%.2f)\n", timestamp(), newParent, (float)etx / ETX_SCALE);
+    }
+
+    vclock_sem_wait(&neighbours.mutex);
+    neighbours.nodes[newParent].link = OUTBOUND;
+    neighbours.nodes[parentAddr].link = IDLE;
+    vclock_sem_post(&neighbours.mutex);
+    parentAddr = newParent;
+}
+
+// Switch to a better parent on new link estimates, unless it saves less than ETX_HYSTERESIS
+static void evaluateEtxParent()
+{
+    if (config.strategy != ETX || config.self == ADDR_SINK)
+    {
+        return;
+    }
+
+    const ActiveNodes activeNodes = neighbours;
+    uint16_t bestETX;
+    uint8_t best = bestEtxNeighbour(&activeNodes, INITIAL_PARENT, &bestETX);
+    uint16_t currentETX = ownPathETX();
+    if (best == INITIAL_PARENT || best == parentAddr ||
+        (currentETX != ETX_INFINITE && bestETX + ETX_HYSTERESIS >= currentETX))
+    {
+        return;
+    }
+
+    uint8_t prevParentAddr = parentAddr;
+    vclock_sem_wait(&neighbours.mutex);
+    neighbours.nodes[prevParentAddr].link = IDLE;
+    neighbours.nodes[best].link = OUTBOUND;
+    vclock_sem_post(&neighbours.mutex);
+    parentAddr = best;
+    if (config.loglevel >= DEBUG && prevParentAddr != INITIAL_PARENT)
+    {
+        printf("# %s - Changing parent. Prev: %02d (ETX %.2f) New: %02d (ETX %.2f)\n", timestamp(), prevParentAddr,
+               currentETX == ETX_INFINITE ? -1 : (float)currentETX / ETX_SCALE, best, (float)bestETX / ETX_SCALE);
+    }
+    printf("%s - Parent: %02d (%02d) ETX: %.2f\n", timestamp(), best, neighbours.nodes[best].RSSI, (float)bestETX / ETX_SCALE);
+    metrics.data[0].parentChanges++;
+    trickleReset();
+}
+
 static void changeParent()
 {
-    time_t start = time(NULL);
+    time_t start = vclock_time(NULL);
     uint8_t prevParentAddr = parentAddr;
     switch (config.strategy)
     {
@@ -1088,12 +1545,17 @@ static void changeParent()
     case FIXED:
         parentAddr = config.parentAddr;
         break;
+    case ETX:
+        selectEtxNeighbour();
+        break;
     default:
         selectNextLowerNeighbour();
         break;
     }
+    refreshRank();
     printf("%s - New parent: %02d (%02d)\n", timestamp(), parentAddr, neighbours.nodes[parentAddr].RSSI);
     metrics.data[0].parentChanges++;
+    trickleReset();
 }
 
 void initNeighbours()
@@ -1105,17 +1567,20 @@ void initNeighbours()
     for (uint8_t i = 0; i < MAX_ACTIVE_NODES; i++)
     {
         neighbours.nodes[i].state = UNKNOWN;
+        neighbours.nodes[i].ackRatio = -1;
+        neighbours.nodes[i].pathETX = ETX_INFINITE;
+        neighbours.nodes[i].hops = HOPS_INFINITE;
     }
     neighbours.minAddr = MAX_ACTIVE_NODES - 1;
     neighbours.maxAddr = 0;
-    neighbours.lastCleanupTime = time(NULL);
+    neighbours.lastCleanupTime = vclock_time(NULL);
 }
 
 static void cleanupInactiveNodes()
 {
-    time_t currentTime = time(NULL);
+    time_t currentTime = vclock_time(NULL);
     bool parentInactive = false;
-    sem_wait(&neighbours.mutex);
+    vclock_sem_wait(&neighbours.mutex);
     uint8_t numActive = neighbours.numActive;
     for (uint8_t i = neighbours.minAddr, inactive = 0; i <= neighbours.maxAddr && inactive < numActive; i++)
     {
@@ -1134,8 +1599,8 @@ static void cleanupInactiveNodes()
         }
     }
     numActive = neighbours.numActive;
-    neighbours.lastCleanupTime = time(NULL);
-    sem_post(&neighbours.mutex);
+    neighbours.lastCleanupTime = vclock_time(NULL);
+    vclock_sem_post(&neighbours.mutex);
     if (parentInactive)
     {
         printf("%s - Parent inactive: %02d\n", timestamp(), parentAddr);
@@ -1156,34 +1621,121 @@ static void sendBeacon()
     beacon.ctrl = CTRL_BCN;
     beacon.parent = parentAddr;
     beacon.parentRSSI = neighbours.nodes[parentAddr].RSSI;
+    beacon.seq = beaconSeq++;
+    refreshRank();
+    beacon.pathETX = ownPathETX();
+    beacon.hops = ownHops();
     if (config.loglevel >= DEBUG)
     {
         printf("# %s - Sending beacon\n", timestamp());
     }
 
-    if (!MAC_send(config.mac, ADDR_BROADCAST, (uint8_t *)&beacon, sizeof(Beacon)))
+    uint8_t pkt[sizeof(Beacon)]; // Never shorter than beaconSize
+    int pktSize = serializeBeacon(beacon, pkt);
+    if (!MAC_sendPrio(config.mac, ADDR_BROADCAST, pkt, pktSize, MAC_PRIO_CONTROL))
     {
-        printf("%s - ### Error: MAC_send failed %s:%d\n", timestamp(), __FILE__, __LINE__);
+        printf("%s - ### Error: MAC_sendPrio failed %s:%d\n", timestamp(), __FILE__, __LINE__);
     }
     else
     {
         metrics.data[0].beaconsSent++;
+        trickle.lastSent = vclock_time(NULL);
     }
 }
 
+static void trickleInit()
+{
+    sem_init(&trickle.mutex, 0, 1);
+    sem_init(&trickle.reset, 0, 0);
+    trickle.interval = config.beaconIminMs;
+    trickle.heard = 0;
+    trickle.resets = 0;
+    trickle.lastSent = 0;
+}
+
+// Inconsistency (new neighbour, parent change, loop): restart with the minimum interval
+static void trickleReset()
+{
+    vclock_sem_wait(&trickle.mutex);
+    trickle.resets++;
+    if (trickle.interval > config.beaconIminMs)
+    {
+        trickle.interval = config.beaconIminMs;
+        vclock_sem_post(&trickle.reset);
+    }
+    vclock_sem_post(&trickle.mutex);
+}
+
+static uint32_t trickleResets()
+{
+    vclock_sem_wait(&trickle.mutex);
+    uint32_t resets = trickle.resets;
+    vclock_sem_post(&trickle.mutex);
+    return resets;
+}
+
+// Count a beacon from a neighbour, unless an inconsistency was detected since trickleResets returned resets
+static void trickleHeard(uint32_t resets)
+{
+    vclock_sem_wait(&trickle.mutex);
+    if (trickle.resets == resets && trickle.heard < UINT8_MAX)
+    {
+        trickle.heard++;
+    }
+    vclock_sem_post(&trickle.mutex);
+}
+
+// @returns true if the interval was reset before the deadline
+static bool trickleWait(uint64_t deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000;
+    ts.tv_nsec = deadline % 1000000000;
+    return vclock_sem_clockwait(&trickle.reset, CLOCK_MONOTONIC, &ts) == 0;
+}
+
 static void *sendBeaconPeriodic(void *args)
 {
-    sleep(config.beaconIntervalS);
     while (1)
     {
-        usleep(randInRange(500000, 1200000));
-        sendBeacon();
-        logMessage(INFO, "Sent beacon\n");
-        if ((time(NULL) - neighbours.lastCleanupTime) > config.nodeTimeoutS)
+        vclock_sem_wait(&trickle.mutex);
+        uint32_t interval = trickle.interval;
+        trickle.heard = 0;
+        vclock_sem_post(&trickle.mutex);
+
+        // Beacon at a random point in the second half of the interval, unless enough neighbours already sent one
+        uint64_t start = vclock_now();
+        if (trickleWait(start + (uint64_t)randInRange(interval / 2, interval) * 1000000))
+        {
+            continue;
+        }
+        vclock_sem_wait(&trickle.mutex);
+        bool redundant = trickle.heard >= config.beaconRedundancy && vclock_time(NULL) - trickle.lastSent < config.nodeTimeoutS / 2;
+        vclock_sem_post(&trickle.mutex);
+        if (redundant)
+        {
+            logMessage(DEBUG, "Beacon suppressed\n");
+        }
+        else
+        {
+            sendBeacon();
+            logMessage(INFO, "Sent beacon\n");
+        }
+        if ((vclock_time(NULL) - neighbours.lastCleanupTime) > config.nodeTimeoutS)
         {
             cleanupInactiveNodes();
         }
-        sleep(config.beaconIntervalS);
+
+        // Consistent interval: double it up to the maximum
+        if (!trickleWait(start + (uint64_t)interval * 1000000))
+        {
+            vclock_sem_wait(&trickle.mutex);
+            if (trickle.interval == interval)
+            {
+                trickle.interval = interval * 2 < config.beaconIntervalS * 1000 ? interval * 2 : config.beaconIntervalS * 1000;
+            }
+            vclock_sem_post(&trickle.mutex);
+        }
     }
     return NULL;
 }
@@ -1242,27 +1794,31 @@ uint8_t Routing_isDataPkt(uint8_t ctrl)
 
 uint8_t *Routing_getMetricsHeader()
 {
-    return "AggParentChanges,AggBeaconsSent,TotalBeaconsRecv";
+    return "AggParentChanges,AggBeaconsSent,TotalBeaconsRecv,Forwarded,AvgFwdLatencyMs,AggFwdDropped,MaxFwdQueue";
 }
 
 int Routing_getMetricsData(uint8_t *buffer, uint8_t addr)
 {
     const STRP_Params data = metrics.data[addr];
-    int rowlen = sprintf(buffer, "%d,%d,%d", metrics.data[0].parentChanges, metrics.data[0].beaconsSent, data.beaconsRecv);
-    sem_wait(&metrics.mutex);
+    int rowlen = sprintf(buffer, "%d,%d,%d,%d,%u,%d,%d", metrics.data[0].parentChanges, metrics.data[0].beaconsSent, data.beaconsRecv,
+                         data.forwarded, data.forwarded > 0 ? data.fwdLatencyMs / data.forwarded : 0, metrics.data[0].fwdDropped,
+                         metrics.data[0].fwdQueueMax);
+    vclock_sem_wait(&metrics.mutex);
     metrics.data[addr] = (STRP_Params){0};
     metrics.data[0].beaconsSent = 0;
     metrics.data[0].parentChanges = 0;
-    sem_post(&metrics.mutex);
+    metrics.data[0].fwdDropped = 0;
+    metrics.data[0].fwdQueueMax = 0;
+    vclock_sem_post(&metrics.mutex);
     return rowlen;
 }
 
 static void initMetrics()
 {
     sem_init(&metrics.mutex, 0, 1);
-    sem_wait(&metrics.mutex);
+    vclock_sem_wait(&metrics.mutex);
     memset(&metrics.data, 0, sizeof(metrics.data));
-    sem_post(&metrics.mutex);
+    vclock_sem_post(&metrics.mutex);
 }
 
 int Routing_getTopologyData(char *buffer, uint16_t size)
@@ -1272,7 +1828,7 @@ int Routing_getTopologyData(char *buffer, uint16_t size)
     uint8_t min = neighbours.minAddr;
     int offset = 0;
     uint8_t src = config.self;
-    time_t timestamp = time(NULL);
+    time_t timestamp = vclock_time(NULL);
 
     // Write parent info first
     NodeInfo node = activeNodes.nodes[parentAddr];
@@ -1323,6 +1879,14 @@ void setConfigDefaults(STRP_Config *config)
     {
         config->beaconIntervalS = 30;
     }
+    if (config->beaconIminMs == 0 || config->beaconIminMs > config->beaconIntervalS * 1000)
+    {
+        config->beaconIminMs = config->beaconIminMs == 0 ? 1000 : config->beaconIntervalS * 1000;
+    }
+    if (config->beaconRedundancy == 0)
+    {
+        config->beaconRedundancy = 2;
+    }
     if (config->senseDurationS == 0)
     {
         config->senseDurationS = 15;
@@ -1339,6 +1903,10 @@ void setConfigDefaults(STRP_Config *config)
     {
         config->loglevel = INFO;
     }
+    if (config->fwdQueueDepth == 0 || config->fwdQueueDepth > FWDQ_SIZE)
+    {
+        config->fwdQueueDepth = config->fwdQueueDepth == 0 ? 8 : FWDQ_SIZE;
+    }
     if (config->strategy == FIXED)
     {
         parentAddr = config->parentAddr;
@@ -20,9 +20,20 @@ typedef enum ParentSelectionStrategy
     NEXT_LOWER,    // Choose the neighbor with next lower address than self
     CLOSEST,       // Choose the neighbor with least RSSI
     CLOSEST_LOWER, // Choose the closest neighbor with address lower than self
-    FIXED          // Use the parent assignment in the config
+    FIXED,         // Use the parent assignment in the config
+    ETX            // Choose the neighbor with the least expected transmissions to the sink
 } ParentSelectionStrategy;
 
+/**
+ * @brief Packet dropped when the forwarding queue is full
+ *
+ */
+typedef enum FwdDropPolicy
+{
+    DROP_TAIL, // Drop the arriving packet
+    DROP_HEAD  // Drop the oldest queued packet to make room for the arriving one
+} FwdDropPolicy;
+
 typedef struct Routing_Header
 {
     uint8_t src;  // Source of the packet
@@ -50,10 +61,19 @@ typedef struct STRP_Config
     // Default 15s
     unsigned int senseDurationS;
 
-    // Interval between periodic beacons (seconds)
+    // Maximum interval between beacons (seconds), Trickle Imax
+    // The interval restarts at beaconIminMs on topology changes and doubles up to this while they are stable
     // Default 30s
     unsigned int beaconIntervalS;
 
+    // Minimum interval between beacons (milliseconds), Trickle Imin
+    // Default 1000ms
+    unsigned int beaconIminMs;
+
+    // Beacons heard within an interval that make the own one redundant, Trickle k
+    // Default 2
+    unsigned int beaconRedundancy;
+
     // Neighbor keepalive timeout (seconds)
     // Default 60s
     unsigned int nodeTimeoutS;
@@ -63,6 +83,13 @@ typedef struct STRP_Config
     // Parent address for the FIXED strategy
     uint8_t parentAddr;
 
+    // Packets waiting to be forwarded to the parent (max. 16)
+    // Default 8
+    unsigned int fwdQueueDepth;
+
+    // Default DROP_TAIL
+    FwdDropPolicy fwdDropPolicy;
+
 } STRP_Config;
 
 /**
@@ -0,0 +1,297 @@
+/**
+ * Send path microbenchmark for ALOHA.
+ *
+ * Messages go through ALOHA_send (or ALOHA_Isend with -i) into the send queue and are
+ * framed by sendMsg_func. The PHY below only counts the frames. The clock below passes
+ * semaphores straight through to libc but skips every sleep, so the random delay before
+ * each transmission costs nothing. What remains is the queue hand-off, framing and
+ * checksum. Broadcasts are sent, so no ACK is awaited.
+ *
+ * With -q the two queue implementations are compared directly instead: one producer
+ * and one consumer thread move messages through the lock-free SPSC ring and through the
+ * previous queue (mutex, free and full semaphores).
+ *
+ * Build (from the project directory, vclock.c and SX1262/SX1262.c are replaced below):
+ * 	gcc -O2 -o Debug/aloha_send benchmark/aloha_send.c ALOHA/ALOHA.c -lpthread
+ * Usage:
+ * 	Debug/aloha_send [-i] [-q] [-n messages] [-s payloadSize] [-t senderThreads]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ALOHA/ALOHA.h"
+#include "../SX1262/SX1262.h"
+#include "../spsc.h"
+
+static unsigned int numMessages = 200000;
+static unsigned int payloadSize = 32;
+static unsigned int numThreads = 1;
+static int nonBlocking = 0;
+
+static atomic_ulong framesSent;
+static atomic_ulong bytesSent;
+static atomic_ulong queueFull;
+
+/*** real clock without sleeps ***/
+void vclock_init() {}
+int vclock_isSim() { return 0; }
+int vclock_thread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg) { return pthread_create(thread, attr, start, arg); }
+time_t vclock_time(time_t *t) { return time(t); }
+int vclock_gettime(clockid_t clock, struct timespec *ts) { return clock_gettime(clock, ts); }
+uint64_t vclock_now() { struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return ts.tv_sec * 1000000000ULL + ts.tv_nsec; }
+unsigned int vclock_sleep(unsigned int s) { return 0; }
+int vclock_usleep(useconds_t us) { return 0; }
+unsigned int vclock_msleep(unsigned int ms) { return 0; }
+int vclock_sem_wait(sem_t *sem) { return sem_wait(sem); }
+int vclock_sem_timedwait(sem_t *sem, const struct timespec *abstime) { return sem_timedwait(sem, abstime); }
+int vclock_sem_post(sem_t *sem) { return sem_post(sem); }
+/*** ***/
+
+/*** PHY that only counts frames ***/
+void SX1262_init(const SX1262_Config *cfg) {}
+void SX1262_send(unsigned char *msg, unsigned int len) {}
+
+unsigned int SX1262_sendFrame(const struct iovec *iov, int iovcnt)
+{
+    unsigned int len = 0;
+    for (int i = 0; i < iovcnt; i++)
+        len += iov[i].iov_len;
+    atomic_fetch_add(&framesSent, 1);
+    atomic_fetch_add(&bytesSent, len);
+    return len;
+}
+
+// nothing is ever received, the receive thread stays blocked here
+void SX1262_recv(unsigned char *msg, unsigned int len)
+{
+    while (1)
+        pause();
+}
+
+unsigned int SX1262_tryrecv(unsigned char *msg, unsigned int len) { return 0; }
+unsigned int SX1262_timedrecv(unsigned char *msg, unsigned int len, unsigned int timeout) { return 0; }
+void SX1262_deadline(struct timespec *ts, unsigned int ms) { clock_gettime(CLOCK_MONOTONIC, ts); }
+SX1262_Frame *SX1262_frameGet() { return NULL; }
+void SX1262_frameRelease(SX1262_Frame *frame) {}
+unsigned int SX1262_recvFrameUntil(SX1262_Frame *frame, unsigned int len, const struct timespec *deadline) { return 0; }
+/*** ***/
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static MAC mac;
+
+static void *sender_func(void *args)
+{
+    unsigned int count = *(unsigned int *)args;
+    uint8_t payload[payloadSize];
+    memset(payload, 0xAB, sizeof(payload));
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!nonBlocking)
+        {
+            ALOHA_send(&mac, ADDR_BROADCAST, payload, payloadSize);
+            continue;
+        }
+
+        // queue full -> retry
+        while (!ALOHA_Isend(&mac, ADDR_BROADCAST, payload, payloadSize))
+        {
+            atomic_fetch_add(&queueFull, 1);
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/*** queue comparison ***/
+typedef struct QueueMessage
+{
+    uint8_t addr;
+    uint16_t len;
+    uint8_t *data;
+    bool blocking;
+    bool *success;
+    sem_t *fin;
+} QueueMessage;
+
+#define QUEUE_SIZE 32
+
+static SPSC ring;
+static QueueMessage ringSlots[QUEUE_SIZE];
+
+static struct
+{
+    QueueMessage msg[QUEUE_SIZE];
+    unsigned int begin, end;
+    sem_t mutex, free, full;
+} legacyQ;
+
+static void *ringProducer_func(void *args)
+{
+    QueueMessage msg = {0};
+    for (unsigned int i = 0; i < numMessages; i++)
+    {
+        msg.len = i;
+        spsc_push(&ring, &msg);
+    }
+    return NULL;
+}
+
+static void *legacyProducer_func(void *args)
+{
+    QueueMessage msg = {0};
+    for (unsigned int i = 0; i < numMessages; i++)
+    {
+        msg.len = i;
+        sem_wait(&legacyQ.free);
+        sem_wait(&legacyQ.mutex);
+        legacyQ.msg[legacyQ.end] = msg;
+        legacyQ.end = (legacyQ.end + 1) % QUEUE_SIZE;
+        sem_post(&legacyQ.mutex);
+        sem_post(&legacyQ.full);
+    }
+    return NULL;
+}
+
+static void compareQueues()
+{
+    spsc_init(&ring, ringSlots, QUEUE_SIZE, sizeof(QueueMessage));
+    sem_init(&legacyQ.mutex, 0, 1);
+    sem_init(&legacyQ.free, 0, QUEUE_SIZE);
+    sem_init(&legacyQ.full, 0, 0);
+
+    for (int legacy = 0; legacy <= 1; legacy++)
+    {
+        double start = now(), cpuStart = cpuTime();
+        pthread_t producer;
+        pthread_create(&producer, NULL, legacy ? legacyProducer_func : ringProducer_func, NULL);
+
+        unsigned int bad = 0;
+        for (unsigned int i = 0; i < numMessages; i++)
+        {
+            QueueMessage msg;
+            if (legacy)
+            {
+                sem_wait(&legacyQ.full);
+                sem_wait(&legacyQ.mutex);
+                msg = legacyQ.msg[legacyQ.begin];
+                legacyQ.begin = (legacyQ.begin + 1) % QUEUE_SIZE;
+                sem_post(&legacyQ.mutex);
+                sem_post(&legacyQ.free);
+            }
+            else
+                spsc_pop(&ring, &msg);
+            bad += msg.len != (uint16_t)i;
+        }
+        pthread_join(producer, NULL);
+
+        double elapsed = now() - start, cpu = cpuTime() - cpuStart;
+        if (bad)
+            fprintf(stderr, "%s: %u messages lost or reordered\n", legacy ? "legacy" : "spsc", bad);
+        printf("%-28s %10.0f msg/s  cpu %.3f s\n", legacy ? "legacy (3 semaphores)" : "spsc ring", numMessages / elapsed, cpu);
+    }
+}
+/*** ***/
+
+int main(int argc, char *argv[])
+{
+    int queues = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "iqn:s:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            nonBlocking = 1;
+            break;
+        case 'q':
+            queues = 1;
+            break;
+        case 'n':
+            numMessages = atoi(optarg);
+            break;
+        case 's':
+            payloadSize = atoi(optarg);
+            break;
+        case 't':
+            numThreads = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-i] [-q] [-n messages] [-s payloadSize] [-t senderThreads]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (queues)
+    {
+        compareQueues();
+        return 0;
+    }
+
+    ALOHA_init(&mac, 1);
+    mac.ambient = 0;
+
+    // one frame per message, the loop below counts frames
+    mac.aggregate = 0;
+
+    // sendMsg_func prints every frame, keep that out of the results
+    fflush(stdout);
+    int out = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+
+    double start = now(), cpuStart = cpuTime();
+
+    pthread_t senders[numThreads];
+    unsigned int counts[numThreads];
+    for (unsigned int t = 0; t < numThreads; t++)
+    {
+        counts[t] = numMessages / numThreads + (t < numMessages % numThreads);
+        pthread_create(&senders[t], NULL, sender_func, &counts[t]);
+    }
+    for (unsigned int t = 0; t < numThreads; t++)
+        pthread_join(senders[t], NULL);
+
+    // ALOHA_Isend returns before the frame is sent
+    while (atomic_load(&framesSent) < numMessages)
+        sched_yield();
+
+    double elapsed = now() - start, cpu = cpuTime() - cpuStart;
+
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+
+    printf("path:       %s, %u sender thread(s)\n", nonBlocking ? "ALOHA_Isend" : "ALOHA_send", numThreads);
+    printf("messages:   %lu (%u B payload), queue full %lu times\n", atomic_load(&framesSent), payloadSize, atomic_load(&queueFull));
+    printf("throughput: %.0f msg/s, %.2f MB/s\n", numMessages / elapsed, atomic_load(&bytesSent) / elapsed / 1e6);
+    printf("cpu:        %.3f s (%.2f us/msg)\n", cpu, cpu / numMessages * 1e6);
+
+    return 0;
+}
@@ -0,0 +1,281 @@
+/**
+ * Receive path microbenchmark for the SX1262 PHY.
+ *
+ * A pseudo-terminal stands in for /dev/ttyS0: a fake module thread answers the
+ * configuration handshake on the master side and then streams MAC-sized frames
+ * (ctrl | header | payload | RSSI) into it. The consumer parses them the way the
+ * MAC receive threads do (ctrl byte, header, payload) and reports throughput and
+ * CPU time per MB.
+ *
+ * With -l the same workload is run against the previous receive path (one
+ * semaphore-protected queue operation per byte) for comparison.
+ *
+ * Build (from the project directory, GPIO is stubbed below):
+ * 	gcc -O2 -o Debug/sx1262_recv benchmark/sx1262_recv.c SX1262/SX1262.c -lpthread
+ * Usage:
+ * 	Debug/sx1262_recv [-l] [-n frames] [-s payloadSize]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../SX1262/SX1262.h"
+
+#define HEADER_LEN 9
+#define CFG_LEN 12
+
+static int master;
+static unsigned int numFrames = 20000;
+static unsigned int payloadSize = 100;
+
+// GPIO is not available off the Pi, the module is always "configured"
+void GPIO_init() {}
+void GPIO_setup(int pin, int mode) {}
+int GPIO_input(int pin) { return 0; }
+void GPIO_output(int pin, int value) {}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void writeAll(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+// Fake module: echo the configuration, then stream frames
+static void *module_func(void *args)
+{
+    int configure = *(int *)args;
+    if (configure)
+    {
+        uint8_t cfg[CFG_LEN];
+        size_t got = 0;
+        while (got < sizeof(cfg))
+        {
+            ssize_t n = read(master, cfg + got, sizeof(cfg) - got);
+            if (n > 0)
+                got += n;
+        }
+        cfg[0] = 0xC1;
+        writeAll(master, cfg, sizeof(cfg));
+
+        // SX1262_init waits 100ms before reading the answer and flushes before that
+        usleep(300000);
+    }
+
+    unsigned int frameLen = HEADER_LEN + payloadSize + 1;
+    uint8_t frame[frameLen];
+    memset(frame, 0xAB, sizeof(frame));
+    frame[0] = 0xC4;
+    *(uint16_t *)&frame[5] = payloadSize;
+
+    for (unsigned int i = 0; i < numFrames; i++)
+    {
+        *(uint16_t *)&frame[3] = i;
+        writeAll(master, frame, frameLen);
+    }
+    return NULL;
+}
+
+/*** previous receive path: one semaphore round-trip per byte ***/
+static struct
+{
+    uint8_t data[256];
+    unsigned int begin, end;
+    sem_t mutex, free, full;
+} legacyQ;
+static int legacyFd;
+
+static void *legacyRecv_func(void *args)
+{
+    while (1)
+    {
+        uint8_t c;
+        if (read(legacyFd, &c, 1) != 1)
+            continue;
+        sem_wait(&legacyQ.free);
+        sem_wait(&legacyQ.mutex);
+        legacyQ.data[legacyQ.end] = c;
+        legacyQ.end = (legacyQ.end + 1) % sizeof(legacyQ.data);
+        sem_post(&legacyQ.mutex);
+        sem_post(&legacyQ.full);
+    }
+    return NULL;
+}
+
+static unsigned int legacy_timedrecv(unsigned char *msg, unsigned int len, unsigned int timeout)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t nsec = ts.tv_nsec + (timeout * 1000000ULL);
+    ts.tv_sec += nsec / 1000000000;
+    ts.tv_nsec = nsec % 1000000000;
+
+    for (unsigned int i = 0; i < len; i++)
+    {
+        if (sem_timedwait(&legacyQ.full, &ts) == -1)
+            return i;
+        sem_wait(&legacyQ.mutex);
+        msg[i] = legacyQ.data[legacyQ.begin];
+        legacyQ.begin = (legacyQ.begin + 1) % sizeof(legacyQ.data);
+        sem_post(&legacyQ.mutex);
+        sem_post(&legacyQ.free);
+    }
+    return len;
+}
+
+static void legacy_init(const char *path)
+{
+    legacyFd = open(path, O_RDWR | O_NOCTTY);
+    if (legacyFd < 0)
+    {
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    struct termios options;
+    tcgetattr(legacyFd, &options);
+    cfmakeraw(&options);
+    options.c_cc[VMIN] = 1;
+    options.c_cc[VTIME] = 0;
+    tcsetattr(legacyFd, TCSANOW, &options);
+
+    sem_init(&legacyQ.mutex, 0, 1);
+    sem_init(&legacyQ.free, 0, sizeof(legacyQ.data));
+    sem_init(&legacyQ.full, 0, 0);
+
+    pthread_t t;
+    pthread_create(&t, NULL, legacyRecv_func, NULL);
+}
+/*** ***/
+
+int main(int argc, char *argv[])
+{
+    int legacy = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "ln:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            legacy = 1;
+            break;
+        case 'n':
+            numFrames = atoi(optarg);
+            break;
+        case 's':
+            payloadSize = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-l] [-n frames] [-s payloadSize]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        perror("posix_openpt");
+        exit(EXIT_FAILURE);
+    }
+    const char *slave = ptsname(master);
+
+    // the slave end must be in raw mode before the module starts writing
+    struct termios options;
+    tcgetattr(master, &options);
+    cfmakeraw(&options);
+    tcsetattr(master, TCSANOW, &options);
+
+    int configure = !legacy;
+    pthread_t moduleT;
+    if (legacy)
+        legacy_init(slave);
+    else
+    {
+        SX1262_Config cfg = {0};
+        cfg.port = slave;
+        pthread_create(&moduleT, NULL, module_func, &configure);
+        SX1262_init(&cfg);
+    }
+
+    unsigned int (*recv)(unsigned char *, unsigned int, unsigned int) = legacy ? legacy_timedrecv : SX1262_timedrecv;
+
+    if (legacy)
+        pthread_create(&moduleT, NULL, module_func, &configure);
+
+    uint8_t payload[payloadSize + 1];
+    uint64_t bytes = 0;
+    unsigned int frames = 0, lost = 0;
+    double start = 0, cpuStart = 0;
+
+    while (frames + lost < numFrames)
+    {
+        uint8_t ctrl;
+        if (recv(&ctrl, 1, 2000) != 1)
+            break;
+        if (frames == 0)
+        {
+            start = now();
+            cpuStart = cpuTime();
+        }
+
+        uint8_t header[HEADER_LEN - 1];
+        if (recv(header, sizeof(header), 1000) != sizeof(header))
+        {
+            lost++;
+            continue;
+        }
+        uint16_t len = *(uint16_t *)&header[4];
+        if (recv(payload, len + 1, 1000) != len + 1u)
+        {
+            lost++;
+            continue;
+        }
+
+        bytes += HEADER_LEN + len + 1;
+        frames++;
+    }
+
+    double elapsed = now() - start;
+    double cpu = cpuTime() - cpuStart;
+
+    printf("path:       %s\n", legacy ? "legacy (per-byte semaphores)" : "bulk ring");
+    printf("frames:     %u (%u lost), %u B payload\n", frames, lost, payloadSize);
+    printf("throughput: %.2f MB/s, %.0f frames/s\n", bytes / elapsed / 1e6, frames / elapsed);
+    printf("cpu:        %.3f s (%.3f s/MB)\n", cpu, cpu / (bytes / 1e6));
+
+    return 0;
+}
@@ -0,0 +1,368 @@
+/**
+ * Throughput sweep over UART baud rate and air data rate for the SX1262 PHY.
+ *
+ * Every combination runs in its own child process (SX1262_init starts the PHY
+ * threads once per process). A pseudo-terminal stands in for /dev/ttyS0: the fake
+ * module answers the configuration handshake, decodes baud rate and air data rate
+ * from REG0 and then loops every frame back as if a peer had sent it, delayed by a
+ * simple timing model:
+ *
+ * 	UART in   len * 10 / baud           (8N1, one frame after the other)
+ * 	air       (len + overhead) * 8 / air per packet of packetSize bytes
+ * 	UART out  (len + 1) * 10 / baud     (frame plus RSSI byte)
+ *
+ * The host side sends a fixed workload of MAC-sized frames with SX1262_sendFrame,
+ * keeps at most `window` frames in flight and receives them with SX1262_recvFrame.
+ * Each setting reports payload bytes/s and per-frame latency (send -> receive).
+ *
+ * Build (from the project directory, GPIO is stubbed below):
+ * 	gcc -O2 -o Debug/sx1262_sweep benchmark/sx1262_sweep.c SX1262/SX1262.c -lpthread
+ * Usage:
+ * 	Debug/sx1262_sweep [-b baud,...] [-a air,...] [-n frames] [-s payloadSize] [-w window]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../SX1262/SX1262.h"
+
+#define HEADER_LEN 9
+#define CFG_LEN 12
+#define MAX_SETTINGS 8
+
+// preamble, sync word and LoRa header per air packet, roughly in bytes
+#define AIR_OVERHEAD 12
+
+static const unsigned int baudRates[] = {1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200};
+static const unsigned int airRates[] = {300, 1200, 2400, 4800, 9600, 19200, 38400, 62500};
+static const unsigned int packetSizes[] = {240, 128, 64, 32};
+
+static int master;
+static unsigned int numFrames = 20;
+static unsigned int payloadSize = 100;
+static unsigned int window = 4;
+
+// GPIO is not available off the Pi, the module is always "configured"
+void GPIO_init() {}
+void GPIO_setup(int pin, int mode) {}
+int GPIO_input(int pin) { return 0; }
+void GPIO_output(int pin, int value) {}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleepUntil(double t)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static void readAll(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = read(fd, buf, len);
+        if (n <= 0)
+        {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+static void writeAll(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+/*** fake module ***/
+typedef struct Delayed
+{
+    uint8_t bytes[SX1262_RXFRAME_SIZE];
+    unsigned int len;
+    double due; // time the last byte leaves the module's UART
+} Delayed;
+
+static struct
+{
+    unsigned int baud, air, packetSize;
+    Delayed queue[64];
+    unsigned int begin, end;
+    sem_t free, full;
+} module;
+
+// loop frames back once the timing model says they have arrived at the peer
+static void *moduleOut_func(void *args)
+{
+    while (1)
+    {
+        sem_wait(&module.full);
+        Delayed *d = &module.queue[module.begin];
+        sleepUntil(d->due);
+        writeAll(master, d->bytes, d->len);
+        module.begin = (module.begin + 1) % 64;
+        sem_post(&module.free);
+    }
+    return NULL;
+}
+
+static void *moduleIn_func(void *args)
+{
+    // configuration handshake: echo the registers with 0xC1 and pick up the rates from REG0
+    uint8_t cfg[CFG_LEN];
+    readAll(master, cfg, sizeof(cfg));
+    module.baud = baudRates[cfg[6] >> 5];
+    module.air = airRates[cfg[6] & 0x07];
+    module.packetSize = packetSizes[cfg[7] >> 6];
+    cfg[0] = 0xC1;
+    writeAll(master, cfg, sizeof(cfg));
+
+    double uartInFree = 0, airFree = 0, uartOutFree = 0;
+    while (1)
+    {
+        sem_wait(&module.free);
+        Delayed *d = &module.queue[module.end];
+
+        // ctrl | header | payload as written by the host
+        readAll(master, d->bytes, HEADER_LEN);
+        uint16_t len = *(uint16_t *)&d->bytes[5];
+        readAll(master, d->bytes + HEADER_LEN, len);
+        d->len = HEADER_LEN + len;
+        d->bytes[d->len++] = (uint8_t)-60; // RSSI
+
+        unsigned int frameLen = HEADER_LEN + len;
+        unsigned int packets = (frameLen + module.packetSize - 1) / module.packetSize;
+
+        double t = now();
+        double uartInDone = (t > uartInFree ? t : uartInFree) + frameLen * 10.0 / module.baud;
+        uartInFree = uartInDone;
+
+        double airStart = uartInDone > airFree ? uartInDone : airFree;
+        airFree = airStart + (frameLen + packets * AIR_OVERHEAD) * 8.0 / module.air;
+
+        uartOutFree = (airFree > uartOutFree ? airFree : uartOutFree) + (frameLen + 1) * 10.0 / module.baud;
+        d->due = uartOutFree;
+
+        module.end = (module.end + 1) % 64;
+        sem_post(&module.full);
+    }
+    return NULL;
+}
+/*** ***/
+
+static sem_t inFlight;
+static double *sentAt, *latency;
+static unsigned int received;
+
+static void *receiver_func(void *args)
+{
+    while (received < numFrames)
+    {
+        SX1262_Frame *frame = SX1262_frameGet();
+
+        // ctrl, header, payload and RSSI straight into the borrowed frame
+        if (SX1262_timedrecv(frame->bytes, 1, 10000) != 1)
+        {
+            SX1262_frameRelease(frame);
+            break;
+        }
+        frame->len = 1;
+        if (SX1262_recvFrame(frame, HEADER_LEN - 1, 1000) != HEADER_LEN - 1)
+        {
+            SX1262_frameRelease(frame);
+            break;
+        }
+        uint16_t seq = *(uint16_t *)&frame->bytes[3];
+        uint16_t len = *(uint16_t *)&frame->bytes[5];
+        if (SX1262_recvFrame(frame, len + 1, 1000) != len + 1u || seq >= numFrames)
+        {
+            SX1262_frameRelease(frame);
+            break;
+        }
+
+        latency[received++] = now() - sentAt[seq];
+        SX1262_frameRelease(frame);
+        sem_post(&inFlight);
+    }
+    return NULL;
+}
+
+static int cmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void runSetting(unsigned int baud, unsigned int air)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        perror("posix_openpt");
+        exit(EXIT_FAILURE);
+    }
+
+    // the slave end must be in raw mode before the module starts writing
+    struct termios options;
+    tcgetattr(master, &options);
+    cfmakeraw(&options);
+    tcsetattr(master, TCSANOW, &options);
+
+    sem_init(&module.free, 0, 64);
+    sem_init(&module.full, 0, 0);
+    pthread_t inT, outT;
+    pthread_create(&inT, NULL, moduleIn_func, NULL);
+    pthread_create(&outT, NULL, moduleOut_func, NULL);
+
+    SX1262_Config cfg = {0};
+    cfg.port = ptsname(master);
+    cfg.baudRate = baud;
+    cfg.airRate = air;
+    SX1262_init(&cfg);
+
+    sentAt = calloc(numFrames, sizeof(double));
+    latency = calloc(numFrames, sizeof(double));
+    sem_init(&inFlight, 0, window);
+
+    pthread_t recvT;
+    pthread_create(&recvT, NULL, receiver_func, NULL);
+
+    uint8_t header[HEADER_LEN] = {0xC4, 1, 2};
+    uint8_t payload[payloadSize];
+    memset(payload, 0xAB, sizeof(payload));
+    struct iovec frame[] = {{header, sizeof(header)}, {payload, sizeof(payload)}};
+
+    double start = now();
+    for (unsigned int i = 0; i < numFrames; i++)
+    {
+        sem_wait(&inFlight);
+        *(uint16_t *)&header[3] = i;
+        *(uint16_t *)&header[5] = payloadSize;
+        sentAt[i] = now();
+        SX1262_sendFrame(frame, 2);
+    }
+    pthread_join(recvT, NULL);
+    double elapsed = now() - start;
+
+    qsort(latency, received, sizeof(double), cmpDouble);
+    double sum = 0;
+    for (unsigned int i = 0; i < received; i++)
+        sum += latency[i];
+
+    printf("%6u %6u %6u/%-6u %10.0f %9.1f %9.1f %9.1f %9.1f\n", baud, air, received, numFrames,
+           received * payloadSize / elapsed,
+           received ? sum / received * 1e3 : 0,
+           received ? latency[received / 2] * 1e3 : 0,
+           received ? latency[(received * 99) / 100] * 1e3 : 0,
+           received ? latency[received - 1] * 1e3 : 0);
+    fflush(stdout);
+}
+
+static unsigned int parseList(char *arg, unsigned int *list)
+{
+    unsigned int n = 0;
+    for (char *tok = strtok(arg, ","); tok != NULL && n < MAX_SETTINGS; tok = strtok(NULL, ","))
+        list[n++] = atoi(tok);
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int bauds[MAX_SETTINGS] = {9600, 19200, 38400, 57600, 115200};
+    unsigned int airs[MAX_SETTINGS] = {2400, 9600, 62500};
+    unsigned int numBauds = 5, numAirs = 3;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:a:n:s:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            numBauds = parseList(optarg, bauds);
+            break;
+        case 'a':
+            numAirs = parseList(optarg, airs);
+            break;
+        case 'n':
+            numFrames = atoi(optarg);
+            break;
+        case 's':
+            payloadSize = atoi(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b baud,...] [-a air,...] [-n frames] [-s payloadSize] [-w window]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (HEADER_LEN + payloadSize + 1 > SX1262_RXFRAME_SIZE || window == 0 || numFrames == 0)
+    {
+        fprintf(stderr, "Invalid workload: payload must fit into a frame, window and frames must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%u frames x %u B payload, window %u\n", numFrames, payloadSize, window);
+    printf("%6s %6s %13s %10s %9s %9s %9s %9s\n", "baud", "air", "frames", "B/s", "avg ms", "p50 ms", "p99 ms", "max ms");
+    fflush(stdout);
+
+    for (unsigned int b = 0; b < numBauds; b++)
+    {
+        for (unsigned int a = 0; a < numAirs; a++)
+        {
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                perror("fork");
+                exit(EXIT_FAILURE);
+            }
+            if (pid == 0)
+            {
+                runSetting(bauds[b], airs[a]);
+                exit(EXIT_SUCCESS);
+            }
+
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                printf("%6u %6u  failed\n", bauds[b], airs[a]);
+        }
+    }
+
+    return 0;
+}
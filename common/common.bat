@@ -22,6 +22,12 @@ for /D %%i in (../*) do (
 		copy /Y "Routing\\Routing.c" "..\\%%i\\Routing\\Routing.c"
 
 		copy /Y "common.h" "..\\%%i\\common.h"
+
+		copy /Y "util\\vclock.h" "..\\%%i\\vclock.h"
+		copy /Y "util\\vclock.c" "..\\%%i\\vclock.c"
+		copy /Y "util\\spsc.h" "..\\%%i\\spsc.h"
+		copy /Y "util\\crc16.h" "..\\%%i\\crc16.h"
+		copy /Y "util\\nav.h" "..\\%%i\\nav.h"
 	)
 )
 
@@ -0,0 +1,159 @@
+#ifndef NAV_H
+#define NAV_H
+
+#include <semaphore.h> // sem_t, sem_init
+#include <stdint.h>    // uint32_t, uint64_t
+
+#include "vclock.h"
+
+/**
+ * Network allocation vector (NAV) of the RTS/CTS MACs (MACAW, STEM) on the monotonic clock.
+ *
+ * The receive thread reserves the medium for every overheard RTS, CTS or data frame with the airtime of the rest
+ * of the exchange, derived from msg_len and the module timing (t_offset + bytes * t_perByte). Reservations are
+ * kept on vclock_now, so NTP steps of the wall clock do not shorten or stretch them, and they only ever grow:
+ * a shorter reservation never cuts off a longer one that is still running.
+ *
+ * Carrier sense:
+ *   NAV_IDLE -> NAV_RTS  overheard RTS, reserve CTS + data + ACK
+ *   NAV_RTS  -> NAV_CTS  overheard CTS, reserve data + ACK
+ *   NAV_*    -> NAV_MSG  overheard data frame, reserve ACK
+ *   NAV_RTS  -> NAV_IDLE if neither CTS nor data follow the RTS in time (the exchange failed)
+ *   NAV_*    -> NAV_IDLE once the reservation has run out
+ *
+ * Senders call nav_defer before they contend for the medium; it blocks until the medium is free and keeps the
+ * number of deferrals and the time spent deferring.
+ */
+
+typedef enum NAV_State
+{
+    NAV_IDLE, // medium free
+    NAV_RTS,  // reserved by an overheard RTS, exchange not confirmed yet
+    NAV_CTS,  // reserved by an overheard CTS
+    NAV_MSG   // reserved by an overheard data frame (for its ACK)
+} NAV_State;
+
+typedef struct NAV
+{
+    sem_t mutex;
+    NAV_State state;    // frame that set the latest reservation
+    uint64_t until;     // end of the reservation (vclock_now)
+    uint64_t rtsCheck;  // NAV_RTS: CTS or data must have been heard by then
+
+    /* statistics */
+    uint32_t deferrals;  // calls of nav_defer that had to wait
+    uint64_t deferredNs; // time spent waiting in nav_defer
+    uint32_t released;   // RTS reservations released because the exchange did not start
+} NAV;
+
+static inline void nav_init(NAV *nav)
+{
+    sem_init(&nav->mutex, 0, 1);
+    nav->state = NAV_IDLE;
+    nav->until = 0;
+    nav->rtsCheck = 0;
+    nav->deferrals = 0;
+    nav->deferredNs = 0;
+    nav->released = 0;
+}
+
+/**
+ * @returns Airtime of a frame of len bytes in ns
+ */
+static inline uint64_t nav_airtime(unsigned int t_offset, unsigned int t_perByte, unsigned int len)
+{
+    return (t_offset + (uint64_t)len * t_perByte) * 1000000;
+}
+
+// Lock held
+static inline uint64_t nav_update(NAV *nav, uint64_t now)
+{
+    // RTS without CTS or data: release its reservation (an RTS only sets the state on a free medium)
+    if (nav->state == NAV_RTS && now >= nav->rtsCheck)
+    {
+        nav->until = now;
+        nav->released++;
+    }
+
+    if (now >= nav->until)
+        nav->state = NAV_IDLE;
+
+    return nav->state == NAV_IDLE ? 0 : nav->until - now;
+}
+
+/**
+ * @brief Reserve the medium for an overheard frame
+ * @param state Frame that was heard (NAV_RTS, NAV_CTS or NAV_MSG)
+ * @param ns Airtime of the rest of the exchange
+ * @param checkNs NAV_RTS only: time within which CTS or data have to be heard
+ */
+static inline void nav_reserve(NAV *nav, NAV_State state, uint64_t ns, uint64_t checkNs)
+{
+    vclock_sem_wait(&nav->mutex);
+    uint64_t now = vclock_now();
+    nav_update(nav, now);
+
+    if (state == NAV_RTS)
+        nav->rtsCheck = now + checkNs;
+    else if (nav->state == NAV_RTS)
+        // exchange confirmed
+        nav->state = state;
+
+    if (now + ns > nav->until)
+    {
+        nav->until = now + ns;
+        // a confirmed reservation is not turned back into a pending one
+        if (state != NAV_RTS || nav->state == NAV_IDLE)
+            nav->state = state;
+    }
+    vclock_sem_post(&nav->mutex);
+}
+
+/**
+ * @returns Time in ns until the medium is free (0 -> free)
+ */
+static inline uint64_t nav_remaining(NAV *nav)
+{
+    vclock_sem_wait(&nav->mutex);
+    uint64_t remaining = nav_update(nav, vclock_now());
+    vclock_sem_post(&nav->mutex);
+    return remaining;
+}
+
+/**
+ * @brief Block until the medium is free
+ * @returns Time spent waiting in ns
+ */
+static inline uint64_t nav_defer(NAV *nav)
+{
+    uint64_t start = 0;
+
+    while (1)
+    {
+        vclock_sem_wait(&nav->mutex);
+        uint64_t now = vclock_now();
+        if (nav_update(nav, now) == 0)
+        {
+            uint64_t waited = start ? now - start : 0;
+            if (start)
+            {
+                nav->deferrals++;
+                nav->deferredNs += waited;
+            }
+            vclock_sem_post(&nav->mutex);
+            return waited;
+        }
+        if (!start)
+            start = now;
+
+        // wake at the end of the reservation, or earlier to check a pending RTS
+        uint64_t wake = nav->until;
+        if (nav->state == NAV_RTS && nav->rtsCheck < wake)
+            wake = nav->rtsCheck;
+        vclock_sem_post(&nav->mutex);
+
+        vclock_sleepUntil(wake);
+    }
+}
+
+#endif /* NAV_H */
@@ -7,6 +7,7 @@
 #include <stdarg.h> // va_list, va_start, va_end
 
 #include "common.h"
+#include "vclock.h"
 
 /**
  * @returns Current local timestamp in the yyyy-mm-dd'T'hh:mm:ss format. Eg: 2024-06-16T11:56:23
@@ -16,7 +17,7 @@ char *timestamp()
     time_t current_time;
     struct tm *time_info;
     static char time_buffer[20];
-    time(&current_time);                  // Get current time
+    vclock_time(&current_time);                  // Get current time
     time_info = localtime(&current_time); // Convert to local time
 
     // Format the timestamp